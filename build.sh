@@ -41,6 +41,10 @@ REQUIRED_FILES=(
     "plugins/sync/monitor.h"
     "plugins/sync/consumer_producer.c"
     "plugins/sync/consumer_producer.h"
+    "plugins/sync/buffer_pool.c"
+    "plugins/sync/buffer_pool.h"
+    "plugins/sync/message.c"
+    "plugins/sync/message.h"
 )
 
 print_status "Checking required files..."
@@ -53,6 +57,21 @@ done
 
 print_status "All required core files are present."
 
+# ========================
+# Sync backend selection
+# ========================
+# MONITOR_IMPL=futex ./build.sh builds monitor_t on Linux futex(2) instead of pthread mutex/condvar
+SYNC_FLAGS=""
+case "${MONITOR_IMPL:-pthread}" in
+    pthread) ;;
+    futex) SYNC_FLAGS="-DMONITOR_USE_FUTEX" ;;
+    *)
+        print_error "Unknown MONITOR_IMPL '${MONITOR_IMPL}' (expected pthread or futex)"
+        exit 1
+        ;;
+esac
+print_status "Monitor backend: ${MONITOR_IMPL:-pthread}"
+
 # ========================
 # Build plugins individually (according to example)
 # ========================
@@ -61,12 +80,14 @@ PLUGINS=("logger" "uppercaser" "rotator" "flipper" "expander" "typewriter")
 for plugin_name in "${PLUGINS[@]}"; do
     if [ -f "plugins/${plugin_name}.c" ]; then
         print_status "Building plugin: $plugin_name"
-        gcc -fPIC -shared -Wall -Wextra -Werror -Wno-unused-parameter \
+        gcc -fPIC -shared -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS \
             -o output/${plugin_name}.so \
             plugins/${plugin_name}.c \
             plugins/plugin_common.c \
             plugins/sync/monitor.c \
             plugins/sync/consumer_producer.c \
+            plugins/sync/buffer_pool.c \
+            plugins/sync/message.c \
             -ldl -lpthread || {
                 print_error "Failed to build plugin: $plugin_name"
                 exit 1
@@ -80,11 +101,11 @@ done
 # Test compile of main program
 # ========================
 print_status "Testing compilation of main analyzer..."
-gcc -Wall -Wextra -Werror -Wno-unused-parameter \
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS \
   -I. \
   -Wl,-rpath,'$ORIGIN' \
   -o output/analyzer \
-  main.c stage2_loader.c \
+  main.c stage2_loader.c plugins/sync/consumer_producer.c plugins/sync/monitor.c plugins/sync/buffer_pool.c \
   -ldl -lpthread || {
     print_error "Failed to compile main analyzer"
     exit 1
@@ -99,6 +120,8 @@ gcc -Wall -Wextra -Werror -Wno-unused-parameter \
 # Test compile of sync and common files individually
 # ========================
 print_status "Testing compilation of sync and common modules..."
-gcc -Wall -Wextra -Werror -Wno-unused-parameter -c plugins/plugin_common.c -I. -o output/plugin_common.o
-gcc -Wall -Wextra -Werror -Wno-unused-parameter -c plugins/sync/monitor.c -I. -o output/monitor.o
-gcc -Wall -Wextra -Werror -Wno-unused-parameter -c plugins/sync/consumer_producer.c -I. -o output/consumer_producer.o
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS -c plugins/plugin_common.c -I. -o output/plugin_common.o
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS -c plugins/sync/monitor.c -I. -o output/monitor.o
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS -c plugins/sync/consumer_producer.c -I. -o output/consumer_producer.o
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS -c plugins/sync/buffer_pool.c -I. -o output/buffer_pool.o
+gcc -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS -c plugins/sync/message.c -I. -o output/message.o
@@ -10,6 +10,45 @@ typedef const char* (*plugin_place_work_func_t)(const char* s);
 typedef void        (*plugin_attach_func_t)(const char* (*next_place_work)(const char*));
 typedef const char* (*plugin_wait_finished_func_t)(void);
 
+/* -------- Optional extensions (resolved if exported, NULL otherwise) -------- */
+typedef const char* (*plugin_place_work_batch_func_t)(const char* const* strs, int count);
+typedef void        (*plugin_attach_batch_func_t)(plugin_place_work_batch_func_t next_place_work_batch);
+struct cp_byte_budget;
+typedef const char* (*plugin_set_byte_budget_func_t)(struct cp_byte_budget* budget, int gate);
+typedef const char* (*plugin_set_queue_backend_func_t)(const char* name);
+typedef int         (*plugin_grant_credits_func_t)(int max_credits);
+typedef void        (*plugin_attach_credits_func_t)(plugin_grant_credits_func_t next_grant_credits);
+typedef const char* (*plugin_set_workers_func_t)(int workers);
+typedef const char* (*plugin_place_work_owned_func_t)(char* s);
+typedef const char* (*plugin_place_work_owned_batch_func_t)(char** strs, int count);
+typedef void        (*plugin_attach_owned_func_t)(plugin_place_work_owned_func_t next_place_work_owned,
+                                                  plugin_place_work_owned_batch_func_t next_place_work_owned_batch);
+struct buffer_pool;
+typedef const char* (*plugin_set_buffer_pool_func_t)(struct buffer_pool* pool);
+typedef const char* (*plugin_place_control_func_t)(int kind);
+typedef void        (*plugin_attach_control_func_t)(plugin_place_control_func_t next_place_control);
+
+/* -------- Instance ABI (optional): one .so serves several stages, each call takes the instance handle -------- */
+typedef const char* (*plugin_instance_init_func_t)(int queue_size, const char* queue_backend, void** out_instance);
+typedef const char* (*plugin_instance_fini_func_t)(void* instance);
+typedef const char* (*plugin_instance_place_work_func_t)(void* instance, const char* s);
+typedef void        (*plugin_instance_attach_func_t)(void* instance, plugin_instance_place_work_func_t next_place_work, void* next_instance);
+typedef const char* (*plugin_instance_wait_finished_func_t)(void* instance);
+typedef const char* (*plugin_instance_place_work_batch_func_t)(void* instance, const char* const* strs, int count);
+typedef void        (*plugin_instance_attach_batch_func_t)(void* instance, plugin_instance_place_work_batch_func_t next_place_work_batch);
+typedef const char* (*plugin_instance_set_byte_budget_func_t)(void* instance, struct cp_byte_budget* budget, int gate);
+typedef int         (*plugin_instance_grant_credits_func_t)(void* instance, int max_credits);
+typedef void        (*plugin_instance_attach_credits_func_t)(void* instance, plugin_instance_grant_credits_func_t next_grant_credits);
+typedef const char* (*plugin_instance_set_workers_func_t)(void* instance, int workers);
+typedef const char* (*plugin_instance_place_work_owned_func_t)(void* instance, char* s);
+typedef const char* (*plugin_instance_place_work_owned_batch_func_t)(void* instance, char** strs, int count);
+typedef void        (*plugin_instance_attach_owned_func_t)(void* instance, plugin_instance_place_work_owned_func_t next_place_work_owned,
+                                                           plugin_instance_place_work_owned_batch_func_t next_place_work_owned_batch);
+typedef const char* (*plugin_instance_place_control_func_t)(void* instance, int kind);
+typedef void        (*plugin_instance_attach_control_func_t)(void* instance, plugin_instance_place_control_func_t next_place_control);
+
+#define PLUGIN_QUEUE_BACKEND_MAX 32
+
 /* -------- Handle we keep per loaded plugin -------- */
 typedef struct {
     plugin_init_func_t          init;
@@ -17,11 +56,43 @@ typedef struct {
     plugin_place_work_func_t    place_work;
     plugin_attach_func_t        attach;
     plugin_wait_finished_func_t wait_finished;
+    plugin_place_work_batch_func_t place_work_batch; /* optional */
+    plugin_attach_batch_func_t  attach_batch;        /* optional */
+    plugin_set_byte_budget_func_t set_byte_budget;   /* optional */
+    plugin_set_queue_backend_func_t set_queue_backend; /* optional */
+    plugin_grant_credits_func_t grant_credits;       /* optional */
+    plugin_attach_credits_func_t attach_credits;     /* optional */
+    plugin_set_workers_func_t   set_workers;         /* optional */
+    plugin_place_work_owned_func_t place_work_owned; /* optional */
+    plugin_place_work_owned_batch_func_t place_work_owned_batch; /* optional */
+    plugin_attach_owned_func_t  attach_owned;        /* optional */
+    plugin_set_buffer_pool_func_t set_buffer_pool;   /* optional; kept only if the plugin took the shared pool */
+    plugin_place_control_func_t place_control;       /* optional */
+    plugin_attach_control_func_t attach_control;     /* optional */
+    /* Instance ABI: all five core calls set, or all NULL (legacy plugin, one stage per .so) */
+    plugin_instance_init_func_t          instance_init;
+    plugin_instance_fini_func_t          instance_fini;
+    plugin_instance_place_work_func_t    instance_place_work;
+    plugin_instance_attach_func_t        instance_attach;
+    plugin_instance_wait_finished_func_t instance_wait_finished;
+    plugin_instance_place_work_batch_func_t instance_place_work_batch; /* optional */
+    plugin_instance_attach_batch_func_t  instance_attach_batch;        /* optional */
+    plugin_instance_set_byte_budget_func_t instance_set_byte_budget;   /* optional */
+    plugin_instance_grant_credits_func_t instance_grant_credits;       /* optional */
+    plugin_instance_attach_credits_func_t instance_attach_credits;     /* optional */
+    plugin_instance_set_workers_func_t   instance_set_workers;         /* optional */
+    plugin_instance_place_work_owned_func_t instance_place_work_owned; /* optional */
+    plugin_instance_place_work_owned_batch_func_t instance_place_work_owned_batch; /* optional */
+    plugin_instance_attach_owned_func_t  instance_attach_owned;        /* optional */
+    plugin_instance_place_control_func_t instance_place_control;       /* optional */
+    plugin_instance_attach_control_func_t instance_attach_control;     /* optional */
+    void*                       instance;      /* this stage's instance (NULL until init) */
+    char                        queue_backend[PLUGIN_QUEUE_BACKEND_MAX]; /* passed to instance_init ("" = default) */
     char*                       name;    /* plugin name (without .so), owned by us */
     void*                       handle;  /* dlopen handle */
 } plugin_handle_t;
 
-/* Public API: loads all plugins and resolves required symbols.
+/* Public API: loads all plugins, resolves required symbols and shares the analyzer's buffer pool with them.
  * On ANY failure:
  *  - prints the error to stderr
  *  - prints usage (via the callback) to stdout
@@ -31,6 +102,21 @@ typedef struct {
  */
 void stage2_load_plugins(char** plugin_names, int plugin_count, plugin_handle_t** out_arr, void (*print_usage_to_stdout)(void));
 
+/* Per-stage calls: through the instance ABI when the plugin exports it, else through the legacy symbols.
+ * Each returns NULL on success or an error message, like the plugin calls themselves. */
+const char* plugin_handle_init(plugin_handle_t* p, int queue_size);
+const char* plugin_handle_fini(plugin_handle_t* p);
+const char* plugin_handle_place_work(plugin_handle_t* p, const char* s);
+const char* plugin_handle_place_end(plugin_handle_t* p);   /* END control if supported, else the "<END>" string */
+const char* plugin_handle_wait_finished(plugin_handle_t* p);
+int         plugin_handle_has_byte_budget(const plugin_handle_t* p);
+const char* plugin_handle_set_byte_budget(plugin_handle_t* p, struct cp_byte_budget* budget, int gate);
+const char* plugin_handle_set_workers(plugin_handle_t* p, int workers);
+
+/* Wire stage p to stage next: place_work, plus batches, owned handoff, control messages and
+ * (if use_credits) credits when both sides support them */
+void plugin_handle_attach(plugin_handle_t* p, plugin_handle_t* next, int use_credits);
+
 /* (Optional) helpers exposed for unit-testing; can be left unused by callers. */
 char* build_so_filename(const char* name); /* returns "<name>.so" (heap-allocated, caller frees) */
 
@@ -15,12 +15,7 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    // Do not transform the termination token; pass it through unchanged
-    if (is_end(input)) {
-        return input;
-    }
-
-    size_t len = strlen(input);
+    size_t len = message_length(input);
 
     // Nothing to expand for empty or single-character strings
     if (len <= 1) {
@@ -30,8 +25,8 @@ const char* plugin_transform(const char* input)
     // Output length: one space between each pair => len + (len - 1)
     size_t out_len = len + (len - 1);
 
-    // Allocate output buffer (out_len + 1 for the terminating NUL)
-    char* out = (char*)malloc(out_len + 1);
+    // Allocate the output message (out_len characters; we write them and the NUL)
+    char* out = message_alloc(out_len);
     if (out == NULL) {
         // Best-effort fallback: return original input without crashing
         return input;
@@ -50,6 +45,79 @@ const char* plugin_transform(const char* input)
     return out;
 }
 
+/**
+ * In-place form of plugin_transform: spreads the line out in its own buffer.
+ * The line grows to len + (len - 1) characters, so it asks for a larger buffer when needed.
+ * @param buf Line to transform (*len characters plus NUL)
+ * @param len Line length (updated)
+ * @param capacity Bytes available in buf
+ * @return 0 on success, -1 on invalid input, or the capacity needed
+ */
+long plugin_transform_inplace(char* buf, size_t* len, size_t capacity)
+{
+    if (buf == NULL || len == NULL) {
+        return -1;
+    }
+
+    // Nothing to expand for empty or single-character strings
+    size_t n = *len;
+    if (n <= 1) {
+        return 0;
+    }
+    size_t out_len = n + (n - 1);
+    if (capacity < out_len + 1) {
+        return (long)(out_len + 1);
+    }
+
+    // Fill from the back so no character is overwritten before it is moved
+    buf[out_len] = '\0';
+    for (size_t i = n; i-- > 0;) {
+        buf[2 * i] = buf[i];
+        if (i > 0) {
+            buf[2 * i - 1] = ' ';
+        }
+    }
+    *len = out_len;
+    return 0;
+}
+
+/**
+ * Batch form of plugin_transform: spreads out every line of the batch in one call.
+ * A line of n > 1 characters becomes n + (n - 1), so the output offsets are worked out first.
+ * @param in Lines to transform
+ * @param out Receives the expanded lines
+ * @return 0 on success, -1 on invalid input, or the capacity it needs
+ */
+long plugin_transform_batch(const plugin_batch_t* in, plugin_batch_t* out)
+{
+    if (in == NULL || out == NULL) {
+        return -1;
+    }
+
+    // Output offsets: one space between each pair of characters
+    out->offsets[0] = 0;
+    for (int k = 0; k < in->count; ++k) {
+        size_t n = in->offsets[k + 1] - in->offsets[k];
+        out->offsets[k + 1] = out->offsets[k] + (n > 1 ? n + (n - 1) : n);
+    }
+    if (out->capacity < out->offsets[in->count]) {
+        return (long)out->offsets[in->count];
+    }
+
+    for (int k = 0; k < in->count; ++k) {
+        const char* src = in->data + in->offsets[k];
+        size_t n = in->offsets[k + 1] - in->offsets[k];
+        char* dst = out->data + out->offsets[k];
+        for (size_t i = 0; i < n; ++i) {
+            if (i > 0) {
+                *dst++ = ' ';
+            }
+            *dst++ = src[i];
+        }
+    }
+    return 0;
+}
+
 /**
  * Initialize the expander plugin
  * @param queue_size Maximum number of items that can be queued
@@ -57,5 +125,19 @@ const char* plugin_transform(const char* input)
  */
 const char* plugin_init(int queue_size)
 {
-    return common_plugin_init(plugin_transform, "expander", queue_size);
+    return common_plugin_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch, "expander",
+                                    queue_size);
+}
+
+/**
+ * Create and start a new instance of the expander plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch,
+                                             "expander", queue_size, queue_backend, out_instance);
 }
@@ -16,19 +16,14 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    // Do not transform the termination token; pass it through unchanged
-    if (is_end(input)) {
-        return input;
-    }
-
     // For empty or single-character strings, there is nothing to flip
-    size_t len = strlen(input);
+    size_t len = message_length(input);
     if (len <= 1) {
         return input;
     }
 
-    // Allocate output buffer (len + 1 for the terminating NUL)
-    char* out = (char*)malloc(len + 1);
+    // Allocate the output message (len characters; we write them and the NUL)
+    char* out = message_alloc(len);
     if (out == NULL) {
         // Best-effort fallback: return original input without crashing
         return input;
@@ -42,6 +37,57 @@ const char* plugin_transform(const char* input)
 
     return out;}
 
+/**
+ * In-place form of plugin_transform: reverses the line in its own buffer
+ * @param buf Line to transform (*len characters plus NUL)
+ * @param len Line length (unchanged)
+ * @param capacity Bytes available in buf (unused: the length never changes)
+ * @return 0 on success, -1 on invalid input
+ */
+long plugin_transform_inplace(char* buf, size_t* len, size_t capacity)
+{
+    (void)capacity;
+    if (buf == NULL || len == NULL) {
+        return -1;
+    }
+
+    // Swap from both ends towards the middle
+    for (size_t i = 0, j = *len; i + 1 < j; ++i, --j) {
+        char tmp = buf[i];
+        buf[i] = buf[j - 1];
+        buf[j - 1] = tmp;
+    }
+    return 0;
+}
+
+/**
+ * Batch form of plugin_transform: reverses every line of the batch in one call.
+ * Lines keep their lengths, so each one is copied backwards into the same place in out.
+ * @param in Lines to transform
+ * @param out Receives the reversed lines
+ * @return 0 on success, -1 on invalid input, or the capacity it needs
+ */
+long plugin_transform_batch(const plugin_batch_t* in, plugin_batch_t* out)
+{
+    if (in == NULL || out == NULL) {
+        return -1;
+    }
+    size_t bytes = in->offsets[in->count];
+    if (out->capacity < bytes) {
+        return (long)bytes;
+    }
+
+    for (int k = 0; k < in->count; ++k) {
+        const char* src = in->data + in->offsets[k];
+        char* dst = out->data + in->offsets[k] + (in->offsets[k + 1] - in->offsets[k]);
+        for (size_t i = in->offsets[k]; i < in->offsets[k + 1]; ++i) {
+            *--dst = *src++;
+        }
+    }
+    memcpy(out->offsets, in->offsets, (size_t)(in->count + 1) * sizeof(size_t));
+    return 0;
+}
+
 /**
  * Initialize the flipper plugin
  * @param queue_size Maximum number of items that can be queued
@@ -49,5 +95,19 @@ const char* plugin_transform(const char* input)
  */
 const char* plugin_init(int queue_size)
 {
-    return common_plugin_init(plugin_transform, "flipper", queue_size);
+    return common_plugin_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch, "flipper",
+                                    queue_size);
+}
+
+/**
+ * Create and start a new instance of the flipper plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch,
+                                             "flipper", queue_size, queue_backend, out_instance);
 }
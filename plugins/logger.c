@@ -14,11 +14,6 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    // Do not print for the termination token; pass it through unchanged
-    if (is_end(input)) {
-        return input;
-    }
-
     // Print the log line to STDOUT (empty strings are allowed)
     // Single call to keep the line as atomic as possible
     fprintf(stdout, "[logger] %s\n", input);
@@ -37,3 +32,15 @@ const char* plugin_init(int queue_size)
 {
     return common_plugin_init(plugin_transform, "logger", queue_size);
 }
+
+/**
+ * Create and start a new instance of the logger plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init(plugin_transform, "logger", queue_size, queue_backend, out_instance);
+}
@@ -1,567 +1,2736 @@
-#define _POSIX_C_SOURCE 200809L
-
-#include "plugin_common.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-static const char END_SENTINEL[] = "<END>";
-static plugin_context_t g_plugin_context;
-
-/**
- * Returns 1 if s equals the END sentinel exactly, otherwise 0.
- * Treats NULL as "not END".
- */
-inline int is_end(const char* s) {
-    return (s != NULL && strcmp(s, END_SENTINEL) == 0);
-}
-
-
-/**
- * Generic consumer thread function
- * This function runs in a separate thread and processes items from the queue
- * @param arg Pointer to plugin_context_t
- * @return NULL
- */
-void* plugin_consumer_thread(void* arg)
-{
-    plugin_context_t* ctx = (plugin_context_t*)arg;
-    if (!ctx || !ctx->queue || !ctx->process_function) {
-        /* Nothing we can safely do */
-        return NULL;
-    }
-
-    for (;;) {
-        /* 1) Blocking fetch from the queue (no busy-wait) */
-        char* in = consumer_producer_get(ctx->queue);
-        if (in == NULL) {
-            continue;
-        }
-
-        /* 2) END propagation and shutdown */
-        if (is_end(in)) {
-            if (ctx->attached && ctx->next_place_work) {
-                /* Forward END downstream; ownership passes on success */
-                const char* err = ctx->next_place_work(in);
-                if (err != NULL) {
-                    /* Downstream refused END; we still own the buffer, free it here */
-                    log_error(ctx, err);
-                    free(in);
-                }
-            } else {
-                /* Last plugin: free END here */
-                free(in);
-            }
-
-            /* Mark finished and exit the loop (graceful shutdown) */
-            ctx->finished = 1;
-            consumer_producer_signal_finished(ctx->queue);
-            return NULL;
-        }
-
-        /* 3) Process a regular string */
-        const char* out_c = ctx->process_function(in);
-        char* out = (char*)out_c; /* We may need to free it depending on ownership rules */
-
-        if (out == NULL) {
-            /* Transform failed: nothing to send downstream; we still own input */
-            log_error(ctx, "transform failed");
-            free(in);
-            continue;
-        }
-
-        /* 4) Forward or finalize depending on whether there is a next stage */
-        if (ctx->attached && ctx->next_place_work) {
-            /* Forward downstream; ownership transfers on success */
-            const char* err = ctx->next_place_work(out);
-            if (err == NULL) {
-                /* Successfully handed off `out`; release any old input we still own */
-                if (out != in) {
-                    free(in);
-                }
-                /* If out == in (in-place), we passed the same pointer; do not free here */
-            } else {
-                log_error(ctx, err);
-                /* Downstream failed; we still own whatever we tried to send */
-                if (out != in) {
-                    /* We allocated a new buffer: free both the new output and old input */
-                    free(out);
-                    free(in);
-                } else {
-                    /* In-place case: we only have one buffer to free */
-                    free(in);
-                }
-                /* Downstream is broken; exit to avoid endless failures */
-                continue;
-            }
-        } else {
-            /* Last plugin in the chain: nothing to forward
-               We must free the final string locally to avoid leaks */
-            if (out != in) {
-                /* We created a new buffer: free both new output and old input */
-                free(out);
-                free(in);
-            } else {
-                /* In-place: single buffer to free */
-                free(in);
-            }
-            /* Continue processing until END arrives */
-        }
-    }
-    return NULL;
-}
-
-
-
-
-//  void* plugin_consumer_thread(void* arg)
-// {
-//     plugin_context_t* ctx = (plugin_context_t*)arg;
-
-//     for (;;) {
-//         /* Pull next item from our input queue */
-//         char* in = consumer_producer_get(ctx->queue);
-//         if (in == NULL) {
-//             /* Graceful upstream end (nothing more to consume) */
-//             break;
-//         }
-
-//         /* Handle end-of-stream token: never transform it */
-//         if (is_end(in)) {
-//             if (ctx->attached == 1 && ctx->next_place_work != NULL) {
-//                 /* Forward the token downstream. Ownership moves to the next stage. */
-//                 const char* err = ctx->next_place_work(in);
-//                 if (err != NULL) {
-//                     log_error(ctx, err);
-//                     free(in);  /* We still own it if forwarding failed */
-//                 }
-//                 /* DO NOT free(in); next stage will free it. */
-//             } else {
-//                 /* Last stage: safe to release the token here. */
-//                 free(in);
-//             }
-
-//             /* Mark our stage as finished and stop consuming */
-//             ctx->finished = 1;
-//             consumer_producer_signal_finished(ctx->queue);
-//             break;
-//         }
-
-//         /* Transform. We currently own 'in'. */
-//         const char* out = ctx->process_function(in);
-//         if (out == NULL) {
-//             /* Transformation failed for this item; drop it and continue. */
-//             log_error(ctx, "transform failed");
-//             free(in);
-//             continue;
-//         }
-
-//         if (ctx->attached == 1 && ctx->next_place_work != NULL) {
-//             /* Non-final stage: forward result to next stage.
-//                The queue takes ownership of 'out'. */
-//             const char* err = ctx->next_place_work(out);
-//             if (err != NULL) {
-//                 log_error(ctx, err);
-//             }
-
-//             /* Memory rules:
-//                - If 'out' is a NEW buffer (out != in), we no longer need 'in' -> free it.
-//                - If 'out' == 'in', DO NOT free here; next stage now owns that buffer. */
-//             if (out != in) {
-//                 free(in);
-//                 free(out);
-//             }
-//             /* DO NOT free(out) here; ownership has moved downstream. */
-
-//         } else {
-//             /* Final stage: the plugin already performed side-effects (e.g., printed).
-//                We must free exactly once per allocated buffer: */
-//             if (out == in) {
-//                 /* Single buffer case (logger/typewriter): free once. */
-//                 free((void*)out);
-//             } else {
-//                 /* Two distinct buffers: free both. */
-//                 free((void*)out);
-//                 free(in);
-//             }
-//         }
-//     }
-
-//     return NULL;
-// }
-
-
-
-// void* plugin_consumer_thread(void* arg)
-// {
-//     // Convert and validate context
-//     plugin_context_t* ctx = (plugin_context_t*)arg;
-//     if (ctx == NULL || ctx->queue == NULL) {
-//         // Cannot even log safely without a context
-//         return NULL;
-//     }
-
-//     if (ctx->process_function == NULL) {
-//         log_error(ctx, "no process_function provided");
-//         return NULL;
-//     }
-
-//     // Main work loop
-//     for (;;)
-//     {
-//         // Pull next item (blocks if empty). NULL means queue was finished and drained.
-//         char* in = consumer_producer_get(ctx->queue);
-//         if (in == NULL) {
-//             break;  // graceful end-of-input
-//         }
-
-//         // Handle end-of-stream token first (do not process/print it)
-//         if (is_end(in)) {
-//             if (ctx->attached == 1 && ctx->next_place_work != NULL) {
-//                 const char* err = ctx->next_place_work(in);
-//                 if (err != NULL) {
-//                     log_error(ctx, err);
-//                 }
-//             }
-//             free(in);
-//             consumer_producer_signal_finished(ctx->queue);
-//             ctx->finished = 1;
-//             break;
-//         }
-
-//         // Transform the input. Ownership of 'in' is on the worker.
-//         const char* out = ctx->process_function(in);
-
-//         if (out == NULL) {
-//             // Transform failed for this item — log and continue with the next one
-//             log_error(ctx, "transform failed");
-//             free(in);
-//             continue;
-//         }
-
-//         // Free the input after transform 
-//         if (out != in) {
-//             free(in);
-//         } 
-
-
-//         // Forward downstream if attached; otherwise print to stdout
-//         if (ctx->attached == 1 && ctx->next_place_work != NULL) {
-//             const char* err = ctx->next_place_work(out);
-//             if (err != NULL) {
-//                 log_error(ctx, err);
-//             }
-//         } 
-        
-//         // own 'out' and must free after forwarding
-//         free((void*)out);
-//     }
-
-//     // Mark worker finished (join is done in plugin_fini, not here)
-//     ctx->finished = 1;
-//     return NULL;
-// }
-
-
-
-/**
- * Print error message in the format [ERROR][Plugin Name] - message
- * @param context Plugin context
- * @param message Error message
- */
-void log_error(plugin_context_t* context, const char* message)
-{
-    // Resolve plugin name (fallback to "unknown" if context or name is missing)
-    const char* name = (context && context->name) ? context->name : "unknown";
-
-    // Resolve message text (fallback to "unknown error" if NULL/empty)
-    const char* text = (message && message[0] != '\0') ? message : "unknown error";
-
-    // Avoid interleaving from multiple threads writing to stderr
-    flockfile(stderr);
-
-    // Print in the exact required format and ensure newline at the end
-    // Use a fixed format string to avoid format-string vulnerabilities
-    fprintf(stderr, "[ERROR][%s] - %s\n", name, text);
-
-    // // Flush immediately so logs appear in real time
-    // fflush(stderr);
-
-    // Release the stream lock
-    funlockfile(stderr);
-}
-
-/**
- * Print info message in the format [INFO][Plugin Name] - message
- * @param context Plugin context
- * @param message Info message
- */
-void log_info(plugin_context_t* context, const char* message)
-{
-    // Resolve plugin name (fallback to "unknown" if context or name is missing)
-    const char* name = (context && context->name) ? context->name : "unknown";
-
-    // Resolve message text (fallback to "no info" if NULL/empty)
-    const char* text = (message && message[0] != '\0') ? message : "no info";
-
-    // Prevent interleaved lines from multiple threads
-    flockfile(stderr);
-
-    // Print in the required format and ensure newline
-    fprintf(stderr, "[INFO][%s] - %s\n", name, text);
-
-    // // Flush to show logs immediately
-    // fflush(stderr);
-
-    // Release the stream lock
-    funlockfile(stderr);
-}
-
-/**
- * Get the plugin's name
- * @return The plugin's name (should not be modified or freed)
- */
-const char* plugin_get_name(void)
-{
-    // Snapshot fields locally to avoid reading changing state twice
-    const int inited = g_plugin_context.initialized;
-    const char* name = g_plugin_context.name;
-
-    // If called before init, during/after fini, or name missing → return a safe fallback
-    if (inited != 1 || name == NULL || name[0] == '\0') {
-        return "unknown";
-    }
-
-    return name;
-}
-
-
-/**
- * Initialize the common plugin infrastructure with the specified queue size
- * @param process_function Plugin-specific processing function
- * @param name Plugin name
- * @param queue_size Maximum number of items that can be queued
- * @return NULL on success, error message on failure
- */
-const char* common_plugin_init(const char* (*process_function)(const char*),
-                               const char* name,
-                               int queue_size)
-{
-    // Validate inputs
-    if (process_function == NULL) {
-        return "invalid process function";
-    }
-    if (name == NULL || name[0] == '\0') {
-        return "invalid plugin name";
-    }
-    if (queue_size <= 0) {
-        return "invalid queue size";
-    }
-    if (g_plugin_context.initialized == 1) {
-        return "plugin already initialized";
-    }
-
-    // Reset context to a known base state (do not mark initialized yet)
-    g_plugin_context.attached       = 0;
-    g_plugin_context.initialized    = 0;
-    g_plugin_context.finished       = 0;
-    g_plugin_context.worker_joined  = 0;
-    g_plugin_context.next_place_work = NULL;
-    g_plugin_context.queue          = NULL;
-    g_plugin_context.name           = name;               // set name early for logging
-    g_plugin_context.process_function = process_function;
-
-    // Allocate and initialize the queue
-    g_plugin_context.queue = (consumer_producer_t*)malloc(sizeof(consumer_producer_t));
-    if (g_plugin_context.queue == NULL) {
-        log_error(&g_plugin_context, "out of memory");
-        return "out of memory";
-    }
-
-    const char* qerr = consumer_producer_init(g_plugin_context.queue, queue_size);
-    if (qerr != NULL) {
-        // Propagate the queue's error upward; clean up the allocation
-        log_error(&g_plugin_context, qerr);
-        free(g_plugin_context.queue);
-        g_plugin_context.queue = NULL;
-        return qerr;
-    }
-
-    // Start the worker thread
-    int trc = pthread_create(&g_plugin_context.consumer_thread,
-                             NULL,
-                             plugin_consumer_thread,
-                             (void*)&g_plugin_context);
-    if (trc != 0) {
-        log_error(&g_plugin_context, "thread create failed");
-        consumer_producer_destroy(g_plugin_context.queue);
-        free(g_plugin_context.queue);
-        g_plugin_context.queue = NULL;
-
-        // keep context in a non-initialized, clean state
-        g_plugin_context.attached       = 0;
-        g_plugin_context.finished       = 0;
-        g_plugin_context.initialized    = 0;
-        g_plugin_context.worker_joined  = 0;
-        g_plugin_context.next_place_work = NULL;
-        return "thread create failed";
-    }
-
-    // Mark success only after everything is ready
-    g_plugin_context.initialized = 1;
-    return NULL;
-}
-
-/**
- * Finalize the plugin - drain queue and terminate thread gracefully (pthread_join)
- * @return NULL on success, error message on failure
- */
-// Finalize the plugin: ensure all work is drained, join the worker, and release resources.
-// Returns NULL on success, or a constant error string on failure.
-const char* plugin_fini(void)
-{
-    // Validate initialization state
-    if (g_plugin_context.initialized != 1) {
-        log_error(&g_plugin_context, "plugin_fini: plugin not initialized");
-        return "plugin not initialized";
-    }
-
-    // Guard against joining from the worker thread itself
-    if (pthread_equal(pthread_self(), g_plugin_context.consumer_thread)) {
-        log_error(&g_plugin_context, "plugin_fini: cannot join self");
-        return "cannot join self";
-    }
-
-    // Block until the queue has been fully drained 
-    const char* werr = plugin_wait_finished();
-    if (werr != NULL) {
-        log_error(&g_plugin_context, werr);
-        return werr;
-    } 
-
-    // Join the worker thread exactly once
-    if (g_plugin_context.worker_joined == 0) {
-        int jrc = pthread_join(g_plugin_context.consumer_thread, NULL);
-        if (jrc != 0) {
-            log_error(&g_plugin_context, "plugin_fini: join failed");
-            return "join failed";
-        }
-        g_plugin_context.worker_joined = 1;
-    }
-
-    // Destroy and free the queue
-    if (g_plugin_context.queue != NULL) {
-        consumer_producer_destroy(g_plugin_context.queue);
-        free(g_plugin_context.queue);
-        g_plugin_context.queue = NULL;
-    }
-
-    // Reset context fields (do not free 'name' — no ownership)
-    g_plugin_context.next_place_work  = NULL;
-    g_plugin_context.process_function = NULL;
-    g_plugin_context.attached         = 0;
-    g_plugin_context.finished         = 0;
-    g_plugin_context.name             = NULL;   // optional: prevent accidental reuse
-    // (optional) clear thread handle
-    g_plugin_context.consumer_thread  = (pthread_t)0;
-
-    // Mark as not initialized
-    g_plugin_context.initialized = 0;
-
-    // Success
-    return NULL;
-}
-
-
-/**
- * Place work (a string) into the plugin's queue
- * @param str The string to process (plugin takes ownership if it allocates new memory)
- * @return NULL on success, error message on failure
- */
-const char* plugin_place_work(const char* str)
-{
-    // Basic validation
-    if (str == NULL) {
-        log_error(&g_plugin_context, "plugin_place_work: invalid input (NULL)");
-        return "invalid input";  // SDK: non-NULL on failure
-    }
-    if (g_plugin_context.initialized != 1) {
-        log_error(&g_plugin_context, "plugin_place_work: plugin not initialized");
-        return "plugin not initialized";
-    }
-
-    // Duplicate input so the queue/worker owns the memory
-    char* dup = strdup(str);
-    if (dup == NULL) {
-        log_error(&g_plugin_context, "plugin_place_work: out of memory");
-        return "out of memory";
-    }
-
-    // Enqueue (queue takes ownership on success)
-    const char* err = consumer_producer_put(g_plugin_context.queue, dup);
-    if (err != NULL) {
-        // put failed — we still own 'dup'
-        free(dup);
-        log_error(&g_plugin_context, err);
-        return err;  // propagate queue's constant error string
-    }
-
-    // Success
-    return NULL;
-}
-
-/**
- * Attach this plugin to the next plugin in the chain
- * @param next_place_work Function pointer to the next plugin's place_work function
- */
-void plugin_attach(const char* (*next_place_work)(const char*))
-{
-    // Ensure attach is called only after successful init
-    if (g_plugin_context.initialized != 1) {
-        log_error(&g_plugin_context, "attach called before init");
-        return;
-    }
-
-    // Prevent attaching while/after finishing
-    if (g_plugin_context.finished == 1) {
-        log_error(&g_plugin_context, "attach after finish");
-        return;
-    }
-
-    // Prevent double attach: keep the original wiring
-    if (g_plugin_context.attached == 1) {
-        log_error(&g_plugin_context, "attach called twice");
-        return;
-    }
-
-
-    // Store downstream hook (NULL means this is the last plugin in the chain)
-    g_plugin_context.next_place_work = next_place_work;
-
-    // Mark that attach() was explicitly called (even if next_place_work == NULL)
-    g_plugin_context.attached = 1;
-}
-
-/**
- * Wait until the plugin has finished processing all work and is ready to shutdown
- * This is a blocking function used for graceful shutdown coordination
- * @return NULL on success, error message on failure
- */
-const char* plugin_wait_finished(void)
-{
-    // Validate initialization state
-    if (g_plugin_context.initialized != 1) {
-        log_error(&g_plugin_context, "plugin_wait_finished: plugin not initialized");
-        return "plugin not initialized";
-    }
-
-    // Block until the queue is marked finished and fully drained
-    int er = consumer_producer_wait_finished(g_plugin_context.queue);
-    if (er != 0) {
-        log_error(&g_plugin_context, "plugin_wait_finished: wait finished failed");
-        return "wait finished failed";
-    }
-
-    // Success 
-    return NULL;
-}
+#define _POSIX_C_SOURCE 200809L
+
+#include "plugin_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+
+static const char END_SENTINEL[] = "<END>";
+static plugin_context_t g_plugin_context;   // Default instance behind the legacy plugin_* symbols
+
+/* Queue items standing for control messages, one per kind. Only their addresses matter: each
+   copy of this file has its own, so controls cross into another plugin through its place_control. */
+static char g_control_items[PLUGIN_CONTROL_KINDS];
+
+/* Environment variable selecting the queue backend for every stage */
+static const char QUEUE_MODE_ENV[] = "ANALYZER_QUEUE_MODE";
+
+/* Backend chosen for this stage by plugin_set_queue_backend (NULL = ANALYZER_QUEUE_MODE) */
+static const cp_backend_t* g_queue_backend = NULL;
+
+/**
+ * Resolve the queue backend from ANALYZER_QUEUE_MODE ("locked", "spsc", "mpmc" or "inline").
+ * Unset or empty means the default locked queue. The analyzer feeds every stage
+ * from exactly one thread, so "spsc" is safe for pipelines built by main;
+ * "mpmc" is for stages served by several threads.
+ * @param out_backend Receives the resolved backend
+ * @return NULL on success, error message on an unknown value
+ */
+static const char* queue_backend_from_env(const cp_backend_t** out_backend)
+{
+    const char* value = getenv(QUEUE_MODE_ENV);
+
+    *out_backend = &cp_backend_locked;
+    if (value == NULL || value[0] == '\0') {
+        return NULL;
+    }
+    *out_backend = consumer_producer_backend(value);
+    if (*out_backend == NULL) {
+        return "invalid ANALYZER_QUEUE_MODE (expected locked, spsc, mpmc or inline)";
+    }
+    return NULL;
+}
+
+/* Environment variables selecting how blocked queue calls wait in this pipeline */
+static const char WAIT_STRATEGY_ENV[] = "ANALYZER_WAIT_STRATEGY";
+static const char SPIN_ITERS_ENV[] = "ANALYZER_SPIN_ITERS";
+
+/**
+ * Resolve the wait strategy from ANALYZER_WAIT_STRATEGY ("park", "spin" or "adaptive")
+ * and its spin budget from ANALYZER_SPIN_ITERS (a positive iteration count).
+ * Unset or empty means parking, which burns no CPU while a stage is idle.
+ * @param out_strategy Receives the resolved strategy
+ * @param out_spin_limit Receives the spin budget (0 = queue default)
+ * @return NULL on success, error message on an unknown value
+ */
+static const char* wait_strategy_from_env(consumer_producer_wait_t* out_strategy, int* out_spin_limit)
+{
+    const char* value = getenv(WAIT_STRATEGY_ENV);
+    const char* iters = getenv(SPIN_ITERS_ENV);
+
+    *out_strategy = CP_WAIT_PARK;
+    *out_spin_limit = 0;
+    if (value == NULL || value[0] == '\0' || strcmp(value, "park") == 0) {
+        *out_strategy = CP_WAIT_PARK;
+    } else if (strcmp(value, "spin") == 0) {
+        *out_strategy = CP_WAIT_SPIN;
+    } else if (strcmp(value, "adaptive") == 0) {
+        *out_strategy = CP_WAIT_ADAPTIVE;
+    } else {
+        return "invalid ANALYZER_WAIT_STRATEGY (expected park, spin or adaptive)";
+    }
+
+    if (iters != NULL && iters[0] != '\0') {
+        char* end = NULL;
+        long n = strtol(iters, &end, 10);
+        if (*end != '\0' || n <= 0 || n > INT_MAX) {
+            return "invalid ANALYZER_SPIN_ITERS (expected a positive integer)";
+        }
+        *out_spin_limit = (int)n;
+    }
+    return NULL;
+}
+
+/* Environment variables enabling elastic queue capacity in this pipeline */
+static const char QUEUE_MAX_ENV[] = "ANALYZER_QUEUE_MAX";
+static const char QUEUE_HIGH_ENV[] = "ANALYZER_QUEUE_HIGH_WATERMARK";
+static const char QUEUE_LOW_ENV[] = "ANALYZER_QUEUE_LOW_WATERMARK";
+
+/**
+ * Read an optional positive integer from the environment
+ * @param name Variable name
+ * @param out Receives the value (left untouched when unset or empty)
+ * @return 0 if unset or valid, -1 if set to anything but a positive integer
+ */
+static int positive_int_from_env(const char* name, int* out)
+{
+    const char* value = getenv(name);
+    if (value == NULL || value[0] == '\0') {
+        return 0;
+    }
+    char* end = NULL;
+    long n = strtol(value, &end, 10);
+    if (*end != '\0' || n <= 0 || n > INT_MAX) {
+        return -1;
+    }
+    *out = (int)n;
+    return 0;
+}
+
+/**
+ * Resolve elastic capacity from ANALYZER_QUEUE_MAX (the largest capacity a queue may grow to)
+ * and the optional ANALYZER_QUEUE_HIGH_WATERMARK / ANALYZER_QUEUE_LOW_WATERMARK percentages.
+ * Unset means a fixed capacity of queue_size, exactly as given on the command line.
+ * @param out_max Receives the maximum capacity (0 = elastic capacity disabled)
+ * @param out_high Receives the high watermark (0 = queue default)
+ * @param out_low Receives the low watermark (0 = queue default)
+ * @return NULL on success, error message on an invalid value
+ */
+static const char* elastic_from_env(int* out_max, int* out_high, int* out_low)
+{
+    *out_max = 0;
+    *out_high = 0;
+    *out_low = 0;
+    if (positive_int_from_env(QUEUE_MAX_ENV, out_max) != 0) {
+        return "invalid ANALYZER_QUEUE_MAX (expected a positive integer)";
+    }
+    if (positive_int_from_env(QUEUE_HIGH_ENV, out_high) != 0 || *out_high > 100) {
+        return "invalid ANALYZER_QUEUE_HIGH_WATERMARK (expected a percentage)";
+    }
+    if (positive_int_from_env(QUEUE_LOW_ENV, out_low) != 0 || *out_low > 100) {
+        return "invalid ANALYZER_QUEUE_LOW_WATERMARK (expected a percentage)";
+    }
+    return NULL;
+}
+
+/* Environment variable capping the bytes held by each stage queue */
+static const char QUEUE_BYTES_ENV[] = "ANALYZER_QUEUE_BYTES";
+
+/**
+ * Resolve the per-queue byte budget from ANALYZER_QUEUE_BYTES (a positive byte count).
+ * Unset means queues are bounded by their item count only.
+ * @param out_bytes Receives the budget (0 = none)
+ * @return NULL on success, error message on an invalid value
+ */
+static const char* queue_bytes_from_env(size_t* out_bytes)
+{
+    int bytes = 0;
+    if (positive_int_from_env(QUEUE_BYTES_ENV, &bytes) != 0) {
+        return "invalid ANALYZER_QUEUE_BYTES (expected a positive integer)";
+    }
+    *out_bytes = (size_t)bytes;
+    return NULL;
+}
+
+/* Environment variable turning on queue contention counters */
+static const char QUEUE_STATS_ENV[] = "ANALYZER_QUEUE_STATS";
+
+/**
+ * Resolve whether to instrument the queue from ANALYZER_QUEUE_STATS ("1" = on, unset or "0" = off)
+ * @param out_enabled Receives 1 or 0
+ * @return NULL on success, error message on an invalid value
+ */
+static const char* queue_stats_from_env(int* out_enabled)
+{
+    const char* value = getenv(QUEUE_STATS_ENV);
+    *out_enabled = 0;
+    if (value == NULL || value[0] == '\0' || strcmp(value, "0") == 0) {
+        return NULL;
+    }
+    if (strcmp(value, "1") == 0) {
+        *out_enabled = 1;
+        return NULL;
+    }
+    return "invalid ANALYZER_QUEUE_STATS (expected 0 or 1)";
+}
+
+/* Environment variable giving every queue slot an inline payload area */
+static const char QUEUE_INLINE_ENV[] = "ANALYZER_QUEUE_INLINE";
+
+/**
+ * Resolve the inline slot size from ANALYZER_QUEUE_INLINE (payload bytes per slot).
+ * Unset means every queued string is a separate heap allocation.
+ * @param out_size Receives the slot size (0 = no inline slots)
+ * @return NULL on success, error message on an invalid value
+ */
+static const char* queue_inline_from_env(size_t* out_size)
+{
+    int size = 0;
+    if (positive_int_from_env(QUEUE_INLINE_ENV, &size) != 0) {
+        return "invalid ANALYZER_QUEUE_INLINE (expected a positive integer)";
+    }
+    *out_size = (size_t)size;
+    return NULL;
+}
+
+/* Environment variables choosing what a full stage queue does with new work */
+static const char OVERFLOW_ENV[] = "ANALYZER_OVERFLOW";
+static const char SAMPLE_PERCENT_ENV[] = "ANALYZER_SAMPLE_PERCENT";
+static const char SPILL_DIR_ENV[] = "ANALYZER_SPILL_DIR";
+
+/**
+ * Resolve the overflow policy from ANALYZER_OVERFLOW ("block", "drop-newest", "drop-oldest",
+ * "sample" or "spill") and, for sampling, the share of overflowing lines kept from
+ * ANALYZER_SAMPLE_PERCENT. Unset or empty means blocking, which never loses a line.
+ * @param out_policy Receives the resolved policy
+ * @param out_percent Receives the sample percentage (0 = queue default)
+ * @return NULL on success, error message on an invalid value
+ */
+static const char* overflow_from_env(cp_overflow_t* out_policy, int* out_percent)
+{
+    const char* value = getenv(OVERFLOW_ENV);
+
+    *out_policy = CP_OVERFLOW_BLOCK;
+    *out_percent = 0;
+    if (value == NULL || value[0] == '\0' || strcmp(value, "block") == 0) {
+        *out_policy = CP_OVERFLOW_BLOCK;
+    } else if (strcmp(value, "drop-newest") == 0) {
+        *out_policy = CP_OVERFLOW_DROP_NEWEST;
+    } else if (strcmp(value, "drop-oldest") == 0) {
+        *out_policy = CP_OVERFLOW_DROP_OLDEST;
+    } else if (strcmp(value, "sample") == 0) {
+        *out_policy = CP_OVERFLOW_SAMPLE;
+    } else if (strcmp(value, "spill") == 0) {
+        *out_policy = CP_OVERFLOW_SPILL;
+    } else {
+        return "invalid ANALYZER_OVERFLOW (expected block, drop-newest, drop-oldest, sample or spill)";
+    }
+    if (positive_int_from_env(SAMPLE_PERCENT_ENV, out_percent) != 0 || *out_percent > 99) {
+        return "invalid ANALYZER_SAMPLE_PERCENT (expected 1..99)";
+    }
+    return NULL;
+}
+
+/**
+ * Report the queue's contention counters (only when instrumented).
+ * Long producer waits mean the worker cannot keep up; long consumer waits mean it is starved.
+ * @param ctx Plugin context
+ */
+static void log_queue_stats(plugin_context_t* ctx)
+{
+    cp_stats_t stats;
+    if (!ctx->queue->instrumented || consumer_producer_get_stats(ctx->queue, &stats) != 0) {
+        return;
+    }
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "queue stats (%s): %ld put(s), %ld get(s), peak %d/%d; producers blocked %ld time(s) for %.3f ms, "
+             "consumers blocked %ld time(s) for %.3f ms; monitor waits %ld (%ld spurious)",
+             stats.backend, stats.puts, stats.gets, stats.peak_count, stats.capacity,
+             stats.producer_blocked, stats.producer_blocked_ns / 1e6,
+             stats.consumer_blocked, stats.consumer_blocked_ns / 1e6,
+             stats.monitor_waits, stats.monitor_spurious_wakeups);
+    log_info(ctx, msg);
+}
+
+/**
+ * Report how an elastic queue was resized over the run (nothing for fixed queues)
+ * @param ctx Plugin context
+ */
+static void log_queue_resizes(plugin_context_t* ctx)
+{
+    cp_stats_t stats;
+    if (consumer_producer_get_stats(ctx->queue, &stats) != 0 || stats.grows + stats.shrinks == 0) {
+        return;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "queue resized %ld time(s) up, %ld time(s) down (capacity %d..%d, peak %d)",
+             stats.grows, stats.shrinks, stats.min_capacity, stats.max_capacity, stats.peak_capacity);
+    log_info(ctx, msg);
+}
+
+/**
+ * Report how many lines the overflow policy dropped (nothing if none were)
+ * @param ctx Plugin context
+ */
+static void log_queue_drops(plugin_context_t* ctx)
+{
+    cp_stats_t stats;
+    if (consumer_producer_get_stats(ctx->queue, &stats) != 0 ||
+        stats.dropped_newest + stats.dropped_oldest + stats.dropped_sampled == 0) {
+        return;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "queue overloaded: dropped %ld new, %ld queued and %ld unsampled line(s)",
+             stats.dropped_newest, stats.dropped_oldest, stats.dropped_sampled);
+    log_info(ctx, msg);
+}
+
+/**
+ * Report how many lines were spilled to disk (nothing if none were)
+ * @param ctx Plugin context
+ */
+static void log_queue_spills(plugin_context_t* ctx)
+{
+    cp_stats_t stats;
+    if (consumer_producer_get_stats(ctx->queue, &stats) != 0 || stats.spilled == 0) {
+        return;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "queue spilled %ld line(s) to disk (peak %zu bytes on disk, %ld lost)",
+             stats.spilled, stats.spill_peak_bytes, stats.spill_lost);
+    log_info(ctx, msg);
+}
+
+/**
+ * With ANALYZER_QUEUE_STATS=1, report how often the plugin placing work into this one waited for
+ * credits (nothing if it never did)
+ * @param ctx Plugin context
+ */
+static void log_queue_credit_stalls(plugin_context_t* ctx)
+{
+    cp_stats_t stats;
+    if (!ctx->queue->instrumented || consumer_producer_get_stats(ctx->queue, &stats) != 0 ||
+        stats.credit_stalls == 0) {
+        return;
+    }
+    char msg[160];
+    snprintf(msg, sizeof(msg), "upstream starved of credits %ld time(s) for %.3f ms (%ld grant(s))",
+             stats.credit_stalls, stats.credit_stall_ns / 1e6, stats.credit_grants);
+    log_info(ctx, msg);
+}
+
+/**
+ * Returns 1 if s equals the END sentinel exactly, otherwise 0.
+ * Treats NULL as "not END".
+ */
+inline int is_end(const char* s) {
+    if (s == NULL) {
+        return 0;
+    }
+    return strcmp(s, END_SENTINEL) == 0;
+}
+
+/**
+ * Tell a control item from data by its address alone
+ * @param item Item taken from a queue
+ * @return Its PLUGIN_CONTROL_* kind, or -1 for data
+ */
+static inline int control_kind(const char* item)
+{
+    uintptr_t offset = (uintptr_t)item - (uintptr_t)g_control_items;
+    return offset < PLUGIN_CONTROL_KINDS ? (int)offset : -1;
+}
+
+/**
+ * Queue free hook: control items are not allocated, everything else is a message
+ * @param item Item the queue drops
+ */
+static void release_queue_item(void* item)
+{
+    if (control_kind((const char*)item) < 0) {
+        message_release(item);
+    }
+}
+
+
+/**
+ * Forward processed outputs downstream, in order.
+ * Downstream place_work copies its input, so the caller keeps ownership of outs.
+ * @param ctx Plugin context
+ * @param outs Outputs to forward
+ * @param count Number of outputs
+ */
+static void forward_outputs(plugin_context_t* ctx, const char** outs, int count)
+{
+    // Last plugin in the chain (or nothing to send): nothing to forward
+    if (count == 0 || !ctx->attached || !ctx->next_place_work) {
+        return;
+    }
+
+    // Whole batch in one downstream queue operation when the next plugin supports it
+    if (ctx->next_place_work_batch) {
+        const char* err = ctx->next_place_work_batch(ctx->next_instance, outs, count);
+        if (err != NULL) {
+            log_error(ctx, err);
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const char* err = ctx->next_place_work(ctx->next_instance, outs[i]);
+        if (err != NULL) {
+            log_error(ctx, err);
+        }
+    }
+}
+
+/**
+ * Free a drained input, unless it is a copy of an inline item in the worker's scratch buffer
+ * @param ctx Plugin context
+ * @param in Input taken from the queue
+ */
+static void release_input(plugin_context_t* ctx, char* in)
+{
+    if (!consumer_producer_scratch_owns(&ctx->scratch, in)) {
+        message_release(in);
+    }
+}
+
+/**
+ * Hand processed outputs to a next plugin that takes ownership: no copy, no free on our side.
+ * An output that aliases its input moves on with the input's buffer; only inputs living in our
+ * scratch buffer still have to be copied.
+ * @param ctx Plugin context
+ * @param ins Inputs that produced the outputs
+ * @param outs Outputs to hand off
+ * @param count Number of input/output pairs (at most PLUGIN_BATCH_MAX)
+ */
+static void hand_off_outputs(plugin_context_t* ctx, char** ins, const char** outs, int count)
+{
+    char* owned[PLUGIN_BATCH_MAX];
+    int n = 0;
+    for (int k = 0; k < count; ++k) {
+        char* out = (char*)outs[k];
+        if (out != ins[k]) {
+            release_input(ctx, ins[k]);
+        } else if (consumer_producer_scratch_owns(&ctx->scratch, out)) {
+            out = message_dup(out);
+            if (out == NULL) {
+                log_error(ctx, "out of memory");
+                continue;
+            }
+        }
+        owned[n++] = out;
+    }
+
+    if (ctx->next_place_work_owned_batch) {
+        const char* err = ctx->next_place_work_owned_batch(ctx->next_instance, owned, n);
+        if (err != NULL) {
+            log_error(ctx, err);
+        }
+        return;
+    }
+    for (int k = 0; k < n; ++k) {
+        const char* err = ctx->next_place_work_owned(ctx->next_instance, owned[k]);
+        if (err != NULL) {
+            log_error(ctx, err);
+        }
+    }
+}
+
+/**
+ * Forward processed outputs downstream, then release the buffers we own.
+ * An output either aliases its input (in-place) or is a new buffer from the transform.
+ * @param ctx Plugin context
+ * @param ins Inputs that produced the outputs
+ * @param outs Outputs to forward
+ * @param count Number of input/output pairs
+ */
+static void flush_outputs(plugin_context_t* ctx, char** ins, const char** outs, int count)
+{
+    if (count > 0 && ctx->attached && ctx->next_place_work_owned) {
+        hand_off_outputs(ctx, ins, outs, count);
+        return;
+    }
+    forward_outputs(ctx, outs, count);
+    for (int k = 0; k < count; ++k) {
+        if (outs[k] != ins[k]) {
+            message_release((char*)outs[k]);
+        }
+        release_input(ctx, ins[k]);
+    }
+}
+
+/**
+ * Run the plugin's transform on one input. With an in-place transform the input's own buffer
+ * becomes the output, grown first if the transform asks for more room. A new output message
+ * keeps its input's sequence number.
+ * @param ctx Plugin context
+ * @param in Input taken from the queue; replaced if its buffer had to move
+ * @return The output (may alias *in), or NULL if the transform failed (we still own *in)
+ */
+static const char* run_transform(plugin_context_t* ctx, char** in)
+{
+    if (ctx->inplace_function == NULL) {
+        const char* out = ctx->process_function(*in);
+        message_t* from = message_of(*in);
+        message_t* to = out != *in ? message_of(out) : NULL;
+        if (from != NULL && to != NULL) {
+            to->seq = from->seq;
+        }
+        return out;
+    }
+
+    // Messages carry their length and room (and are copied first if someone else holds them);
+    // scratch copies own a whole inline slot; anything else is taken to be exactly as long as
+    // its string
+    char* buf = *in;
+    size_t len = message_length(buf);
+    int in_scratch = consumer_producer_scratch_owns(&ctx->scratch, buf);
+    if (!in_scratch && (buf = message_writable(buf, len + 1)) == NULL) {
+        log_error(ctx, "out of memory");
+        return NULL;
+    }
+    *in = buf;
+    size_t capacity = in_scratch ? ctx->scratch.slot_size : message_capacity(buf);
+    if (capacity == 0) {
+        capacity = len + 1;
+    }
+    for (;;) {
+        long need = ctx->inplace_function(buf, &len, capacity);
+        if (need == 0) {
+            message_set_length(buf, len);
+            return buf;
+        }
+        if (need < 0 || (size_t)need <= capacity) {
+            return NULL;
+        }
+        char* bigger = in_scratch ? message_alloc((size_t)need - 1) : message_writable(buf, (size_t)need);
+        if (bigger == NULL) {
+            log_error(ctx, "out of memory");
+            return NULL;
+        }
+        if (in_scratch) {
+            memcpy(bigger, buf, len + 1);
+            message_set_length(bigger, len);
+            in_scratch = 0;
+        }
+        buf = bigger;
+        *in = buf;
+        capacity = message_capacity(buf);
+        if (capacity < (size_t)need) {
+            capacity = (size_t)need;
+        }
+    }
+}
+
+/* A worker's arenas for columnar batches, kept from one batch to the next (see worker_exit) */
+typedef struct
+{
+    char* in;
+    size_t in_capacity;
+    char* out;
+    size_t out_capacity;
+    size_t in_offsets[PLUGIN_BATCH_MAX + 1];
+    size_t out_offsets[PLUGIN_BATCH_MAX + 1];
+} batch_arena_t;
+
+static _Thread_local batch_arena_t batch_arena;
+
+/**
+ * Make sure an arena holds at least need bytes (its contents are not kept)
+ * @param data Arena, replaced when it grows
+ * @param capacity Its size, updated
+ * @param need Bytes needed
+ * @return 0 on success, -1 when out of memory
+ */
+static int arena_reserve(char** data, size_t* capacity, size_t need)
+{
+    if (*data != NULL && need <= *capacity) {
+        return 0;
+    }
+    size_t size = *capacity > 0 ? *capacity : 4096;
+    while (size < need) {
+        size *= 2;
+    }
+    char* bigger = (char*)malloc(size);
+    if (bigger == NULL) {
+        return -1;
+    }
+    free(*data);
+    *data = bigger;
+    *capacity = size;
+    return 0;
+}
+
+/* Give back what a worker thread holds on to: cached pool buffers and its batch arenas */
+static void worker_exit(void)
+{
+    buffer_pool_flush_thread();
+    free(batch_arena.in);
+    free(batch_arena.out);
+    batch_arena.in = batch_arena.out = NULL;
+    batch_arena.in_capacity = batch_arena.out_capacity = 0;
+}
+
+/**
+ * Transform a run of inputs one at a time
+ * @param ctx Plugin context
+ * @param ins Inputs; replaced in place by the ones that produced an output
+ * @param outs Receives the matching outputs (may alias the input)
+ * @param count Number of inputs
+ * @return Number of input/output pairs left in ins/outs
+ */
+static int transform_each(plugin_context_t* ctx, char** ins, const char** outs, int count)
+{
+    int produced = 0;
+    for (int i = 0; i < count; ++i) {
+        char* in = ins[i];
+        const char* out = run_transform(ctx, &in);
+        if (out == NULL) {
+            log_error(ctx, "transform failed");
+            release_input(ctx, in);
+            continue;
+        }
+        ins[produced] = in;
+        outs[produced] = out;
+        produced++;
+    }
+    return produced;
+}
+
+/**
+ * Transform a run of inputs with the plugin's batch transform: gather the texts into a columnar
+ * batch, call the transform once, then write each result back into its input's message when the
+ * worker is its only holder and it has the room, or into a new message otherwise.
+ * Falls back to transform_each if the batch cannot be built or the transform fails.
+ * @param ctx Plugin context
+ * @param ins Inputs (data only); replaced in place by the ones that produced an output
+ * @param outs Receives the matching outputs (may alias the input)
+ * @param count Number of inputs (at most PLUGIN_BATCH_MAX)
+ * @return Number of input/output pairs left in ins/outs
+ */
+static int transform_batch(plugin_context_t* ctx, char** ins, const char** outs, int count)
+{
+    if (ctx->batch_function == NULL) {
+        return transform_each(ctx, ins, outs, count);
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    batch_arena_t* arena = &batch_arena;
+    size_t total = 0;
+    arena->in_offsets[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        total += message_length(ins[i]);
+        arena->in_offsets[i + 1] = total;
+    }
+    if (arena_reserve(&arena->in, &arena->in_capacity, total) != 0 ||
+        arena_reserve(&arena->out, &arena->out_capacity, total) != 0) {
+        log_error(ctx, "out of memory");
+        return transform_each(ctx, ins, outs, count);
+    }
+    for (int i = 0; i < count; ++i) {
+        memcpy(arena->in + arena->in_offsets[i], ins[i], arena->in_offsets[i + 1] - arena->in_offsets[i]);
+    }
+
+    plugin_batch_t in = { arena->in, arena->in_offsets, count, total };
+    plugin_batch_t out = { arena->out, arena->out_offsets, count, arena->out_capacity };
+    for (;;) {
+        long need = ctx->batch_function(&in, &out);
+        if (need == 0) {
+            break;
+        }
+        if (need < 0 || (size_t)need <= out.capacity ||
+            arena_reserve(&arena->out, &arena->out_capacity, (size_t)need) != 0) {
+            log_error(ctx, "batch transform failed");
+            return transform_each(ctx, ins, outs, count);
+        }
+        out.data = arena->out;
+        out.capacity = arena->out_capacity;
+    }
+
+    int produced = 0;
+    for (int i = 0; i < count; ++i) {
+        char* src = ins[i];
+        size_t len = out.offsets[i + 1] - out.offsets[i];
+        message_t* msg = consumer_producer_scratch_owns(&ctx->scratch, src) ? NULL : message_of(src);
+        char* dst = src;
+        if (msg == NULL || msg->capacity < len + 1 || atomic_load_explicit(&msg->refs, memory_order_acquire) != 1) {
+            dst = message_alloc(len);
+            if (dst == NULL) {
+                log_error(ctx, "out of memory");
+                release_input(ctx, src);
+                continue;
+            }
+            if (msg != NULL && message_of(dst) != NULL) {
+                message_of(dst)->seq = msg->seq;
+            }
+        }
+        memcpy(dst, out.data + out.offsets[i], len);
+        dst[len] = '\0';
+        message_set_length(dst, len);
+        ins[produced] = src;
+        outs[produced] = dst;
+        produced++;
+    }
+    return produced;
+}
+
+/**
+ * How many items the next fetch may take. With credit-based flow control, take no more than the
+ * next plugin can accept without blocking: whatever we leave queued back-pressures the plugin
+ * before us, instead of us stalling half-way through forwarding a batch we already took.
+ * @param ctx Plugin context
+ * @param limit Largest batch the caller wants
+ * @return Items to fetch (1..limit)
+ */
+static int fetch_limit(plugin_context_t* ctx, int limit)
+{
+    if (ctx->next_grant_credits == NULL) {
+        return limit;
+    }
+    if (ctx->credits == 0) {
+        ctx->credits = ctx->next_grant_credits(ctx->next_instance, PLUGIN_BATCH_MAX);
+    }
+    if (ctx->credits > 0) {
+        return ctx->credits < limit ? ctx->credits : limit;
+    }
+    log_error(ctx, "next plugin granted no credits, falling back to blocking puts");
+    ctx->next_grant_credits = NULL;
+    ctx->credits = 0;
+    return limit;
+}
+
+/**
+ * Spend one credit per fetched item: each of them may produce one output downstream
+ * @param ctx Plugin context
+ * @param count Items fetched
+ */
+static void spend_credits(plugin_context_t* ctx, int count)
+{
+    if (ctx->next_grant_credits != NULL) {
+        ctx->credits = count < ctx->credits ? ctx->credits - count : 0;
+    }
+}
+
+/**
+ * Number the messages of a fetched batch in queue order. Messages numbered by an earlier stage
+ * keep their number and the count continues from it, so a stream is numbered once, where it enters.
+ * Messages other holders can see are left alone.
+ * @param ctx Plugin context
+ * @param batch Fetched items
+ * @param count Number of items
+ */
+static void number_messages(plugin_context_t* ctx, char** batch, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        message_t* msg = message_of(batch[i]);
+        if (msg == NULL || atomic_load_explicit(&msg->refs, memory_order_acquire) != 1) {
+            continue;
+        }
+        if (msg->seq == 0) {
+            msg->seq = ++ctx->message_seq;
+        } else {
+            ctx->message_seq = msg->seq;
+        }
+    }
+}
+
+/**
+ * Pass a control message on to the next plugin. A next plugin without place_control still gets
+ * END, as the string "<END>"; the other controls stop here. The last plugin flushes stdout.
+ * @param ctx Plugin context
+ * @param kind PLUGIN_CONTROL_*
+ */
+static void forward_control(plugin_context_t* ctx, int kind)
+{
+    const char* err = NULL;
+    if (!ctx->attached || !ctx->next_place_work) {
+        if (kind != PLUGIN_CONTROL_END) {
+            fflush(stdout);
+        }
+    } else if (ctx->next_place_control) {
+        err = ctx->next_place_control(ctx->next_instance, kind);
+    } else if (kind == PLUGIN_CONTROL_END) {
+        err = ctx->next_place_work(ctx->next_instance, END_SENTINEL);
+    }
+    if (err != NULL) {
+        log_error(ctx, err);
+    }
+}
+
+/**
+ * Act on FLUSH or BARRIER once the outputs before it went downstream: pass it on, and count a
+ * barrier for plugin_instance_wait_barrier
+ * @param ctx Plugin context
+ * @param kind PLUGIN_CONTROL_FLUSH or PLUGIN_CONTROL_BARRIER
+ */
+static void pass_control(plugin_context_t* ctx, int kind)
+{
+    forward_control(ctx, kind);
+    if (kind == PLUGIN_CONTROL_BARRIER) {
+        pthread_mutex_lock(&ctx->control_lock);
+        ctx->barriers++;
+        pthread_cond_broadcast(&ctx->barrier_passed);
+        pthread_mutex_unlock(&ctx->control_lock);
+    }
+}
+
+/**
+ * Forward END downstream and mark the instance finished
+ * @param ctx Plugin context
+ */
+static void finish_with_end(plugin_context_t* ctx)
+{
+    forward_control(ctx, PLUGIN_CONTROL_END);
+
+    // Mark finished (graceful shutdown); barrier waiters stop waiting
+    pthread_mutex_lock(&ctx->control_lock);
+    ctx->finished = 1;
+    pthread_cond_broadcast(&ctx->barrier_passed);
+    pthread_mutex_unlock(&ctx->control_lock);
+    consumer_producer_signal_finished(ctx->queue);
+}
+
+/**
+ * Drop the items fetched after END: they are never processed
+ * @param ctx Plugin context
+ * @param items Items after END
+ * @param count Number of items
+ */
+static void discard_after_end(plugin_context_t* ctx, char** items, int count)
+{
+    for (int k = 0; k < count; ++k) {
+        if (control_kind(items[k]) < 0) {
+            release_input(ctx, items[k]);
+        }
+    }
+}
+
+/* One batch in flight in a worker pool: processed by any worker, released downstream in sequence */
+typedef struct
+{
+    char* ins[PLUGIN_BATCH_MAX];        // Inputs that produced an output, and FLUSH/BARRIER items
+    const char* outs[PLUGIN_BATCH_MAX]; // Matching outputs (may alias the input); NULL for a control
+    int count;                          // Entries
+    int controls;                       // Control entries among them
+    int end;                            // 1 = END closed the stream in this batch
+    int ready;                          // 1 = processed, waiting for its turn (under lock)
+    int parked;                         // 1 = finished before the batches ahead of it (under lock)
+    struct timespec parked_at;          // When it was parked
+} plugin_pool_slot_t;
+
+/* Worker pool of one plugin instance. Batches are numbered when fetched (under fetch_lock) and
+   released in that order; at most slot_count batches are in flight, so batch seq always owns
+   slots[seq % slot_count] until it is released. */
+struct plugin_pool
+{
+    int workers;                        // Workers, the instance's own thread included
+    int batch_max;                      // Largest batch one worker takes, so work spreads across workers
+    pthread_t threads[PLUGIN_WORKERS_MAX]; // Extra workers (threads[0] is unused: the instance's own thread)
+    int started;                        // Extra workers actually started (under lock)
+    pthread_mutex_t fetch_lock;         // Serializes fetching and numbering batches
+    pthread_mutex_t lock;               // Guards everything below
+    pthread_cond_t window_open;         // Signalled when a batch is released or the pool stops
+    long next_seq;                      // Number of the next fetched batch
+    long next_release;                  // Number of the next batch to release downstream
+    int stopping;                       // 1 = END or the end of the queue was fetched: no more fetches
+    long batches;                       // Batches released
+    long parked;                        // Batches that waited in the reorder buffer
+    int depth;                          // Batches in the reorder buffer now
+    int peak;                           // Most batches ever in the reorder buffer
+    long hol_stall_ns;                  // Time parked batches waited for the ones ahead of them
+    int slot_count;
+    plugin_pool_slot_t slots[];
+};
+
+static long elapsed_ns(const struct timespec* since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000000000L + (now.tv_nsec - since->tv_nsec);
+}
+
+/**
+ * Cut a fetched batch at END: nothing after END is ever processed
+ * @param ctx Plugin context
+ * @param batch Fetched items
+ * @param count Number of items
+ * @return Items left, END included; sets *ended to 1 if END was found
+ */
+static int cut_at_end(plugin_context_t* ctx, char** batch, int count, int* ended)
+{
+    *ended = 0;
+    for (int i = 0; i < count; ++i) {
+        if (control_kind(batch[i]) == PLUGIN_CONTROL_END) {
+            discard_after_end(ctx, batch + i + 1, count - i - 1);
+            *ended = 1;
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * Fetch and number the next batch for a pool worker. Waits while the reorder window is full.
+ * @param ctx Plugin context
+ * @param pool The instance's pool
+ * @param batch Receives the items (END, if any, is the last one)
+ * @param seq Receives the batch number
+ * @return Number of items, or 0 once the pool stops
+ */
+static int pool_fetch(plugin_context_t* ctx, struct plugin_pool* pool, char** batch, long* seq)
+{
+    pthread_mutex_lock(&pool->fetch_lock);
+    int n = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stopping && pool->next_seq - pool->next_release >= pool->slot_count) {
+            pthread_cond_wait(&pool->window_open, &pool->lock);
+        }
+        int stopping = pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+        if (stopping) {
+            break;
+        }
+
+        n = consumer_producer_get_batch(ctx->queue, batch, fetch_limit(ctx, pool->batch_max));
+        if (n < 0) {
+            continue;
+        }
+        int ended = n == 0;
+        if (n > 0) {
+            number_messages(ctx, batch, n);
+            n = cut_at_end(ctx, batch, n, &ended);
+            spend_credits(ctx, n);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (n > 0) {
+            *seq = pool->next_seq++;
+        }
+        if (ended) {
+            pool->stopping = 1;
+            pthread_cond_broadcast(&pool->window_open);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        break;
+    }
+    pthread_mutex_unlock(&pool->fetch_lock);
+    return n;
+}
+
+/**
+ * Send a processed batch downstream: its outputs, with any FLUSH/BARRIER passed on in between
+ * @param ctx Plugin context
+ * @param slot The batch's slot
+ */
+static void release_slot(plugin_context_t* ctx, plugin_pool_slot_t* slot)
+{
+    int start = 0;
+    for (int k = 0; slot->controls > 0 && k < slot->count; ++k) {
+        if (slot->outs[k] == NULL) {
+            flush_outputs(ctx, slot->ins + start, slot->outs + start, k - start);
+            pass_control(ctx, control_kind(slot->ins[k]));
+            start = k + 1;
+        }
+    }
+    flush_outputs(ctx, slot->ins + start, slot->outs + start, slot->count - start);
+}
+
+/**
+ * Process a numbered batch into its slot, then release it and every batch parked behind it,
+ * or park it until the batches ahead of it are released
+ * @param ctx Plugin context
+ * @param pool The instance's pool
+ * @param batch Items of the batch (END, if any, is the last one)
+ * @param count Number of items
+ * @param seq Batch number
+ */
+static void pool_process(plugin_context_t* ctx, struct plugin_pool* pool, char** batch, int count, long seq)
+{
+    plugin_pool_slot_t* slot = &pool->slots[seq % pool->slot_count];
+    slot->count = 0;
+    slot->controls = 0;
+    slot->end = 0;
+    int run = 0;                        // Start of the data run a batch transform has yet to take
+    for (int i = 0; i < count; ++i) {
+        int kind = control_kind(batch[i]);
+        if (kind == PLUGIN_CONTROL_END) {
+            slot->end = 1;
+            break;
+        }
+        if (kind >= 0) {
+            // Passed on at release, after the outputs ahead of it
+            if (ctx->batch_function != NULL) {
+                slot->count = run + transform_batch(ctx, slot->ins + run, slot->outs + run, slot->count - run);
+                run = slot->count + 1;
+            }
+            slot->ins[slot->count] = batch[i];
+            slot->outs[slot->count] = NULL;
+            slot->count++;
+            slot->controls++;
+            continue;
+        }
+        if (ctx->batch_function != NULL) {
+            slot->ins[slot->count++] = batch[i];
+            continue;
+        }
+        const char* out = run_transform(ctx, &batch[i]);
+        if (out == NULL) {
+            log_error(ctx, "transform failed");
+            release_input(ctx, batch[i]);
+            continue;
+        }
+        slot->ins[slot->count] = batch[i];
+        slot->outs[slot->count] = out;
+        slot->count++;
+    }
+    if (ctx->batch_function != NULL) {
+        slot->count = run + transform_batch(ctx, slot->ins + run, slot->outs + run, slot->count - run);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    slot->ready = 1;
+    if (seq != pool->next_release) {
+        // Head-of-line blocked: wait in the reorder buffer for the batches ahead of it
+        clock_gettime(CLOCK_MONOTONIC, &slot->parked_at);
+        slot->parked = 1;
+        pool->parked++;
+        pool->depth++;
+        if (pool->depth > pool->peak) {
+            pool->peak = pool->depth;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    // Our turn: release this batch and whatever was parked right behind it. Nobody else can match
+    // next_release until we advance it, so forwarding happens outside the lock, one batch at a time.
+    while (slot->ready) {
+        if (slot->parked) {
+            pool->hol_stall_ns += elapsed_ns(&slot->parked_at);
+            pool->depth--;
+            slot->parked = 0;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        release_slot(ctx, slot);
+        if (slot->end) {
+            finish_with_end(ctx);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        slot->ready = 0;
+        pool->next_release++;
+        pool->batches++;
+        pthread_cond_broadcast(&pool->window_open);
+        slot = &pool->slots[pool->next_release % pool->slot_count];
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Extra pool worker: fetch, process and release batches until the pool stops
+ * @param arg Pointer to plugin_context_t
+ * @return NULL
+ */
+static void* plugin_pool_thread(void* arg)
+{
+    plugin_context_t* ctx = (plugin_context_t*)arg;
+    struct plugin_pool* pool = atomic_load_explicit(&ctx->pool, memory_order_acquire);
+    char* batch[PLUGIN_BATCH_MAX];
+    long seq;
+    int n;
+    while ((n = pool_fetch(ctx, pool, batch, &seq)) > 0) {
+        pool_process(ctx, pool, batch, n, seq);
+    }
+    worker_exit();
+    return NULL;
+}
+
+/**
+ * Turn the instance's worker into a pool of workers, handing it the batch it just fetched as batch 0
+ * @param ctx Plugin context
+ * @param workers Requested number of workers
+ * @param ended 1 if the fetched batch holds END (no more fetches then)
+ * @return The pool, or NULL if it could not be set up (the worker then carries on alone)
+ */
+static struct plugin_pool* start_pool(plugin_context_t* ctx, int workers, int ended)
+{
+    int slot_count = 2 * workers;
+    struct plugin_pool* pool = (struct plugin_pool*)calloc(1, sizeof(struct plugin_pool) +
+                                                          (size_t)slot_count * sizeof(plugin_pool_slot_t));
+    if (pool == NULL) {
+        log_error(ctx, "out of memory, keeping a single worker");
+        return NULL;
+    }
+    pool->workers = workers;
+    pool->batch_max = PLUGIN_BATCH_MAX / workers > 0 ? PLUGIN_BATCH_MAX / workers : 1;
+    pool->slot_count = slot_count;
+    pool->next_seq = 1;
+    pool->stopping = ended;
+    pthread_mutex_init(&pool->fetch_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->window_open, NULL);
+    atomic_store_explicit(&ctx->pool, pool, memory_order_release);
+
+    int started = 0;
+    for (int i = 1; i < workers; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, plugin_pool_thread, ctx) != 0) {
+            log_error(ctx, "thread create failed, running with fewer workers");
+            break;
+        }
+        started++;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->started = started;
+    pthread_mutex_unlock(&pool->lock);
+    return pool;
+}
+
+/**
+ * Join a pool's extra workers and report its reorder buffer (with ANALYZER_QUEUE_STATS=1)
+ * @param ctx Plugin context
+ */
+static void stop_pool(plugin_context_t* ctx)
+{
+    struct plugin_pool* pool = atomic_load_explicit(&ctx->pool, memory_order_acquire);
+    if (pool == NULL) {
+        return;
+    }
+    for (int i = 1; i <= pool->started; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    if (ctx->queue->instrumented) {
+        char msg[200];
+        snprintf(msg, sizeof(msg),
+                 "worker pool (%d workers): %ld batch(es), %ld reordered; reorder buffer peak %d, "
+                 "head-of-line stalls %.3f ms",
+                 pool->started + 1, pool->batches, pool->parked, pool->peak, pool->hol_stall_ns / 1e6);
+        log_info(ctx, msg);
+    }
+    atomic_store(&ctx->pool, NULL);
+    pthread_cond_destroy(&pool->window_open);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->fetch_lock);
+    free(pool);
+}
+
+/**
+ * Generic consumer thread function
+ * This function runs in a separate thread and processes items from the queue
+ * @param arg Pointer to plugin_context_t
+ * @return NULL
+ */
+void* plugin_consumer_thread(void* arg)
+{
+    plugin_context_t* ctx = (plugin_context_t*)arg;
+    if (!ctx || !ctx->queue || !ctx->process_function) {
+        /* Nothing we can safely do */
+        return NULL;
+    }
+
+    char* batch[PLUGIN_BATCH_MAX];      /* Items drained from our queue (we own them) */
+    char* ins[PLUGIN_BATCH_MAX];        /* Inputs that produced an output */
+    const char* outs[PLUGIN_BATCH_MAX]; /* Matching outputs (may alias the input) */
+    int wired = 0;                      /* Set after the first fetch: attach*() happened before that put */
+
+    for (;;) {
+        /* 1) With credit-based flow control, take no more than the next plugin accepts without blocking */
+        int max_items = wired ? fetch_limit(ctx, PLUGIN_BATCH_MAX) : PLUGIN_BATCH_MAX;
+
+        /* 2) Blocking fetch of whatever is available, up to max_items items (no busy-wait).
+              Inline items land in our scratch buffer and stay valid until the next fetch. */
+        int n = ctx->scratch.slots > 0
+                    ? consumer_producer_get_batch_copy(ctx->queue, batch, max_items, &ctx->scratch)
+                    : consumer_producer_get_batch(ctx->queue, batch, max_items);
+        if (n <= 0) {
+            continue;
+        }
+        if (wired) {
+            spend_credits(ctx, n);
+        }
+        wired = 1;
+        number_messages(ctx, batch, n);
+
+        /* With plugin_instance_set_workers, hand this batch to a worker pool and serve the queue with it */
+        int workers = atomic_load(&ctx->requested_workers);
+        if (workers > 1) {
+            int ended;
+            n = cut_at_end(ctx, batch, n, &ended);
+            struct plugin_pool* pool = start_pool(ctx, workers, ended);
+            if (pool != NULL) {
+                long seq = 0;
+                do {
+                    pool_process(ctx, pool, batch, n, seq);
+                } while ((n = pool_fetch(ctx, pool, batch, &seq)) > 0);
+                worker_exit();
+                return NULL;
+            }
+            atomic_store(&ctx->requested_workers, 1);
+        }
+
+        int produced = 0;
+        for (int i = 0; i < n; ++i) {
+            char* in = batch[i];
+
+            /* 3) Control messages: everything before them goes downstream first (FIFO) */
+            int kind = control_kind(in);
+            if (kind >= 0) {
+                if (ctx->batch_function != NULL) {
+                    produced = transform_batch(ctx, ins, outs, produced);
+                }
+                flush_outputs(ctx, ins, outs, produced);
+                produced = 0;
+                if (kind != PLUGIN_CONTROL_END) {
+                    pass_control(ctx, kind);
+                    continue;
+                }
+
+                /* END: nothing after it is ever processed. Forward it, mark finished and exit
+                   the loop; our cached buffers go back to the pool for the threads still running */
+                discard_after_end(ctx, batch + i + 1, n - i - 1);
+                finish_with_end(ctx);
+                worker_exit();
+                return NULL;
+            }
+
+            /* 4) Process a regular string; a batch transform takes the whole run at once */
+            if (ctx->batch_function != NULL) {
+                ins[produced++] = in;
+                continue;
+            }
+            const char* out = run_transform(ctx, &in);
+            if (out == NULL) {
+                /* Transform failed: nothing to send downstream; we still own input */
+                log_error(ctx, "transform failed");
+                release_input(ctx, in);
+                continue;
+            }
+
+            ins[produced] = in;
+            outs[produced] = out;
+            produced++;
+
+            /* Without a batch-capable next plugin, forward right away so that
+               downstream side effects keep their per-item order */
+            if (ctx->next_place_work_owned ? ctx->next_place_work_owned_batch == NULL
+                                           : ctx->next_place_work_batch == NULL) {
+                flush_outputs(ctx, ins, outs, produced);
+                produced = 0;
+            }
+        }
+
+        /* 5) Forward the batch (or nothing, for the last plugin), then release our buffers */
+        if (ctx->batch_function != NULL) {
+            produced = transform_batch(ctx, ins, outs, produced);
+        }
+        flush_outputs(ctx, ins, outs, produced);
+    }
+    return NULL;
+}
+
+
+
+//  void* plugin_consumer_thread(void* arg)
+// {
+//     plugin_context_t* ctx = (plugin_context_t*)arg;
+
+//     for (;;) {
+//         /* Pull next item from our input queue */
+//         char* in = consumer_producer_get(ctx->queue);
+//         if (in == NULL) {
+//             /* Graceful upstream end (nothing more to consume) */
+//             break;
+//         }
+
+//         /* Handle end-of-stream token: never transform it */
+//         if (is_end(in)) {
+//             if (ctx->attached == 1 && ctx->next_place_work != NULL) {
+//                 /* Forward the token downstream. Ownership moves to the next stage. */
+//                 const char* err = ctx->next_place_work(in);
+//                 if (err != NULL) {
+//                     log_error(ctx, err);
+//                     free(in);  /* We still own it if forwarding failed */
+//                 }
+//                 /* DO NOT free(in); next stage will free it. */
+//             } else {
+//                 /* Last stage: safe to release the token here. */
+//                 free(in);
+//             }
+
+//             /* Mark our stage as finished and stop consuming */
+//             ctx->finished = 1;
+//             consumer_producer_signal_finished(ctx->queue);
+//             break;
+//         }
+
+//         /* Transform. We currently own 'in'. */
+//         const char* out = ctx->process_function(in);
+//         if (out == NULL) {
+//             /* Transformation failed for this item; drop it and continue. */
+//             log_error(ctx, "transform failed");
+//             free(in);
+//             continue;
+//         }
+
+//         if (ctx->attached == 1 && ctx->next_place_work != NULL) {
+//             /* Non-final stage: forward result to next stage.
+//                The queue takes ownership of 'out'. */
+//             const char* err = ctx->next_place_work(out);
+//             if (err != NULL) {
+//                 log_error(ctx, err);
+//             }
+
+//             /* Memory rules:
+//                - If 'out' is a NEW buffer (out != in), we no longer need 'in' -> free it.
+//                - If 'out' == 'in', DO NOT free here; next stage now owns that buffer. */
+//             if (out != in) {
+//                 free(in);
+//                 free(out);
+//             }
+//             /* DO NOT free(out) here; ownership has moved downstream. */
+
+//         } else {
+//             /* Final stage: the plugin already performed side-effects (e.g., printed).
+//                We must free exactly once per allocated buffer: */
+//             if (out == in) {
+//                 /* Single buffer case (logger/typewriter): free once. */
+//                 free((void*)out);
+//             } else {
+//                 /* Two distinct buffers: free both. */
+//                 free((void*)out);
+//                 free(in);
+//             }
+//         }
+//     }
+
+//     return NULL;
+// }
+
+
+
+// void* plugin_consumer_thread(void* arg)
+// {
+//     // Convert and validate context
+//     plugin_context_t* ctx = (plugin_context_t*)arg;
+//     if (ctx == NULL || ctx->queue == NULL) {
+//         // Cannot even log safely without a context
+//         return NULL;
+//     }
+
+//     if (ctx->process_function == NULL) {
+//         log_error(ctx, "no process_function provided");
+//         return NULL;
+//     }
+
+//     // Main work loop
+//     for (;;)
+//     {
+//         // Pull next item (blocks if empty). NULL means queue was finished and drained.
+//         char* in = consumer_producer_get(ctx->queue);
+//         if (in == NULL) {
+//             break;  // graceful end-of-input
+//         }
+
+//         // Handle end-of-stream token first (do not process/print it)
+//         if (is_end(in)) {
+//             if (ctx->attached == 1 && ctx->next_place_work != NULL) {
+//                 const char* err = ctx->next_place_work(in);
+//                 if (err != NULL) {
+//                     log_error(ctx, err);
+//                 }
+//             }
+//             free(in);
+//             consumer_producer_signal_finished(ctx->queue);
+//             ctx->finished = 1;
+//             break;
+//         }
+
+//         // Transform the input. Ownership of 'in' is on the worker.
+//         const char* out = ctx->process_function(in);
+
+//         if (out == NULL) {
+//             // Transform failed for this item — log and continue with the next one
+//             log_error(ctx, "transform failed");
+//             free(in);
+//             continue;
+//         }
+
+//         // Free the input after transform 
+//         if (out != in) {
+//             free(in);
+//         } 
+
+
+//         // Forward downstream if attached; otherwise print to stdout
+//         if (ctx->attached == 1 && ctx->next_place_work != NULL) {
+//             const char* err = ctx->next_place_work(out);
+//             if (err != NULL) {
+//                 log_error(ctx, err);
+//             }
+//         } 
+        
+//         // own 'out' and must free after forwarding
+//         free((void*)out);
+//     }
+
+//     // Mark worker finished (join is done in plugin_fini, not here)
+//     ctx->finished = 1;
+//     return NULL;
+// }
+
+
+
+/**
+ * Print error message in the format [ERROR][Plugin Name] - message
+ * @param context Plugin context
+ * @param message Error message
+ */
+void log_error(plugin_context_t* context, const char* message)
+{
+    // Resolve plugin name (fallback to "unknown" if context or name is missing)
+    const char* name = (context && context->name) ? context->name : "unknown";
+
+    // Resolve message text (fallback to "unknown error" if NULL/empty)
+    const char* text = (message && message[0] != '\0') ? message : "unknown error";
+
+    // Avoid interleaving from multiple threads writing to stderr
+    flockfile(stderr);
+
+    // Print in the exact required format and ensure newline at the end
+    // Use a fixed format string to avoid format-string vulnerabilities
+    fprintf(stderr, "[ERROR][%s] - %s\n", name, text);
+
+    // // Flush immediately so logs appear in real time
+    // fflush(stderr);
+
+    // Release the stream lock
+    funlockfile(stderr);
+}
+
+/**
+ * Print info message in the format [INFO][Plugin Name] - message
+ * @param context Plugin context
+ * @param message Info message
+ */
+void log_info(plugin_context_t* context, const char* message)
+{
+    // Resolve plugin name (fallback to "unknown" if context or name is missing)
+    const char* name = (context && context->name) ? context->name : "unknown";
+
+    // Resolve message text (fallback to "no info" if NULL/empty)
+    const char* text = (message && message[0] != '\0') ? message : "no info";
+
+    // Prevent interleaved lines from multiple threads
+    flockfile(stderr);
+
+    // Print in the required format and ensure newline
+    fprintf(stderr, "[INFO][%s] - %s\n", name, text);
+
+    // // Flush to show logs immediately
+    // fflush(stderr);
+
+    // Release the stream lock
+    funlockfile(stderr);
+}
+
+/**
+ * Get the plugin's name
+ * @return The plugin's name (should not be modified or freed)
+ */
+const char* plugin_get_name(void)
+{
+    // Snapshot fields locally to avoid reading changing state twice
+    const int inited = g_plugin_context.initialized;
+    const char* name = g_plugin_context.name;
+
+    // If called before init, during/after fini, or name missing → return a safe fallback
+    if (inited != 1 || name == NULL || name[0] == '\0') {
+        return "unknown";
+    }
+
+    return name;
+}
+
+
+/**
+ * Set up a context: validate, allocate and configure its queue, start its worker
+ * @param ctx Context to initialize (the default instance or a zeroed heap one)
+ * @param process_function Plugin-specific processing function
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param inplace_function In-place transform (NULL = process_function only)
+ * @param batch_function Batch transform (NULL = line by line)
+ * @param backend Queue backend (NULL = ANALYZER_QUEUE_MODE)
+ * @return NULL on success, error message on failure
+ */
+static const char* context_init(plugin_context_t* ctx,
+                                const char* (*process_function)(const char*),
+                                plugin_inplace_fn inplace_function,
+                                plugin_batch_fn batch_function,
+                                const char* name,
+                                int queue_size,
+                                const cp_backend_t* backend)
+{
+    // Validate inputs
+    if (process_function == NULL) {
+        return "invalid process function";
+    }
+    if (name == NULL || name[0] == '\0') {
+        return "invalid plugin name";
+    }
+    if (queue_size <= 0) {
+        return "invalid queue size";
+    }
+    if (ctx->initialized == 1) {
+        return "plugin already initialized";
+    }
+
+    // Reset context to a known base state (do not mark initialized yet)
+    ctx->attached       = 0;
+    ctx->initialized    = 0;
+    ctx->finished       = 0;
+    ctx->worker_joined  = 0;
+    ctx->next_place_work = NULL;
+    ctx->next_place_work_batch = NULL;
+    ctx->next_place_work_owned = NULL;
+    ctx->next_place_work_owned_batch = NULL;
+    ctx->next_place_control = NULL;
+    ctx->next_instance  = NULL;
+    ctx->next_grant_credits = NULL;
+    ctx->credits        = 0;
+    ctx->legacy_place_work = NULL;
+    ctx->legacy_place_work_batch = NULL;
+    ctx->legacy_place_work_owned = NULL;
+    ctx->legacy_place_work_owned_batch = NULL;
+    ctx->legacy_place_control = NULL;
+    ctx->legacy_grant_credits = NULL;
+    ctx->barriers       = 0;
+    atomic_store(&ctx->requested_workers, 1);
+    atomic_store(&ctx->pool, NULL);
+    ctx->queue          = NULL;
+    ctx->name           = name;               // set name early for logging
+    ctx->process_function = process_function;
+    ctx->inplace_function = inplace_function;
+    ctx->batch_function = batch_function;
+
+    // Resolve the queue backend before allocating anything (a per-stage choice wins over the env)
+    if (backend == NULL) {
+        const char* merr = queue_backend_from_env(&backend);
+        if (merr != NULL) {
+            log_error(ctx, merr);
+            return merr;
+        }
+    }
+    consumer_producer_wait_t wait_strategy;
+    int spin_limit;
+    const char* werr = wait_strategy_from_env(&wait_strategy, &spin_limit);
+    if (werr != NULL) {
+        log_error(ctx, werr);
+        return werr;
+    }
+    int max_capacity, high_pct, low_pct;
+    const char* eerr = elastic_from_env(&max_capacity, &high_pct, &low_pct);
+    if (eerr != NULL) {
+        log_error(ctx, eerr);
+        return eerr;
+    }
+    size_t queue_bytes;
+    const char* berr = queue_bytes_from_env(&queue_bytes);
+    if (berr != NULL) {
+        log_error(ctx, berr);
+        return berr;
+    }
+    int instrumented;
+    const char* serr = queue_stats_from_env(&instrumented);
+    if (serr != NULL) {
+        log_error(ctx, serr);
+        return serr;
+    }
+    size_t inline_size;
+    const char* ierr = queue_inline_from_env(&inline_size);
+    if (ierr != NULL) {
+        log_error(ctx, ierr);
+        return ierr;
+    }
+    cp_overflow_t overflow;
+    int sample_percent;
+    const char* oerr = overflow_from_env(&overflow, &sample_percent);
+    if (oerr != NULL) {
+        log_error(ctx, oerr);
+        return oerr;
+    }
+
+    // Allocate and initialize the queue (zeroed so init sees a clean, uninitialized queue)
+    ctx->queue = (consumer_producer_t*)calloc(1, sizeof(consumer_producer_t));
+    if (ctx->queue == NULL) {
+        log_error(ctx, "out of memory");
+        return "out of memory";
+    }
+
+    const char* qerr = consumer_producer_init_backend(ctx->queue, queue_size, backend);
+    if (qerr != NULL) {
+        // Propagate the queue's error upward; clean up the allocation
+        log_error(ctx, qerr);
+        free(ctx->queue);
+        ctx->queue = NULL;
+        return qerr;
+    }
+    consumer_producer_set_wait_strategy(ctx->queue, wait_strategy, spin_limit);
+    consumer_producer_set_allocator(ctx->queue, message_alloc_item, release_queue_item);
+    consumer_producer_set_item_size(ctx->queue, message_item_bytes);
+    consumer_producer_set_item_tag(ctx->queue, message_item_tag, message_set_item_tag);
+    if (max_capacity > 0) {
+        qerr = consumer_producer_set_elastic(ctx->queue, max_capacity, high_pct, low_pct, 0);
+    }
+    if (qerr == NULL && queue_bytes > 0) {
+        qerr = consumer_producer_set_byte_budget(ctx->queue, queue_bytes, NULL, 0);
+    }
+    if (qerr == NULL && instrumented) {
+        qerr = consumer_producer_enable_instrumentation(ctx->queue);
+    }
+    if (qerr == NULL && overflow == CP_OVERFLOW_SPILL) {
+        qerr = consumer_producer_set_spill(ctx->queue, getenv(SPILL_DIR_ENV));
+    } else if (qerr == NULL && overflow != CP_OVERFLOW_BLOCK) {
+        qerr = consumer_producer_set_overflow(ctx->queue, overflow, sample_percent, NULL, NULL);
+    }
+    if (qerr == NULL && inline_size > 0) {
+        qerr = consumer_producer_set_inline(ctx->queue, inline_size);
+    }
+    // Inline slots come from ANALYZER_QUEUE_INLINE or from the backend itself
+    if (qerr == NULL && ctx->queue->inline_size > 0) {
+        qerr = consumer_producer_scratch_init(ctx->queue, &ctx->scratch, PLUGIN_BATCH_MAX);
+    }
+    if (qerr != NULL) {
+        log_error(ctx, qerr);
+        consumer_producer_destroy(ctx->queue);
+        free(ctx->queue);
+        ctx->queue = NULL;
+        return qerr;
+    }
+
+    // Start the worker thread
+    pthread_mutex_init(&ctx->control_lock, NULL);
+    pthread_cond_init(&ctx->barrier_passed, NULL);
+    int trc = pthread_create(&ctx->consumer_thread,
+                             NULL,
+                             plugin_consumer_thread,
+                             (void*)ctx);
+    if (trc != 0) {
+        log_error(ctx, "thread create failed");
+        pthread_cond_destroy(&ctx->barrier_passed);
+        pthread_mutex_destroy(&ctx->control_lock);
+        consumer_producer_scratch_destroy(&ctx->scratch);
+        consumer_producer_destroy(ctx->queue);
+        free(ctx->queue);
+        ctx->queue = NULL;
+
+        // keep context in a non-initialized, clean state
+        ctx->attached       = 0;
+        ctx->finished       = 0;
+        ctx->initialized    = 0;
+        ctx->worker_joined  = 0;
+        ctx->next_place_work = NULL;
+        return "thread create failed";
+    }
+
+    // Mark success only after everything is ready
+    ctx->initialized = 1;
+    return NULL;
+}
+
+/**
+ * Initialize the common plugin infrastructure with the specified queue size
+ * @param process_function Plugin-specific processing function
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init(const char* (*process_function)(const char*),
+                               const char* name,
+                               int queue_size)
+{
+    return context_init(&g_plugin_context, process_function, NULL, NULL, name, queue_size, g_queue_backend);
+}
+
+/**
+ * Initialize the common plugin infrastructure for a plugin with an in-place transform
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init_inplace(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                       const char* name, int queue_size)
+{
+    return context_init(&g_plugin_context, process_function, inplace_function, NULL, name, queue_size,
+                        g_queue_backend);
+}
+
+/**
+ * Initialize the common plugin infrastructure for a plugin with a batch transform
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform (optional, NULL allowed)
+ * @param batch_function Columnar form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init_batch(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                     plugin_batch_fn batch_function, const char* name, int queue_size)
+{
+    return context_init(&g_plugin_context, process_function, inplace_function, batch_function, name, queue_size,
+                        g_queue_backend);
+}
+
+/**
+ * Create and start a new, independent instance of a plugin
+ * @param process_function Plugin-specific processing function
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init(const char* (*process_function)(const char*),
+                                        const char* name,
+                                        int queue_size,
+                                        const char* queue_backend,
+                                        void** out_instance)
+{
+    return common_plugin_instance_init_inplace(process_function, NULL, name, queue_size, queue_backend, out_instance);
+}
+
+/**
+ * Create and start a new, independent instance of a plugin with an in-place transform
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform (NULL = process_function only)
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init_inplace(const char* (*process_function)(const char*),
+                                                plugin_inplace_fn inplace_function,
+                                                const char* name,
+                                                int queue_size,
+                                                const char* queue_backend,
+                                                void** out_instance)
+{
+    return common_plugin_instance_init_batch(process_function, inplace_function, NULL, name, queue_size,
+                                             queue_backend, out_instance);
+}
+
+/**
+ * Create and start a new, independent instance of a plugin with a batch transform
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform (optional, NULL allowed)
+ * @param batch_function Columnar form of the same transform (NULL = line by line)
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init_batch(const char* (*process_function)(const char*),
+                                              plugin_inplace_fn inplace_function,
+                                              plugin_batch_fn batch_function,
+                                              const char* name,
+                                              int queue_size,
+                                              const char* queue_backend,
+                                              void** out_instance)
+{
+    if (out_instance == NULL) {
+        return "invalid instance pointer";
+    }
+    *out_instance = NULL;
+
+    const cp_backend_t* backend = NULL;
+    if (queue_backend != NULL && queue_backend[0] != '\0') {
+        backend = consumer_producer_backend(queue_backend);
+        if (backend == NULL) {
+            return "unknown queue backend";
+        }
+    }
+
+    plugin_context_t* ctx = (plugin_context_t*)calloc(1, sizeof(plugin_context_t));
+    if (ctx == NULL) {
+        return "out of memory";
+    }
+    ctx->heap_allocated = 1;
+
+    const char* err = context_init(ctx, process_function, inplace_function, batch_function, name, queue_size, backend);
+    if (err != NULL) {
+        free(ctx);
+        return err;
+    }
+    *out_instance = ctx;
+    return NULL;
+}
+
+/**
+ * Finalize an instance, then free it unless it is the default one
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure
+ */
+// Finalize the plugin: ensure all work is drained, join the worker, and release resources.
+// Returns NULL on success, or a constant error string on failure.
+const char* plugin_instance_fini(void* instance)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+
+    // Validate initialization state
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_fini: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    // Guard against joining from the worker thread itself
+    if (pthread_equal(pthread_self(), ctx->consumer_thread)) {
+        log_error(ctx, "plugin_fini: cannot join self");
+        return "cannot join self";
+    }
+
+    // Block until the queue has been fully drained 
+    const char* werr = plugin_instance_wait_finished(ctx);
+    if (werr != NULL) {
+        log_error(ctx, werr);
+        return werr;
+    } 
+
+    // Join the worker thread exactly once
+    if (ctx->worker_joined == 0) {
+        int jrc = pthread_join(ctx->consumer_thread, NULL);
+        if (jrc != 0) {
+            log_error(ctx, "plugin_fini: join failed");
+            return "join failed";
+        }
+        ctx->worker_joined = 1;
+    }
+    stop_pool(ctx);
+
+    // Destroy and free the queue
+    if (ctx->queue != NULL) {
+        log_queue_resizes(ctx);
+        log_queue_stats(ctx);
+        log_queue_drops(ctx);
+        log_queue_spills(ctx);
+        log_queue_credit_stalls(ctx);
+        consumer_producer_scratch_destroy(&ctx->scratch);
+        consumer_producer_destroy(ctx->queue);
+        free(ctx->queue);
+        ctx->queue = NULL;
+    }
+    pthread_cond_destroy(&ctx->barrier_passed);
+    pthread_mutex_destroy(&ctx->control_lock);
+
+    // Reset context fields (do not free 'name' — no ownership)
+    ctx->next_place_work  = NULL;
+    ctx->next_place_work_batch = NULL;
+    ctx->next_place_work_owned = NULL;
+    ctx->next_place_work_owned_batch = NULL;
+    ctx->next_place_control = NULL;
+    ctx->next_instance    = NULL;
+    ctx->next_grant_credits = NULL;
+    ctx->credits          = 0;
+    ctx->legacy_place_work = NULL;
+    ctx->legacy_place_work_batch = NULL;
+    ctx->legacy_place_work_owned = NULL;
+    ctx->legacy_place_work_owned_batch = NULL;
+    ctx->legacy_place_control = NULL;
+    ctx->legacy_grant_credits = NULL;
+    ctx->process_function = NULL;
+    ctx->inplace_function = NULL;
+    ctx->batch_function   = NULL;
+    ctx->attached         = 0;
+    ctx->finished         = 0;
+    ctx->name             = NULL;   // optional: prevent accidental reuse
+    // (optional) clear thread handle
+    ctx->consumer_thread  = (pthread_t)0;
+
+    // Mark as not initialized
+    ctx->initialized = 0;
+
+    if (ctx->heap_allocated) {
+        free(ctx);
+    }
+
+    // Success
+    return NULL;
+}
+
+/**
+ * Finalize the plugin - drain queue and terminate thread gracefully (pthread_join)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_fini(void)
+{
+    return plugin_instance_fini(&g_plugin_context);
+}
+
+
+/**
+ * Queue a control item. Backends with control lanes never make it wait for room, drop or spill
+ * it; the others queue it in FIFO order like any other item.
+ * @param ctx Plugin context
+ * @param kind PLUGIN_CONTROL_*
+ * @param order Lane to use where there is one
+ * @return NULL on success, error message on failure
+ */
+static const char* queue_control(plugin_context_t* ctx, int kind, cp_control_order_t order)
+{
+    consumer_producer_t* queue = ctx->queue;
+    char* item = &g_control_items[kind];
+    const char* err = (queue->backend->features & CP_FEATURE_CONTROL)
+                          ? consumer_producer_put_control(queue, item, order)
+                          : consumer_producer_put(queue, item);
+    if (err != NULL) {
+        log_error(ctx, err);
+    }
+    return err;
+}
+
+/**
+ * Place work (a string) into an instance's queue
+ * @param instance Handle from plugin_instance_init
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work(void* instance, const char* str)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+
+    // Basic validation
+    if (str == NULL) {
+        log_error(ctx, "plugin_place_work: invalid input (NULL)");
+        return "invalid input";  // SDK: non-NULL on failure
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_work: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    // The string ABI's END sentinel becomes the END control
+    if (is_end(str)) {
+        return queue_control(ctx, PLUGIN_CONTROL_END, CP_CONTROL_ORDERED);
+    }
+
+    // Copy the input into the queue (into the slot itself when it has inline room)
+    const char* err = consumer_producer_put_copy(ctx->queue, str);
+    if (err != NULL) {
+        log_error(ctx, err);
+        return err;  // propagate queue's constant error string
+    }
+
+    // Success
+    return NULL;
+}
+
+/**
+ * Place work (a string) into the plugin's queue
+ * @param str The string to process (plugin takes ownership if it allocates new memory)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_work(const char* str)
+{
+    return plugin_instance_place_work(&g_plugin_context, str);
+}
+
+/**
+ * Place a string ahead of all queued work of an instance
+ * @param instance Handle from plugin_instance_init
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work_urgent(void* instance, const char* str)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+
+    // Basic validation
+    if (str == NULL) {
+        log_error(ctx, "plugin_place_work_urgent: invalid input (NULL)");
+        return "invalid input";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_work_urgent: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    if (is_end(str)) {
+        return queue_control(ctx, PLUGIN_CONTROL_END, CP_CONTROL_URGENT);
+    }
+
+    char* dup = message_dup(str);
+    if (dup == NULL) {
+        log_error(ctx, "plugin_place_work_urgent: out of memory");
+        return "out of memory";
+    }
+
+    // Backends without a priority lane queue the string in FIFO order like any other
+    consumer_producer_t* queue = ctx->queue;
+    const char* err = (queue->backend->features & CP_FEATURE_CONTROL)
+                          ? consumer_producer_put_control(queue, dup, CP_CONTROL_URGENT)
+                          : consumer_producer_put(queue, dup);
+    if (err != NULL) {
+        message_release(dup);
+        log_error(ctx, err);
+        return err;
+    }
+    return NULL;
+}
+
+/**
+ * Place a string ahead of all queued work
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_work_urgent(const char* str)
+{
+    return plugin_instance_place_work_urgent(&g_plugin_context, str);
+}
+
+/**
+ * Check that a context may be attached: initialized, not finished and not attached before
+ * @param ctx Plugin context
+ * @return 1 if attach may proceed, 0 otherwise (logged)
+ */
+static int attach_allowed(plugin_context_t* ctx)
+{
+    // Ensure attach is called only after successful init
+    if (ctx->initialized != 1) {
+        log_error(ctx, "attach called before init");
+        return 0;
+    }
+
+    // Prevent attaching while/after finishing
+    if (ctx->finished == 1) {
+        log_error(ctx, "attach after finish");
+        return 0;
+    }
+
+    // Prevent double attach: keep the original wiring
+    if (ctx->attached == 1) {
+        log_error(ctx, "attach called twice");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Attach an instance to the next plugin instance in the chain
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work The next plugin's plugin_instance_place_work (NULL = last in the chain)
+ * @param next_instance Handle passed to next_place_work
+ */
+void plugin_instance_attach(void* instance, plugin_instance_place_work_fn next_place_work, void* next_instance)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL || !attach_allowed(ctx)) {
+        return;
+    }
+
+    // Store downstream hook (NULL means this is the last plugin in the chain)
+    ctx->next_instance = next_instance;
+    ctx->next_place_work = next_place_work;
+
+    // Mark that attach() was explicitly called (even if next_place_work == NULL)
+    ctx->attached = 1;
+}
+
+/* Shim trampolines: the legacy attach calls keep the next plugin's global functions in the
+   context and wire these instead, with the context itself as the "next instance" */
+static const char* legacy_next_place_work(void* self, const char* str)
+{
+    return ((plugin_context_t*)self)->legacy_place_work(str);
+}
+
+static const char* legacy_next_place_work_batch(void* self, const char* const* strs, int count)
+{
+    return ((plugin_context_t*)self)->legacy_place_work_batch(strs, count);
+}
+
+static int legacy_next_grant_credits(void* self, int max_credits)
+{
+    return ((plugin_context_t*)self)->legacy_grant_credits(max_credits);
+}
+
+/**
+ * Attach this plugin to the next plugin in the chain
+ * @param next_place_work Function pointer to the next plugin's place_work function
+ */
+void plugin_attach(const char* (*next_place_work)(const char*))
+{
+    plugin_context_t* ctx = &g_plugin_context;
+    if (!attach_allowed(ctx)) {
+        return;
+    }
+
+    ctx->legacy_place_work = next_place_work;
+    ctx->next_instance = ctx;
+    ctx->next_place_work = next_place_work != NULL ? legacy_next_place_work : NULL;
+    ctx->attached = 1;
+}
+
+/**
+ * Place several strings into an instance's queue, in order, with one queue operation per chunk
+ * @param instance Handle from plugin_instance_init
+ * @param strs The strings to process (copied; the caller keeps ownership)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work_batch(void* instance, const char* const* strs, int count)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+
+    // Basic validation
+    if (strs == NULL || count < 0) {
+        log_error(ctx, "plugin_place_work_batch: invalid input");
+        return "invalid input";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_work_batch: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    int done = 0;
+
+    while (done < count) {
+        int n = count - done < PLUGIN_BATCH_MAX ? count - done : PLUGIN_BATCH_MAX;
+
+        // Reject a NULL string before anything of its chunk is queued
+        for (int i = 0; i < n; ++i) {
+            if (strs[done + i] == NULL) {
+                log_error(ctx, "invalid input");
+                return "invalid input";
+            }
+        }
+
+        // Copy the chunk into the queue (into the slots themselves when they have inline room)
+        const char* err = consumer_producer_put_copy_batch(ctx->queue, strs + done, n, NULL);
+        if (err != NULL) {
+            log_error(ctx, err);
+            return err;
+        }
+        done += n;
+    }
+
+    // Success
+    return NULL;
+}
+
+/**
+ * Place several strings into the plugin's queue, in order, with one queue operation per chunk
+ * @param strs The strings to process (copied; the caller keeps ownership)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_work_batch(const char* const* strs, int count)
+{
+    return plugin_instance_place_work_batch(&g_plugin_context, strs, count);
+}
+
+/**
+ * Check that a context was attached before extending the wiring with batches or credits
+ * @param ctx Plugin context
+ * @param message Error logged otherwise
+ * @return 1 if attached, 0 otherwise
+ */
+static int attached_or_log(plugin_context_t* ctx, const char* message)
+{
+    if (ctx->initialized != 1 || ctx->attached != 1) {
+        log_error(ctx, message);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Optional: let an instance forward whole batches to the next plugin instance
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work_batch The next plugin's plugin_instance_place_work_batch
+ */
+void plugin_instance_attach_batch(void* instance, plugin_instance_place_work_batch_fn next_place_work_batch)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    // Batch forwarding only extends an existing attach()
+    if (ctx == NULL || !attached_or_log(ctx, "attach_batch called before attach")) {
+        return;
+    }
+
+    ctx->next_place_work_batch = next_place_work_batch;
+}
+
+/**
+ * Optional: let this plugin forward whole batches to the next plugin
+ * @param next_place_work_batch Function pointer to the next plugin's place_work_batch function
+ */
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int))
+{
+    plugin_context_t* ctx = &g_plugin_context;
+    if (!attached_or_log(ctx, "attach_batch called before attach")) {
+        return;
+    }
+
+    ctx->legacy_place_work_batch = next_place_work_batch;
+    ctx->next_place_work_batch = next_place_work_batch != NULL ? legacy_next_place_work_batch : NULL;
+}
+
+/**
+ * Place a heap string into an instance's queue without copying it
+ * @param instance Handle from plugin_instance_init
+ * @param str Heap string to process (the instance owns it from now on, even on failure)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work_owned(void* instance, char* str)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        message_release(str);
+        return "invalid instance";
+    }
+
+    // Basic validation
+    if (str == NULL) {
+        log_error(ctx, "plugin_place_work_owned: invalid input (NULL)");
+        return "invalid input";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_work_owned: plugin not initialized");
+        message_release(str);
+        return "plugin not initialized";
+    }
+
+    // The queue takes the buffer as is
+    const char* err = consumer_producer_put(ctx->queue, str);
+    if (err != NULL) {
+        message_release(str);
+        log_error(ctx, err);
+        return err;
+    }
+    return NULL;
+}
+
+/**
+ * Place a heap string into the plugin's queue without copying it
+ * @param str Heap string to process (the plugin owns it from now on, even on failure)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_work_owned(char* str)
+{
+    return plugin_instance_place_work_owned(&g_plugin_context, str);
+}
+
+/**
+ * Place several heap strings into an instance's queue, in order, with one queue operation
+ * @param instance Handle from plugin_instance_init
+ * @param strs Heap strings to process (the instance owns them from now on, even on failure)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work_owned_batch(void* instance, char** strs, int count)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (strs == NULL || count < 0) {
+        if (ctx != NULL) {
+            log_error(ctx, "plugin_place_work_owned_batch: invalid input");
+        }
+        return "invalid input";
+    }
+
+    const char* err = NULL;
+    int put = 0;
+    if (ctx == NULL) {
+        err = "invalid instance";
+    } else if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_work_owned_batch: plugin not initialized");
+        err = "plugin not initialized";
+    } else {
+        err = consumer_producer_put_batch(ctx->queue, strs, count, &put);
+        if (err != NULL) {
+            log_error(ctx, err);
+        }
+    }
+
+    // Whatever was not queued is ours to free
+    if (err != NULL) {
+        for (int i = put; i < count; ++i) {
+            message_release(strs[i]);
+        }
+    }
+    return err;
+}
+
+/**
+ * Place several heap strings into the plugin's queue, in order, with one queue operation
+ * @param strs Heap strings to process (the plugin owns them from now on, even on failure)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_work_owned_batch(char** strs, int count)
+{
+    return plugin_instance_place_work_owned_batch(&g_plugin_context, strs, count);
+}
+
+/**
+ * Optional: let an instance hand its outputs to the next plugin instance instead of having them copied
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work_owned The next plugin's plugin_instance_place_work_owned
+ * @param next_place_work_owned_batch The next plugin's plugin_instance_place_work_owned_batch (may be NULL)
+ */
+void plugin_instance_attach_owned(void* instance, plugin_instance_place_work_owned_fn next_place_work_owned,
+                                  plugin_instance_place_work_owned_batch_fn next_place_work_owned_batch)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    // Owned handoff only extends an existing attach()
+    if (ctx == NULL || !attached_or_log(ctx, "attach_owned called before attach")) {
+        return;
+    }
+
+    ctx->next_place_work_owned = next_place_work_owned;
+    ctx->next_place_work_owned_batch = next_place_work_owned != NULL ? next_place_work_owned_batch : NULL;
+}
+
+static const char* legacy_next_place_work_owned(void* self, char* str)
+{
+    return ((plugin_context_t*)self)->legacy_place_work_owned(str);
+}
+
+static const char* legacy_next_place_work_owned_batch(void* self, char** strs, int count)
+{
+    return ((plugin_context_t*)self)->legacy_place_work_owned_batch(strs, count);
+}
+
+/**
+ * Optional: let this plugin hand its outputs to the next plugin instead of having them copied
+ * @param next_place_work_owned The next plugin's place_work_owned function
+ * @param next_place_work_owned_batch The next plugin's place_work_owned_batch function (may be NULL)
+ */
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char**, int))
+{
+    plugin_context_t* ctx = &g_plugin_context;
+    if (!attached_or_log(ctx, "attach_owned called before attach")) {
+        return;
+    }
+
+    if (next_place_work_owned == NULL) {
+        next_place_work_owned_batch = NULL;
+    }
+    ctx->legacy_place_work_owned = next_place_work_owned;
+    ctx->legacy_place_work_owned_batch = next_place_work_owned_batch;
+    ctx->next_place_work_owned = next_place_work_owned != NULL ? legacy_next_place_work_owned : NULL;
+    ctx->next_place_work_owned_batch = next_place_work_owned_batch != NULL ? legacy_next_place_work_owned_batch : NULL;
+}
+
+/**
+ * Queue a control message into an instance, behind the work placed so far
+ * @param instance Handle from plugin_instance_init
+ * @param kind PLUGIN_CONTROL_*
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_control(void* instance, int kind)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (kind < 0 || kind >= PLUGIN_CONTROL_KINDS) {
+        log_error(ctx, "plugin_place_control: invalid control kind");
+        return "invalid control kind";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_place_control: plugin not initialized");
+        return "plugin not initialized";
+    }
+    return queue_control(ctx, kind, CP_CONTROL_ORDERED);
+}
+
+/**
+ * Queue a control message behind the work placed so far
+ * @param kind PLUGIN_CONTROL_*
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_place_control(int kind)
+{
+    return plugin_instance_place_control(&g_plugin_context, kind);
+}
+
+/**
+ * Optional: let an instance pass control messages on to the next plugin instance
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_control The next plugin's plugin_instance_place_control
+ */
+void plugin_instance_attach_control(void* instance, plugin_instance_place_control_fn next_place_control)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    // Controls only extend an existing attach()
+    if (ctx == NULL || !attached_or_log(ctx, "attach_control called before attach")) {
+        return;
+    }
+
+    ctx->next_place_control = next_place_control;
+}
+
+static const char* legacy_next_place_control(void* self, int kind)
+{
+    return ((plugin_context_t*)self)->legacy_place_control(kind);
+}
+
+/**
+ * Optional: let this plugin pass control messages on to the next plugin
+ * @param next_place_control The next plugin's place_control function
+ */
+void plugin_attach_control(const char* (*next_place_control)(int))
+{
+    plugin_context_t* ctx = &g_plugin_context;
+    if (!attached_or_log(ctx, "attach_control called before attach")) {
+        return;
+    }
+
+    ctx->legacy_place_control = next_place_control;
+    ctx->next_place_control = next_place_control != NULL ? legacy_next_place_control : NULL;
+}
+
+/**
+ * Wait until an instance passed count BARRIER controls on
+ * @param instance Handle from plugin_instance_init
+ * @param count Barriers to wait for, counted since init
+ * @return NULL once count barriers passed, error message on failure or if the instance finished first
+ */
+const char* plugin_instance_wait_barrier(void* instance, long count)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_wait_barrier: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    pthread_mutex_lock(&ctx->control_lock);
+    while (ctx->barriers < count && !ctx->finished) {
+        pthread_cond_wait(&ctx->barrier_passed, &ctx->control_lock);
+    }
+    int passed = ctx->barriers >= count;
+    pthread_mutex_unlock(&ctx->control_lock);
+    return passed ? NULL : "finished before the barrier";
+}
+
+/**
+ * Wait until this plugin passed count BARRIER controls on
+ * @param count Barriers to wait for, counted since init
+ * @return NULL once count barriers passed, error message on failure or if the plugin finished first
+ */
+const char* plugin_wait_barrier(long count)
+{
+    return plugin_instance_wait_barrier(&g_plugin_context, count);
+}
+
+/**
+ * Optional: credits an instance's queue grants to the plugin placing work into it
+ * @param instance Handle from plugin_instance_init
+ * @param max_credits Largest grant wanted
+ * @return Number of credits (1..max_credits), or -1 if the instance is not running
+ */
+int plugin_instance_grant_credits(void* instance, int max_credits)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL || ctx->initialized != 1 || ctx->queue == NULL || max_credits <= 0) {
+        return -1;
+    }
+    int credits = consumer_producer_wait_credits(ctx->queue, NULL);
+    if (credits <= 0) {
+        return -1;
+    }
+    return credits < max_credits ? credits : max_credits;
+}
+
+/**
+ * Optional: credits this plugin's queue grants to the plugin placing work into it
+ * @param max_credits Largest grant wanted
+ * @return Number of credits (1..max_credits), or -1 if the plugin is not running
+ */
+int plugin_grant_credits(int max_credits)
+{
+    return plugin_instance_grant_credits(&g_plugin_context, max_credits);
+}
+
+/**
+ * Optional: switch an instance to credit-based flow control towards the next plugin instance
+ * @param instance Handle from plugin_instance_init
+ * @param next_grant_credits The next plugin's plugin_instance_grant_credits
+ */
+void plugin_instance_attach_credits(void* instance, plugin_instance_grant_credits_fn next_grant_credits)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    // Credits only extend an existing attach()
+    if (ctx == NULL || !attached_or_log(ctx, "attach_credits called before attach")) {
+        return;
+    }
+
+    ctx->next_grant_credits = next_grant_credits;
+}
+
+/**
+ * Optional: switch this plugin to credit-based flow control towards the next plugin
+ * @param next_grant_credits Function pointer to the next plugin's grant_credits function
+ */
+void plugin_attach_credits(int (*next_grant_credits)(int))
+{
+    plugin_context_t* ctx = &g_plugin_context;
+    if (!attached_or_log(ctx, "attach_credits called before attach")) {
+        return;
+    }
+
+    ctx->legacy_grant_credits = next_grant_credits;
+    ctx->next_grant_credits = next_grant_credits != NULL ? legacy_next_grant_credits : NULL;
+}
+
+/**
+ * Optional: account an instance's queue against a byte budget shared by the whole pipeline
+ * @param instance Handle from plugin_instance_init
+ * @param budget Shared budget (owned by the caller; must outlive plugin_instance_fini)
+ * @param gate 1 if place_work waits for room in the budget, 0 to only account bytes
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_set_byte_budget(void* instance, cp_byte_budget_t* budget, int gate)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "set_byte_budget called before init");
+        return "plugin not initialized";
+    }
+
+    // Keep the per-queue budget from ANALYZER_QUEUE_BYTES, add the shared one
+    cp_stats_t stats;
+    consumer_producer_get_stats(ctx->queue, &stats);
+    const char* err = consumer_producer_set_byte_budget(ctx->queue, stats.byte_budget, budget, gate);
+    if (err != NULL) {
+        log_error(ctx, err);
+    }
+    return err;
+}
+
+/**
+ * Optional: account this plugin's queue against a byte budget shared by the whole pipeline
+ * @param budget Shared budget (owned by the caller; must outlive plugin_fini)
+ * @param gate 1 if place_work waits for room in the budget, 0 to only account bytes
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_byte_budget(cp_byte_budget_t* budget, int gate)
+{
+    return plugin_instance_set_byte_budget(&g_plugin_context, budget, gate);
+}
+
+/**
+ * Optional: serve an instance's queue with several worker threads, releasing their batches downstream
+ * in input order. The pool starts with the next batch the instance takes.
+ * @param instance Handle from plugin_instance_init
+ * @param workers Number of workers (1..PLUGIN_WORKERS_MAX)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_set_workers(void* instance, int workers)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (ctx->initialized != 1) {
+        log_error(ctx, "set_workers called before init");
+        return "plugin not initialized";
+    }
+    if (workers < 1 || workers > PLUGIN_WORKERS_MAX) {
+        return "invalid worker count";
+    }
+    if (workers > 1 && ctx->queue->backend == &cp_backend_spsc) {
+        log_error(ctx, "spsc queues allow a single consumer");
+        return "spsc queues allow a single consumer";
+    }
+    if (atomic_load(&ctx->pool) != NULL) {
+        log_error(ctx, "set_workers called after the pool started");
+        return "worker pool already running";
+    }
+    atomic_store(&ctx->requested_workers, workers);
+    return NULL;
+}
+
+/**
+ * Optional: serve this plugin's queue with several worker threads (see plugin_instance_set_workers)
+ * @param workers Number of workers (1..PLUGIN_WORKERS_MAX)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_workers(int workers)
+{
+    return plugin_instance_set_workers(&g_plugin_context, workers);
+}
+
+/**
+ * Optional: allocate this plugin's message buffers from a pool shared with the rest of the process
+ * @param pool Pool from buffer_pool_default() in the loading program
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_buffer_pool(buffer_pool_t* pool)
+{
+    const char* err = buffer_pool_use(pool);
+    if (err != NULL) {
+        log_error(&g_plugin_context, err);
+    }
+    return err;
+}
+
+/**
+ * Optional: snapshot an instance's worker pool (reorder-buffer depth and head-of-line stalls)
+ * @param instance Handle from plugin_instance_init
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_get_pool_stats(void* instance, plugin_pool_stats_t* out)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (out == NULL) {
+        return "stats pointer is NULL";
+    }
+    if (ctx->initialized != 1) {
+        return "plugin not initialized";
+    }
+    memset(out, 0, sizeof(*out));
+    out->workers = 1;
+    struct plugin_pool* pool = atomic_load_explicit(&ctx->pool, memory_order_acquire);
+    if (pool == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->lock);
+    out->workers = pool->started + 1;
+    out->batches = pool->batches;
+    out->parked = pool->parked;
+    out->reorder_depth = pool->depth;
+    out->reorder_peak = pool->peak;
+    out->hol_stall_ns = pool->hol_stall_ns;
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Optional: choose this plugin's queue backend, overriding ANALYZER_QUEUE_MODE. Call before init.
+ * @param name Backend name ("locked", "spsc", "mpmc" or "inline")
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_set_queue_backend(const char* name)
+{
+    if (g_plugin_context.initialized == 1) {
+        log_error(&g_plugin_context, "set_queue_backend called after init");
+        return "plugin already initialized";
+    }
+    const cp_backend_t* backend = consumer_producer_backend(name);
+    if (backend == NULL) {
+        return "unknown queue backend";
+    }
+    g_queue_backend = backend;
+    return NULL;
+}
+
+/**
+ * Optional: snapshot an instance's queue (capacity, occupancy and, with ANALYZER_QUEUE_STATS=1,
+ * contention counters)
+ * @param instance Handle from plugin_instance_init
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_get_queue_stats(void* instance, cp_stats_t* out)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+    if (out == NULL) {
+        return "stats pointer is NULL";
+    }
+    if (ctx->initialized != 1 || ctx->queue == NULL) {
+        return "plugin not initialized";
+    }
+    if (consumer_producer_get_stats(ctx->queue, out) != 0) {
+        return "failed to read queue stats";
+    }
+    return NULL;
+}
+
+/**
+ * Optional: snapshot this plugin's queue (capacity, occupancy and, with ANALYZER_QUEUE_STATS=1,
+ * contention counters)
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_get_queue_stats(cp_stats_t* out)
+{
+    return plugin_instance_get_queue_stats(&g_plugin_context, out);
+}
+
+/**
+ * Wait until an instance has finished processing all work and is ready to shutdown
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_wait_finished(void* instance)
+{
+    plugin_context_t* ctx = (plugin_context_t*)instance;
+    if (ctx == NULL) {
+        return "invalid instance";
+    }
+
+    // Validate initialization state
+    if (ctx->initialized != 1) {
+        log_error(ctx, "plugin_wait_finished: plugin not initialized");
+        return "plugin not initialized";
+    }
+
+    // Block until the queue is marked finished and fully drained
+    int er = consumer_producer_wait_finished(ctx->queue);
+    if (er != 0) {
+        log_error(ctx, "plugin_wait_finished: wait finished failed");
+        return "wait finished failed";
+    }
+
+    // The caller is the thread that placed the work: the buffers it cached go back to the pool
+    buffer_pool_flush_thread();
+
+    // Success 
+    return NULL;
+}
+
+/**
+ * Wait until the plugin has finished processing all work and is ready to shutdown
+ * This is a blocking function used for graceful shutdown coordination
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_wait_finished(void)
+{
+    return plugin_instance_wait_finished(&g_plugin_context);
+}
@@ -1,95 +1,608 @@
-#include <pthread.h>
-#include "sync/consumer_producer.h"
-
-/**
- * Plugin context structure holding shared data and state for a plugin
- */
-typedef struct
-{
-    const char* name;                         // Plugin name (for diagnosis)
-    consumer_producer_t* queue;               // Input queue
-    pthread_t consumer_thread;                // Consumer thread
-    const char* (*next_place_work)(const char*);   // Next plugin's place_work function
-    const char* (*process_function)(const char*);  // Plugin-specific processing function
-    int initialized;                          // Initialization flag
-    int finished;                             // Finished processing flag
-    int attached;                             // 0 = not attached yet; 1 = attach() was called (even if next_place_work == NULL)
-    int worker_joined;                        // 0 = not joined yet; 1 = pthread_join was performed
-} plugin_context_t;
-
-
-/**
- * Generic consumer thread function
- * This function runs in a separate thread and processes items from the queue
- * @param arg Pointer to plugin_context_t
- * @return NULL
- */
-void* plugin_consumer_thread(void* arg);
-
-/**
- * Print error message in the format [ERROR][Plugin Name] - message
- * @param context Plugin context
- * @param message Error message
- */
-void log_error(plugin_context_t* context, const char* message);
-
-/**
- * Print info message in the format [INFO][Plugin Name] - message
- * @param context Plugin context
- * @param message Info message
- */
-void log_info(plugin_context_t* context, const char* message);
-
-/**
- * Get the plugin's name
- * @return The plugin's name (should not be modified or freed)
- */
-__attribute__((visibility("default")))
-const char* plugin_get_name(void);
-
-/**
- * Initialize the common plugin infrastructure with the specified queue size
- * @param process_function Plugin-specific processing function
- * @param name Plugin name
- * @param queue_size Maximum number of items that can be queued
- * @return NULL on success, error message on failure
- */
-const char* common_plugin_init(const char* (*process_function)(const char*), const char* name, int queue_size);
-
-
-/**
- * Finalize the plugin - drain queue and terminate thread gracefully (pthread_join)
- * @return NULL on success, error message on failure
- */
-__attribute__((visibility("default")))
-const char* plugin_fini(void);
-
-/**
- * Place work (a string) into the plugin's queue
- * @param str The string to process (plugin takes ownership if it allocates new memory)
- * @return NULL on success, error message on failure
- */
-__attribute__((visibility("default")))
-const char* plugin_place_work(const char* str);
-
-/**
- * Attach this plugin to the next plugin in the chain
- * @param next_place_work Function pointer to the next plugin's place_work function
- */
-__attribute__((visibility("default")))
-void plugin_attach(const char* (*next_place_work)(const char*));
-
-/**
- * Wait until the plugin has finished processing all work and is ready to shutdown
- * This is a blocking function used for graceful shutdown coordination
- * @return NULL on success, error message on failure
- */
-__attribute__((visibility("default")))
-const char* plugin_wait_finished(void);
-
-
-/**
- * Returns 1 if s equals the END sentinel exactly, otherwise 0.
- * Treats NULL as "not END".
- */
-int is_end(const char* s);
+#include <pthread.h>
+#include "sync/consumer_producer.h"
+#include "sync/buffer_pool.h"
+#include "sync/message.h"
+
+/* Maximum number of items a consumer thread drains and forwards per batch */
+#define PLUGIN_BATCH_MAX 64
+
+/* Most worker threads one plugin instance may run (see plugin_instance_set_workers) */
+#define PLUGIN_WORKERS_MAX 16
+
+/**
+ * Control messages. They travel through the queues in order with the data, as reserved items
+ * that are never transformed, so no data line is ever mistaken for one.
+ */
+typedef enum
+{
+    PLUGIN_CONTROL_END = 0,     /* End of stream: flush, forward and shut the instance down */
+    PLUGIN_CONTROL_FLUSH,       /* Push everything before it downstream; the last stage flushes stdout */
+    PLUGIN_CONTROL_BARRIER,     /* Like FLUSH, and counted by every stage it passes (plugin_instance_wait_barrier) */
+    PLUGIN_CONTROL_KINDS
+} plugin_control_t;
+
+/**
+ * In-place transform: rewrites buf, which holds *len characters plus a NUL and has room for
+ * capacity bytes (NUL included), and updates *len. Never called with END.
+ * @return 0 on success, -1 on failure, or the capacity it needs if capacity is too small
+ *         (buf untouched; the worker grows the buffer and calls again)
+ */
+typedef long (*plugin_inplace_fn)(char* buf, size_t* len, size_t capacity);
+
+/**
+ * Columnar batch of lines: their texts back to back in one arena, without NULs, plus an offsets
+ * array (Arrow-style). Line i is data[offsets[i]] .. data[offsets[i + 1]), so offsets holds
+ * count + 1 entries and offsets[0] is 0.
+ */
+typedef struct
+{
+    char* data;                 /* Arena */
+    size_t* offsets;            /* count + 1 offsets into data */
+    int count;                  /* Lines */
+    size_t capacity;            /* Bytes data may hold */
+} plugin_batch_t;
+
+/**
+ * Batch transform: transforms every line of in into the line with the same index in out, in one
+ * call. out comes with count and an arena of out->capacity bytes (at least in's size); the
+ * transform writes the texts and all count + 1 offsets. Never sees control items.
+ * @return 0 on success, -1 on failure, or the capacity it needs if out->capacity is too small
+ *         (the worker grows the arena and calls again)
+ */
+typedef long (*plugin_batch_fn)(const plugin_batch_t* in, plugin_batch_t* out);
+
+struct plugin_pool;   /* Worker pool and reorder buffer of a stage with several workers (plugin_common.c) */
+
+/**
+ * Plugin context structure holding shared data and state for one plugin instance.
+ * plugin_instance_init allocates one per call; the legacy plugin_* symbols share a static default one.
+ */
+typedef struct
+{
+    const char* name;                         // Plugin name (for diagnosis)
+    consumer_producer_t* queue;               // Input queue
+    pthread_t consumer_thread;                // Consumer thread
+    const char* (*next_place_work)(void*, const char*);   // Next plugin's place_work, called with next_instance
+    const char* (*next_place_work_batch)(void*, const char* const*, int); // Next plugin's batch place_work (optional)
+    const char* (*next_place_work_owned)(void*, char*);   // Next plugin's owned place_work (optional; no copies)
+    const char* (*next_place_work_owned_batch)(void*, char**, int); // Next plugin's owned batch place_work (optional)
+    const char* (*next_place_control)(void*, int);   // Next plugin's place_control (optional; END falls back to "<END>")
+    void* next_instance;                      // Next plugin's instance handle
+    const char* (*process_function)(const char*);  // Plugin-specific processing function (new outputs from message_alloc, buffer_pool_alloc or malloc)
+    plugin_inplace_fn inplace_function;       // In-place form of process_function (optional; preferred)
+    plugin_batch_fn batch_function;           // Columnar form of process_function (optional; preferred over both)
+    int initialized;                          // Initialization flag
+    int finished;                             // Finished processing flag
+    int attached;                             // 0 = not attached yet; 1 = attach() was called (even if next_place_work == NULL)
+    int worker_joined;                        // 0 = not joined yet; 1 = pthread_join was performed
+    cp_scratch_t scratch;                     // Worker's copies of inline queue items (data is NULL without inline slots)
+    int (*next_grant_credits)(void*, int);    // Next plugin's grant_credits function (optional; NULL = blocking puts)
+    int credits;                              // Items the next plugin accepts without blocking (fetching worker only)
+    const char* (*legacy_place_work)(const char*);   // Set by plugin_attach: the next plugin's global symbols,
+    const char* (*legacy_place_work_batch)(const char* const*, int); // called through the shim's trampolines
+    const char* (*legacy_place_work_owned)(char*);
+    const char* (*legacy_place_work_owned_batch)(char**, int);
+    const char* (*legacy_place_control)(int);
+    int (*legacy_grant_credits)(int);
+    int heap_allocated;                       // 1 = created by plugin_instance_init, freed by plugin_instance_fini
+    atomic_int requested_workers;             // Set by plugin_instance_set_workers; the worker starts the pool
+    _Atomic(struct plugin_pool*) pool;        // NULL while a single worker serves the queue
+    unsigned long message_seq;                // Last sequence number given or seen (fetching worker only)
+    pthread_mutex_t control_lock;             // Guards barriers and wakes plugin_instance_wait_barrier
+    pthread_cond_t barrier_passed;
+    long barriers;                            // BARRIER controls this instance passed on
+} plugin_context_t;
+
+/**
+ * Worker pool counters of one plugin instance (see plugin_instance_get_pool_stats)
+ */
+typedef struct
+{
+    int workers;                // Workers serving the queue (1 = no pool)
+    long batches;               // Batches released downstream by the pool
+    long parked;                // Batches finished out of order that waited in the reorder buffer
+    int reorder_depth;          // Batches in the reorder buffer now
+    int reorder_peak;           // Most batches ever in the reorder buffer
+    long hol_stall_ns;          // Total time parked batches waited for the batches ahead of them
+} plugin_pool_stats_t;
+
+/* Instance ABI: next-plugin hooks take the next plugin's instance handle as their first argument */
+typedef const char* (*plugin_instance_place_work_fn)(void* instance, const char* str);
+typedef const char* (*plugin_instance_place_work_batch_fn)(void* instance, const char* const* strs, int count);
+typedef const char* (*plugin_instance_place_work_owned_fn)(void* instance, char* str);
+typedef const char* (*plugin_instance_place_work_owned_batch_fn)(void* instance, char** strs, int count);
+typedef int (*plugin_instance_grant_credits_fn)(void* instance, int max_credits);
+typedef const char* (*plugin_instance_place_control_fn)(void* instance, int kind);
+
+
+/**
+ * Generic consumer thread function
+ * This function runs in a separate thread and processes items from the queue
+ * @param arg Pointer to plugin_context_t
+ * @return NULL
+ */
+void* plugin_consumer_thread(void* arg);
+
+/**
+ * Print error message in the format [ERROR][Plugin Name] - message
+ * @param context Plugin context
+ * @param message Error message
+ */
+void log_error(plugin_context_t* context, const char* message);
+
+/**
+ * Print info message in the format [INFO][Plugin Name] - message
+ * @param context Plugin context
+ * @param message Info message
+ */
+void log_info(plugin_context_t* context, const char* message);
+
+/**
+ * Get the plugin's name
+ * @return The plugin's name (should not be modified or freed)
+ */
+__attribute__((visibility("default")))
+const char* plugin_get_name(void);
+
+/**
+ * Initialize the common plugin infrastructure with the specified queue size
+ * @param process_function Plugin-specific processing function
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init(const char* (*process_function)(const char*), const char* name, int queue_size);
+
+/**
+ * Create and start a new instance of a plugin, independent of the default instance behind the
+ * legacy symbols and of every other instance (own queue, worker thread and next-plugin wiring).
+ * Each plugin exports plugin_instance_init as a wrapper passing its transform and name.
+ * @param process_function Plugin-specific processing function
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name (see consumer_producer_backend); NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init(const char* (*process_function)(const char*), const char* name,
+                                        int queue_size, const char* queue_backend, void** out_instance);
+
+/**
+ * common_plugin_init for plugins that can also transform a line in its own buffer.
+ * The worker then uses inplace_function and the line's buffer travels on without a new allocation.
+ * @param process_function Plugin-specific processing function (kept as the const-input contract)
+ * @param inplace_function In-place form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init_inplace(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                       const char* name, int queue_size);
+
+/**
+ * common_plugin_instance_init for plugins with an in-place transform (see common_plugin_init_inplace)
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init_inplace(const char* (*process_function)(const char*),
+                                                plugin_inplace_fn inplace_function, const char* name,
+                                                int queue_size, const char* queue_backend, void** out_instance);
+
+/**
+ * common_plugin_init for plugins that can also transform a whole run of lines at once.
+ * The worker gathers each run of data lines it fetches (up to PLUGIN_BATCH_MAX, cut at control
+ * items) into a columnar batch, calls batch_function once, and turns the results back into
+ * messages for the next stage. Queues keep carrying single messages, so stages with scalar
+ * transforms on either side are unaffected.
+ * @param process_function Plugin-specific processing function (kept as the const-input contract)
+ * @param inplace_function In-place form of the same transform (optional, NULL allowed)
+ * @param batch_function Columnar form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_init_batch(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                     plugin_batch_fn batch_function, const char* name, int queue_size);
+
+/**
+ * common_plugin_instance_init for plugins with a batch transform (see common_plugin_init_batch)
+ * @param process_function Plugin-specific processing function
+ * @param inplace_function In-place form of the same transform (optional, NULL allowed)
+ * @param batch_function Columnar form of the same transform
+ * @param name Plugin name
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* common_plugin_instance_init_batch(const char* (*process_function)(const char*),
+                                              plugin_inplace_fn inplace_function, plugin_batch_fn batch_function,
+                                              const char* name, int queue_size, const char* queue_backend,
+                                              void** out_instance);
+
+/**
+ * Create and start a new instance of this plugin (defined by each plugin, see common_plugin_instance_init).
+ * Instances let one .so appear several times in a chain, or run as parallel replicas.
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Backend name; NULL or "" = ANALYZER_QUEUE_MODE
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance);
+
+/**
+ * Finalize an instance like plugin_fini, then free it. The handle is invalid afterwards.
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure (the instance is kept)
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_fini(void* instance);
+
+/**
+ * Place work (a string) into an instance's queue, like plugin_place_work
+ * @param instance Handle from plugin_instance_init
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_work(void* instance, const char* str);
+
+/**
+ * Attach an instance to the next plugin instance in the chain
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work The next plugin's plugin_instance_place_work (NULL = last in the chain)
+ * @param next_instance Handle passed to next_place_work (and to the batch/credit hooks attached later)
+ */
+__attribute__((visibility("default")))
+void plugin_instance_attach(void* instance, plugin_instance_place_work_fn next_place_work, void* next_instance);
+
+/**
+ * Wait until an instance has finished processing all work, like plugin_wait_finished
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_wait_finished(void* instance);
+
+/**
+ * Optional: instance form of plugin_place_work_urgent
+ * @param instance Handle from plugin_instance_init
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_work_urgent(void* instance, const char* str);
+
+/**
+ * Optional: instance form of plugin_place_work_batch
+ * @param instance Handle from plugin_instance_init
+ * @param strs The strings to process (copied; the caller keeps ownership)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_work_batch(void* instance, const char* const* strs, int count);
+
+/**
+ * Optional: instance form of plugin_attach_batch. Must be called after plugin_instance_attach();
+ * next_place_work_batch is called with the next instance given there.
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work_batch The next plugin's plugin_instance_place_work_batch
+ */
+__attribute__((visibility("default")))
+void plugin_instance_attach_batch(void* instance, plugin_instance_place_work_batch_fn next_place_work_batch);
+
+/**
+ * Optional: instance form of plugin_place_work_owned
+ * @param instance Handle from plugin_instance_init
+ * @param str Heap string to process (the instance owns it from now on, even on failure)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_work_owned(void* instance, char* str);
+
+/**
+ * Optional: instance form of plugin_place_work_owned_batch
+ * @param instance Handle from plugin_instance_init
+ * @param strs Heap strings to process (the instance owns them from now on, even on failure)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_work_owned_batch(void* instance, char** strs, int count);
+
+/**
+ * Optional: instance form of plugin_attach_owned. Must be called after plugin_instance_attach();
+ * the functions are called with the next instance given there.
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work_owned The next plugin's plugin_instance_place_work_owned
+ * @param next_place_work_owned_batch The next plugin's plugin_instance_place_work_owned_batch (may be NULL)
+ */
+__attribute__((visibility("default")))
+void plugin_instance_attach_owned(void* instance, plugin_instance_place_work_owned_fn next_place_work_owned,
+                                  plugin_instance_place_work_owned_batch_fn next_place_work_owned_batch);
+
+/**
+ * Optional: instance form of plugin_place_control
+ * @param instance Handle from plugin_instance_init
+ * @param kind PLUGIN_CONTROL_*
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_place_control(void* instance, int kind);
+
+/**
+ * Optional: instance form of plugin_attach_control. Must be called after plugin_instance_attach();
+ * next_place_control is called with the next instance given there.
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_control The next plugin's plugin_instance_place_control
+ */
+__attribute__((visibility("default")))
+void plugin_instance_attach_control(void* instance, plugin_instance_place_control_fn next_place_control);
+
+/**
+ * Optional: instance form of plugin_wait_barrier
+ * @param instance Handle from plugin_instance_init
+ * @param count Barriers to wait for, counted since init
+ * @return NULL once count barriers passed, error message on failure or if the instance finished first
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_wait_barrier(void* instance, long count);
+
+/**
+ * Optional: instance form of plugin_grant_credits
+ * @param instance Handle from plugin_instance_init
+ * @param max_credits Largest grant wanted
+ * @return Number of credits (1..max_credits), or -1 if the instance is not running
+ */
+__attribute__((visibility("default")))
+int plugin_instance_grant_credits(void* instance, int max_credits);
+
+/**
+ * Optional: instance form of plugin_attach_credits. Must be called after plugin_instance_attach();
+ * next_grant_credits is called with the next instance given there.
+ * @param instance Handle from plugin_instance_init
+ * @param next_grant_credits The next plugin's plugin_instance_grant_credits
+ */
+__attribute__((visibility("default")))
+void plugin_instance_attach_credits(void* instance, plugin_instance_grant_credits_fn next_grant_credits);
+
+/**
+ * Optional: instance form of plugin_set_byte_budget
+ * @param instance Handle from plugin_instance_init
+ * @param budget Shared budget (owned by the caller; must outlive plugin_instance_fini)
+ * @param gate 1 if place_work waits for room in the budget, 0 to only account bytes
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_set_byte_budget(void* instance, cp_byte_budget_t* budget, int gate);
+
+/**
+ * Optional: serve an instance's queue with several worker threads. Batches are numbered as they
+ * are taken from the queue and released downstream in that order through a reorder buffer, so the
+ * output order matches the input order. The transform must be thread-safe, and its own side effects
+ * (e.g. printing) happen in processing order, not in release order.
+ * The workers start with the next batch the instance takes; "spsc" queues allow one consumer only.
+ * @param instance Handle from plugin_instance_init
+ * @param workers Number of workers (1..PLUGIN_WORKERS_MAX; 1 keeps the single worker)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_set_workers(void* instance, int workers);
+
+/**
+ * Optional: snapshot an instance's worker pool (reorder-buffer depth and head-of-line stalls).
+ * Exact once plugin_instance_wait_finished returned.
+ * @param instance Handle from plugin_instance_init
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_get_pool_stats(void* instance, plugin_pool_stats_t* out);
+
+/**
+ * Optional: instance form of plugin_get_queue_stats
+ * @param instance Handle from plugin_instance_init
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_instance_get_queue_stats(void* instance, cp_stats_t* out);
+
+/* Legacy ABI: the plugin_* symbols below drive the default instance that plugin_init starts */
+
+/**
+ * Finalize the plugin - drain queue and terminate thread gracefully (pthread_join)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_fini(void);
+
+/**
+ * Place work (a string) into the plugin's queue. The string "<END>" is taken as the END control
+ * here, and only here: the batch and owned calls carry data only.
+ * @param str The string to process (plugin takes ownership if it allocates new memory)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_work(const char* str);
+
+/**
+ * Optional: queue a control message behind the work placed so far. It never waits for room, is
+ * never dropped or spilled, and each stage passes it on once everything before it went downstream.
+ * @param kind PLUGIN_CONTROL_END, PLUGIN_CONTROL_FLUSH or PLUGIN_CONTROL_BARRIER
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_control(int kind);
+
+/**
+ * Optional: let this plugin pass control messages on to the next plugin as control messages.
+ * Must be called after plugin_attach(); without it END is forwarded as the string "<END>" and the
+ * other controls stop here.
+ * @param next_place_control The next plugin's place_control function
+ */
+__attribute__((visibility("default")))
+void plugin_attach_control(const char* (*next_place_control)(int));
+
+/**
+ * Optional: wait until this plugin passed count BARRIER controls on (in total since init), i.e.
+ * until everything placed before the count-th barrier went through it. Wait on the last plugin
+ * to know the whole chain has output it.
+ * @param count Barriers to wait for
+ * @return NULL once count barriers passed, error message on failure or if the plugin finished first
+ */
+__attribute__((visibility("default")))
+const char* plugin_wait_barrier(long count);
+
+/**
+ * Optional: place a string ahead of all queued work (urgent records, abort requests).
+ * Only the locked queue mode has a priority lane; the other modes queue it in FIFO order.
+ * An urgent "<END>" shuts the plugin down without processing the work queued before it.
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_work_urgent(const char* str);
+
+/**
+ * Attach this plugin to the next plugin in the chain
+ * @param next_place_work Function pointer to the next plugin's place_work function
+ */
+__attribute__((visibility("default")))
+void plugin_attach(const char* (*next_place_work)(const char*));
+
+/**
+ * Place several strings into the plugin's queue, in order, with one queue operation per chunk
+ * @param strs The strings to process (copied; the caller keeps ownership)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_work_batch(const char* const* strs, int count);
+
+/**
+ * Optional: let this plugin forward whole batches to the next plugin.
+ * Must be called after plugin_attach(); without it, items are forwarded one at a time.
+ * @param next_place_work_batch Function pointer to the next plugin's place_work_batch function
+ */
+__attribute__((visibility("default")))
+void plugin_attach_batch(const char* (*next_place_work_batch)(const char* const*, int));
+
+/**
+ * Optional: place a heap string into the plugin's queue without copying it. The plugin takes
+ * ownership and frees the string once processed, or right away if it cannot be queued.
+ * @param str Heap string to process (a message, or from buffer_pool_alloc or malloc; the caller must not touch it again)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_work_owned(char* str);
+
+/**
+ * Optional: place several heap strings into the plugin's queue, in order, without copying them
+ * @param strs Heap strings to process (the plugin owns them from now on, even on failure)
+ * @param count Number of strings
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_place_work_owned_batch(char** strs, int count);
+
+/**
+ * Optional: let this plugin hand its outputs to the next plugin instead of having them copied.
+ * Must be called after plugin_attach(); it replaces the copying place_work calls for regular work.
+ * @param next_place_work_owned The next plugin's place_work_owned function
+ * @param next_place_work_owned_batch The next plugin's place_work_owned_batch function (may be NULL)
+ */
+__attribute__((visibility("default")))
+void plugin_attach_owned(const char* (*next_place_work_owned)(char*),
+                         const char* (*next_place_work_owned_batch)(char**, int));
+
+/**
+ * Optional: credits this plugin's queue grants to the plugin placing work into it, i.e. how many
+ * items place_work accepts without blocking. Blocks until at least one credit is available;
+ * waits are counted as credit stalls in the queue stats. Call only from the thread that places work.
+ * @param max_credits Largest grant wanted
+ * @return Number of credits (1..max_credits), or -1 if the plugin is not running
+ */
+__attribute__((visibility("default")))
+int plugin_grant_credits(int max_credits);
+
+/**
+ * Optional: switch this plugin to credit-based flow control towards the next plugin.
+ * Its worker then takes only as many items from its own queue as the next plugin granted credits
+ * for, so it never blocks half-way through forwarding a batch and the items it cannot forward yet
+ * stay queued, back-pressuring the plugin before it. Must be called after plugin_attach().
+ * @param next_grant_credits Function pointer to the next plugin's grant_credits function
+ */
+__attribute__((visibility("default")))
+void plugin_attach_credits(int (*next_grant_credits)(int));
+
+/**
+ * Optional: account this plugin's queue against a byte budget shared by the whole pipeline.
+ * Call after init and before any work is placed. Only the first plugin should gate on it:
+ * inner stages that waited on the shared budget could deadlock the chain.
+ * @param budget Shared budget (owned by the caller; must outlive plugin_fini)
+ * @param gate 1 if place_work waits for room in the budget, 0 to only account bytes
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_set_byte_budget(cp_byte_budget_t* budget, int gate);
+
+/**
+ * Optional: choose the queue backend of this plugin alone (see consumer_producer_backend),
+ * overriding ANALYZER_QUEUE_MODE, so implementations can be compared stage by stage.
+ * Call before plugin_init. "spsc" is only safe while one thread places work.
+ * @param name Backend name ("locked", "spsc", "mpmc" or "inline")
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_set_queue_backend(const char* name);
+
+/**
+ * Optional: snapshot this plugin's queue. Contention counters (puts/gets, time blocked on
+ * full/empty, peak occupancy) are only filled in when ANALYZER_QUEUE_STATS=1.
+ * @param out Receives the snapshot
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_get_queue_stats(cp_stats_t* out);
+
+/**
+ * Optional: serve this plugin's queue with several worker threads (see plugin_instance_set_workers)
+ * @param workers Number of workers (1..PLUGIN_WORKERS_MAX)
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_set_workers(int workers);
+
+/**
+ * Optional: allocate this plugin's message buffers from a pool shared with the rest of the process
+ * instead of its own, so buffers handed from plugin to plugin go back to one pool wherever they are
+ * freed. Call before plugin_init; once this plugin allocated from its own pool it refuses.
+ * @param pool Pool from buffer_pool_default() in the loading program
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_set_buffer_pool(buffer_pool_t* pool);
+
+/**
+ * Wait until the plugin has finished processing all work and is ready to shutdown
+ * This is a blocking function used for graceful shutdown coordination
+ * @return NULL on success, error message on failure
+ */
+__attribute__((visibility("default")))
+const char* plugin_wait_finished(void);
+
+
+/**
+ * Returns 1 if s equals the END sentinel exactly, otherwise 0.
+ * Treats NULL as "not END". Only the string entry points (plugin_place_work) use it: inside the
+ * pipeline END is a control message (PLUGIN_CONTROL_END).
+ */
+int is_end(const char* s);
@@ -38,3 +38,48 @@ void plugin_attach(const char* (*next_place_work)(const char*));
  */
 const char* plugin_wait_finished(void);
 
+
+/*
+ * Instance ABI (optional): one .so may be initialized several times in one process.
+ * Each call to plugin_instance_init returns a handle with its own queue and worker;
+ * the calls below take that handle. The functions above drive a single default instance.
+ */
+
+/**
+ * Create and start a new instance of the plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = the default backend)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance);
+
+/**
+ * Finalize an instance and free it; the handle is invalid afterwards
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_fini(void* instance);
+
+/**
+ * Place work (a string) into an instance's queue
+ * @param instance Handle from plugin_instance_init
+ * @param str The string to process (copied; the caller keeps ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_place_work(void* instance, const char* str);
+
+/**
+ * Attach an instance to the next plugin instance in the chain
+ * @param instance Handle from plugin_instance_init
+ * @param next_place_work The next plugin's plugin_instance_place_work (NULL = last in the chain)
+ * @param next_instance Handle passed to next_place_work
+ */
+void plugin_instance_attach(void* instance, const char* (*next_place_work)(void*, const char*), void* next_instance);
+
+/**
+ * Wait until an instance has finished processing all work
+ * @param instance Handle from plugin_instance_init
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_wait_finished(void* instance);
@@ -15,19 +15,14 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    // Do not transform the termination token; pass it through unchanged
-    if (is_end(input)) {
-        return input;
-    }
-
     // For empty or single-character strings, rotation is a no-op
-    size_t len = strlen(input);
+    size_t len = message_length(input);
     if (len <= 1) {
         return input;
     }
 
-    // Allocate output buffer (len + 1 for the terminating NUL)
-    char* out = (char*)malloc(len + 1);
+    // Allocate the output message (len characters; we write them and the NUL)
+    char* out = message_alloc(len);
     if (out == NULL) {
         // Best-effort fallback: return original input without crashing
         return input;
@@ -42,6 +37,29 @@ const char* plugin_transform(const char* input)
 
     return out;}
 
+/**
+ * In-place form of plugin_transform: rotates the line right by one in its own buffer
+ * @param buf Line to transform (*len characters plus NUL)
+ * @param len Line length (unchanged)
+ * @param capacity Bytes available in buf (unused: the length never changes)
+ * @return 0 on success, -1 on invalid input
+ */
+long plugin_transform_inplace(char* buf, size_t* len, size_t capacity)
+{
+    (void)capacity;
+    if (buf == NULL || len == NULL) {
+        return -1;
+    }
+
+    // Last char goes to index 0, others shift right by one
+    if (*len > 1) {
+        char last = buf[*len - 1];
+        memmove(buf + 1, buf, *len - 1);
+        buf[0] = last;
+    }
+    return 0;
+}
+
 /**
  * Initialize the rotator plugin
  * @param queue_size Maximum number of items that can be queued
@@ -49,5 +67,18 @@ const char* plugin_transform(const char* input)
  */
 const char* plugin_init(int queue_size)
 {
-    return common_plugin_init(plugin_transform, "rotator", queue_size);
+    return common_plugin_init_inplace(plugin_transform, plugin_transform_inplace, "rotator", queue_size);
+}
+
+/**
+ * Create and start a new instance of the rotator plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init_inplace(plugin_transform, plugin_transform_inplace, "rotator", queue_size,
+                                               queue_backend, out_instance);
 }
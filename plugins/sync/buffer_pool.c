@@ -0,0 +1,357 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE     /* MAP_ANONYMOUS, MAP_NORESERVE */
+#endif
+
+#include "buffer_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+/* A free buffer links to the next one through its first bytes */
+typedef struct bp_block
+{
+    struct bp_block* next;
+} bp_block_t;
+
+struct buffer_pool
+{
+    char* base;                     /* Reserved range (NULL = none: everything goes to malloc) */
+    size_t slabs;                   /* Slabs the range holds */
+    atomic_size_t carved;           /* Slabs handed out so far */
+    unsigned char slab_class[BP_REGION_SLABS];  /* Class of each carved slab, set before its buffers escape */
+    _Atomic(bp_block_t*) returned[BP_CLASSES];  /* Buffers given back by threads with a full cache */
+    atomic_long hits;
+    atomic_long misses;
+    atomic_long fallbacks;
+    atomic_long returned_count;
+};
+
+/* Hits a thread counts locally before adding them to the pool's counter */
+#define BP_PUBLISH_EVERY 256
+
+/* Per-thread cache: a LIFO of free buffers per class, bound to the pool they came from */
+typedef struct
+{
+    buffer_pool_t* pool;
+    bp_block_t* head[BP_CLASSES];
+    bp_block_t* tail[BP_CLASSES];
+    int count[BP_CLASSES];
+    long hits;                      /* Not yet published to pool->hits */
+} bp_cache_t;
+
+static _Thread_local bp_cache_t bp_cache;
+
+static buffer_pool_t bp_default_pool;
+static pthread_once_t bp_default_once = PTHREAD_ONCE_INIT;
+static _Atomic(buffer_pool_t*) bp_current = NULL;
+
+/* Reserve the default pool's range; pages are only backed by memory once a slab is used */
+static void bp_default_init(void)
+{
+    size_t bytes = (size_t)BP_REGION_SLABS * BP_SLAB_SIZE;
+    void* base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base != MAP_FAILED) {
+        bp_default_pool.base = (char*)base;
+        bp_default_pool.slabs = BP_REGION_SLABS;
+    }
+}
+
+buffer_pool_t* buffer_pool_default(void)
+{
+    pthread_once(&bp_default_once, bp_default_init);
+    return &bp_default_pool;
+}
+
+const char* buffer_pool_use(buffer_pool_t* pool)
+{
+    if (pool == NULL) {
+        return "Pool is NULL";
+    }
+    buffer_pool_t* expected = NULL;
+    if (!atomic_compare_exchange_strong(&bp_current, &expected, pool) && expected != pool) {
+        return "Buffers were already allocated from another pool";
+    }
+    return NULL;
+}
+
+buffer_pool_t* buffer_pool_current(void)
+{
+    buffer_pool_t* pool = atomic_load_explicit(&bp_current, memory_order_acquire);
+    if (pool == NULL) {
+        buffer_pool_t* own = buffer_pool_default();
+        pool = atomic_compare_exchange_strong(&bp_current, &pool, own) ? own : pool;
+    }
+    return pool;
+}
+
+/* Smallest class holding size bytes (size <= BP_CLASS_MAX) */
+static int bp_class_of(size_t size)
+{
+    if (size <= BP_CLASS_MIN) {
+        return 0;
+    }
+    int bits = (int)(sizeof(unsigned long) * CHAR_BIT) - __builtin_clzl((unsigned long)(size - 1));
+    return bits - BP_CLASS_MIN_SHIFT;
+}
+
+/* Does ptr lie in the pool's range? Sets its slab if so */
+static int bp_slab_of(const buffer_pool_t* pool, const void* ptr, size_t* slab)
+{
+    if (pool->base == NULL) {
+        return 0;
+    }
+    uintptr_t off = (uintptr_t)ptr - (uintptr_t)pool->base;    // Wraps around below base
+    if (off >= (uintptr_t)pool->slabs * BP_SLAB_SIZE) {
+        return 0;
+    }
+    *slab = (size_t)(off / BP_SLAB_SIZE);
+    return 1;
+}
+
+/* Start of the buffer holding ptr, which may point anywhere inside it */
+static char* bp_block_start(const buffer_pool_t* pool, const void* ptr, size_t slab)
+{
+    size_t size = BP_CLASS_MIN << pool->slab_class[slab];
+    char* base = pool->base + slab * BP_SLAB_SIZE;
+    return base + ((size_t)((const char*)ptr - base) / size) * size;
+}
+
+/* Push a chain of buffers onto a class's return list; lock-free, any thread */
+static void bp_return(buffer_pool_t* pool, int cls, bp_block_t* first, bp_block_t* last, int count)
+{
+    bp_block_t* head = atomic_load_explicit(&pool->returned[cls], memory_order_relaxed);
+    do {
+        last->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->returned[cls], &head, first,
+                                                    memory_order_release, memory_order_relaxed));
+    atomic_fetch_add_explicit(&pool->returned_count, count, memory_order_relaxed);
+}
+
+static void bp_publish_hits(bp_cache_t* cache)
+{
+    if (cache->hits > 0) {
+        atomic_fetch_add_explicit(&cache->pool->hits, cache->hits, memory_order_relaxed);
+        cache->hits = 0;
+    }
+}
+
+/* Give a cache's buffers back to its pool */
+static void bp_cache_flush(bp_cache_t* cache)
+{
+    for (int cls = 0; cls < BP_CLASSES; ++cls) {
+        if (cache->head[cls] != NULL) {
+            bp_return(cache->pool, cls, cache->head[cls], cache->tail[cls], cache->count[cls]);
+            cache->head[cls] = NULL;
+            cache->tail[cls] = NULL;
+            cache->count[cls] = 0;
+        }
+    }
+    bp_publish_hits(cache);
+}
+
+/* The calling thread's cache, bound to pool */
+static bp_cache_t* bp_thread_cache(buffer_pool_t* pool)
+{
+    bp_cache_t* cache = &bp_cache;
+    if (cache->pool != pool) {
+        if (cache->pool != NULL) {
+            bp_cache_flush(cache);
+        }
+        cache->pool = pool;
+    }
+    return cache;
+}
+
+/**
+ * Fill an empty cache class: first with every buffer other threads returned, else with a new slab
+ * @return 1 from returned buffers, 2 from a new slab, 0 if the range is used up
+ */
+static int bp_refill(buffer_pool_t* pool, bp_cache_t* cache, int cls)
+{
+    bp_block_t* first = atomic_exchange_explicit(&pool->returned[cls], NULL, memory_order_acquire);
+    if (first != NULL) {
+        int count = 1;
+        bp_block_t* last = first;
+        while (last->next != NULL) {
+            last = last->next;
+            count++;
+        }
+        cache->head[cls] = first;
+        cache->tail[cls] = last;
+        cache->count[cls] = count;
+        return 1;
+    }
+
+    if (pool->base == NULL || atomic_load_explicit(&pool->carved, memory_order_relaxed) >= pool->slabs) {
+        return 0;
+    }
+    size_t slab = atomic_fetch_add_explicit(&pool->carved, 1, memory_order_relaxed);
+    if (slab >= pool->slabs) {
+        return 0;
+    }
+    pool->slab_class[slab] = (unsigned char)cls;
+    size_t size = BP_CLASS_MIN << cls;
+    int count = (int)(BP_SLAB_SIZE / size);
+    char* base = pool->base + slab * BP_SLAB_SIZE;
+    for (int i = 0; i < count - 1; ++i) {
+        ((bp_block_t*)(base + (size_t)i * size))->next = (bp_block_t*)(base + (size_t)(i + 1) * size);
+    }
+    bp_block_t* last = (bp_block_t*)(base + (size_t)(count - 1) * size);
+    last->next = NULL;
+    cache->head[cls] = (bp_block_t*)base;
+    cache->tail[cls] = last;
+    cache->count[cls] = count;
+    return 2;
+}
+
+void* buffer_pool_alloc(size_t size)
+{
+    buffer_pool_t* pool = buffer_pool_current();
+    if (size > BP_CLASS_MAX) {
+        atomic_fetch_add_explicit(&pool->fallbacks, 1, memory_order_relaxed);
+        return malloc(size);
+    }
+
+    int cls = bp_class_of(size);
+    bp_cache_t* cache = bp_thread_cache(pool);
+    bp_block_t* block = cache->head[cls];
+    int carved = 0;
+    if (block == NULL) {
+        int refill = bp_refill(pool, cache, cls);
+        if (refill == 0) {
+            atomic_fetch_add_explicit(&pool->fallbacks, 1, memory_order_relaxed);
+            return malloc(size > 0 ? size : 1);
+        }
+        carved = refill == 2;
+        block = cache->head[cls];
+    }
+
+    cache->head[cls] = block->next;
+    if (cache->head[cls] == NULL) {
+        cache->tail[cls] = NULL;
+    }
+    cache->count[cls]--;
+    if (carved) {
+        atomic_fetch_add_explicit(&pool->misses, 1, memory_order_relaxed);
+    } else if (++cache->hits >= BP_PUBLISH_EVERY) {
+        bp_publish_hits(cache);
+    }
+    return block;
+}
+
+char* buffer_pool_strdup(const char* s)
+{
+    size_t bytes = strlen(s) + 1;
+    char* copy = (char*)buffer_pool_alloc(bytes);
+    if (copy != NULL) {
+        memcpy(copy, s, bytes);
+    }
+    return copy;
+}
+
+void* buffer_pool_realloc(void* ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return buffer_pool_alloc(size);
+    }
+    size_t capacity = buffer_pool_capacity(ptr);
+    if (capacity == 0) {
+        return realloc(ptr, size);      // A malloc'd buffer stays one
+    }
+    if (size <= capacity) {
+        return ptr;
+    }
+    void* bigger = buffer_pool_alloc(size);
+    if (bigger != NULL) {
+        memcpy(bigger, ptr, capacity);
+        buffer_pool_free(ptr);
+    }
+    return bigger;
+}
+
+void buffer_pool_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    buffer_pool_t* pool = buffer_pool_current();
+    size_t slab;
+    if (!bp_slab_of(pool, ptr, &slab)) {
+        free(ptr);
+        return;
+    }
+
+    int cls = pool->slab_class[slab];
+    bp_cache_t* cache = bp_thread_cache(pool);
+    bp_block_t* block = (bp_block_t*)bp_block_start(pool, ptr, slab);
+    block->next = cache->head[cls];
+    if (cache->count[cls] >= BP_CACHE_MAX) {
+        // Full: the whole class goes back in one step, for a thread that allocates to pick up
+        bp_return(pool, cls, block, cache->tail[cls], cache->count[cls] + 1);
+        cache->head[cls] = NULL;
+        cache->tail[cls] = NULL;
+        cache->count[cls] = 0;
+        return;
+    }
+    if (cache->head[cls] == NULL) {
+        cache->tail[cls] = block;
+    }
+    cache->head[cls] = block;
+    cache->count[cls]++;
+}
+
+size_t buffer_pool_capacity(const void* ptr)
+{
+    if (ptr == NULL) {
+        return 0;
+    }
+    buffer_pool_t* pool = buffer_pool_current();
+    size_t slab;
+    if (!bp_slab_of(pool, ptr, &slab)) {
+        return 0;
+    }
+    char* end = bp_block_start(pool, ptr, slab) + (BP_CLASS_MIN << pool->slab_class[slab]);
+    return (size_t)(end - (const char*)ptr);
+}
+
+void* buffer_pool_block(const void* ptr)
+{
+    if (ptr == NULL) {
+        return NULL;
+    }
+    buffer_pool_t* pool = buffer_pool_current();
+    size_t slab;
+    if (!bp_slab_of(pool, ptr, &slab)) {
+        return NULL;
+    }
+    return bp_block_start(pool, ptr, slab);
+}
+
+void buffer_pool_flush_thread(void)
+{
+    if (bp_cache.pool != NULL) {
+        bp_cache_flush(&bp_cache);
+    }
+}
+
+int buffer_pool_get_stats(buffer_pool_t* pool, buffer_pool_stats_t* out)
+{
+    if (pool == NULL || out == NULL) {
+        return -1;
+    }
+    size_t carved = atomic_load_explicit(&pool->carved, memory_order_relaxed);
+    if (carved > pool->slabs) {
+        carved = pool->slabs;
+    }
+    out->hits = atomic_load_explicit(&pool->hits, memory_order_relaxed);
+    out->misses = atomic_load_explicit(&pool->misses, memory_order_relaxed);
+    out->fallbacks = atomic_load_explicit(&pool->fallbacks, memory_order_relaxed);
+    out->returned = atomic_load_explicit(&pool->returned_count, memory_order_relaxed);
+    out->slabs = (long)carved;
+    out->slab_bytes = carved * BP_SLAB_SIZE;
+    return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Pooled allocator for message buffers. Buffers are malloc'd in one thread and freed in another
+ * all along the pipeline, which is the worst case for malloc arenas; the pool recycles them instead.
+ * Sizes are rounded up to power-of-two classes (BP_CLASS_MIN..BP_CLASS_MAX bytes) carved from slabs
+ * of one reserved address range. Each thread keeps a small cache per class; a thread whose cache
+ * overflows hands the surplus back to the pool through a lock-free list, where any thread that runs
+ * dry picks it up. Larger requests, and requests after the range is used up, go to malloc.
+ * buffer_pool_free takes either kind (and any malloc'd pointer), so mixed callers stay safe.
+ */
+#define BP_CLASS_MIN_SHIFT 5            /* Smallest class: 32 bytes */
+#define BP_CLASS_MAX_SHIFT 16           /* Largest class: 64 KiB, the slab size */
+#define BP_CLASSES (BP_CLASS_MAX_SHIFT - BP_CLASS_MIN_SHIFT + 1)
+#define BP_CLASS_MIN ((size_t)1 << BP_CLASS_MIN_SHIFT)
+#define BP_CLASS_MAX ((size_t)1 << BP_CLASS_MAX_SHIFT)
+#define BP_SLAB_SIZE BP_CLASS_MAX       /* Every slab holds buffers of one class */
+#define BP_REGION_SLABS 4096            /* Address range reserved per pool: 4096 slabs = 256 MiB */
+#define BP_CACHE_MAX 64                 /* Buffers a thread keeps per class before returning them */
+
+typedef struct buffer_pool buffer_pool_t;
+
+/**
+ * Pool counters snapshot (buffer_pool_get_stats). Threads publish their hits in batches and when
+ * they flush their cache, so hits may lag slightly while threads run.
+ */
+typedef struct
+{
+    long hits;              /* Allocations served from a thread cache or from returned buffers */
+    long misses;            /* Allocations that had to carve a new slab */
+    long fallbacks;         /* Allocations that went to malloc (too large, or the range is used up) */
+    long returned;          /* Buffers handed back through the lock-free return lists */
+    long slabs;             /* Slabs carved so far */
+    size_t slab_bytes;      /* Memory behind those slabs */
+} buffer_pool_stats_t;
+
+/**
+ * This copy's own pool, created on first use. Each shared object linking buffer_pool.c has its
+ * own; a process that loads several of them shares one through buffer_pool_use.
+ * @return The pool (never NULL: without a reserved range it serves everything from malloc)
+ */
+buffer_pool_t* buffer_pool_default(void);
+
+/**
+ * Allocate, free and size buffers from another copy's pool from now on, so buffers can move
+ * between shared objects. Call before this copy allocates anything.
+ * @param pool Pool to use (from buffer_pool_default in the copy that owns it)
+ * @return NULL on success, error message on failure
+ */
+const char* buffer_pool_use(buffer_pool_t* pool);
+
+/**
+ * The pool this copy allocates from
+ * @return The shared pool given to buffer_pool_use, else buffer_pool_default()
+ */
+buffer_pool_t* buffer_pool_current(void);
+
+/**
+ * Allocate a buffer
+ * @param size Bytes needed
+ * @return The buffer, or NULL when out of memory
+ */
+void* buffer_pool_alloc(size_t size);
+
+/**
+ * Duplicate a string into a pooled buffer
+ * @param s String to copy
+ * @return The copy, or NULL when out of memory
+ */
+char* buffer_pool_strdup(const char* s);
+
+/**
+ * Resize a buffer; a pooled one stays put while its class has room
+ * @param ptr Buffer from buffer_pool_alloc or malloc (NULL = allocate)
+ * @param size Bytes needed
+ * @return The buffer (possibly moved), or NULL when out of memory (ptr is left untouched)
+ */
+void* buffer_pool_realloc(void* ptr, size_t size);
+
+/**
+ * Free a buffer from buffer_pool_alloc, from malloc, or NULL
+ * @param ptr Buffer to free (for a pooled buffer, any address inside it)
+ */
+void buffer_pool_free(void* ptr);
+
+/**
+ * Usable size of a pooled buffer
+ * @param ptr Buffer to look at (may point inside a pooled buffer)
+ * @return Bytes from ptr to the end of its buffer's class, or 0 if it did not come from the pool
+ */
+size_t buffer_pool_capacity(const void* ptr);
+
+/**
+ * Find the pooled buffer an address belongs to, so callers can keep a header in front of the
+ * bytes they hand out (see message.h)
+ * @param ptr Address to look up
+ * @return Start of the pooled buffer holding ptr, or NULL if ptr is not in the pool
+ */
+void* buffer_pool_block(const void* ptr);
+
+/**
+ * Hand the calling thread's cached buffers back to the pool and publish its counters.
+ * Worker threads call it before they exit, so their caches are not stranded.
+ */
+void buffer_pool_flush_thread(void);
+
+/**
+ * Get a snapshot of a pool's counters
+ * @param pool Pool to look at
+ * @param out Receives the counters
+ * @return 0 on success, -1 on invalid arguments
+ */
+int buffer_pool_get_stats(buffer_pool_t* pool, buffer_pool_stats_t* out);
+
+#endif /* BUFFER_POOL_H */
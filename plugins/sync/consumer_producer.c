@@ -1,409 +1,3965 @@
-#include "consumer_producer.h"
-#include <stdlib.h>
-#include <string.h>
-#include <limits.h>
-
-
-/**
- * Initialize a consumer-producer queue
- * @param queue Pointer to queue structure
- * @param capacity Maximum number of items
- * @return NULL on success, error message on failure
- */
-const char* consumer_producer_init(consumer_producer_t* queue, int capacity)
-{
-    // 1. Validate input parameters
-    if (queue == NULL) {
-        return "Queue pointer is NULL";
-    }
-    if (capacity <= 0) {
-        return "Invalid queue capacity";
-    }
-    if (queue->initialized == 1) {
-        return "Queue already initialized";
-    }
-    if (capacity > INT_MAX / (int)sizeof(char*)) {
-        return "Queue capacity too large";
-    }
-
-    // 2. Initialize base fields
-    queue->items = NULL;
-    queue->count = 0;
-    queue->head = 0;
-    queue->tail = 0;
-    queue->capacity = capacity;
-    queue->initialized = 0; // Will be set to 1 only if init completes successfully
-    queue->finished_flag = 0;
-
-    // 2.1 Initialize the queue state mutex (NEW)
-    if (pthread_mutex_init(&queue->lock, NULL) != 0) {
-        return "Failed to initialize queue lock";
-    }
-
-    // 3. Allocate memory for items array
-    queue->items = (char**)calloc(capacity, sizeof(char*));
-    if (queue->items == NULL) {
-        pthread_mutex_destroy(&queue->lock);
-        return "Failed to allocate memory for queue items";
-    }
-
-    // 4. Initialize monitors
-    if (monitor_init(&queue->not_full_monitor) != 0) {
-        free(queue->items);
-        queue->items = NULL;
-        pthread_mutex_destroy(&queue->lock);
-        return "Failed to initialize monitors";
-    }
-
-    if (monitor_init(&queue->not_empty_monitor) != 0) {
-        monitor_destroy(&queue->not_full_monitor);
-        free(queue->items);
-        queue->items = NULL;
-        pthread_mutex_destroy(&queue->lock);
-        return "Failed to initialize monitors";
-    }
-
-    if (monitor_init(&queue->finished_monitor) != 0) {
-        monitor_destroy(&queue->not_full_monitor);
-        monitor_destroy(&queue->not_empty_monitor);
-        free(queue->items);
-        queue->items = NULL;
-        pthread_mutex_destroy(&queue->lock);
-        return "Failed to initialize monitors";
-    }
-
-    // 5. Mark initialization success
-    queue->initialized = 1;
-
-    // 6. Return success
-    return NULL;
-}
-
-
-/**
- * Destroy a consumer-producer queue and free its resources
- * @param queue Pointer to queue structure
- */
-void consumer_producer_destroy(consumer_producer_t* queue)
-{
-    // 1. Validate input
-    if (queue == NULL)
-    {
-        // Nothing to destroy
-        return;
-    }
-    if (queue->initialized != 1)
-    {
-        // Queue was never successfully initialized
-        return;
-    }
-
-    //  Drain remaining items (queue owns items) before freeing the items array
-    //  This prevents memory leaks if destroy is called while items still remain.
-    if (queue->items != NULL && queue->count > 0 && queue->capacity > 0) {
-        int remaining = queue->count;
-        for (int i = 0; i < remaining; ++i) {
-            int idx = (queue->head + i) % queue->capacity;
-            // Free any leftover item; free(NULL) is safe
-            free(queue->items[idx]);
-            queue->items[idx] = NULL; // Defensive: avoid accidental reuse
-        }
-    }
-
-    // 2. Free the items array if allocated
-    if (queue->items != NULL)
-    {
-        free(queue->items);
-        queue->items = NULL;
-    }
-
-    // 3. Destroy monitors
-    monitor_destroy(&queue->not_full_monitor);
-    monitor_destroy(&queue->not_empty_monitor);
-    monitor_destroy(&queue->finished_monitor);
-
-    // 3.1 Destroy the queue state mutex (NEW)
-    pthread_mutex_destroy(&queue->lock);
-
-    // 4. Reset structure fields
-    queue->capacity = 0;
-    queue->count = 0;
-    queue->head = 0;
-    queue->tail = 0;
-    queue->initialized = 0;
-    queue->finished_flag = 0;
-
-}
-
-/**
- * Add an item to the queue (producer). Blocks if queue is full.
- * @param queue Pointer to queue structure
- * @param item String to add (queue takes ownership)
- * @return NULL on success, error message on failure
- */
-const char* consumer_producer_put(consumer_producer_t* queue, const char* item)
-{
-    // Validate input parameters
-    if (queue == NULL) {
-        return "Queue pointer is NULL";
-    }
-    if (item == NULL) {
-        return "Item pointer is NULL";
-    }
-    if (queue->initialized != 1) {
-        return "Queue not initialized";
-    }
-    if (queue->finished_flag == 1) {
-        // Do not accept new items after finished was signaled
-        return "Cannot add item after finished signal";
-    }
-
-    // Lock the queue state before checking/modifying the queue
-    if (pthread_mutex_lock(&queue->lock) != 0) {
-        return "Failed to lock queue";
-    }
-
-    // Re-check finished under the lock to avoid races with signal_finished()
-    if (queue->finished_flag == 1) {
-        pthread_mutex_unlock(&queue->lock);
-        return "Cannot add item after finished signal";
-    }
-
-    // Wait while the queue is full (block without busy-wait)
-    while (queue_is_full(queue)) {
-        // Consume any stale signal before sleeping
-        monitor_reset(&queue->not_full_monitor);
-
-        // Release the lock while waiting so others can make progress
-        pthread_mutex_unlock(&queue->lock);
-
-        // Sleep until a producer can add (not full)
-        if (monitor_wait(&queue->not_full_monitor) != 0) {
-            // On monitor error, report failure (no lock held here)
-            return "Failed during monitor operation (wait)";
-        }
-
-        // Re-acquire the lock and re-check the predicate in the loop
-        if (pthread_mutex_lock(&queue->lock) != 0) {
-            return "Failed to lock queue";
-        }
-        // Note: we intentionally do NOT reject here if finished_flag became 1,
-        // because this put started before 'finished' and is allowed to complete.
-    }
-
-    // Insert the item into the queue (still holding the lock)
-    queue->items[queue->tail] = (char*)item;  // queue takes ownership
-    queue->tail = (queue->tail + 1) % queue->capacity;
-    queue->count++;
-
-    // Release the lock before signaling
-    pthread_mutex_unlock(&queue->lock);
-
-    // Signal that the queue is not empty to wake waiting consumers
-    monitor_signal(&queue->not_empty_monitor);
-
-    // Success
-    return NULL;
-}
-
-/**
- * Remove an item from the queue (consumer) and returns it. Blocks if queue is empty.
- * @param queue Pointer to queue structure
- * @return String item or NULL if queue is empty
- */
-char* consumer_producer_get(consumer_producer_t* queue)
-{
-    // Validate input
-    if (queue == NULL) {
-        return NULL;
-    }
-    if (queue->initialized != 1) {
-        return NULL;
-    }
-
-    // Lock the queue state before checking/modifying it
-    if (pthread_mutex_lock(&queue->lock) != 0) {
-        return NULL; // Failed to lock (rare)
-    }
-
-    // Block while the queue is empty and we are not finished yet
-    while (queue_is_empty(queue) && queue->finished_flag == 0) {
-        // Consume any stale signal before sleeping
-        monitor_reset(&queue->not_empty_monitor);
-
-        // Release the queue lock while waiting so producers can make progress
-        pthread_mutex_unlock(&queue->lock);
-
-        // Sleep until the queue becomes non-empty (or a related signal arrives)
-        if (monitor_wait(&queue->not_empty_monitor) != 0) {
-            // On monitor error, just return NULL (no lock is held here)
-            return NULL;
-        }
-
-        // Re-acquire the queue lock and re-check the predicate in the loop
-        if (pthread_mutex_lock(&queue->lock) != 0) {
-            return NULL; // Failed to lock (rare)
-        }
-    }
-
-    // If we are finished and still empty, nothing more to consume
-    if (queue_is_empty(queue) && queue->finished_flag == 1) {
-        pthread_mutex_unlock(&queue->lock);
-        return NULL;
-    }
-
-    // Dequeue one item under the queue lock
-    int old_head = queue->head;
-    char* item = queue->items[old_head];     // Ownership transfers to the caller
-    queue->items[old_head] = NULL;           // Defensive: avoid accidental reuse
-    queue->head = (queue->head + 1) % queue->capacity;
-    queue->count--;
-
-    // Determine if we just made the queue empty after 'finished' was set
-    int became_empty = (queue->count == 0 && queue->finished_flag == 1);
-
-    // Release the queue lock before signaling
-    pthread_mutex_unlock(&queue->lock);
-
-    // Wake any producers waiting for space
-    monitor_signal(&queue->not_full_monitor);
-
-    // If the queue became empty after finishing, notify waiters on 'finished'
-    if (became_empty) {
-        monitor_signal(&queue->finished_monitor);
-    }
-
-    // Return the dequeued item to the caller (caller is responsible to free)
-    return item;
-}
-
-
-/**
- * Signal that processing is finished
- * @param queue Pointer to queue structure
- */
-void consumer_producer_signal_finished(consumer_producer_t* queue)
-{
-    // Validate input
-    if (queue == NULL) {
-        return;
-    }
-    if (queue->initialized != 1) {
-        return;
-    }
-
-    // Protect finished_flag with the queue lock
-    if (pthread_mutex_lock(&queue->lock) != 0) {
-        return; // Failed to lock (rare)
-    }
-
-    // If already finished, nothing to do
-    if (queue->finished_flag == 1) {
-        pthread_mutex_unlock(&queue->lock);
-        return;
-    }
-
-    // Mark as finished under the lock
-    queue->finished_flag = 1;
-
-    // Release the lock before signaling
-    pthread_mutex_unlock(&queue->lock);
-
-    // Notify waiters:
-    // 1) finished_monitor: wake wait_finished() "phase 1"
-    // 2) not_empty_monitor: wake consumers sleeping on "empty"
-    monitor_signal(&queue->finished_monitor);
-    monitor_signal(&queue->not_empty_monitor);
-}
-
-/**
- * Wait for processing to be finished
- * @param queue Pointer to queue structure
- * @return 0 on success, -1 on timeout
- */
-int consumer_producer_wait_finished(consumer_producer_t* queue)
-{
-    // Validate input
-    if (queue == NULL) {
-        return -1;
-    }
-    if (queue->initialized != 1) {
-        return -1;
-    }
-
-    // Take the queue lock to safely read/modify the queue state
-    if (pthread_mutex_lock(&queue->lock) != 0) {
-        return -1; // Failed to lock (rare)
-    }
-
-    // Fast path: already finished and fully drained
-    if (queue->finished_flag == 1 && queue->count == 0) {
-        pthread_mutex_unlock(&queue->lock);
-        return 0;
-    }
-
-    // Phase 1: wait for 'finished' to be signaled (without busy-wait)
-    while (queue->finished_flag == 0) {
-        // Consume any stale signal before sleeping
-        monitor_reset(&queue->finished_monitor);
-
-        // Release the queue lock while waiting so others can make progress
-        pthread_mutex_unlock(&queue->lock);
-
-        // Sleep until 'finished' is signaled
-        if (monitor_wait(&queue->finished_monitor) != 0) {
-            // On monitor error, report failure (no lock is held here)
-            return -1;
-        }
-
-        // Re-acquire the lock and re-check the predicate in the loop
-        if (pthread_mutex_lock(&queue->lock) != 0) {
-            return -1;
-        }
-    }
-
-    // Phase 2: 'finished' is set; wait until the queue is fully drained
-    while (queue->count > 0) {
-        // Consume any stale signal before sleeping
-        monitor_reset(&queue->finished_monitor);
-
-        // Release the lock while waiting
-        pthread_mutex_unlock(&queue->lock);
-
-        // Sleep until a consumer makes the queue empty after 'finished'
-        if (monitor_wait(&queue->finished_monitor) != 0) {
-            return -1; // No lock is held here
-        }
-
-        // Re-acquire the lock and re-check
-        if (pthread_mutex_lock(&queue->lock) != 0) {
-            return -1;
-        }
-    }
-
-    // Done: finished was signaled and the queue is empty
-    pthread_mutex_unlock(&queue->lock);
-    return 0;
-}
-
-/**
- * Check if the queue is full
- * @param queue Pointer to the queue structure
- * @return 1 if full, 0 otherwise
- */
-int queue_is_full(const consumer_producer_t* queue)
-{
-    // A queue is full when the number of items equals its capacity
-    return queue->count == queue->capacity;
-}
-
-/**
- * Check if the queue is empty
- * @param queue Pointer to the queue structure
- * @return 1 if empty, 0 otherwise
- */
-int queue_is_empty(const consumer_producer_t* queue)
-{
-    // A queue is empty when there are no items in it
-    return queue->count == 0;
-}
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L     /* clock_gettime, sched_yield */
+#endif
+
+#include "consumer_producer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/* Assumed cache line size, used to keep producer and consumer indices apart */
+#define CP_CACHE_LINE 64
+
+const char CP_ERR_TIMEOUT[] = "Timed out waiting for the queue";
+
+/* Being in the past, CP_NO_WAIT also behaves correctly if it ever reaches a timed wait */
+const struct timespec cp_no_wait_deadline = { 0, 0 };
+
+/* Initialize a condition variable whose timed waits take CLOCK_MONOTONIC deadlines */
+static int cp_cond_init(pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+    int rc = pthread_condattr_init(&attr);
+    if (rc != 0) {
+        return rc;
+    }
+    rc = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (rc == 0) {
+        rc = pthread_cond_init(cond, &attr);
+    }
+    pthread_condattr_destroy(&attr);
+    return rc;
+}
+
+/* pthread_cond_wait, or pthread_cond_timedwait when a deadline is given */
+static int cp_cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, const struct timespec* deadline)
+{
+    if (deadline == NULL) {
+        return pthread_cond_wait(cond, lock);
+    }
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+/* ---------------------------------------------------------------------------
+ * Readiness eventfd helpers
+ *
+ * An fd is "armed" by a non-blocking call that found nothing to do: it clears
+ * the eventfd, sets the armed flag and re-checks the queue. The other side
+ * notifies only if it finds the flag set (and clears it), so an idle queue
+ * costs no syscalls and a busy one costs at most one write per re-arm. In
+ * SPSC mode the flag/index accesses are seq_cst, exactly like the parked
+ * flags, so "arm, then re-check" and "publish, then check armed" cannot both
+ * miss; in locked mode all of it happens under the queue lock.
+ * ------------------------------------------------------------------------- */
+
+static void cp_event_notify(int fd)
+{
+    uint64_t one = 1;
+    ssize_t rc = write(fd, &one, sizeof(one));
+    (void)rc;   // EAGAIN only if the counter is saturated, i.e. already readable
+}
+
+/* Clear the eventfd, then arm it so the next transition notifies */
+static void cp_event_arm(atomic_int* armed, int fd)
+{
+    uint64_t value;
+    ssize_t rc = read(fd, &value, sizeof(value));
+    (void)rc;   // EAGAIN when it was not readable: nothing to clear
+    atomic_store(armed, 1);
+}
+
+/* Called after making the queue non-empty (items fd) or non-full (space fd) */
+static void cp_event_fire(atomic_int* armed, int fd)
+{
+    if (fd >= 0 && atomic_load(armed) && atomic_exchange(armed, 0)) {
+        cp_event_notify(fd);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Wait strategy helpers
+ *
+ * A blocked call first spins on pause instructions (re-checking its wake-up
+ * condition without sleeping), then yields a few times, and only then parks
+ * on its monitor/condition variable. Spinning runs at most once per blocked
+ * call and never replaces the parking protocol, it only delays it.
+ *
+ * CP_WAIT_ADAPTIVE measures how long blocked calls actually waited and what
+ * one spin iteration costs, then sets the budget to about twice the typical
+ * wait (the pause cost is measured once per process). When waits are longer
+ * than spin_limit iterations the budget drops to 0 and the side parks at
+ * once; the waits it keeps measuring while parked bring spinning back when
+ * the chain heats up again. Clocks are only read on the blocking path.
+ *
+ * With a single online CPU the other side cannot make progress while we
+ * spin, so the pause loop is skipped and only the yields remain.
+ * ------------------------------------------------------------------------- */
+
+/* Yields tried between spinning and parking */
+#define CP_YIELD_ROUNDS 4
+/* Locked mode: pause iterations between two peeks at the (mutex-guarded) state */
+#define CP_LOCKED_PEEK_STRIDE 16
+/* Smallest non-zero adaptive spin budget */
+#define CP_SPIN_MIN 32
+
+/* Per-call bookkeeping of a blocked put/get */
+typedef struct
+{
+    long long start_ns;     /* When the call started blocking (adaptive only) */
+    int tried;              /* The spin phase already ran for this call */
+} cp_wait_t;
+
+/* Wake-up condition polled while spinning */
+typedef int (*cp_ready_fn)(consumer_producer_t* queue, const void* arg);
+
+static inline void cp_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+static long long cp_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Machine facts probed once: whether spinning can help and what one pause costs */
+static atomic_int cp_probed = 0;
+static atomic_int cp_multi_cpu = 0;
+static atomic_long cp_pause_ps = 0;
+
+static void cp_probe(void)
+{
+    if (atomic_load_explicit(&cp_probed, memory_order_acquire)) {
+        return;
+    }
+
+    // Best of a few short runs, so a preemption during one run does not skew the cost
+    long best = 0;
+    for (int run = 0; run < 3; ++run) {
+        long long t0 = cp_now_ns();
+        for (int i = 0; i < 1000; ++i) {
+            cp_cpu_relax();
+        }
+        long ps = (long)(cp_now_ns() - t0);     // ns per 1000 pauses == ps per pause
+        if (best == 0 || (ps > 0 && ps < best)) {
+            best = ps;
+        }
+    }
+    atomic_store_explicit(&cp_pause_ps, best > 0 ? best : 1, memory_order_relaxed);
+    atomic_store_explicit(&cp_multi_cpu, sysconf(_SC_NPROCESSORS_ONLN) > 1, memory_order_relaxed);
+    atomic_store_explicit(&cp_probed, 1, memory_order_release);
+}
+
+/* Instrumentation: when the current thread's put/get call started blocking (0 = it has not).
+ * Thread-local, so cp_put_batch/cp_get_batch can account a wait begun by any mode's helpers. */
+static _Thread_local long long cp_blocked_since_ns = 0;
+
+/* Note that the calling thread is about to block on queue (only timed while instrumented) */
+static void cp_mark_blocked(const consumer_producer_t* queue)
+{
+    if (queue->instrumented && cp_blocked_since_ns == 0) {
+        cp_blocked_since_ns = cp_now_ns();
+    }
+}
+
+/* Start tracking a blocked call (called only once the fast path failed) */
+static void cp_wait_begin(consumer_producer_t* queue, cp_wait_t* wait)
+{
+    cp_mark_blocked(queue);
+    wait->tried = 0;
+    wait->start_ns = (queue->wait_strategy == CP_WAIT_ADAPTIVE) ? cp_now_ns() : 0;
+}
+
+/* Whether this blocked call should still spin before parking */
+static int cp_wait_should_spin(const consumer_producer_t* queue, cp_spin_state_t* side, const cp_wait_t* wait)
+{
+    return queue->wait_strategy != CP_WAIT_PARK && !wait->tried &&
+           atomic_load_explicit(&side->budget, memory_order_relaxed) > 0;
+}
+
+/* Spin, then yield, until ready() holds or the budget runs out.
+ * @return 1 if ready() became true, 0 if the caller should park */
+static int cp_wait_spin(consumer_producer_t* queue, cp_spin_state_t* side, cp_wait_t* wait,
+                        cp_ready_fn ready, const void* arg)
+{
+    const int stride = (queue->mode == CP_MODE_LOCKED) ? CP_LOCKED_PEEK_STRIDE : 1;
+    int budget = atomic_load_explicit(&side->budget, memory_order_relaxed);
+    if (!atomic_load_explicit(&cp_multi_cpu, memory_order_relaxed)) {
+        budget = 0;     // Nobody can publish while we hold the only CPU
+    }
+
+    wait->tried = 1;
+    for (int i = 1; i <= budget; ++i) {
+        cp_cpu_relax();
+        if ((i % stride == 0 || i == budget) && ready(queue, arg)) {
+            return 1;
+        }
+    }
+
+    // Give the other side a chance to run on this core before we pay for a sleep
+    for (int r = 0; r < CP_YIELD_ROUNDS; ++r) {
+        sched_yield();
+        if (ready(queue, arg)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Finish tracking a blocked call that got what it waited for; adaptive mode resizes the budget */
+static void cp_wait_end(consumer_producer_t* queue, cp_spin_state_t* side, const cp_wait_t* wait)
+{
+    if (queue->wait_strategy != CP_WAIT_ADAPTIVE) {
+        return;
+    }
+
+    // Moving average of the wait, i.e. the inter-arrival gap as seen by this side
+    long waited = (long)(cp_now_ns() - wait->start_ns);
+    long avg = atomic_load_explicit(&side->avg_wait_ns, memory_order_relaxed);
+    avg = (avg == 0) ? waited : (3 * avg + waited) / 4;
+    atomic_store_explicit(&side->avg_wait_ns, avg, memory_order_relaxed);
+
+    // Spin for about twice the typical wait; park at once if that exceeds the limit
+    long long target = 2LL * avg * 1000 / atomic_load_explicit(&cp_pause_ps, memory_order_relaxed);
+    int budget = 0;
+    if (target <= queue->spin_limit) {
+        budget = target < CP_SPIN_MIN ? CP_SPIN_MIN : (int)target;
+    }
+    atomic_store_explicit(&side->budget, budget, memory_order_relaxed);
+}
+
+
+/* ---------------------------------------------------------------------------
+ * CP_MODE_SPSC helpers
+ *
+ * One producer owns the tail index, one consumer owns the head index. Each side keeps a
+ * cached copy of the other side's index and only re-reads the shared one when
+ * the cached value says the ring is full/empty, so the hot path touches no
+ * shared cache line that the other side is writing.
+ *
+ * Parking uses the existing monitors, but only when the ring is truly
+ * full/empty. The "parked" flags and the indices are accessed with seq_cst
+ * operations so that "publish index, then check parked" on one side and
+ * "set parked, then re-check index" on the other can never both miss.
+ * ------------------------------------------------------------------------- */
+
+/* CP_MODE_SPSC state (queue->impl): count/head/tail are unused, the ring is driven by these indices.
+ * Indices grow monotonically; slot = index & mask (ring size is a power of two). */
+typedef struct
+{
+    char** slots;                   /* Ring slots (queue->items is unused) */
+    size_t mask;                    /* Ring size - 1 */
+    char pad0[CP_CACHE_LINE];
+    atomic_size_t head;             /* Next slot to read; written only by the consumer */
+    size_t cached_tail;             /* Consumer's last observed tail (avoids touching the producer line) */
+    atomic_int consumer_parked;     /* 1 while the consumer sleeps on not_empty_monitor */
+    char pad1[CP_CACHE_LINE];
+    atomic_size_t tail;             /* Next slot to write; written only by the producer */
+    size_t cached_head;             /* Producer's last observed head */
+    atomic_int producer_parked;     /* 1 while the producer sleeps on not_full_monitor */
+    char pad2[CP_CACHE_LINE];
+} cp_spsc_t;
+
+/* Round capacity up to the next power of two (0 if it would overflow) */
+static size_t spsc_ring_size(int capacity)
+{
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+        if (size > ((size_t)INT_MAX + 1) / 2) {
+            return 0;
+        }
+        size <<= 1;
+    }
+    return size;
+}
+
+/* Number of items currently in the ring (exact only when called by the producer or consumer) */
+static size_t spsc_size(const consumer_producer_t* queue)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    size_t tail = atomic_load(&spsc->tail);
+    size_t head = atomic_load(&spsc->head);
+    return tail - head;
+}
+
+/* Spin predicate (producer): a slot is free at *(size_t*)arg */
+static int spsc_space_ready(consumer_producer_t* queue, const void* arg)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    size_t tail = *(const size_t*)arg;
+    return tail - atomic_load_explicit(&spsc->head, memory_order_acquire) < (size_t)queue->capacity;
+}
+
+/* Spin predicate (consumer): an item was published after *(size_t*)arg, or finished */
+static int spsc_items_ready(consumer_producer_t* queue, const void* arg)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    size_t head = *(const size_t*)arg;
+    return atomic_load_explicit(&spsc->tail, memory_order_acquire) != head ||
+           atomic_load_explicit(&queue->finished_flag, memory_order_relaxed) == 1;
+}
+
+/* Producer side: block until at least one slot is free or the deadline passes.
+ * @return number of free slots (>0), -1 on monitor failure, or CP_TIMEDOUT */
+static long spsc_wait_for_space(consumer_producer_t* queue, size_t tail, const struct timespec* deadline)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    const size_t capacity = (size_t)queue->capacity;
+    cp_wait_t wait;
+    int waiting = 0;
+
+    // Fast path: the cached head already shows free space
+    while (tail - spsc->cached_head >= capacity) {
+        // Refresh from the consumer's index
+        spsc->cached_head = atomic_load_explicit(&spsc->head, memory_order_acquire);
+        if (tail - spsc->cached_head < capacity) {
+            break;
+        }
+
+        // Full: a try_put gives up here (arming the space fd, then looking once more),
+        // anything else spins first if the wait strategy asks for it
+        if (deadline == CP_NO_WAIT) {
+            if (queue->space_event_fd < 0) {
+                return CP_TIMEDOUT;
+            }
+            cp_event_arm(&queue->space_armed, queue->space_event_fd);
+            spsc->cached_head = atomic_load(&spsc->head);
+            if (tail - spsc->cached_head >= capacity) {
+                return CP_TIMEDOUT;
+            }
+            break;
+        }
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        if (cp_wait_should_spin(queue, &queue->producer_spin, &wait) &&
+            cp_wait_spin(queue, &queue->producer_spin, &wait, spsc_space_ready, &tail)) {
+            continue;
+        }
+
+        // Truly full: announce that we are going to sleep, then re-check once
+        monitor_reset(&queue->not_full_monitor);
+        atomic_store(&spsc->producer_parked, 1);
+        spsc->cached_head = atomic_load(&spsc->head);
+        if (tail - spsc->cached_head < capacity) {
+            atomic_store(&spsc->producer_parked, 0);
+            break;
+        }
+
+        int rc = monitor_timedwait(&queue->not_full_monitor, deadline);
+        atomic_store(&spsc->producer_parked, 0);
+        if (rc < 0) {
+            return -1;
+        }
+        if (rc == 1) {
+            // Deadline passed: one last look before giving up
+            spsc->cached_head = atomic_load(&spsc->head);
+            if (tail - spsc->cached_head >= capacity) {
+                return CP_TIMEDOUT;
+            }
+        }
+    }
+
+    if (waiting) {
+        cp_wait_end(queue, &queue->producer_spin, &wait);
+    }
+    return (long)(capacity - (tail - spsc->cached_head));
+}
+
+/* Consumer side: block until at least one item is readable or the deadline passes.
+ * @return number of readable items (>0), 0 if finished and drained, -1 on monitor failure, or CP_TIMEDOUT */
+static long spsc_wait_for_items(consumer_producer_t* queue, size_t head, const struct timespec* deadline)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    cp_wait_t wait;
+    int waiting = 0;
+
+    // Fast path: the cached tail already shows an item
+    while (head == spsc->cached_tail) {
+        // Refresh from the producer's index
+        spsc->cached_tail = atomic_load_explicit(&spsc->tail, memory_order_acquire);
+        if (head != spsc->cached_tail) {
+            break;
+        }
+
+        // Empty and finished: nothing more will ever arrive
+        if (atomic_load(&queue->finished_flag) == 1) {
+            spsc->cached_tail = atomic_load(&spsc->tail);
+            if (head != spsc->cached_tail) {
+                break;
+            }
+            return 0;
+        }
+
+        // Empty: a try_get gives up here (arming the items fd, then looking once more),
+        // anything else spins first if the wait strategy asks for it
+        if (deadline == CP_NO_WAIT) {
+            if (queue->items_event_fd < 0) {
+                return CP_TIMEDOUT;
+            }
+            cp_event_arm(&queue->items_armed, queue->items_event_fd);
+            spsc->cached_tail = atomic_load(&spsc->tail);
+            if (head == spsc->cached_tail && atomic_load(&queue->finished_flag) == 0) {
+                return CP_TIMEDOUT;
+            }
+            continue;   // Items or finished arrived meanwhile: handle them normally
+        }
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        if (cp_wait_should_spin(queue, &queue->consumer_spin, &wait) &&
+            cp_wait_spin(queue, &queue->consumer_spin, &wait, spsc_items_ready, &head)) {
+            continue;
+        }
+
+        // Truly empty: announce that we are going to sleep, then re-check once
+        monitor_reset(&queue->not_empty_monitor);
+        atomic_store(&spsc->consumer_parked, 1);
+        spsc->cached_tail = atomic_load(&spsc->tail);
+        if (head != spsc->cached_tail || atomic_load(&queue->finished_flag) == 1) {
+            atomic_store(&spsc->consumer_parked, 0);
+            continue;
+        }
+
+        int rc = monitor_timedwait(&queue->not_empty_monitor, deadline);
+        atomic_store(&spsc->consumer_parked, 0);
+        if (rc < 0) {
+            return -1;
+        }
+        if (rc == 1) {
+            // Deadline passed: one last look (items or finished) before giving up
+            spsc->cached_tail = atomic_load(&spsc->tail);
+            if (head == spsc->cached_tail && atomic_load(&queue->finished_flag) == 0) {
+                return CP_TIMEDOUT;
+            }
+        }
+    }
+
+    if (waiting) {
+        cp_wait_end(queue, &queue->consumer_spin, &wait);
+    }
+    return (long)(spsc->cached_tail - head);
+}
+
+/* Producer side: publish n already-filled slots and wake the consumer if it sleeps */
+static void spsc_publish(consumer_producer_t* queue, size_t new_tail)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    atomic_store(&spsc->tail, new_tail);
+
+    // Wake the consumer only if it actually went to sleep
+    if (atomic_load(&spsc->consumer_parked)) {
+        monitor_signal(&queue->not_empty_monitor);
+    }
+
+    // Same for a consumer that is waiting on the items fd
+    cp_event_fire(&queue->items_armed, queue->items_event_fd);
+}
+
+/* Consumer side: release consumed slots and wake whoever is waiting on that */
+static void spsc_release(consumer_producer_t* queue, size_t new_head)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    atomic_store(&spsc->head, new_head);
+
+    // Wake the producer only if it actually went to sleep (or waits on the space fd)
+    if (atomic_load(&spsc->producer_parked)) {
+        monitor_signal(&queue->not_full_monitor);
+    }
+    cp_event_fire(&queue->space_armed, queue->space_event_fd);
+
+    // If we just drained the ring after 'finished', release everyone in wait_finished()
+    if (atomic_load(&queue->finished_flag) == 1 && new_head == atomic_load(&spsc->tail)) {
+        pthread_mutex_lock(&queue->lock);
+        if (queue->finish_waiters > 0) {
+            pthread_cond_broadcast(&queue->drained);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+static const char* spsc_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                  const struct timespec* deadline, int copy)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    (void)copy;     // No inline slots: copy puts hand over heap strings only
+    // Do not accept new items after finished was signaled
+    if (atomic_load(&queue->finished_flag) == 1) {
+        return "Cannot add item after finished signal";
+    }
+
+    size_t tail = atomic_load_explicit(&spsc->tail, memory_order_relaxed);
+    int done = 0;
+
+    while (done < count) {
+        long room = spsc_wait_for_space(queue, tail, deadline);
+        if (room == CP_TIMEDOUT) {
+            return CP_ERR_TIMEOUT;
+        }
+        if (room < 0) {
+            return "Failed during monitor operation (wait)";
+        }
+
+        // Fill every free slot we can, then publish them with a single index store
+        size_t n = (size_t)(count - done) < (size_t)room ? (size_t)(count - done) : (size_t)room;
+        for (size_t k = 0; k < n; ++k) {
+            spsc->slots[(tail + k) & spsc->mask] = items[done + (int)k];
+        }
+        tail += n;
+        done += (int)n;
+        spsc_publish(queue, tail);
+
+        if (put_count != NULL) {
+            *put_count = done;
+        }
+    }
+
+    return NULL;
+}
+
+static int spsc_get_batch(consumer_producer_t* queue, char** out, int max_items, const struct timespec* deadline,
+                          char* scratch)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    (void)scratch;
+    size_t head = atomic_load_explicit(&spsc->head, memory_order_relaxed);
+
+    long available = spsc_wait_for_items(queue, head, deadline);
+    if (available <= 0) {
+        return (int)available;
+    }
+
+    // Take everything that is readable (up to max_items), then release the slots at once
+    int n = available < (long)max_items ? (int)available : max_items;
+    for (int k = 0; k < n; ++k) {
+        size_t slot = (head + (size_t)k) & spsc->mask;
+        out[k] = spsc->slots[slot];    // Ownership transfers to the caller
+        spsc->slots[slot] = NULL;
+    }
+    spsc_release(queue, head + (size_t)n);
+
+    return n;
+}
+
+
+/* ---------------------------------------------------------------------------
+ * CP_MODE_MPMC helpers
+ *
+ * Bounded ring after Dmitry Vyukov's MPMC queue. A producer claims position
+ * p with a CAS on enqueue_pos once cell[p & mask].seq == p, stores the
+ * item and publishes it with seq = p + 1. A consumer claims p with a CAS on
+ * dequeue_pos once seq == p + 1, takes the item and frees the slot for
+ * the next lap with seq = p + ring size. Producers never touch the consumer
+ * index except to bound the ring to the requested capacity, and no thread
+ * ever waits for another to leave a critical section.
+ *
+ * Parking reuses the queue lock and condition variables, but only when the
+ * ring is truly full/empty. A thread announces itself in the parked counter,
+ * then re-checks the ring under the lock before waiting; the other side
+ * publishes, issues a full fence and only takes the lock to signal when it
+ * sees a parked thread. As with SPSC, the fences guarantee that one of the
+ * two always sees the other. A woken thread passes the wakeup on when it
+ * leaves work for another parked thread of its kind.
+ * ------------------------------------------------------------------------- */
+
+/**
+ * CP_MODE_MPMC ring slot: seq tells producers and consumers whose turn the slot is
+ */
+typedef struct
+{
+    atomic_size_t seq;              /* == position: free for the producer of that position;
+                                       == position + 1: holds the item for its consumer */
+    char* data;                     /* Item stored in the slot */
+} cp_mpmc_cell_t;
+
+/* CP_MODE_MPMC state (queue->impl): producers and consumers claim positions with a CAS on their
+ * own index and hand slots over through each cell's sequence number; the queue's mutex and
+ * condition variables are only used to park when the ring is truly full/empty. */
+typedef struct
+{
+    cp_mpmc_cell_t* cells;          /* Ring slots (queue->items is unused) */
+    size_t mask;                    /* Ring size - 1 */
+    atomic_size_t enqueue_pos;      /* Next position to claim for a put */
+    char pad0[CP_CACHE_LINE];
+    atomic_size_t dequeue_pos;      /* Next position to claim for a get */
+    char pad1[CP_CACHE_LINE];
+    atomic_int producers_parked;    /* Producers asleep on not_full */
+    atomic_int consumers_parked;    /* Consumers asleep on not_empty */
+} cp_mpmc_t;
+
+/* Number of claimed, not yet consumed positions (a snapshot) */
+static size_t mpmc_size(const consumer_producer_t* queue)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    size_t tail = atomic_load(&mpmc->enqueue_pos);
+    size_t head = atomic_load(&mpmc->dequeue_pos);
+    return tail > head ? tail - head : 0;
+}
+
+/* @return 1 if the item was stored, 0 if the ring is full */
+static int mpmc_try_enqueue(consumer_producer_t* queue, char* item)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    size_t pos = atomic_load_explicit(&mpmc->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        cp_mpmc_cell_t* cell = &mpmc->cells[pos & mpmc->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)(seq - pos);
+
+        if (dif == 0) {
+            // Our turn for this slot; also keep the ring within the requested capacity
+            if (pos - atomic_load_explicit(&mpmc->dequeue_pos, memory_order_acquire) >= (size_t)queue->capacity) {
+                return 0;
+            }
+            if (atomic_compare_exchange_weak_explicit(&mpmc->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                cell->data = item;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+            // CAS failed: pos now holds the current index, retry with it
+        } else if (dif < 0) {
+            return 0;   // The slot still holds the previous lap's item: full
+        } else {
+            pos = atomic_load_explicit(&mpmc->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* @return 1 if an item was taken, 0 if the ring is empty */
+static int mpmc_try_dequeue(consumer_producer_t* queue, char** out)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    size_t pos = atomic_load_explicit(&mpmc->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        cp_mpmc_cell_t* cell = &mpmc->cells[pos & mpmc->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)(seq - (pos + 1));
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&mpmc->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *out = cell->data;      // Ownership transfers to the caller
+                cell->data = NULL;
+                atomic_store_explicit(&cell->seq, pos + mpmc->mask + 1, memory_order_release);
+                return 1;
+            }
+        } else if (dif < 0) {
+            return 0;   // Nothing published at this position yet: empty
+        } else {
+            pos = atomic_load_explicit(&mpmc->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/* Spin/park predicate (producer): the next position's slot is free and within capacity */
+static int mpmc_space_ready(consumer_producer_t* queue, const void* arg)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    (void)arg;
+    size_t pos = atomic_load(&mpmc->enqueue_pos);
+    size_t seq = atomic_load(&mpmc->cells[pos & mpmc->mask].seq);
+    return (ptrdiff_t)(seq - pos) >= 0 &&
+           pos - atomic_load(&mpmc->dequeue_pos) < (size_t)queue->capacity;
+}
+
+/* Spin/park predicate (consumer): the next position holds an item, or finished */
+static int mpmc_items_ready(consumer_producer_t* queue, const void* arg)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    (void)arg;
+    size_t pos = atomic_load(&mpmc->dequeue_pos);
+    size_t seq = atomic_load(&mpmc->cells[pos & mpmc->mask].seq);
+    return (ptrdiff_t)(seq - (pos + 1)) >= 0 || atomic_load(&queue->finished_flag) == 1;
+}
+
+/* Finished predicate (consumer): the head item was published, or every claimed position was consumed */
+static int mpmc_tail_settled(consumer_producer_t* queue, const void* arg)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    (void)arg;
+    size_t pos = atomic_load(&mpmc->dequeue_pos);
+    size_t seq = atomic_load(&mpmc->cells[pos & mpmc->mask].seq);
+    return (ptrdiff_t)(seq - (pos + 1)) >= 0 || mpmc_size(queue) == 0;
+}
+
+/* Signal up to 'count' threads parked on cond, if the parked counter says there are any.
+ * One wakeup per item moved: a woken thread takes its own item instead of relaying. */
+static void mpmc_wake(consumer_producer_t* queue, atomic_int* parked, pthread_cond_t* cond, int count)
+{
+    int sleepers = atomic_load_explicit(parked, memory_order_relaxed);
+    if (sleepers <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&queue->lock);
+    if (count >= sleepers) {
+        pthread_cond_broadcast(cond);
+    } else {
+        for (int i = 0; i < count; ++i) {
+            pthread_cond_signal(cond);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* Producer side, after publishing 'count' items */
+static void mpmc_after_put(consumer_producer_t* queue, int count)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    atomic_thread_fence(memory_order_seq_cst);
+    mpmc_wake(queue, &mpmc->consumers_parked, &queue->not_empty, count);
+    cp_event_fire(&queue->items_armed, queue->items_event_fd);
+}
+
+/* Consumer side, after taking 'count' items */
+static void mpmc_after_get(consumer_producer_t* queue, int count)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    atomic_thread_fence(memory_order_seq_cst);
+    mpmc_wake(queue, &mpmc->producers_parked, &queue->not_full, count);
+    cp_event_fire(&queue->space_armed, queue->space_event_fd);
+
+    // Drained after 'finished': release everyone in wait_finished(), and consumers parked
+    // on a put that was still publishing (another consumer took its item)
+    if (atomic_load(&queue->finished_flag) == 1 && queue_is_empty(queue)) {
+        pthread_mutex_lock(&queue->lock);
+        if (queue->finish_waiters > 0) {
+            pthread_cond_broadcast(&queue->drained);
+        }
+        if (atomic_load(&mpmc->consumers_parked) > 0) {
+            pthread_cond_broadcast(&queue->not_empty);
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/* Park on cond until ready() holds or the deadline passes.
+ * @return 0 when ready, -1 on error, CP_TIMEDOUT */
+static int mpmc_park(consumer_producer_t* queue, atomic_int* parked, pthread_cond_t* cond,
+                     cp_ready_fn ready, const struct timespec* deadline)
+{
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return -1;
+    }
+
+    // Announce, then re-check: whoever publishes after this sees us and signals under the lock
+    atomic_fetch_add(parked, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    int rc = 0;
+    while (rc == 0 && !ready(queue, NULL)) {
+        rc = cp_cond_wait(cond, &queue->lock, deadline);
+    }
+    atomic_fetch_sub(parked, 1);
+    pthread_mutex_unlock(&queue->lock);
+
+    if (rc == ETIMEDOUT) {
+        return ready(queue, NULL) ? 0 : CP_TIMEDOUT;
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+static const char* mpmc_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                  const struct timespec* deadline, int copy)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    (void)copy;     // No inline slots: copy puts hand over heap strings only
+    // Do not accept new items after finished was signaled
+    if (atomic_load(&queue->finished_flag) == 1) {
+        return "Cannot add item after finished signal";
+    }
+
+    cp_wait_t wait;
+    int waiting = 0;
+    int done = 0;
+    while (done < count) {
+        // Store as many items as fit, then wake consumers once for the whole run
+        int run = 0;
+        while (done < count && mpmc_try_enqueue(queue, items[done])) {
+            done++;
+            run++;
+        }
+        if (put_count != NULL) {
+            *put_count = done;
+        }
+        if (run > 0) {
+            mpmc_after_put(queue, run);
+        }
+        if (done == count) {
+            break;
+        }
+
+        // Full: a try_put gives up here (arming the space fd, then looking once more)
+        if (deadline == CP_NO_WAIT) {
+            if (queue->space_event_fd < 0) {
+                return CP_ERR_TIMEOUT;
+            }
+            cp_event_arm(&queue->space_armed, queue->space_event_fd);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (!mpmc_space_ready(queue, NULL)) {
+                return CP_ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        // Spin first if the wait strategy asks for it, then park
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        if (cp_wait_should_spin(queue, &queue->producer_spin, &wait) &&
+            cp_wait_spin(queue, &queue->producer_spin, &wait, mpmc_space_ready, NULL)) {
+            continue;
+        }
+        int rc = mpmc_park(queue, &mpmc->producers_parked, &queue->not_full, mpmc_space_ready, deadline);
+        if (rc == CP_TIMEDOUT) {
+            return CP_ERR_TIMEOUT;
+        }
+        if (rc != 0) {
+            return "Failed while waiting for free space";
+        }
+    }
+
+    if (waiting) {
+        cp_wait_end(queue, &queue->producer_spin, &wait);
+    }
+    return NULL;
+}
+
+static int mpmc_get_batch(consumer_producer_t* queue, char** out, int max_items, const struct timespec* deadline,
+                          char* scratch)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    (void)scratch;
+    cp_wait_t wait;
+    int waiting = 0;
+
+    while (!mpmc_try_dequeue(queue, &out[0])) {
+        // Finished: done once every claimed position has been consumed (a put that started
+        // before 'finished' may still be publishing its item)
+        if (atomic_load(&queue->finished_flag) == 1) {
+            if (mpmc_size(queue) == 0) {
+                return 0;
+            }
+            if (deadline == CP_NO_WAIT) {
+                return CP_TIMEDOUT;
+            }
+            // Sleep until that put publishes (its after_put wakes us) or the deadline passes
+            int rc = mpmc_park(queue, &mpmc->consumers_parked, &queue->not_empty, mpmc_tail_settled, deadline);
+            if (rc != 0) {
+                return rc;
+            }
+            continue;
+        }
+
+        // Empty: a try_get gives up here (arming the items fd, then looking once more)
+        if (deadline == CP_NO_WAIT) {
+            if (queue->items_event_fd < 0) {
+                return CP_TIMEDOUT;
+            }
+            cp_event_arm(&queue->items_armed, queue->items_event_fd);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (!mpmc_items_ready(queue, NULL)) {
+                return CP_TIMEDOUT;
+            }
+            continue;
+        }
+
+        // Spin first if the wait strategy asks for it, then park
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        if (cp_wait_should_spin(queue, &queue->consumer_spin, &wait) &&
+            cp_wait_spin(queue, &queue->consumer_spin, &wait, mpmc_items_ready, NULL)) {
+            continue;
+        }
+        int rc = mpmc_park(queue, &mpmc->consumers_parked, &queue->not_empty, mpmc_items_ready, deadline);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    // Got one; take whatever else is ready without waiting
+    int n = 1;
+    while (n < max_items && mpmc_try_dequeue(queue, &out[n])) {
+        n++;
+    }
+    mpmc_after_get(queue, n);
+
+    if (waiting) {
+        cp_wait_end(queue, &queue->consumer_spin, &wait);
+    }
+    return n;
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Byte budgets
+ *
+ * A queue accounts the bytes of the items it holds (strlen + 1, or item_size) and may cap
+ * them. A budget shared between queues is charged on put and credited on get
+ * with plain atomics; only gated producers sleep on it, and creditors take its
+ * lock only when the waiter count says someone sleeps.
+ * ------------------------------------------------------------------------- */
+
+/* Default item size: the string and its NUL */
+static size_t cp_strlen_bytes(const char* item)
+{
+    return item != NULL ? strlen(item) + 1 : 0;
+}
+
+/* Bytes an item accounts for */
+static size_t cp_item_bytes(const consumer_producer_t* queue, const char* item)
+{
+    return item != NULL ? queue->item_size(item) : 0;
+}
+
+/* Raise a peak watermark to value if it is higher */
+static void cp_raise_peak(atomic_size_t* peak, size_t value)
+{
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(peak, &seen, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/* Would bytes fit into the shared budget? An empty budget admits anything, so huge items cannot wedge it. */
+static int cp_budget_fits(cp_byte_budget_t* budget, size_t bytes)
+{
+    size_t used = atomic_load(&budget->used);
+    return used == 0 || used + bytes <= budget->limit;
+}
+
+/* Charge bytes without waiting */
+static void cp_budget_charge(cp_byte_budget_t* budget, size_t bytes)
+{
+    cp_raise_peak(&budget->peak, atomic_fetch_add(&budget->used, bytes) + bytes);
+}
+
+/* Credit bytes back and wake gated producers, if any sleep */
+static void cp_budget_credit(cp_byte_budget_t* budget, size_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+    atomic_fetch_sub(&budget->used, bytes);
+    if (atomic_load(&budget->waiters) > 0) {
+        pthread_mutex_lock(&budget->lock);
+        pthread_cond_broadcast(&budget->released);
+        pthread_mutex_unlock(&budget->lock);
+    }
+}
+
+/* Reserve bytes in the shared budget for a put on queue, waiting until they fit or the deadline passes.
+ * @return 0 when reserved, -1 on error, CP_TIMEDOUT */
+static int cp_budget_reserve(consumer_producer_t* queue, cp_byte_budget_t* budget, size_t bytes,
+                             const struct timespec* deadline)
+{
+    for (;;) {
+        size_t used = atomic_load(&budget->used);
+        while (used == 0 || used + bytes <= budget->limit) {
+            if (atomic_compare_exchange_weak(&budget->used, &used, used + bytes)) {
+                cp_raise_peak(&budget->peak, used + bytes);
+                return 0;
+            }
+        }
+        if (deadline == CP_NO_WAIT) {
+            return CP_TIMEDOUT;
+        }
+
+        // Announce, then re-check under the lock: a credit after this sees us and broadcasts
+        cp_mark_blocked(queue);
+        if (pthread_mutex_lock(&budget->lock) != 0) {
+            return -1;
+        }
+        atomic_fetch_add(&budget->waiters, 1);
+        int rc = 0;
+        while (rc == 0 && !cp_budget_fits(budget, bytes)) {
+            rc = cp_cond_wait(&budget->released, &budget->lock, deadline);
+        }
+        atomic_fetch_sub(&budget->waiters, 1);
+        pthread_mutex_unlock(&budget->lock);
+
+        if (rc == ETIMEDOUT && !cp_budget_fits(budget, bytes)) {
+            return CP_TIMEDOUT;
+        }
+        if (rc != 0 && rc != ETIMEDOUT) {
+            return -1;
+        }
+    }
+}
+
+
+/* ---------------------------------------------------------------------------
+ * CP_MODE_LOCKED helpers
+ *
+ * One mutex (queue->lock) guards all state. Threads that must block wait on a
+ * condition variable and are counted while they wait, so wakeups are only
+ * issued when someone is actually asleep and only on the transitions that can
+ * unblock them: empty -> non-empty for consumers, full -> not-full for
+ * producers, finished-and-drained for wait_finished().
+ *
+ * A woken thread that leaves the queue still usable for another waiter of the
+ * same kind passes the wakeup on, so one signal per transition is enough even
+ * with several producers or consumers.
+ * ------------------------------------------------------------------------- */
+
+/* Does item live in the queue's inline slab? (lock held) */
+static int cp_is_inline(const consumer_producer_t* queue, const char* item)
+{
+    uintptr_t start = (uintptr_t)queue->inline_slab;
+    uintptr_t p = (uintptr_t)item;
+    return queue->inline_slab != NULL && p >= start &&
+           p < start + (uintptr_t)queue->capacity * queue->inline_size;
+}
+
+/* Would one more item of 'bytes' fit right now? (lock held) A queue holding no bytes admits any item. */
+static int locked_fits(const consumer_producer_t* queue, size_t bytes)
+{
+    if (queue->count >= queue->capacity) {
+        return 0;
+    }
+    return queue->byte_budget == 0 || queue->bytes_in_flight == 0 ||
+           queue->bytes_in_flight + bytes <= queue->byte_budget;
+}
+
+/* Spin predicate (producer): peek under the lock whether a slot is free */
+static int locked_space_ready(consumer_producer_t* queue, const void* arg)
+{
+    (void)arg;
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return 1;   // Let the caller re-lock and report the error
+    }
+    int ready = queue->count < queue->capacity;
+    pthread_mutex_unlock(&queue->lock);
+    return ready;
+}
+
+/* Spin predicate (consumer): peek under the lock whether an item or finished arrived */
+static int locked_items_ready(consumer_producer_t* queue, const void* arg)
+{
+    (void)arg;
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return 1;
+    }
+    int ready = !queue_is_empty(queue) || queue->finished_flag == 1;
+    pthread_mutex_unlock(&queue->lock);
+    return ready;
+}
+
+/* Move the items into a fresh array of new_capacity slots (lock held, new_capacity >= count).
+ * @return 0 on success, -1 if the allocation failed (the queue is left unchanged) */
+static int locked_resize(consumer_producer_t* queue, int new_capacity)
+{
+    char** items = (char**)calloc((size_t)new_capacity, sizeof(char*));
+    if (items == NULL) {
+        return -1;
+    }
+    char* slab = NULL;
+    if (queue->inline_size > 0) {
+        slab = (char*)malloc((size_t)new_capacity * queue->inline_size);
+        if (slab == NULL) {
+            free(items);
+            return -1;
+        }
+    }
+    for (int i = 0; i < queue->count; ++i) {
+        items[i] = queue->items[(queue->head + i) % queue->capacity];
+        // Inline payloads move with their slot
+        if (cp_is_inline(queue, items[i])) {
+            char* moved = slab + (size_t)i * queue->inline_size;
+            memcpy(moved, items[i], queue->inline_size);
+            items[i] = moved;
+        }
+    }
+    free(queue->items);
+    queue->items = items;
+    if (slab != NULL) {
+        free(queue->inline_slab);
+        queue->inline_slab = slab;
+    }
+    queue->capacity = new_capacity;
+    queue->head = 0;
+    queue->tail = queue->count % new_capacity;
+    return 0;
+}
+
+/* Elastic growth (lock held): double the capacity while the queue sits at or above the
+ * high watermark. Returns 1 if the queue grew, so a producer about to block can retry. */
+static int locked_elastic_grow(consumer_producer_t* queue)
+{
+    if (!queue->elastic || queue->capacity >= queue->max_capacity ||
+        (long)queue->count * 100 < (long)queue->capacity * queue->high_watermark) {
+        return 0;
+    }
+    int new_capacity = queue->capacity > queue->max_capacity / 2 ? queue->max_capacity : queue->capacity * 2;
+    if (locked_resize(queue, new_capacity) != 0) {
+        return 0;   // Out of memory: keep the current ring and let backpressure do its job
+    }
+    queue->grows++;
+    queue->idle_gets = 0;
+    if (queue->capacity > queue->peak_capacity) {
+        queue->peak_capacity = queue->capacity;
+    }
+
+    // New room: every producer asleep on a full queue can go on
+    if (queue->producers_waiting > 0) {
+        pthread_cond_broadcast(&queue->not_full);
+    }
+    cp_event_fire(&queue->space_armed, queue->space_event_fd);
+    return 1;
+}
+
+/* Elastic shrink (lock held): halve the capacity after a sustained run of gets that left
+ * the queue at or below the low watermark. */
+static void locked_elastic_shrink(consumer_producer_t* queue)
+{
+    if (!queue->elastic || queue->capacity <= queue->min_capacity) {
+        return;
+    }
+    if ((long)queue->count * 100 > (long)queue->capacity * queue->low_watermark) {
+        queue->idle_gets = 0;
+        return;
+    }
+    if (++queue->idle_gets < queue->shrink_after) {
+        return;
+    }
+    queue->idle_gets = 0;
+
+    int new_capacity = queue->capacity / 2 < queue->min_capacity ? queue->min_capacity : queue->capacity / 2;
+    if (new_capacity < queue->count || locked_resize(queue, new_capacity) != 0) {
+        return;
+    }
+    queue->shrinks++;
+}
+
+/* Initial slot count of a control lane (doubles when full) */
+#define CP_CONTROL_LANE_MIN 4
+
+/* Append a control message (lock held). @return 0, or -1 if the lane could not grow */
+static int control_lane_push(cp_control_lane_t* lane, char* item, size_t after)
+{
+    if (lane->count == lane->capacity) {
+        int new_capacity = lane->capacity > 0 ? lane->capacity * 2 : CP_CONTROL_LANE_MIN;
+        cp_control_t* slots = (cp_control_t*)malloc((size_t)new_capacity * sizeof(cp_control_t));
+        if (slots == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < lane->count; ++i) {
+            slots[i] = lane->slots[(lane->head + i) % lane->capacity];
+        }
+        free(lane->slots);
+        lane->slots = slots;
+        lane->capacity = new_capacity;
+        lane->head = 0;
+    }
+    cp_control_t* slot = &lane->slots[(lane->head + lane->count) % lane->capacity];
+    slot->item = item;
+    slot->after = after;
+    lane->count++;
+    return 0;
+}
+
+/* Remove the oldest control message (lock held, lane not empty) */
+static char* control_lane_pop(cp_control_lane_t* lane)
+{
+    char* item = lane->slots[lane->head].item;
+    lane->slots[lane->head].item = NULL;
+    lane->head = (lane->head + 1) % lane->capacity;
+    lane->count--;
+    return item;
+}
+
+/* Free a lane and any message still in it */
+static void control_lane_free(consumer_producer_t* queue, cp_control_lane_t* lane)
+{
+    while (lane->count > 0) {
+        queue->item_free(control_lane_pop(lane));
+    }
+    free(lane->slots);
+    lane->slots = NULL;
+    lane->capacity = 0;
+    lane->head = 0;
+}
+
+/* Take the next item in delivery order (lock held): urgent controls, then ordered controls whose
+ * preceding data is gone, then data. *freed accumulates the bytes of data items taken.
+ * An inline item is copied to copy_to, or to the heap when copy_to is NULL.
+ * @return 1 if an item was taken, 0 if the queue is empty, -1 if an inline item could not be copied */
+static int locked_take(consumer_producer_t* queue, char** out, size_t* freed, char* copy_to)
+{
+    if (queue->urgent_lane.count > 0) {
+        *out = control_lane_pop(&queue->urgent_lane);
+        return 1;
+    }
+    cp_control_lane_t* ordered = &queue->ordered_lane;
+    if (ordered->count > 0 && ordered->slots[ordered->head].after <= queue->data_taken) {
+        *out = control_lane_pop(ordered);
+        return 1;
+    }
+    if (queue->count == 0) {
+        return 0;
+    }
+    char* item = queue->items[queue->head];
+    size_t bytes = cp_item_bytes(queue, item);
+    if (cp_is_inline(queue, item)) {
+        if (copy_to == NULL && (copy_to = (char*)queue->item_alloc(bytes)) == NULL) {
+            return -1;  // Left in place: nothing was taken
+        }
+        memcpy(copy_to, item, bytes);
+        item = copy_to;
+    }
+    *out = item;
+    *freed += bytes;
+    queue->items[queue->head] = NULL;   // Defensive: avoid accidental reuse
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    queue->data_taken++;
+    return 1;
+}
+
+/* CP_OVERFLOW_SAMPLE: per-thread xorshift state (0 = not seeded yet), so sampling needs no shared state */
+static _Thread_local uint32_t cp_sample_state = 0;
+
+/* Decide whether to keep an overflowing item, with probability percent/100 */
+static int cp_sample_keep(int percent)
+{
+    if (cp_sample_state == 0) {
+        cp_sample_state = (uint32_t)cp_now_ns() ^ (uint32_t)(uintptr_t)&cp_sample_state;
+        if (cp_sample_state == 0) {
+            cp_sample_state = 1;
+        }
+    }
+    uint32_t x = cp_sample_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    cp_sample_state = x;
+    return (int)(x % 100) < percent;
+}
+
+/* Drop an item on the overflow path (lock held): count it, report it, free it if the queue owns it */
+static void locked_drop(consumer_producer_t* queue, char* item, int owned, long* counter)
+{
+    (*counter)++;
+    if (queue->on_drop != NULL) {
+        queue->on_drop(item, queue->on_drop_arg);
+    }
+    if (owned) {
+        queue->item_free(item);
+    }
+}
+
+/* CP_OVERFLOW_DROP_OLDEST (lock held): evict the oldest data item to make room */
+static void locked_evict_oldest(consumer_producer_t* queue)
+{
+    char* item = queue->items[queue->head];
+    size_t bytes = cp_item_bytes(queue, item);
+    queue->items[queue->head] = NULL;
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    queue->data_taken++;    // Ordered controls put after it must not wait for it
+    queue->bytes_in_flight -= bytes;
+    if (queue->shared_budget != NULL) {
+        cp_budget_credit(queue->shared_budget, bytes);
+    }
+    locked_drop(queue, item, !cp_is_inline(queue, item), &queue->dropped_oldest);
+}
+
+/* Apply the overflow policy to an item that does not fit (lock held). *sampled carries the
+ * CP_OVERFLOW_SAMPLE decision for this item (0 = not made yet) across retries.
+ * @return 1 if room was made, -1 if the item was dropped, 0 if the put should wait */
+static int locked_shed(consumer_producer_t* queue, char* item, int copy, int* sampled)
+{
+    // Copy puts keep ownership of the strings that would have been inlined
+    int owned = !(copy && cp_item_bytes(queue, item) <= queue->inline_size);
+
+    switch (queue->overflow) {
+    case CP_OVERFLOW_DROP_NEWEST:
+        locked_drop(queue, item, owned, &queue->dropped_newest);
+        return -1;
+    case CP_OVERFLOW_SAMPLE:
+        if (*sampled == 0) {
+            *sampled = cp_sample_keep(queue->sample_percent) ? 1 : -1;
+        }
+        if (*sampled < 0) {
+            locked_drop(queue, item, owned, &queue->dropped_sampled);
+            return -1;
+        }
+        // A kept sample makes room the drop-oldest way rather than waiting for it
+        // fall through
+    case CP_OVERFLOW_DROP_OLDEST:
+        if (queue->count == 0) {
+            return 0;   // Only control messages queued: nothing to evict
+        }
+        locked_evict_oldest(queue);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * CP_OVERFLOW_SPILL: items that do not fit go to a length-prefixed spill file
+ * (see cp_spill_t) and come back in order as the ring drains. Records are
+ * staged in memory under the queue lock; the file is only written and read
+ * with the lock released, by one writer and one reader at a time, so threads
+ * using the ring never wait for the disk. Items on disk normally sit behind a
+ * non-empty ring; the ring can run dry while the next ones are read back, and
+ * they then still count as queued (locked_size).
+ * ------------------------------------------------------------------------- */
+
+/* Header of a spill record: the item's length and its tag (consumer_producer_set_item_tag) */
+typedef struct
+{
+    uint32_t len;                   /* Bytes that follow, terminator excluded */
+    uint32_t flags;
+    uint64_t seq;
+} cp_spill_record_t;
+
+/* Bytes [off, off + len) of the current spill segment, held in memory */
+typedef struct
+{
+    char* data;
+    size_t off;
+    size_t len;
+    size_t cap;                     /* Allocated bytes: CP_SPILL_BUFFER, more for a longer record */
+} cp_spill_buf_t;
+
+/**
+ * Spill file of a CP_OVERFLOW_SPILL queue: an unlinked temp file of records in put order, each a
+ * cp_spill_record_t and then the item's bytes without terminator. Offsets count from the start
+ * of the current segment: [0, file_end) is on disk, then come fbuf (handed to the writer) and
+ * wbuf (filling up); a record never straddles two of them. Once every record was read back and no
+ * write or read is running, the segment starts over and the file is truncated.
+ */
+typedef struct
+{
+    int fd;                         /* Spill file (-1 = not spilling) */
+    cp_spill_buf_t wbuf;            /* Records not written yet */
+    cp_spill_buf_t fbuf;            /* Full write buffer waiting for or under a write (len 0 = none) */
+    cp_spill_buf_t rbuf;            /* File bytes read back last */
+    cp_spill_buf_t rnext;           /* Spare read buffer, filled by the reader */
+    int writing;                    /* A thread writes fbuf out with the lock released */
+    int reading;                    /* A thread reads into rnext with the lock released */
+    int write_failed;               /* A write failed: records from failed_off on are lost */
+    size_t failed_off;
+    size_t file_end;                /* Bytes written to the file */
+    size_t read_off;                /* Next record to read back */
+    int count;                      /* Records not read back yet */
+    size_t bytes;                   /* Their bytes (item size each) */
+    size_t peak_bytes;              /* Largest value of bytes */
+    long total;                     /* Items ever spilled */
+    long lost;                      /* Items lost to write or read errors */
+} cp_spill_t;
+
+/* CP_MODE_LOCKED state (queue->impl) beyond the ring fields of the queue itself */
+typedef struct
+{
+    cp_spill_t spill;               /* CP_OVERFLOW_SPILL only; items on disk always come after the ring's */
+    pthread_cond_t spill_written;   /* Broadcast when a spill write finishes (waited on with the queue lock) */
+} cp_locked_t;
+
+/* Spill state of a queue on the locked hooks */
+static cp_spill_t* cp_spill_of(const consumer_producer_t* queue)
+{
+    return &((cp_locked_t*)queue->impl)->spill;
+}
+
+/* Items wait on disk, or a write or read is running: the spill file must stay (lock held) */
+static int spill_busy(const cp_spill_t* spill)
+{
+    return spill->count > 0 || spill->writing || spill->reading;
+}
+
+/* The ring ran dry while spilled items wait to be read back: nothing can be taken right now (lock held) */
+static int locked_spill_dry(const consumer_producer_t* queue)
+{
+    return queue->count == 0 && queue->urgent_lane.count == 0 && cp_spill_of(queue)->count > 0;
+}
+
+/* Write all of buf at offset off; 0 on success, -1 on error */
+static int spill_pwrite(int fd, const char* buf, size_t len, size_t off)
+{
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += (size_t)n;
+    }
+    return 0;
+}
+
+/* Read exactly len bytes at offset off; 0 on success, -1 on error or end of file */
+static int spill_pread(int fd, char* buf, size_t len, size_t off)
+{
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)off);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += (size_t)n;
+    }
+    return 0;
+}
+
+/* Grow buf to hold at least need bytes; 0 on success, -1 if out of memory */
+static int spill_buf_reserve(cp_spill_buf_t* buf, size_t need)
+{
+    if (need <= buf->cap) {
+        return 0;
+    }
+    char* data = (char*)realloc(buf->data, need);
+    if (data == NULL) {
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = need;
+    return 0;
+}
+
+/* Give a buffer that grew for a long record back its usual size (it stays usable if that fails) */
+static void spill_buf_trim(cp_spill_buf_t* buf)
+{
+    if (buf->cap > CP_SPILL_BUFFER) {
+        char* data = (char*)realloc(buf->data, CP_SPILL_BUFFER);
+        if (data != NULL) {
+            buf->data = data;
+            buf->cap = CP_SPILL_BUFFER;
+        }
+    }
+}
+
+/* Hand the write buffer to the writer (fbuf must be free); the free one takes its place */
+static void spill_swap(cp_spill_t* spill)
+{
+    cp_spill_buf_t free_buf = spill->fbuf;
+    spill->fbuf = spill->wbuf;
+    spill->wbuf = free_buf;
+    spill->wbuf.off = spill->fbuf.off + spill->fbuf.len;
+    spill->wbuf.len = 0;
+}
+
+/* Copy len bytes at offset off out of the buffers in memory.
+ * @return 0 on success, 1 if they must be read from the file first, -1 if they are nowhere */
+static int spill_copy(const cp_spill_t* spill, size_t off, char* out, size_t len)
+{
+    const cp_spill_buf_t* bufs[] = { &spill->rbuf, &spill->fbuf, &spill->wbuf };
+    while (len > 0) {
+        const cp_spill_buf_t* from = NULL;
+        for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); ++i) {
+            if (off >= bufs[i]->off && off < bufs[i]->off + bufs[i]->len) {
+                from = bufs[i];
+                break;
+            }
+        }
+        if (from == NULL) {
+            return off < spill->file_end ? 1 : -1;
+        }
+        size_t n = from->off + from->len - off;
+        n = n < len ? n : len;
+        memcpy(out, from->data + (off - from->off), n);
+        out += n;
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Read the record at off, and as many after it as fit the buffer, out of file bytes [off, end).
+ * @return 0 on success, -1 on error */
+static int spill_load(int fd, cp_spill_buf_t* buf, size_t off, size_t end)
+{
+    cp_spill_record_t record;
+    size_t want = end - off < buf->cap ? end - off : buf->cap;
+    if (want < sizeof(record) || spill_pread(fd, buf->data, want, off) != 0) {
+        return -1;
+    }
+    memcpy(&record, buf->data, sizeof(record));
+    size_t need = sizeof(record) + (size_t)record.len;
+    if (need > end - off) {
+        return -1;
+    }
+    if (need > want) {
+        // A record longer than the buffer: grow it and read the rest
+        if (spill_buf_reserve(buf, need) != 0 ||
+            spill_pread(fd, buf->data + want, need - want, off + want) != 0) {
+            return -1;
+        }
+        want = need;
+    }
+    buf->off = off;
+    buf->len = want;
+    return 0;
+}
+
+/* Everything was read back and no I/O runs: start a new segment and give the disk space back */
+static void spill_reset(cp_spill_t* spill)
+{
+    if (spill->file_end > 0 && ftruncate(spill->fd, 0) != 0) {
+        // Keep going: the next segment simply overwrites the old bytes
+    }
+    cp_spill_buf_t* bufs[] = { &spill->wbuf, &spill->fbuf, &spill->rbuf, &spill->rnext };
+    for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); ++i) {
+        bufs[i]->off = 0;
+        bufs[i]->len = 0;
+    }
+    spill->write_failed = 0;
+    spill->failed_off = 0;
+    spill->file_end = 0;
+    spill->read_off = 0;
+    spill->count = 0;
+    spill->bytes = 0;
+}
+
+/* Allocate the buffers of a spill whose file is open; 0 on success, -1 if out of memory */
+static int spill_alloc(cp_spill_t* spill)
+{
+    cp_spill_buf_t* bufs[] = { &spill->wbuf, &spill->fbuf, &spill->rbuf, &spill->rnext };
+    for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); ++i) {
+        bufs[i]->data = (char*)malloc(CP_SPILL_BUFFER);
+        if (bufs[i]->data == NULL) {
+            return -1;
+        }
+        bufs[i]->cap = CP_SPILL_BUFFER;
+    }
+    return 0;
+}
+
+/* Close the spill file and free its buffers (spilled items are discarded with it) */
+static void spill_close(cp_spill_t* spill)
+{
+    if (spill->fd >= 0) {
+        close(spill->fd);
+    }
+    free(spill->wbuf.data);
+    free(spill->fbuf.data);
+    free(spill->rbuf.data);
+    free(spill->rnext.data);
+    memset(spill, 0, sizeof(*spill));
+    spill->fd = -1;
+}
+
+/* Write fbuf out with the lock released, again while wbuf filled up meanwhile. One writer at a
+ * time; lock held on entry and exit. A failed write loses its records (counted when read back). */
+static void locked_spill_write(consumer_producer_t* queue)
+{
+    cp_locked_t* locked = (cp_locked_t*)queue->impl;
+    cp_spill_t* spill = &locked->spill;
+    while (spill->fbuf.len > 0 && !spill->writing) {
+        // Nothing else touches fbuf until writing drops; past a failed write the file has a hole
+        cp_spill_buf_t buf = spill->fbuf;
+        int fd = spill->fd;
+        int skip = spill->write_failed;
+        spill->writing = 1;
+        pthread_mutex_unlock(&queue->lock);
+        int rc = skip ? -1 : spill_pwrite(fd, buf.data, buf.len, buf.off);
+        pthread_mutex_lock(&queue->lock);
+        spill->writing = 0;
+
+        if (rc != 0 && !spill->write_failed) {
+            spill->write_failed = 1;
+            spill->failed_off = buf.off;
+        }
+        spill->file_end = buf.off + buf.len;
+        spill->fbuf.len = 0;
+        spill_buf_trim(&spill->fbuf);
+        pthread_cond_broadcast(&locked->spill_written);
+        if (spill->count == 0 && !spill->reading) {
+            spill_reset(spill);     // Everything was read back while the write ran
+        } else if (spill->wbuf.len >= CP_SPILL_BUFFER) {
+            spill_swap(spill);
+        }
+    }
+}
+
+/* Spill an item that does not fit (lock held); it counts as put. Frees the item if the queue owns it.
+ * Only copies it into the write buffer, but may release the lock to write out a full one first.
+ * @return 0 on success, -1 if it cannot be spilled (too long, out of memory, or the file failed) */
+static int locked_spill(consumer_producer_t* queue, char* item, int copy)
+{
+    cp_locked_t* locked = (cp_locked_t*)queue->impl;
+    cp_spill_t* spill = &locked->spill;
+    size_t bytes = cp_item_bytes(queue, item);
+    if (bytes - 1 > UINT32_MAX) {
+        return -1;
+    }
+    cp_spill_record_t record = { (uint32_t)(bytes - 1), 0, 0 };
+    if (queue->item_tag_get != NULL) {
+        unsigned int flags;
+        unsigned long seq;
+        queue->item_tag_get(item, &flags, &seq);
+        record.flags = flags;
+        record.seq = seq;
+    }
+    size_t need = sizeof(record) + bytes - 1;
+
+    // A full write buffer goes to the writer; if the last one is still being written, wait for it
+    while (!spill->write_failed && spill->wbuf.len > 0 && spill->wbuf.len + need > CP_SPILL_BUFFER) {
+        if (spill->fbuf.len == 0) {
+            spill_swap(spill);
+        } else if (!spill->writing) {
+            locked_spill_write(queue);
+        } else if (cp_cond_wait(&locked->spill_written, &queue->lock, NULL) != 0) {
+            return -1;
+        }
+    }
+    // A record longer than the buffer gets a buffer of its own size
+    if (spill->write_failed || spill_buf_reserve(&spill->wbuf, need) != 0) {
+        return -1;
+    }
+    memcpy(spill->wbuf.data + spill->wbuf.len, &record, sizeof(record));
+    memcpy(spill->wbuf.data + spill->wbuf.len + sizeof(record), item, bytes - 1);
+    spill->wbuf.len += need;
+    if (spill->wbuf.len >= CP_SPILL_BUFFER && spill->fbuf.len == 0) {
+        spill_swap(spill);      // Written once the put releases the lock
+    }
+
+    spill->count++;
+    spill->total++;
+    spill->bytes += bytes;
+    if (spill->bytes > spill->peak_bytes) {
+        spill->peak_bytes = spill->bytes;
+    }
+    queue->data_put++;      // Ordered controls put after it must wait for it
+    if (!(copy && bytes <= queue->inline_size)) {
+        queue->item_free(item);
+    }
+    // A consumer waiting on a dry ring moves it in
+    if (queue->count == 0 && queue->consumers_waiting > 0) {
+        pthread_cond_signal(&queue->not_empty);
+    }
+    return 0;
+}
+
+/* The spilled items left cannot be read back (or there are none): count them lost and skip them,
+ * then start a new segment if no write or read is running (lock held) */
+static void locked_spill_settle(consumer_producer_t* queue)
+{
+    cp_spill_t* spill = cp_spill_of(queue);
+    if (spill->count > 0) {
+        spill->lost += spill->count;
+        queue->data_taken += (size_t)spill->count;  // Ordered controls must not wait for lost items
+        spill->count = 0;
+        spill->bytes = 0;
+    }
+    spill->read_off = spill->wbuf.off + spill->wbuf.len;
+    if (!spill->writing && !spill->reading) {
+        spill_reset(spill);
+    }
+}
+
+/* Move spilled items back into the ring, in order, while they fit and are in memory (lock held).
+ * @return 1 if the next one must be read from the file first (locked_spill_read), 0 otherwise */
+static int locked_unspill(consumer_producer_t* queue)
+{
+    cp_spill_t* spill = cp_spill_of(queue);
+    while (spill->count > 0) {
+        cp_spill_record_t record;
+        int rc = spill_copy(spill, spill->read_off, (char*)&record, sizeof(record));
+        if (rc > 0) {
+            return 1;
+        }
+        if (rc < 0) {
+            break;
+        }
+        size_t len = record.len;
+        size_t bytes = len + 1;
+        if (!locked_fits(queue, bytes)) {
+            return 0;
+        }
+        char* item = (char*)queue->item_alloc(bytes);
+        if (item == NULL) {
+            if (queue->count > 0) {
+                return 0;   // Try again on the next get
+            }
+            break;
+        }
+        rc = spill_copy(spill, spill->read_off + sizeof(record), item, len);
+        if (rc != 0) {
+            queue->item_free(item);
+            if (rc > 0) {
+                return 1;
+            }
+            break;
+        }
+        item[len] = '\0';
+        if (queue->item_tag_set != NULL) {
+            queue->item_tag_set(item, record.flags, (unsigned long)record.seq);
+        }
+        spill->read_off += sizeof(record) + len;
+        spill->count--;
+        spill->bytes -= bytes;
+
+        queue->items[queue->tail] = item;
+        queue->tail = (queue->tail + 1) % queue->capacity;
+        queue->count++;
+        queue->bytes_in_flight += bytes;
+        if (queue->shared_budget != NULL) {
+            cp_budget_charge(queue->shared_budget, bytes);
+        }
+    }
+
+    // Drained, or the rest cannot be read back: either way the segment starts over
+    locked_spill_settle(queue);
+    return 0;
+}
+
+/* Move spilled items back into the ring; when the next ones are only on disk, read them first with
+ * the lock released. One reader at a time; lock held on entry and exit. */
+static void locked_spill_read(consumer_producer_t* queue)
+{
+    cp_spill_t* spill = cp_spill_of(queue);
+    if (spill->reading || locked_unspill(queue) == 0) {
+        return;
+    }
+
+    // Nothing else touches rnext until reading drops; bytes past a failed write are not there
+    cp_spill_buf_t buf = spill->rnext;
+    size_t off = spill->read_off;
+    size_t end = spill->write_failed && spill->failed_off < spill->file_end ? spill->failed_off : spill->file_end;
+    int fd = spill->fd;
+    spill->reading = 1;
+    pthread_mutex_unlock(&queue->lock);
+    int rc = off < end ? spill_load(fd, &buf, off, end) : -1;
+    pthread_mutex_lock(&queue->lock);
+    spill->reading = 0;
+
+    if (rc == 0) {
+        spill->rnext = spill->rbuf;
+        spill->rbuf = buf;
+        spill_buf_trim(&spill->rnext);
+        locked_unspill(queue);
+    } else {
+        spill->rnext = buf;
+        locked_spill_settle(queue);
+    }
+
+    // Consumers that found the ring dry meanwhile wait for this read, as may wait_finished()
+    if (queue->consumers_waiting > 0) {
+        pthread_cond_broadcast(&queue->not_empty);
+    }
+    cp_event_fire(&queue->items_armed, queue->items_event_fd);
+    if (queue_is_empty(queue) && queue->finished_flag == 1 && queue->finish_waiters > 0) {
+        pthread_cond_broadcast(&queue->drained);
+    }
+}
+
+/* Insert items under the lock; *charged receives the bytes of the items accepted */
+static const char* locked_put_items(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                    const struct timespec* deadline, size_t* charged, int copy)
+{
+    // Lock the queue state before checking/modifying the queue
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+
+    // Check finished under the lock to avoid races with signal_finished()
+    if (queue->finished_flag == 1) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Cannot add item after finished signal";
+    }
+
+    int done = 0;
+    while (done < count) {
+        // Wait while the queue is full or the next item would exceed the byte budget.
+        // A put that started before 'finished' is allowed to complete.
+        cp_wait_t wait;
+        int waiting = 0;
+        int sampled = 0;
+        int dropped = 0;
+        int spilled = 0;
+        size_t next_bytes = cp_item_bytes(queue, items[done]);
+        while (cp_spill_of(queue)->count > 0 || !locked_fits(queue, next_bytes)) {
+            // An elastic queue below its maximum grows instead of blocking (unless items wait on disk)
+            if (cp_spill_of(queue)->count == 0 && locked_elastic_grow(queue)) {
+                continue;
+            }
+            // A spilling queue appends the item to its spill file; later items follow it there (FIFO)
+            if (queue->overflow == CP_OVERFLOW_SPILL) {
+                if (locked_spill(queue, items[done], copy) != 0) {
+                    pthread_mutex_unlock(&queue->lock);
+                    return "Failed to spill item to disk";
+                }
+                spilled = 1;
+                break;
+            }
+            // A shedding policy makes room or drops the item instead of blocking
+            if (queue->overflow != CP_OVERFLOW_BLOCK) {
+                int shed = locked_shed(queue, items[done], copy, &sampled);
+                if (shed > 0) {
+                    continue;
+                }
+                if (shed < 0) {
+                    dropped = 1;
+                    break;
+                }
+            }
+            if (deadline == CP_NO_WAIT) {
+                if (queue->space_event_fd >= 0) {
+                    cp_event_arm(&queue->space_armed, queue->space_event_fd);
+                }
+                pthread_mutex_unlock(&queue->lock);
+                return CP_ERR_TIMEOUT;
+            }
+            if (!waiting) {
+                cp_wait_begin(queue, &wait);
+                waiting = 1;
+            }
+            // Spin with the lock released before sleeping, if the wait strategy asks for it
+            if (cp_wait_should_spin(queue, &queue->producer_spin, &wait)) {
+                pthread_mutex_unlock(&queue->lock);
+                cp_wait_spin(queue, &queue->producer_spin, &wait, locked_space_ready, NULL);
+                if (pthread_mutex_lock(&queue->lock) != 0) {
+                    return "Failed to lock queue";
+                }
+                continue;
+            }
+
+            queue->producers_waiting++;
+            int rc = cp_cond_wait(&queue->not_full, &queue->lock, deadline);
+            queue->producers_waiting--;
+            if (rc == ETIMEDOUT && !locked_fits(queue, next_bytes)) {
+                pthread_mutex_unlock(&queue->lock);
+                return CP_ERR_TIMEOUT;
+            }
+            if (rc != 0 && rc != ETIMEDOUT) {
+                pthread_mutex_unlock(&queue->lock);
+                return "Failed while waiting for free space";
+            }
+        }
+        if (waiting) {
+            cp_wait_end(queue, &queue->producer_spin, &wait);
+        }
+        if (dropped || spilled) {
+            done++;
+            if (put_count != NULL) {
+                *put_count = done;
+            }
+            continue;
+        }
+
+        // Insert as many items as fit (queue takes ownership)
+        int was_empty = queue_is_empty(queue);
+        size_t run_bytes = 0;
+        while (done < count && locked_fits(queue, next_bytes)) {
+            char* item = items[done++];
+            // Copy puts store short strings in the slot itself; the caller keeps its string
+            if (copy && next_bytes <= queue->inline_size) {
+                char* payload = queue->inline_slab + (size_t)queue->tail * queue->inline_size;
+                memcpy(payload, item, next_bytes);
+                item = payload;
+                queue->inlined++;
+            }
+            queue->items[queue->tail] = item;
+            queue->tail = (queue->tail + 1) % queue->capacity;
+            queue->count++;
+            queue->data_put++;
+            queue->bytes_in_flight += next_bytes;
+            run_bytes += next_bytes;
+            next_bytes = done < count ? cp_item_bytes(queue, items[done]) : 0;
+        }
+        if (queue->bytes_in_flight > queue->peak_bytes) {
+            queue->peak_bytes = queue->bytes_in_flight;
+        }
+        if (queue->instrumented && queue->count > atomic_load_explicit(&queue->peak_count, memory_order_relaxed)) {
+            atomic_store_explicit(&queue->peak_count, queue->count, memory_order_relaxed);
+        }
+        *charged += run_bytes;
+        // A shared budget this queue does not gate on is charged before consumers can credit it
+        if (queue->shared_budget != NULL && !queue->shared_gate) {
+            cp_budget_charge(queue->shared_budget, run_bytes);
+        }
+        if (put_count != NULL) {
+            *put_count = done;
+        }
+        locked_elastic_grow(queue);
+
+        // Wake one sleeping consumer on empty -> non-empty; pass our own wakeup on if space remains
+        int wake_consumer = was_empty && queue->consumers_waiting > 0;
+        int wake_producer = locked_fits(queue, 0) && queue->producers_waiting > 0;
+        if (wake_consumer) {
+            pthread_cond_signal(&queue->not_empty);
+        }
+        if (wake_producer) {
+            pthread_cond_signal(&queue->not_full);
+        }
+        cp_event_fire(&queue->items_armed, queue->items_event_fd);
+    }
+
+    // A write buffer the spills filled up goes to disk now, with the lock released
+    if (queue->overflow == CP_OVERFLOW_SPILL) {
+        locked_spill_write(queue);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/* Drop a whole batch as CP_OVERFLOW_DROP_NEWEST would (a shedding gate queue found the shared budget spent) */
+static const char* locked_drop_batch(consumer_producer_t* queue, char** items, int count, int* put_count, int copy)
+{
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    if (queue->finished_flag == 1) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Cannot add item after finished signal";
+    }
+    for (int i = 0; i < count; ++i) {
+        int owned = !(copy && cp_item_bytes(queue, items[i]) <= queue->inline_size);
+        locked_drop(queue, items[i], owned, &queue->dropped_newest);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (put_count != NULL) {
+        *put_count = count;
+    }
+    return NULL;
+}
+
+static const char* locked_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                    const struct timespec* deadline, int copy)
+{
+    // Gate queue: reserve the whole batch in the shared budget first, without holding the queue lock
+    // (consumers of this queue must stay free to credit it)
+    size_t reserved = 0;
+    cp_byte_budget_t* gate = queue->shared_gate ? queue->shared_budget : NULL;
+    if (gate != NULL) {
+        for (int i = 0; i < count; ++i) {
+            reserved += cp_item_bytes(queue, items[i]);
+        }
+        // A shedding queue never waits on the shared budget: with no room, the batch is dropped
+        int shedding = queue->overflow != CP_OVERFLOW_BLOCK && queue->overflow != CP_OVERFLOW_SPILL;
+        int rc = cp_budget_reserve(queue, gate, reserved, shedding ? CP_NO_WAIT : deadline);
+        if (rc == CP_TIMEDOUT && shedding) {
+            return locked_drop_batch(queue, items, count, put_count, copy);
+        }
+        if (rc == CP_TIMEDOUT) {
+            return CP_ERR_TIMEOUT;
+        }
+        if (rc != 0) {
+            return "Failed while waiting for the byte budget";
+        }
+    }
+
+    size_t charged = 0;
+    const char* err = locked_put_items(queue, items, count, put_count, deadline, &charged, copy);
+
+    // Give back what was reserved for items the queue did not accept
+    if (gate != NULL && reserved > charged) {
+        cp_budget_credit(gate, reserved - charged);
+    }
+    return err;
+}
+
+static int locked_get_batch(consumer_producer_t* queue, char** out, int max_items, const struct timespec* deadline,
+                            char* scratch)
+{
+    // Lock the queue state before checking/modifying it
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return -1;
+    }
+
+    // Block while the queue is empty and we are not finished yet, or while spilled items are read back
+    cp_wait_t wait;
+    int waiting = 0;
+    while ((queue_is_empty(queue) && queue->finished_flag == 0) || locked_spill_dry(queue)) {
+        // The ring ran dry: read the next spilled items back, unless another consumer already does
+        if (locked_spill_dry(queue) && !cp_spill_of(queue)->reading) {
+            locked_spill_read(queue);
+            continue;
+        }
+        if (deadline == CP_NO_WAIT) {
+            if (queue->items_event_fd >= 0) {
+                cp_event_arm(&queue->items_armed, queue->items_event_fd);
+            }
+            pthread_mutex_unlock(&queue->lock);
+            return CP_TIMEDOUT;
+        }
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        // Spin with the lock released before sleeping, if the wait strategy asks for it
+        if (cp_wait_should_spin(queue, &queue->consumer_spin, &wait)) {
+            pthread_mutex_unlock(&queue->lock);
+            cp_wait_spin(queue, &queue->consumer_spin, &wait, locked_items_ready, NULL);
+            if (pthread_mutex_lock(&queue->lock) != 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        queue->consumers_waiting++;
+        int rc = cp_cond_wait(&queue->not_empty, &queue->lock, deadline);
+        queue->consumers_waiting--;
+        if (rc == ETIMEDOUT && ((queue_is_empty(queue) && queue->finished_flag == 0) || locked_spill_dry(queue))) {
+            pthread_mutex_unlock(&queue->lock);
+            return CP_TIMEDOUT;
+        }
+        if (rc != 0 && rc != ETIMEDOUT) {
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+    }
+
+    // Finished and drained: nothing more to consume
+    if (queue_is_empty(queue)) {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+
+    // Dequeue everything available (up to max_items) in delivery order; ownership transfers to the caller
+    int was_full = queue->count >= queue->capacity;
+    int n = 0;
+    int rc = 0;
+    size_t freed = 0;
+    while (n < max_items) {
+        char* copy_to = scratch != NULL ? scratch + (size_t)n * queue->inline_size : NULL;
+        if ((rc = locked_take(queue, &out[n], &freed, copy_to)) <= 0) {
+            break;
+        }
+        n++;
+    }
+    if (n == 0 && rc < 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+    queue->bytes_in_flight -= freed;
+    locked_elastic_shrink(queue);
+    // Refill from the spill file (this may release the lock to read ahead)
+    if (cp_spill_of(queue)->count > 0) {
+        locked_spill_read(queue);
+    }
+
+    // Wake one sleeping producer on full -> not-full (or whenever bytes were freed under a byte
+    // budget, since a producer may be waiting for room for a large item); pass our own wakeup on
+    // if items remain
+    if ((was_full || queue->byte_budget > 0) && queue->producers_waiting > 0) {
+        pthread_cond_signal(&queue->not_full);
+    }
+    if (!queue_is_empty(queue) && queue->consumers_waiting > 0) {
+        pthread_cond_signal(&queue->not_empty);
+    }
+    cp_event_fire(&queue->space_armed, queue->space_event_fd);
+
+    // Drained after 'finished': release everyone in wait_finished()
+    if (queue_is_empty(queue) && queue->finished_flag == 1 && queue->finish_waiters > 0) {
+        pthread_cond_broadcast(&queue->drained);
+    }
+
+    cp_byte_budget_t* shared = queue->shared_budget;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (shared != NULL) {
+        cp_budget_credit(shared, freed);
+    }
+    if (waiting) {
+        cp_wait_end(queue, &queue->consumer_spin, &wait);
+    }
+    return n;
+}
+
+/* Count one finished call of one side; a call that blocked also adds its waiting time */
+static void cp_count_call(cp_side_counters_t* side, int items)
+{
+    if (items > 0) {
+        atomic_fetch_add_explicit(&side->ops, items, memory_order_relaxed);
+    }
+    if (cp_blocked_since_ns != 0) {
+        atomic_fetch_add_explicit(&side->blocked, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&side->blocked_ns, cp_now_ns() - cp_blocked_since_ns, memory_order_relaxed);
+        cp_blocked_since_ns = 0;
+    }
+}
+
+/* Put/get with instrumentation around the backend's implementation (a single branch while it is off) */
+static const char* cp_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                const struct timespec* deadline, int copy)
+{
+    if (!queue->instrumented) {
+        return queue->backend->put_batch(queue, items, count, put_count, deadline, copy);
+    }
+
+    int accepted = 0;
+    cp_blocked_since_ns = 0;
+    const char* err = queue->backend->put_batch(queue, items, count, &accepted, deadline, copy);
+    if (put_count != NULL) {
+        *put_count = accepted;
+    }
+    cp_count_call(&queue->producer_counters, accepted);
+
+    // The locked mode tracks its peak under the lock; the lock-free rings sample it here
+    if (accepted > 0 && queue->mode != CP_MODE_LOCKED) {
+        size_t size = queue->backend->size(queue);
+        int occupancy = size > (size_t)queue->capacity ? queue->capacity : (int)size;
+        int peak = atomic_load_explicit(&queue->peak_count, memory_order_relaxed);
+        while (occupancy > peak &&
+               !atomic_compare_exchange_weak_explicit(&queue->peak_count, &peak, occupancy,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+        }
+    }
+    return err;
+}
+
+static int cp_get_batch(consumer_producer_t* queue, char** out, int max_items, const struct timespec* deadline,
+                        char* scratch)
+{
+    if (!queue->instrumented) {
+        return queue->backend->get_batch(queue, out, max_items, deadline, scratch);
+    }
+
+    cp_blocked_since_ns = 0;
+    int n = queue->backend->get_batch(queue, out, max_items, deadline, scratch);
+    cp_count_call(&queue->consumer_counters, n);
+    return n;
+}
+
+/* Free the locked ring's slots and inline slab */
+static void cp_free_slots(consumer_producer_t* queue)
+{
+    free(queue->items);
+    queue->items = NULL;
+    free(queue->inline_slab);
+    queue->inline_slab = NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * Backends
+ *
+ * Each mode's implementation above is packaged as a cp_backend_t; the public
+ * calls only reach it through queue->backend. The hooks below are the parts
+ * that used to be picked by switching on the mode: slot allocation, occupancy,
+ * waking and waiting for finished, the stats snapshot and teardown.
+ * ------------------------------------------------------------------------- */
+
+static const char* locked_init(consumer_producer_t* queue)
+{
+    cp_locked_t* locked = (cp_locked_t*)calloc(1, sizeof(cp_locked_t));
+    if (locked == NULL) {
+        return "Failed to allocate queue state";
+    }
+    locked->spill.fd = -1;
+    if (cp_cond_init(&locked->spill_written) != 0) {
+        free(locked);
+        return "Failed to initialize spill condition variable";
+    }
+    queue->items = (char**)calloc((size_t)queue->capacity, sizeof(char*));
+    if (queue->items == NULL) {
+        pthread_cond_destroy(&locked->spill_written);
+        free(locked);
+        return "Failed to allocate memory for queue items";
+    }
+    queue->impl = locked;
+    return NULL;
+}
+
+/* Locked ring whose slots come with CP_INLINE_DEFAULT bytes of inline payload */
+static const char* inline_init(consumer_producer_t* queue)
+{
+    if ((size_t)queue->capacity > SIZE_MAX / CP_INLINE_DEFAULT) {
+        return "Queue capacity too large";
+    }
+    const char* err = locked_init(queue);
+    if (err != NULL) {
+        return err;
+    }
+    queue->inline_slab = (char*)malloc((size_t)queue->capacity * CP_INLINE_DEFAULT);
+    if (queue->inline_slab == NULL) {
+        cp_free_slots(queue);
+        free(queue->impl);
+        queue->impl = NULL;
+        return "Failed to allocate inline slots";
+    }
+    queue->inline_size = CP_INLINE_DEFAULT;
+    return NULL;
+}
+
+/* Slot count of the lock-free rings: the next power of two, for masking (0 if too large) */
+static size_t ring_slots(int capacity)
+{
+    size_t slots = spsc_ring_size(capacity);
+    if (slots > (size_t)(INT_MAX / (int)sizeof(cp_mpmc_cell_t))) {
+        return 0;
+    }
+    return slots;
+}
+
+static const char* spsc_init(consumer_producer_t* queue)
+{
+    size_t slots = ring_slots(queue->capacity);
+    if (slots == 0) {
+        return "Queue capacity too large";
+    }
+    // calloc zeroes the indices and parked flags (all-zero is a valid initial value for them)
+    cp_spsc_t* spsc = (cp_spsc_t*)calloc(1, sizeof(cp_spsc_t));
+    if (spsc == NULL) {
+        return "Failed to allocate queue state";
+    }
+    spsc->slots = (char**)calloc(slots, sizeof(char*));
+    if (spsc->slots == NULL) {
+        free(spsc);
+        return "Failed to allocate memory for queue items";
+    }
+    spsc->mask = slots - 1;
+
+    // SPSC threads park on monitors (only when the ring is truly full/empty); wait_finished()
+    // sleeps on the drained condition like every other backend
+    if (monitor_init(&queue->not_full_monitor) != 0 ||
+        monitor_init(&queue->not_empty_monitor) != 0) {
+        // monitor_destroy ignores monitors that were never initialized
+        monitor_destroy(&queue->not_full_monitor);
+        monitor_destroy(&queue->not_empty_monitor);
+        free(spsc->slots);
+        free(spsc);
+        return "Failed to initialize monitors";
+    }
+    queue->impl = spsc;
+    return NULL;
+}
+
+static const char* mpmc_init(consumer_producer_t* queue)
+{
+    // At least two slots, so "full" and "free next lap" differ
+    size_t slots = ring_slots(queue->capacity < 2 ? 2 : queue->capacity);
+    if (slots == 0) {
+        return "Queue capacity too large";
+    }
+    // calloc zeroes the positions and parked counters
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)calloc(1, sizeof(cp_mpmc_t));
+    if (mpmc == NULL) {
+        return "Failed to allocate queue state";
+    }
+    mpmc->cells = (cp_mpmc_cell_t*)calloc(slots, sizeof(cp_mpmc_cell_t));
+    if (mpmc->cells == NULL) {
+        free(mpmc);
+        return "Failed to allocate memory for queue items";
+    }
+    for (size_t i = 0; i < slots; ++i) {
+        atomic_init(&mpmc->cells[i].seq, i);     // Slot i is free for position i
+    }
+    mpmc->mask = slots - 1;
+    queue->impl = mpmc;
+    return NULL;
+}
+
+/* Spilled items count as queued: the queue is not drained while any wait on disk */
+static size_t locked_size(const consumer_producer_t* queue)
+{
+    return (size_t)queue->count + (size_t)cp_spill_of(queue)->count;
+}
+
+/* Slots a put could fill right now without waiting (lock held) */
+static int locked_free_credits(const consumer_producer_t* queue)
+{
+    // Dropping, sampling and spilling policies never make a put wait
+    if (queue->overflow == CP_OVERFLOW_DROP_NEWEST || queue->overflow == CP_OVERFLOW_DROP_OLDEST ||
+        queue->overflow == CP_OVERFLOW_SAMPLE || queue->overflow == CP_OVERFLOW_SPILL) {
+        return queue->max_capacity;
+    }
+    // A spent byte budget holds the next put back whatever its size
+    if (queue->byte_budget > 0 && queue->bytes_in_flight > 0 && queue->bytes_in_flight >= queue->byte_budget) {
+        return 0;
+    }
+    // Elastic queues grow up to max_capacity instead of waiting
+    int slots = queue->max_capacity - queue->count;
+    // Under a byte budget the room depends on sizes not known yet: one item at a time, so a
+    // holder never takes several lines and then blocks half-way through forwarding them
+    if ((queue->byte_budget > 0 || (queue->shared_budget != NULL && queue->shared_gate)) && slots > 1) {
+        return 1;
+    }
+    return slots;
+}
+
+static int locked_credits(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return -1;
+    }
+
+    // Wait the way a put would, on not_full (consumers signal it whenever a put could proceed)
+    cp_wait_t wait;
+    int waiting = 0;
+    int credits;
+    while ((credits = locked_free_credits(queue)) == 0 && queue->finished_flag == 0) {
+        if (deadline == CP_NO_WAIT) {
+            pthread_mutex_unlock(&queue->lock);
+            return CP_TIMEDOUT;
+        }
+        if (!waiting) {
+            cp_wait_begin(queue, &wait);
+            waiting = 1;
+        }
+        if (cp_wait_should_spin(queue, &queue->producer_spin, &wait)) {
+            pthread_mutex_unlock(&queue->lock);
+            cp_wait_spin(queue, &queue->producer_spin, &wait, locked_space_ready, NULL);
+            if (pthread_mutex_lock(&queue->lock) != 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        queue->producers_waiting++;
+        int rc = cp_cond_wait(&queue->not_full, &queue->lock, deadline);
+        queue->producers_waiting--;
+        if (rc == ETIMEDOUT && locked_free_credits(queue) == 0 && queue->finished_flag == 0) {
+            pthread_mutex_unlock(&queue->lock);
+            return CP_TIMEDOUT;
+        }
+        if (rc != 0 && rc != ETIMEDOUT) {
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+    }
+    if (queue->finished_flag == 1) {
+        credits = 0;
+    } else if (waiting && queue->producers_waiting > 0) {
+        // Pass our wakeup on: a grant reserves nothing, and the put we took it from may be one our
+        // own caller waits for (a pool's head batch), so it must not sleep on a queue with room
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    if (waiting) {
+        cp_wait_end(queue, &queue->producer_spin, &wait);
+    }
+    return credits;
+}
+
+/* SPSC: only the producer may ask (the cached head and the tail are its own) */
+static int spsc_credits(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    if (atomic_load(&queue->finished_flag) == 1) {
+        return 0;
+    }
+    size_t tail = atomic_load_explicit(&spsc->tail, memory_order_relaxed);
+    return (int)spsc_wait_for_space(queue, tail, deadline);
+}
+
+/* MPMC: free slots in a row from the next put position. A consumer hands its slot back only after
+ * claiming its position, so the index distance alone could promise a slot that is still taken. */
+static int mpmc_free_credits(consumer_producer_t* queue)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    size_t pos = atomic_load(&mpmc->enqueue_pos);
+    size_t head = atomic_load(&mpmc->dequeue_pos);
+    size_t size = pos > head ? pos - head : 0;
+    int credits = 0;
+    while (size + (size_t)credits < (size_t)queue->capacity &&
+           atomic_load_explicit(&mpmc->cells[(pos + credits) & mpmc->mask].seq, memory_order_acquire) ==
+               pos + credits) {
+        credits++;
+    }
+    return credits;
+}
+
+static int mpmc_credits(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    int parked = 0;
+    while (atomic_load(&queue->finished_flag) == 0) {
+        int credits = mpmc_free_credits(queue);
+        if (credits > 0) {
+            if (parked) {
+                // Pass our wakeup on, as locked_credits does
+                mpmc_wake(queue, &mpmc->producers_parked, &queue->not_full, 1);
+            }
+            return credits;
+        }
+        if (deadline == CP_NO_WAIT) {
+            return CP_TIMEDOUT;
+        }
+        int rc = mpmc_park(queue, &mpmc->producers_parked, &queue->not_full, mpmc_space_ready, deadline);
+        if (rc != 0) {
+            return rc;
+        }
+        parked = 1;
+    }
+    return 0;
+}
+
+/* Consumers sleeping on "empty" must wake up and return NULL, and wait_finished() callers are
+ * released right away if the queue is already drained */
+static void locked_signal_finished(consumer_producer_t* queue)
+{
+    if (queue->consumers_waiting > 0) {
+        pthread_cond_broadcast(&queue->not_empty);
+    }
+    if (queue_is_empty(queue) && queue->finish_waiters > 0) {
+        pthread_cond_broadcast(&queue->drained);
+    }
+}
+
+/* MPMC: the same, for consumers parked on "empty" (they count themselves in the ring state) */
+static void mpmc_signal_finished(consumer_producer_t* queue)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    if (atomic_load(&mpmc->consumers_parked) > 0) {
+        pthread_cond_broadcast(&queue->not_empty);
+    }
+    if (queue_is_empty(queue) && queue->finish_waiters > 0) {
+        pthread_cond_broadcast(&queue->drained);
+    }
+}
+
+/* SPSC: wake a consumer sleeping on "empty" (monitors never take the queue lock) and release
+ * wait_finished() callers if the ring is already drained */
+static void spsc_signal_finished(consumer_producer_t* queue)
+{
+    monitor_signal(&queue->not_empty_monitor);
+    if (queue_is_empty(queue) && queue->finish_waiters > 0) {
+        pthread_cond_broadcast(&queue->drained);
+    }
+}
+
+static int locked_wait_finished(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    // Take the queue lock to safely read the queue state
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return -1; // Failed to lock (rare)
+    }
+
+    // Block until 'finished' is signaled and the queue is fully drained
+    while (!(queue->finished_flag == 1 && queue_is_empty(queue))) {
+        queue->finish_waiters++;
+        int rc = cp_cond_wait(&queue->drained, &queue->lock, deadline);
+        queue->finish_waiters--;
+        if (rc == ETIMEDOUT && !(queue->finished_flag == 1 && queue_is_empty(queue))) {
+            pthread_mutex_unlock(&queue->lock);
+            return CP_TIMEDOUT;
+        }
+        if (rc != 0 && rc != ETIMEDOUT) {
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+    }
+
+    // Done: finished was signaled and the queue is empty
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+static int locked_stats(consumer_producer_t* queue, cp_stats_t* out)
+{
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return -1;
+    }
+    out->capacity = queue->capacity;
+    out->count = queue->count;
+    out->min_capacity = queue->min_capacity;
+    out->max_capacity = queue->max_capacity;
+    out->peak_capacity = queue->peak_capacity;
+    out->grows = queue->grows;
+    out->shrinks = queue->shrinks;
+    out->bytes = queue->bytes_in_flight;
+    out->peak_bytes = queue->peak_bytes;
+    out->byte_budget = queue->byte_budget;
+    out->controls = queue->urgent_lane.count + queue->ordered_lane.count;
+    out->inline_size = queue->inline_size;
+    out->inlined = queue->inlined;
+    out->overflow = queue->overflow;
+    out->dropped_newest = queue->dropped_newest;
+    out->dropped_oldest = queue->dropped_oldest;
+    out->dropped_sampled = queue->dropped_sampled;
+    const cp_spill_t* spill = cp_spill_of(queue);
+    out->spilled = spill->total;
+    out->spill_count = spill->count;
+    out->spill_bytes = spill->bytes;
+    out->spill_peak_bytes = spill->peak_bytes;
+    out->spill_lost = spill->lost;
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+/* Lock-free rings never resize; their occupancy is read from the ring indices */
+static int ring_stats(consumer_producer_t* queue, cp_stats_t* out)
+{
+    size_t size = queue->backend->size(queue);
+    out->capacity = queue->capacity;
+    out->count = size > (size_t)queue->capacity ? queue->capacity : (int)size;
+    out->min_capacity = queue->capacity;
+    out->max_capacity = queue->capacity;
+    out->peak_capacity = queue->capacity;
+    out->grows = 0;
+    out->shrinks = 0;
+    out->bytes = 0;
+    out->peak_bytes = 0;
+    out->byte_budget = 0;
+    out->controls = 0;
+    out->inline_size = 0;
+    out->inlined = 0;
+    out->overflow = CP_OVERFLOW_BLOCK;
+    out->dropped_newest = 0;
+    out->dropped_oldest = 0;
+    out->dropped_sampled = 0;
+    out->spilled = 0;
+    out->spill_count = 0;
+    out->spill_bytes = 0;
+    out->spill_peak_bytes = 0;
+    out->spill_lost = 0;
+    return 0;
+}
+
+static void locked_destroy(consumer_producer_t* queue)
+{
+    // Free any leftover item (inline ones go with the slab); free(NULL) is safe
+    if (queue->items != NULL && queue->count > 0 && queue->capacity > 0) {
+        int remaining = queue->count;
+        for (int i = 0; i < remaining; ++i) {
+            int idx = (queue->head + i) % queue->capacity;
+            if (!cp_is_inline(queue, queue->items[idx])) {
+                queue->item_free(queue->items[idx]);
+            }
+            queue->items[idx] = NULL; // Defensive: avoid accidental reuse
+        }
+    }
+    cp_free_slots(queue);
+    spill_close(cp_spill_of(queue));     // Items still on disk go with the file
+    pthread_cond_destroy(&((cp_locked_t*)queue->impl)->spill_written);
+    free(queue->impl);
+    queue->impl = NULL;
+}
+
+static void spsc_destroy(consumer_producer_t* queue)
+{
+    cp_spsc_t* spsc = (cp_spsc_t*)queue->impl;
+    size_t tail = atomic_load(&spsc->tail);
+    for (size_t i = atomic_load(&spsc->head); i != tail; ++i) {
+        queue->item_free(spsc->slots[i & spsc->mask]);
+    }
+    free(spsc->slots);
+    free(spsc);
+    queue->impl = NULL;
+    monitor_destroy(&queue->not_full_monitor);
+    monitor_destroy(&queue->not_empty_monitor);
+}
+
+static void mpmc_destroy(consumer_producer_t* queue)
+{
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue->impl;
+    size_t tail = atomic_load(&mpmc->enqueue_pos);
+    for (size_t i = atomic_load(&mpmc->dequeue_pos); i != tail; ++i) {
+        queue->item_free(mpmc->cells[i & mpmc->mask].data);
+    }
+    free(mpmc->cells);
+    free(mpmc);
+    queue->impl = NULL;
+}
+
+#define CP_LOCKED_FEATURES (CP_FEATURE_ELASTIC | CP_FEATURE_BYTE_BUDGET | CP_FEATURE_CONTROL | \
+                            CP_FEATURE_INLINE | CP_FEATURE_OVERFLOW)
+
+const cp_backend_t cp_backend_locked = {
+    "locked", CP_MODE_LOCKED, CP_LOCKED_FEATURES,
+    locked_init, locked_put_batch, locked_get_batch, locked_size, locked_credits,
+    locked_signal_finished, locked_wait_finished, locked_stats, locked_destroy
+};
+
+const cp_backend_t cp_backend_spsc = {
+    "spsc", CP_MODE_SPSC, 0,
+    spsc_init, spsc_put_batch, spsc_get_batch, spsc_size, spsc_credits,
+    spsc_signal_finished, locked_wait_finished, ring_stats, spsc_destroy
+};
+
+// MPMC parks on the queue lock and condition variables, so it shares the locked wait for finished
+const cp_backend_t cp_backend_mpmc = {
+    "mpmc", CP_MODE_MPMC, 0,
+    mpmc_init, mpmc_put_batch, mpmc_get_batch, mpmc_size, mpmc_credits,
+    mpmc_signal_finished, locked_wait_finished, ring_stats, mpmc_destroy
+};
+
+const cp_backend_t cp_backend_inline = {
+    "inline", CP_MODE_LOCKED, CP_LOCKED_FEATURES,
+    inline_init, locked_put_batch, locked_get_batch, locked_size, locked_credits,
+    locked_signal_finished, locked_wait_finished, locked_stats, locked_destroy
+};
+
+static const cp_backend_t* const cp_backends[] = {
+    &cp_backend_locked, &cp_backend_spsc, &cp_backend_mpmc, &cp_backend_inline
+};
+
+/**
+ * Look up a built-in backend by name
+ * @param name Backend name
+ * @return The backend, or NULL if there is none by that name
+ */
+const cp_backend_t* consumer_producer_backend(const char* name)
+{
+    if (name == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(cp_backends) / sizeof(cp_backends[0]); ++i) {
+        if (strcmp(cp_backends[i]->name, name) == 0) {
+            return cp_backends[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Initialize a consumer-producer queue
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init(consumer_producer_t* queue, int capacity)
+{
+    return consumer_producer_init_mode(queue, capacity, CP_MODE_LOCKED);
+}
+
+/**
+ * Initialize a consumer-producer queue in a specific synchronization mode.
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @param mode Synchronization mode
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init_mode(consumer_producer_t* queue, int capacity, consumer_producer_mode_t mode)
+{
+    switch (mode) {
+    case CP_MODE_LOCKED:
+        return consumer_producer_init_backend(queue, capacity, &cp_backend_locked);
+    case CP_MODE_SPSC:
+        return consumer_producer_init_backend(queue, capacity, &cp_backend_spsc);
+    case CP_MODE_MPMC:
+        return consumer_producer_init_backend(queue, capacity, &cp_backend_mpmc);
+    default:
+        return "Invalid queue mode";
+    }
+}
+
+/**
+ * Initialize a consumer-producer queue on a specific backend
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @param backend Backend to use
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init_backend(consumer_producer_t* queue, int capacity, const cp_backend_t* backend)
+{
+    // 1. Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (capacity <= 0) {
+        return "Invalid queue capacity";
+    }
+    if (queue->initialized == 1) {
+        return "Queue already initialized";
+    }
+    if (capacity > INT_MAX / (int)sizeof(char*)) {
+        return "Queue capacity too large";
+    }
+    if (backend == NULL || backend->init == NULL || backend->put_batch == NULL || backend->get_batch == NULL ||
+        backend->size == NULL || backend->credits == NULL || backend->signal_finished == NULL || backend->wait_finished == NULL ||
+        backend->stats == NULL || backend->destroy == NULL) {
+        return "Invalid queue backend";
+    }
+
+    // 2. Initialize base fields
+    queue->items = NULL;
+    queue->impl = NULL;
+    queue->count = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->capacity = capacity;
+    queue->initialized = 0; // Will be set to 1 only if init completes successfully
+    atomic_init(&queue->finished_flag, 0);
+    queue->producers_waiting = 0;
+    queue->consumers_waiting = 0;
+    queue->finish_waiters = 0;
+    queue->backend = backend;
+    queue->mode = backend->mode;
+    queue->wait_strategy = CP_WAIT_PARK;
+    queue->spin_limit = 0;
+    atomic_init(&queue->producer_spin.budget, 0);
+    atomic_init(&queue->producer_spin.avg_wait_ns, 0);
+    atomic_init(&queue->consumer_spin.budget, 0);
+    atomic_init(&queue->consumer_spin.avg_wait_ns, 0);
+    queue->elastic = 0;
+    queue->min_capacity = capacity;
+    queue->max_capacity = capacity;
+    queue->high_watermark = CP_ELASTIC_HIGH_DEFAULT;
+    queue->low_watermark = CP_ELASTIC_LOW_DEFAULT;
+    queue->shrink_after = CP_ELASTIC_SHRINK_AFTER_DEFAULT;
+    queue->idle_gets = 0;
+    queue->peak_capacity = capacity;
+    queue->grows = 0;
+    queue->shrinks = 0;
+    queue->byte_budget = 0;
+    queue->bytes_in_flight = 0;
+    queue->peak_bytes = 0;
+    queue->shared_budget = NULL;
+    queue->shared_gate = 0;
+    memset(&queue->urgent_lane, 0, sizeof(queue->urgent_lane));
+    memset(&queue->ordered_lane, 0, sizeof(queue->ordered_lane));
+    queue->data_put = 0;
+    queue->data_taken = 0;
+    queue->inline_size = 0;
+    queue->inline_slab = NULL;
+    queue->inlined = 0;
+    queue->overflow = CP_OVERFLOW_BLOCK;
+    queue->sample_percent = CP_SAMPLE_PERCENT_DEFAULT;
+    queue->on_drop = NULL;
+    queue->on_drop_arg = NULL;
+    queue->item_alloc = malloc;
+    queue->item_free = free;
+    queue->item_size = cp_strlen_bytes;
+    queue->item_tag_get = NULL;
+    queue->item_tag_set = NULL;
+    queue->dropped_newest = 0;
+    queue->dropped_oldest = 0;
+    queue->dropped_sampled = 0;
+    queue->instrumented = 0;
+    atomic_init(&queue->producer_counters.ops, 0);
+    atomic_init(&queue->producer_counters.blocked, 0);
+    atomic_init(&queue->producer_counters.blocked_ns, 0);
+    atomic_init(&queue->consumer_counters.ops, 0);
+    atomic_init(&queue->consumer_counters.blocked, 0);
+    atomic_init(&queue->consumer_counters.blocked_ns, 0);
+    atomic_init(&queue->peak_count, 0);
+    atomic_init(&queue->credit_grants, 0);
+    atomic_init(&queue->credit_stalls, 0);
+    atomic_init(&queue->credit_stall_ns, 0);
+    queue->items_event_fd = -1;
+    queue->space_event_fd = -1;
+    atomic_init(&queue->items_armed, 0);
+    atomic_init(&queue->space_armed, 0);
+    queue->not_full_monitor.initialized = 0;    // Only SPSC initializes these; destroy checks the flag
+    queue->not_empty_monitor.initialized = 0;
+
+    // 3. Let the backend allocate its slots and private state
+    const char* err = backend->init(queue);
+    if (err != NULL) {
+        return err;
+    }
+
+    // 4. Initialize the queue lock and its condition variables
+    if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+        backend->destroy(queue);
+        return "Failed to initialize queue lock";
+    }
+    if (cp_cond_init(&queue->not_full) != 0) {
+        pthread_mutex_destroy(&queue->lock);
+        backend->destroy(queue);
+        return "Failed to initialize condition variables";
+    }
+    if (cp_cond_init(&queue->not_empty) != 0) {
+        pthread_cond_destroy(&queue->not_full);
+        pthread_mutex_destroy(&queue->lock);
+        backend->destroy(queue);
+        return "Failed to initialize condition variables";
+    }
+    if (cp_cond_init(&queue->drained) != 0) {
+        pthread_cond_destroy(&queue->not_empty);
+        pthread_cond_destroy(&queue->not_full);
+        pthread_mutex_destroy(&queue->lock);
+        backend->destroy(queue);
+        return "Failed to initialize condition variables";
+    }
+
+    // 5. Mark initialization success
+    queue->initialized = 1;
+
+    // 6. Return success
+    return NULL;
+}
+
+/**
+ * Choose how blocked put/get calls wait. Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @param strategy Wait strategy
+ * @param spin_limit Maximum spin iterations (0 selects CP_SPIN_DEFAULT)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_wait_strategy(consumer_producer_t* queue, consumer_producer_wait_t strategy, int spin_limit)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (strategy != CP_WAIT_PARK && strategy != CP_WAIT_SPIN && strategy != CP_WAIT_ADAPTIVE) {
+        return "Invalid wait strategy";
+    }
+    if (spin_limit < 0) {
+        return "Invalid spin limit";
+    }
+
+    cp_probe();
+    int limit = (strategy == CP_WAIT_PARK) ? 0 : (spin_limit > 0 ? spin_limit : CP_SPIN_DEFAULT);
+    queue->wait_strategy = strategy;
+    queue->spin_limit = limit;
+
+    // Both sides start from the full budget; adaptive mode resizes it from there
+    atomic_store(&queue->producer_spin.budget, limit);
+    atomic_store(&queue->producer_spin.avg_wait_ns, 0);
+    atomic_store(&queue->consumer_spin.budget, limit);
+    atomic_store(&queue->consumer_spin.avg_wait_ns, 0);
+    return NULL;
+}
+
+/**
+ * Let a locked queue grow and shrink between its initial capacity and max_capacity
+ * @param queue Pointer to queue structure
+ * @param max_capacity Upper bound (>= the initial capacity)
+ * @param high_pct High watermark in percent (0 selects the default)
+ * @param low_pct Low watermark in percent (0 selects the default)
+ * @param shrink_after Idle gets before shrinking (0 selects the default)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_elastic(consumer_producer_t* queue, int max_capacity,
+                                          int high_pct, int low_pct, int shrink_after)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (!(queue->backend->features & CP_FEATURE_ELASTIC)) {
+        return "Elastic capacity requires the locked queue mode";
+    }
+    if (high_pct == 0) {
+        high_pct = CP_ELASTIC_HIGH_DEFAULT;
+    }
+    if (low_pct == 0) {
+        low_pct = CP_ELASTIC_LOW_DEFAULT;
+    }
+    if (shrink_after == 0) {
+        shrink_after = CP_ELASTIC_SHRINK_AFTER_DEFAULT;
+    }
+    if (high_pct < 1 || high_pct > 100 || low_pct < 1 || low_pct * 2 >= high_pct) {
+        // A halved queue must land below the high watermark, or it would grow right back
+        return "Invalid watermarks (need 1 <= 2 * low < high <= 100)";
+    }
+    if (shrink_after < 0) {
+        return "Invalid shrink delay";
+    }
+    if (max_capacity > INT_MAX / (int)sizeof(char*)) {
+        return "Queue capacity too large";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    if (max_capacity < queue->min_capacity) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Maximum capacity below the initial capacity";
+    }
+    queue->max_capacity = max_capacity;
+    queue->high_watermark = high_pct;
+    queue->low_watermark = low_pct;
+    queue->shrink_after = shrink_after;
+    queue->idle_gets = 0;
+    queue->elastic = max_capacity > queue->min_capacity;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * Initialize a byte budget that several queues can share
+ * @param budget Pointer to budget structure
+ * @param limit Bytes allowed in flight (> 0)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_budget_init(cp_byte_budget_t* budget, size_t limit)
+{
+    if (budget == NULL) {
+        return "Budget pointer is NULL";
+    }
+    if (limit == 0) {
+        return "Invalid byte budget";
+    }
+    budget->limit = limit;
+    atomic_init(&budget->used, 0);
+    atomic_init(&budget->peak, 0);
+    atomic_init(&budget->waiters, 0);
+    budget->initialized = 0;
+    if (pthread_mutex_init(&budget->lock, NULL) != 0) {
+        return "Failed to initialize budget lock";
+    }
+    if (cp_cond_init(&budget->released) != 0) {
+        pthread_mutex_destroy(&budget->lock);
+        return "Failed to initialize condition variables";
+    }
+    budget->initialized = 1;
+    return NULL;
+}
+
+/**
+ * Destroy a shared byte budget
+ * @param budget Pointer to budget structure
+ */
+void consumer_producer_budget_destroy(cp_byte_budget_t* budget)
+{
+    if (budget == NULL || budget->initialized != 1) {
+        return;
+    }
+    pthread_cond_destroy(&budget->released);
+    pthread_mutex_destroy(&budget->lock);
+    budget->initialized = 0;
+}
+
+/**
+ * Bound the bytes held by queued items, per queue and/or through a shared budget
+ * @param queue Pointer to queue structure
+ * @param queue_bytes Per-queue byte limit (0 = none)
+ * @param shared Budget shared with other queues (NULL = none)
+ * @param gate 1 if puts wait for room in the shared budget, 0 if they only charge it
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_byte_budget(consumer_producer_t* queue, size_t queue_bytes,
+                                              cp_byte_budget_t* shared, int gate)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (!(queue->backend->features & CP_FEATURE_BYTE_BUDGET)) {
+        return "Byte budgets require the locked queue mode";
+    }
+    if (shared != NULL && shared->initialized != 1) {
+        return "Shared budget not initialized";
+    }
+    if (gate != 0 && gate != 1) {
+        return "Invalid gate flag";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    if (shared != queue->shared_budget && queue->bytes_in_flight > 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Cannot change the shared budget of a non-empty queue";
+    }
+    queue->byte_budget = queue_bytes;
+    queue->shared_budget = shared;
+    queue->shared_gate = shared != NULL ? gate : 0;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * Queue a control message in the high-priority lane. Never waits for room.
+ * @param queue Pointer to queue structure
+ * @param item Message to queue (queue takes ownership on success)
+ * @param order Delivery rule
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_control(consumer_producer_t* queue, const char* item, cp_control_order_t order)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (item == NULL) {
+        return "Item pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (!(queue->backend->features & CP_FEATURE_CONTROL)) {
+        return "Control lanes require the locked queue mode";
+    }
+    if (order != CP_CONTROL_ORDERED && order != CP_CONTROL_URGENT) {
+        return "Invalid control order";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    if (queue->finished_flag == 1) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Cannot add item after finished signal";
+    }
+
+    // An ordered control waits behind every data item put so far; an urgent one behind nothing
+    int was_empty = queue_is_empty(queue);
+    cp_control_lane_t* lane = order == CP_CONTROL_URGENT ? &queue->urgent_lane : &queue->ordered_lane;
+    if (control_lane_push(lane, (char*)item, queue->data_put) != 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Failed to grow the control lane";
+    }
+
+    if (was_empty && queue->consumers_waiting > 0) {
+        pthread_cond_signal(&queue->not_empty);
+    }
+    cp_event_fire(&queue->items_armed, queue->items_event_fd);
+    pthread_mutex_unlock(&queue->lock);
+
+    if (queue->instrumented) {
+        atomic_fetch_add_explicit(&queue->producer_counters.ops, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/**
+ * Choose what a put does when the item does not fit. Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @param policy Overflow policy
+ * @param sample_percent CP_OVERFLOW_SAMPLE: share of overflowing items kept, 1..99 (0 = default)
+ * @param on_drop Optional callback for every dropped item (NULL = none)
+ * @param arg Passed to on_drop
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_overflow(consumer_producer_t* queue, cp_overflow_t policy, int sample_percent,
+                                           cp_drop_callback_t on_drop, void* arg)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (policy != CP_OVERFLOW_BLOCK && policy != CP_OVERFLOW_DROP_NEWEST &&
+        policy != CP_OVERFLOW_DROP_OLDEST && policy != CP_OVERFLOW_SAMPLE) {
+        return policy == CP_OVERFLOW_SPILL ? "Spilling is set with consumer_producer_set_spill"
+                                           : "Invalid overflow policy";
+    }
+    if (sample_percent < 0 || sample_percent > 99) {
+        return "Invalid sample percentage";
+    }
+    if (policy != CP_OVERFLOW_BLOCK && !(queue->backend->features & CP_FEATURE_OVERFLOW)) {
+        return "Overflow policies require the locked queue mode";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    // Only the locked hooks keep spill state; the lock-free rings never spill
+    if (queue->backend->features & CP_FEATURE_OVERFLOW) {
+        if (spill_busy(cp_spill_of(queue))) {
+            pthread_mutex_unlock(&queue->lock);
+            return "Queue has items spilled to disk";
+        }
+        spill_close(cp_spill_of(queue));
+    }
+    queue->overflow = policy;
+    queue->sample_percent = sample_percent > 0 ? sample_percent : CP_SAMPLE_PERCENT_DEFAULT;
+    queue->on_drop = on_drop;
+    queue->on_drop_arg = arg;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * Spill items that do not fit to a temp file in dir instead of blocking or dropping them.
+ * Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @param dir Directory for the spill file (NULL = CP_SPILL_DIR_DEFAULT)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (!(queue->backend->features & CP_FEATURE_OVERFLOW)) {
+        return "Overflow policies require the locked queue mode";
+    }
+    if (dir == NULL || dir[0] == '\0') {
+        dir = CP_SPILL_DIR_DEFAULT;
+    }
+
+    // Create the file and unlink it right away: it lives exactly as long as the queue holds it open
+    size_t path_len = strlen(dir) + sizeof("/cp-spill-XXXXXX");
+    char* path = (char*)malloc(path_len);
+    if (path == NULL) {
+        return "Failed to allocate spill file name";
+    }
+    snprintf(path, path_len, "%s/cp-spill-XXXXXX", dir);
+    cp_spill_t spill;
+    memset(&spill, 0, sizeof(spill));
+    spill.fd = mkstemp(path);
+    if (spill.fd < 0) {
+        free(path);
+        return "Failed to create spill file";
+    }
+    unlink(path);
+    free(path);
+    if (spill_alloc(&spill) != 0) {
+        spill_close(&spill);
+        return "Failed to allocate spill buffers";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        spill_close(&spill);
+        return "Failed to lock queue";
+    }
+    if (spill_busy(cp_spill_of(queue))) {
+        pthread_mutex_unlock(&queue->lock);
+        spill_close(&spill);
+        return "Queue has items spilled to disk";
+    }
+    spill_close(cp_spill_of(queue));
+    *cp_spill_of(queue) = spill;
+    queue->overflow = CP_OVERFLOW_SPILL;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+/**
+ * Give every slot an inline payload area. Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @param slot_size Payload bytes per slot (CP_INLINE_MIN..CP_INLINE_MAX)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_inline(consumer_producer_t* queue, size_t slot_size)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (!(queue->backend->features & CP_FEATURE_INLINE)) {
+        return "Inline slots require the locked queue mode";
+    }
+    if (slot_size < CP_INLINE_MIN || slot_size > CP_INLINE_MAX) {
+        return "Invalid inline slot size";
+    }
+    if ((size_t)queue->capacity > SIZE_MAX / slot_size) {
+        return "Queue capacity too large";
+    }
+
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return "Failed to lock queue";
+    }
+    if (queue->count > 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Cannot change the inline slots of a non-empty queue";
+    }
+    char* slab = (char*)malloc((size_t)queue->capacity * slot_size);
+    if (slab == NULL) {
+        pthread_mutex_unlock(&queue->lock);
+        return "Failed to allocate inline slots";
+    }
+    free(queue->inline_slab);
+    queue->inline_slab = slab;
+    queue->inline_size = slot_size;
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+const char* consumer_producer_set_allocator(consumer_producer_t* queue, cp_alloc_fn alloc, cp_free_fn release)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if ((alloc == NULL) != (release == NULL)) {
+        return "Allocator needs both an alloc and a free function";
+    }
+
+    queue->item_alloc = alloc != NULL ? alloc : malloc;
+    queue->item_free = release != NULL ? release : free;
+    return NULL;
+}
+
+const char* consumer_producer_set_item_size(consumer_producer_t* queue, cp_size_fn size)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+
+    queue->item_size = size != NULL ? size : cp_strlen_bytes;
+    return NULL;
+}
+
+const char* consumer_producer_set_item_tag(consumer_producer_t* queue, cp_tag_get_fn get, cp_tag_set_fn set)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if ((get == NULL) != (set == NULL)) {
+        return "Item tags need both a get and a set function";
+    }
+
+    queue->item_tag_get = get;
+    queue->item_tag_set = set;
+    return NULL;
+}
+
+/* Strings copied per queue operation by consumer_producer_put_copy_batch */
+#define CP_COPY_CHUNK 64
+
+/**
+ * Copy several strings into the queue (producer), in order. Blocks while the queue is full.
+ * @param queue Pointer to queue structure
+ * @param strs Strings to copy (the caller keeps ownership)
+ * @param count Number of strings
+ * @param put_count If not NULL, receives how many strings were queued
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_copy_batch(consumer_producer_t* queue, const char* const* strs, int count,
+                                             int* put_count)
+{
+    if (put_count != NULL) {
+        *put_count = 0;
+    }
+
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (strs == NULL || count < 0) {
+        return "Invalid batch";
+    }
+    for (int i = 0; i < count; ++i) {
+        if (strs[i] == NULL) {
+            return "Item pointer is NULL";
+        }
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+
+    // Only strings too long for a slot are duplicated up front; the others are copied into
+    // their slot under the lock. inline_size is fixed while threads run, so both sides agree.
+    char* chunk[CP_COPY_CHUNK];
+    int done = 0;
+    while (done < count) {
+        int n = count - done < CP_COPY_CHUNK ? count - done : CP_COPY_CHUNK;
+        for (int i = 0; i < n; ++i) {
+            const char* s = strs[done + i];
+            size_t bytes = cp_item_bytes(queue, s);
+            chunk[i] = bytes <= queue->inline_size ? (char*)s : (char*)queue->item_alloc(bytes);
+            if (chunk[i] == NULL) {
+                for (int k = 0; k < i; ++k) {
+                    if (chunk[k] != strs[done + k]) {
+                        queue->item_free(chunk[k]);
+                    }
+                }
+                return "Failed to copy item";
+            }
+            if (chunk[i] != s) {
+                memcpy(chunk[i], s, bytes);
+            }
+        }
+
+        int accepted = 0;
+        const char* err = cp_put_batch(queue, chunk, n, &accepted, NULL, queue->inline_size > 0);
+        for (int k = accepted; k < n; ++k) {
+            if (chunk[k] != strs[done + k]) {
+                queue->item_free(chunk[k]);
+            }
+        }
+        done += accepted;
+        if (put_count != NULL) {
+            *put_count = done;
+        }
+        if (err != NULL) {
+            return err;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Copy a string into the queue (producer). Blocks if queue is full. The caller keeps ownership of str.
+ * @param queue Pointer to queue structure
+ * @param str String to copy
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_copy(consumer_producer_t* queue, const char* str)
+{
+    if (str == NULL) {
+        return "Item pointer is NULL";
+    }
+    return consumer_producer_put_copy_batch(queue, &str, 1, NULL);
+}
+
+/**
+ * Prepare a consumer's scratch buffer for consumer_producer_get_batch_copy
+ * @param queue Queue the buffer will read from
+ * @param scratch Buffer to prepare
+ * @param slots Largest batch the consumer will take
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_scratch_init(const consumer_producer_t* queue, cp_scratch_t* scratch, int slots)
+{
+    // Validate input parameters
+    if (queue == NULL || scratch == NULL) {
+        return "Queue or scratch pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (slots <= 0) {
+        return "Invalid scratch size";
+    }
+
+    scratch->data = NULL;
+    scratch->slots = slots;
+    scratch->slot_size = queue->inline_size;
+    if (queue->inline_size > 0) {
+        scratch->data = (char*)malloc((size_t)slots * queue->inline_size);
+        if (scratch->data == NULL) {
+            return "Failed to allocate scratch buffer";
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Release a scratch buffer
+ * @param scratch Buffer to release
+ */
+void consumer_producer_scratch_destroy(cp_scratch_t* scratch)
+{
+    if (scratch == NULL) {
+        return;
+    }
+    free(scratch->data);
+    scratch->data = NULL;
+    scratch->slots = 0;
+    scratch->slot_size = 0;
+}
+
+/**
+ * Does item point into the scratch buffer? Such items must not be freed.
+ * @param scratch Buffer passed to consumer_producer_get_batch_copy
+ * @param item Item it returned
+ * @return 1 if the item lives in the scratch buffer, 0 if the caller owns it
+ */
+int consumer_producer_scratch_owns(const cp_scratch_t* scratch, const char* item)
+{
+    if (scratch == NULL || scratch->data == NULL) {
+        return 0;
+    }
+    uintptr_t start = (uintptr_t)scratch->data;
+    uintptr_t p = (uintptr_t)item;
+    return p >= start && p < start + (uintptr_t)scratch->slots * scratch->slot_size;
+}
+
+/**
+ * Like consumer_producer_get_batch, but inline items are copied into scratch instead of the heap
+ * @param queue Pointer to queue structure
+ * @param out Receives the items
+ * @param max_items Capacity of out (at most scratch->slots)
+ * @param scratch Buffer prepared by consumer_producer_scratch_init for this queue
+ * @return Number of items removed, 0 if finished and drained, -1 on error
+ */
+int consumer_producer_get_batch_copy(consumer_producer_t* queue, char** out, int max_items, cp_scratch_t* scratch)
+{
+    // Validate input
+    if (queue == NULL || out == NULL || scratch == NULL || max_items <= 0 || max_items > scratch->slots) {
+        return -1;
+    }
+    if (queue->initialized != 1 || scratch->slot_size != queue->inline_size) {
+        return -1;
+    }
+
+    return cp_get_batch(queue, out, max_items, NULL, scratch->data);
+}
+
+/**
+ * Start counting puts/gets and timing blocked calls. Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_enable_instrumentation(consumer_producer_t* queue)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+
+    queue->instrumented = 1;
+    return NULL;
+}
+
+/* Fill the contention counters of a snapshot (the queue's own and its monitors') */
+static void cp_fill_counters(consumer_producer_t* queue, cp_stats_t* out)
+{
+    out->puts = atomic_load_explicit(&queue->producer_counters.ops, memory_order_relaxed);
+    out->gets = atomic_load_explicit(&queue->consumer_counters.ops, memory_order_relaxed);
+    out->producer_blocked = atomic_load_explicit(&queue->producer_counters.blocked, memory_order_relaxed);
+    out->consumer_blocked = atomic_load_explicit(&queue->consumer_counters.blocked, memory_order_relaxed);
+    out->producer_blocked_ns = atomic_load_explicit(&queue->producer_counters.blocked_ns, memory_order_relaxed);
+    out->consumer_blocked_ns = atomic_load_explicit(&queue->consumer_counters.blocked_ns, memory_order_relaxed);
+    out->peak_count = atomic_load_explicit(&queue->peak_count, memory_order_relaxed);
+    out->credit_grants = atomic_load_explicit(&queue->credit_grants, memory_order_relaxed);
+    out->credit_stalls = atomic_load_explicit(&queue->credit_stalls, memory_order_relaxed);
+    out->credit_stall_ns = atomic_load_explicit(&queue->credit_stall_ns, memory_order_relaxed);
+
+    monitor_t* monitors[] = { &queue->not_full_monitor, &queue->not_empty_monitor };
+    out->monitor_waits = 0;
+    out->monitor_spurious_wakeups = 0;
+    for (size_t i = 0; i < sizeof(monitors) / sizeof(monitors[0]); ++i) {
+        monitor_stats_t m;
+        if (monitor_get_stats(monitors[i], &m) == 0) {
+            out->monitor_waits += m.waits;
+            out->monitor_spurious_wakeups += m.spurious_wakeups;
+        }
+    }
+}
+
+/**
+ * Take a snapshot of the queue's capacity, occupancy, resize and contention counters
+ * @param queue Pointer to queue structure
+ * @param out Receives the snapshot
+ * @return 0 on success, -1 on error
+ */
+int consumer_producer_get_stats(consumer_producer_t* queue, cp_stats_t* out)
+{
+    if (queue == NULL || out == NULL || queue->initialized != 1) {
+        return -1;
+    }
+    cp_fill_counters(queue, out);
+    out->backend = queue->backend->name;
+    return queue->backend->stats(queue, out);
+}
+
+/**
+ * Create readiness eventfds so the queue can be driven from poll/epoll. Call before threads start.
+ * @param queue Pointer to queue structure
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_enable_events(consumer_producer_t* queue)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (queue->items_event_fd >= 0) {
+        return "Queue events already enabled";
+    }
+
+    int items_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (items_fd < 0) {
+        return "Failed to create items eventfd";
+    }
+    int space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (space_fd < 0) {
+        close(items_fd);
+        return "Failed to create space eventfd";
+    }
+
+    // Start from the current state: readable if there is something to do, armed otherwise
+    if (!queue_is_empty(queue) || atomic_load(&queue->finished_flag) == 1) {
+        cp_event_notify(items_fd);
+    } else {
+        atomic_store(&queue->items_armed, 1);
+    }
+    if (!queue_is_full(queue)) {
+        cp_event_notify(space_fd);
+    } else {
+        atomic_store(&queue->space_armed, 1);
+    }
+
+    queue->items_event_fd = items_fd;
+    queue->space_event_fd = space_fd;
+    return NULL;
+}
+
+/**
+ * Get the eventfd that becomes readable when items are available
+ * @param queue Pointer to queue structure
+ * @return File descriptor, or -1 if events are not enabled
+ */
+int consumer_producer_items_fd(const consumer_producer_t* queue)
+{
+    if (queue == NULL || queue->initialized != 1) {
+        return -1;
+    }
+    return queue->items_event_fd;
+}
+
+/**
+ * Get the eventfd that becomes readable when free slots are available
+ * @param queue Pointer to queue structure
+ * @return File descriptor, or -1 if events are not enabled
+ */
+int consumer_producer_space_fd(const consumer_producer_t* queue)
+{
+    if (queue == NULL || queue->initialized != 1) {
+        return -1;
+    }
+    return queue->space_event_fd;
+}
+
+
+/**
+ * Destroy a consumer-producer queue and free its resources
+ * @param queue Pointer to queue structure
+ */
+void consumer_producer_destroy(consumer_producer_t* queue)
+{
+    // 1. Validate input
+    if (queue == NULL)
+    {
+        // Nothing to destroy
+        return;
+    }
+    if (queue->initialized != 1)
+    {
+        // Queue was never successfully initialized
+        return;
+    }
+
+    // Control messages nobody received
+    control_lane_free(queue, &queue->urgent_lane);
+    control_lane_free(queue, &queue->ordered_lane);
+
+    // Leftover items no longer count against a shared byte budget
+    if (queue->shared_budget != NULL) {
+        cp_budget_credit(queue->shared_budget, queue->bytes_in_flight);
+        queue->shared_budget = NULL;
+    }
+
+    // 2. Let the backend free the items still queued (the queue owns them), its slots and its state
+    queue->backend->destroy(queue);
+
+    // 3. Close the readiness eventfds, if any
+    if (queue->items_event_fd >= 0) {
+        close(queue->items_event_fd);
+        queue->items_event_fd = -1;
+    }
+    if (queue->space_event_fd >= 0) {
+        close(queue->space_event_fd);
+        queue->space_event_fd = -1;
+    }
+
+    // 3.1 Destroy the condition variables and the queue lock
+    pthread_cond_destroy(&queue->drained);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    pthread_mutex_destroy(&queue->lock);
+
+    // 4. Reset structure fields
+    queue->capacity = 0;
+    queue->count = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->initialized = 0;
+    queue->finished_flag = 0;
+    queue->producers_waiting = 0;
+    queue->consumers_waiting = 0;
+    queue->finish_waiters = 0;
+    queue->backend = NULL;
+    queue->mode = CP_MODE_LOCKED;
+    queue->wait_strategy = CP_WAIT_PARK;
+    queue->spin_limit = 0;
+    queue->elastic = 0;
+    queue->min_capacity = 0;
+    queue->max_capacity = 0;
+    queue->idle_gets = 0;
+    queue->peak_capacity = 0;
+    queue->grows = 0;
+    queue->shrinks = 0;
+    queue->byte_budget = 0;
+    queue->bytes_in_flight = 0;
+    queue->peak_bytes = 0;
+    queue->shared_gate = 0;
+    queue->inline_size = 0;
+    queue->inlined = 0;
+    queue->overflow = CP_OVERFLOW_BLOCK;
+    queue->on_drop = NULL;
+    queue->on_drop_arg = NULL;
+    queue->item_alloc = malloc;
+    queue->item_free = free;
+    queue->item_size = cp_strlen_bytes;
+    queue->item_tag_get = NULL;
+    queue->item_tag_set = NULL;
+    queue->dropped_newest = 0;
+    queue->dropped_oldest = 0;
+    queue->dropped_sampled = 0;
+    queue->instrumented = 0;
+}
+
+/**
+ * Add an item to the queue (producer). Blocks if queue is full.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put(consumer_producer_t* queue, const char* item)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (item == NULL) {
+        return "Item pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+
+    // A single put is a batch of one (queue takes ownership)
+    char* slot = (char*)item;
+    return cp_put_batch(queue, &slot, 1, NULL, NULL, 0);
+}
+
+/**
+ * Remove an item from the queue (consumer) and returns it. Blocks if queue is empty.
+ * @param queue Pointer to queue structure
+ * @return String item or NULL if queue is empty
+ */
+char* consumer_producer_get(consumer_producer_t* queue)
+{
+    // Validate input
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (queue->initialized != 1) {
+        return NULL;
+    }
+
+    // A single get is a batch of one; NULL once finished and drained (or on error)
+    char* item = NULL;
+    int n = cp_get_batch(queue, &item, 1, NULL, NULL);
+    return n == 1 ? item : NULL;
+}
+
+/**
+ * Add several items to the queue (producer), in order. Blocks while the queue is full.
+ * @param queue Pointer to queue structure
+ * @param items Strings to add (queue takes ownership of each item it accepts)
+ * @param count Number of items
+ * @param put_count If not NULL, receives how many items were accepted
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count)
+{
+    if (put_count != NULL) {
+        *put_count = 0;
+    }
+
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (items == NULL || count < 0) {
+        return "Invalid batch";
+    }
+    for (int i = 0; i < count; ++i) {
+        if (items[i] == NULL) {
+            return "Item pointer is NULL";
+        }
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+    if (count == 0) {
+        return NULL;
+    }
+
+    return cp_put_batch(queue, items, count, put_count, NULL, 0);
+}
+
+/**
+ * Remove up to max_items items from the queue (consumer), oldest first. Blocks while the queue is empty.
+ * @param queue Pointer to queue structure
+ * @param out Receives the items (caller takes ownership)
+ * @param max_items Capacity of out
+ * @return Number of items removed, 0 if finished and drained, -1 on error
+ */
+int consumer_producer_get_batch(consumer_producer_t* queue, char** out, int max_items)
+{
+    return consumer_producer_get_batch_timed(queue, out, max_items, NULL);
+}
+
+/**
+ * Remove up to max_items items from the queue (consumer), waiting at most until deadline.
+ * @param queue Pointer to queue structure
+ * @param out Receives the items (caller takes ownership)
+ * @param max_items Capacity of out
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return Number of items removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the deadline passed
+ */
+int consumer_producer_get_batch_timed(consumer_producer_t* queue, char** out, int max_items,
+                                      const struct timespec* deadline)
+{
+    // Validate input
+    if (queue == NULL || out == NULL || max_items <= 0) {
+        return -1;
+    }
+    if (queue->initialized != 1) {
+        return -1;
+    }
+
+    return cp_get_batch(queue, out, max_items, deadline, NULL);
+}
+
+/**
+ * Remove one item if one is available right now (consumer). Never blocks.
+ * @param queue Pointer to queue structure
+ * @param out Receives the item (caller takes ownership)
+ * @return 1 if an item was removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the queue is empty
+ */
+int consumer_producer_try_get(consumer_producer_t* queue, char** out)
+{
+    return consumer_producer_get_batch_timed(queue, out, 1, CP_NO_WAIT);
+}
+
+/**
+ * Remove one item (consumer), waiting at most until deadline.
+ * @param queue Pointer to queue structure
+ * @param out Receives the item (caller takes ownership)
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return 1 if an item was removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the deadline passed
+ */
+int consumer_producer_get_timed(consumer_producer_t* queue, char** out, const struct timespec* deadline)
+{
+    return consumer_producer_get_batch_timed(queue, out, 1, deadline);
+}
+
+/**
+ * Add an item if there is room right now (producer). Never blocks.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership only on success)
+ * @return NULL on success, CP_ERR_TIMEOUT if the queue is full, other error message on failure
+ */
+const char* consumer_producer_try_put(consumer_producer_t* queue, const char* item)
+{
+    return consumer_producer_put_timed(queue, item, CP_NO_WAIT);
+}
+
+/**
+ * Add an item (producer), waiting at most until deadline for room.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership only on success)
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return NULL on success, CP_ERR_TIMEOUT if the deadline passed, other error message on failure
+ */
+const char* consumer_producer_put_timed(consumer_producer_t* queue, const char* item, const struct timespec* deadline)
+{
+    // Validate input parameters
+    if (queue == NULL) {
+        return "Queue pointer is NULL";
+    }
+    if (item == NULL) {
+        return "Item pointer is NULL";
+    }
+    if (queue->initialized != 1) {
+        return "Queue not initialized";
+    }
+
+    char* slot = (char*)item;
+    return cp_put_batch(queue, &slot, 1, NULL, deadline, 0);
+}
+
+/**
+ * Compute the absolute deadline that lies timeout_ms milliseconds from now
+ * @param deadline Receives the CLOCK_MONOTONIC deadline
+ * @param timeout_ms Relative timeout in milliseconds (negative counts as 0)
+ */
+void consumer_producer_deadline_after(struct timespec* deadline, long timeout_ms)
+{
+    if (deadline == NULL) {
+        return;
+    }
+    if (timeout_ms < 0) {
+        timeout_ms = 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec += 1;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+
+/**
+ * Signal that processing is finished
+ * @param queue Pointer to queue structure
+ */
+void consumer_producer_signal_finished(consumer_producer_t* queue)
+{
+    // Validate input
+    if (queue == NULL) {
+        return;
+    }
+    if (queue->initialized != 1) {
+        return;
+    }
+
+    // Protect finished_flag with the queue lock
+    if (pthread_mutex_lock(&queue->lock) != 0) {
+        return; // Failed to lock (rare)
+    }
+
+    // If already finished, nothing to do
+    if (queue->finished_flag == 1) {
+        pthread_mutex_unlock(&queue->lock);
+        return;
+    }
+
+    // Mark as finished under the lock
+    queue->finished_flag = 1;
+
+    // Poll/epoll-driven sides must come back to see 'finished'
+    if (queue->items_event_fd >= 0) {
+        cp_event_notify(queue->items_event_fd);
+        cp_event_notify(queue->space_event_fd);
+    }
+
+    // Wake whoever sleeps on the backend's waiting points
+    queue->backend->signal_finished(queue);
+
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Wait for processing to be finished (finished was signaled and the queue is drained)
+ * @param queue Pointer to queue structure
+ * @return 0 on success, -1 on error
+ */
+int consumer_producer_wait_finished(consumer_producer_t* queue)
+{
+    return consumer_producer_wait_finished_timed(queue, NULL);
+}
+
+/**
+ * Wait for processing to be finished, giving up at an absolute deadline
+ * @param queue Pointer to queue structure
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return 0 on success, -1 on error, CP_TIMEDOUT if the deadline passed first
+ */
+int consumer_producer_wait_finished_timed(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    // Validate input
+    if (queue == NULL) {
+        return -1;
+    }
+    if (queue->initialized != 1) {
+        return -1;
+    }
+
+    return queue->backend->wait_finished(queue, deadline);
+}
+
+/**
+ * Credits the queue grants its producer right now
+ * @param queue Pointer to queue structure
+ * @return Number of credits (0 if none or finished), -1 on error
+ */
+int consumer_producer_credits(consumer_producer_t* queue)
+{
+    if (queue == NULL || queue->initialized != 1) {
+        return -1;
+    }
+    int credits = queue->backend->credits(queue, CP_NO_WAIT);
+    return credits == CP_TIMEDOUT ? 0 : credits;
+}
+
+/**
+ * Wait until the queue grants at least one credit
+ * @param queue Pointer to queue structure
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return Number of credits (>0), -1 on error or after finished, CP_TIMEDOUT if the deadline passed first
+ */
+int consumer_producer_wait_credits(consumer_producer_t* queue, const struct timespec* deadline)
+{
+    if (queue == NULL || queue->initialized != 1) {
+        return -1;
+    }
+
+    // Only a grant that found no credit pays for the clock reads
+    int credits = queue->backend->credits(queue, CP_NO_WAIT);
+    if (credits == CP_TIMEDOUT) {
+        long long start = cp_now_ns();
+        credits = queue->backend->credits(queue, deadline);
+        atomic_fetch_add_explicit(&queue->credit_stalls, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&queue->credit_stall_ns, cp_now_ns() - start, memory_order_relaxed);
+    }
+    if (credits == 0) {
+        return -1;  // Finished: nothing may be put anymore
+    }
+    if (credits > 0) {
+        atomic_fetch_add_explicit(&queue->credit_grants, 1, memory_order_relaxed);
+    }
+    return credits;
+}
+
+/**
+ * Check if the queue is full
+ * @param queue Pointer to the queue structure
+ * @return 1 if full, 0 otherwise
+ */
+int queue_is_full(const consumer_producer_t* queue)
+{
+    // A queue is full when the number of items reaches its capacity; one without a backend
+    // (never initialized, or destroyed) holds nothing
+    if (queue->backend == NULL) {
+        return 0;
+    }
+    return queue->backend->size(queue) >= (size_t)queue->capacity;
+}
+
+/**
+ * Check if the queue is empty
+ * @param queue Pointer to the queue structure
+ * @return 1 if empty, 0 otherwise
+ */
+int queue_is_empty(const consumer_producer_t* queue)
+{
+    // A queue is empty when there are no items in it (data or control messages)
+    if (queue->backend == NULL) {
+        return 1;
+    }
+    return queue->backend->size(queue) == 0 && queue->urgent_lane.count == 0 && queue->ordered_lane.count == 0;
+}
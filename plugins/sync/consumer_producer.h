@@ -1,77 +1,822 @@
-#include "monitor.h"
-/**
- * Consumer-Producer queue structure for thread-safe producer-consumer pattern
- * Now using monitors for simpler implementation
- */
-typedef struct
-{
-    char** items;           /* Array of string pointers */
-    int capacity;           /* Maximum number of items */
-    int count;              /* Current number of items */
-    int head;               /* Index of first item */
-    int tail;               /* Index of next insertion point */
-    monitor_t not_full_monitor;     /* Monitor for "not full" state */
-    monitor_t not_empty_monitor;    /* Monitor for "not empty" state */
-    monitor_t finished_monitor;     /* Monitor for finished signal */
-    int initialized;        /* Indicates if the queue has been successfully initialized */
-    int finished_flag;              /* Indicates if signal_finished was called */
-    pthread_mutex_t lock;           /* Must be held whenever checking or mutating the queue state */
-} consumer_producer_t;
-
-/**
- * Initialize a consumer-producer queue
- * @param queue Pointer to queue structure
- * @param capacity Maximum number of items
- * @return NULL on success, error message on failure
- */
-const char* consumer_producer_init(consumer_producer_t* queue, int capacity);
-
-/**
- * Destroy a consumer-producer queue and free its resources
- * @param queue Pointer to queue structure
- */
-void consumer_producer_destroy(consumer_producer_t* queue);
-
-/**
- * Add an item to the queue (producer). Blocks if queue is full.
- * @param queue Pointer to queue structure
- * @param item String to add (queue takes ownership)
- * @return NULL on success, error message on failure
- */
-const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
-
-/**
- * Remove an item from the queue (consumer) and returns it. Blocks if queue is empty.
- * @param queue Pointer to queue structure
- * @return String item or NULL if queue is empty
- */
-char* consumer_producer_get(consumer_producer_t* queue);
-
-/**
- * Signal that processing is finished
- * @param queue Pointer to queue structure
- */
-void consumer_producer_signal_finished(consumer_producer_t* queue);
-
-/**
- * Wait for processing to be finished
- * @param queue Pointer to queue structure
- * @return 0 on success, -1 on timeout
- */
-int consumer_producer_wait_finished(consumer_producer_t* queue);
-
-/**
- * Check if the queue is full
- * @param queue Pointer to the queue structure
- * @return 1 if full, 0 otherwise
- */
-int queue_is_full(const consumer_producer_t* queue);
-
-/**
- * Check if the queue is empty
- * @param queue Pointer to the queue structure
- * @return 1 if empty, 0 otherwise
- */
-int queue_is_empty(const consumer_producer_t* queue);
-
-
+#ifndef CONSUMER_PRODUCER_H
+#define CONSUMER_PRODUCER_H
+
+#include "monitor.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * Queue synchronization modes
+ */
+typedef enum
+{
+    CP_MODE_LOCKED = 0,     /* One mutex + condition variables; any number of producers and consumers */
+    CP_MODE_SPSC   = 1,     /* Lock-free ring; exactly one producer thread and one consumer thread */
+    CP_MODE_MPMC   = 2      /* Lock-free sequence-numbered ring; any number of producers and consumers */
+} consumer_producer_mode_t;
+
+/**
+ * What a blocked put/get does before it sleeps
+ */
+typedef enum
+{
+    CP_WAIT_PARK     = 0,   /* Sleep right away (default): no CPU burnt while idle */
+    CP_WAIT_SPIN     = 1,   /* Busy-spin up to spin_limit pause iterations, yield a few times, then sleep */
+    CP_WAIT_ADAPTIVE = 2    /* Like CP_WAIT_SPIN, but the spin budget follows the observed wait times */
+} consumer_producer_wait_t;
+
+/* Returned by get/wait calls that gave up because their deadline passed (or, for try_*, would have blocked) */
+#define CP_TIMEDOUT (-2)
+
+/* Returned by put calls that gave up at their deadline; compare by pointer. The caller keeps the item. */
+extern const char CP_ERR_TIMEOUT[];
+
+/* Deadline meaning "do not wait at all", as passed by the try_* calls to the backend hooks; compare by pointer */
+extern const struct timespec cp_no_wait_deadline;
+#define CP_NO_WAIT (&cp_no_wait_deadline)
+
+/* Default spin budget (pause iterations) when none is given */
+#define CP_SPIN_DEFAULT 4096
+
+/**
+ * Spin bookkeeping for one side of the queue (producers or consumers).
+ * Updated with relaxed atomics: concurrent waiters may lose an update, which only blurs the averages.
+ */
+typedef struct
+{
+    atomic_int budget;              /* Current spin budget in pause iterations (0 = park at once) */
+    atomic_long avg_wait_ns;        /* Moving average of how long a blocked call waited */
+} cp_spin_state_t;
+
+/* Elastic capacity defaults (see consumer_producer_set_elastic) */
+#define CP_ELASTIC_HIGH_DEFAULT         75      /* Percent occupancy that triggers growth */
+#define CP_ELASTIC_LOW_DEFAULT          25      /* Percent occupancy that counts as idle */
+#define CP_ELASTIC_SHRINK_AFTER_DEFAULT 1024    /* Consecutive idle gets before shrinking */
+
+/**
+ * What a put does with an item that does not fit (consumer_producer_set_overflow)
+ */
+typedef enum
+{
+    CP_OVERFLOW_BLOCK       = 0,    /* Wait for room (default): lossless, but a slow consumer stalls every producer */
+    CP_OVERFLOW_DROP_NEWEST = 1,    /* Drop the item being put */
+    CP_OVERFLOW_DROP_OLDEST = 2,    /* Evict the oldest queued item to make room */
+    CP_OVERFLOW_SAMPLE      = 3,    /* Keep the item with a fixed probability (evicting the oldest one, as DROP_OLDEST), else drop it */
+    CP_OVERFLOW_SPILL       = 4     /* Append it to a spill file, read back in order as the ring drains
+                                       (set through consumer_producer_set_spill) */
+} cp_overflow_t;
+
+/**
+ * Called for every item an overflow policy drops, with the queue lock held.
+ * The item is only valid during the call and the callback must not use the queue.
+ */
+typedef void (*cp_drop_callback_t)(const char* item, void* arg);
+
+/**
+ * Allocator for the item buffers a queue creates or frees on its own (see consumer_producer_set_allocator)
+ */
+typedef void* (*cp_alloc_fn)(size_t bytes);
+typedef void  (*cp_free_fn)(void* item);
+
+/**
+ * Bytes an item takes, NUL included (see consumer_producer_set_item_size)
+ */
+typedef size_t (*cp_size_fn)(const char* item);
+
+/**
+ * Metadata an item carries beside its text, kept across the spill file (see consumer_producer_set_item_tag):
+ * read from an item when it is spilled, applied to its copy when it is read back
+ */
+typedef void (*cp_tag_get_fn)(const char* item, unsigned int* flags, unsigned long* seq);
+typedef void (*cp_tag_set_fn)(char* item, unsigned int flags, unsigned long seq);
+
+/* Default share of overflowing items a CP_OVERFLOW_SAMPLE queue keeps */
+#define CP_SAMPLE_PERCENT_DEFAULT 50
+
+/* Spill files (see consumer_producer_set_spill) */
+#define CP_SPILL_DIR_DEFAULT "/tmp"     /* Where the spill file goes when no directory is given */
+#define CP_SPILL_BUFFER      65536      /* Size of each spill write and read buffer */
+
+/* Bounds on the inline payload of a slot (see consumer_producer_set_inline) */
+#define CP_INLINE_MIN   16
+#define CP_INLINE_MAX   4096
+
+/* Inline payload of the built-in "inline" backend (cp_backend_inline) */
+#define CP_INLINE_DEFAULT 64
+
+/**
+ * Queue statistics snapshot (consumer_producer_get_stats)
+ */
+typedef struct
+{
+    int capacity;           /* Current capacity */
+    int count;              /* Items queued when the snapshot was taken */
+    int min_capacity;       /* Elastic lower bound (== capacity for fixed queues) */
+    int max_capacity;       /* Elastic upper bound (== capacity for fixed queues) */
+    int peak_capacity;      /* Largest capacity reached so far */
+    long grows;             /* Elastic resizes up */
+    long shrinks;           /* Elastic resizes down */
+    size_t bytes;           /* Bytes held by queued items (locked mode; 0 elsewhere) */
+    size_t peak_bytes;      /* Largest byte count observed */
+    size_t byte_budget;     /* Per-queue byte budget (0 = none) */
+
+    /* Contention counters; all 0 unless consumer_producer_enable_instrumentation was called */
+    long puts;                  /* Items accepted */
+    long gets;                  /* Items handed out */
+    long producer_blocked;      /* Put calls that found the queue full (or the byte budget spent) and waited */
+    long consumer_blocked;      /* Get calls that found the queue empty and waited */
+    long long producer_blocked_ns;  /* Total time those put calls spent waiting */
+    long long consumer_blocked_ns;  /* Total time those get calls spent waiting */
+    int peak_count;             /* Highest occupancy seen right after a put */
+    long monitor_waits;         /* monitor_wait calls on the queue's monitors (CP_MODE_SPSC parks on them) */
+    long monitor_spurious_wakeups;  /* Of which woke up without the monitor being signaled */
+    int controls;               /* Control messages queued in the priority lanes */
+    size_t inline_size;         /* Inline payload bytes per slot (0 = every item is a heap pointer) */
+    long inlined;               /* Items copied into inline slots instead of being queued by pointer */
+    cp_overflow_t overflow;     /* Overflow policy */
+    long dropped_newest;        /* Items dropped on put by CP_OVERFLOW_DROP_NEWEST (or a spent shared budget) */
+    long dropped_oldest;        /* Queued items evicted by CP_OVERFLOW_DROP_OLDEST */
+    long dropped_sampled;       /* Items CP_OVERFLOW_SAMPLE chose not to keep */
+    long spilled;               /* Items CP_OVERFLOW_SPILL wrote to disk */
+    int spill_count;            /* Of which not read back yet (not counted in count) */
+    size_t spill_bytes;         /* Bytes of those items (item size each, see consumer_producer_set_item_size) */
+    size_t spill_peak_bytes;    /* Largest spill_bytes observed */
+    long spill_lost;            /* Spilled items lost because the spill file could not be read back */
+    const char* backend;        /* Name of the queue backend (cp_backend_t.name) */
+
+    /* Credit-based flow control (consumer_producer_wait_credits); always counted */
+    long credit_grants;         /* wait_credits calls that granted credits */
+    long credit_stalls;         /* Of which found no credit and had to wait (the producer was starved) */
+    long long credit_stall_ns;  /* Total time those calls waited */
+} cp_stats_t;
+
+typedef struct consumer_producer consumer_producer_t;
+
+/* Optional features of a queue backend (cp_backend_t.features). They run on the locked ring's fields and
+ * private state, so a backend that declares them builds on cp_backend_locked's hooks, init and destroy included. */
+#define CP_FEATURE_ELASTIC      0x01    /* consumer_producer_set_elastic */
+#define CP_FEATURE_BYTE_BUDGET  0x02    /* consumer_producer_set_byte_budget */
+#define CP_FEATURE_CONTROL      0x04    /* consumer_producer_put_control */
+#define CP_FEATURE_INLINE       0x08    /* consumer_producer_set_inline */
+#define CP_FEATURE_OVERFLOW     0x10    /* consumer_producer_set_overflow with a shedding policy */
+
+/**
+ * Queue backend: the implementation behind a queue, chosen at init (consumer_producer_init_backend).
+ * The public calls validate their input, handle instrumentation and finished/eventfd bookkeeping,
+ * then dispatch through these hooks, so callers such as plugin_common.c never depend on the backend.
+ * The built-in backends are cp_backend_locked (default), cp_backend_spsc, cp_backend_mpmc and
+ * cp_backend_inline; consumer_producer_backend looks them up by name.
+ */
+typedef struct cp_backend
+{
+    const char* name;               /* Short name, e.g. for ANALYZER_QUEUE_MODE and the stats */
+    consumer_producer_mode_t mode;  /* Synchronization mode, i.e. which queue fields the hooks drive; only
+                                       CP_MODE_LOCKED is special-cased (it tracks its peak under its lock) */
+    unsigned features;              /* CP_FEATURE_* bits: optional calls that work on this backend */
+
+    /* Allocate the slots for queue->capacity items and the backend's private state in queue->impl.
+     * Called once the common fields are set, before the lock exists; must clean up after itself on failure. */
+    const char* (*init)(consumer_producer_t* queue);
+    /* Put up to count items in order, waiting until deadline (NULL = forever) for room.
+     * copy: items that fit queue->inline_size are borrowed and must be copied into their slot. */
+    const char* (*put_batch)(consumer_producer_t* queue, char** items, int count, int* put_count,
+                             const struct timespec* deadline, int copy);
+    /* Take up to max_items items, waiting until deadline for the first; scratch (may be NULL)
+     * receives copies of inline items. Returns the count, 0 if finished and drained, -1 or CP_TIMEDOUT. */
+    int (*get_batch)(consumer_producer_t* queue, char** out, int max_items, const struct timespec* deadline,
+                     char* scratch);
+    /* Data items queued (a snapshot for the lock-free backends) */
+    size_t (*size)(const consumer_producer_t* queue);
+    /* Credits: how many items a put could add right now without waiting, waiting until deadline for
+     * at least one (CP_NO_WAIT only looks). Returns the count, 0 if finished, -1 or CP_TIMEDOUT. */
+    int (*credits)(consumer_producer_t* queue, const struct timespec* deadline);
+    /* Wake every waiter that must see finished_flag, which was just set; called with the queue lock held */
+    void (*signal_finished)(consumer_producer_t* queue);
+    /* Block until finished was signaled and the queue is drained (see consumer_producer_wait_finished_timed) */
+    int (*wait_finished)(consumer_producer_t* queue, const struct timespec* deadline);
+    /* Fill the capacity, occupancy and feature part of a stats snapshot (the caller fills the counters).
+     * Returns 0 on success, -1 on error. */
+    int (*stats)(consumer_producer_t* queue, cp_stats_t* out);
+    /* Free the items still queued, the slots and queue->impl (destroy; no other thread uses the queue anymore) */
+    void (*destroy)(consumer_producer_t* queue);
+} cp_backend_t;
+
+/* Built-in backends */
+extern const cp_backend_t cp_backend_locked;    /* Mutex + condition variables; every feature (CP_MODE_LOCKED) */
+extern const cp_backend_t cp_backend_spsc;      /* Lock-free ring for one producer and one consumer (CP_MODE_SPSC) */
+extern const cp_backend_t cp_backend_mpmc;      /* Lock-free sequence-numbered ring (CP_MODE_MPMC) */
+extern const cp_backend_t cp_backend_inline;    /* cp_backend_locked with CP_INLINE_DEFAULT-byte inline slots */
+
+/**
+ * Contention counters of one side of the queue (producers or consumers).
+ * Relaxed atomics: several threads on one side may add concurrently.
+ */
+typedef struct
+{
+    atomic_long ops;                /* Items put (producer side) or taken (consumer side) */
+    atomic_long blocked;            /* Calls that had to wait */
+    atomic_llong blocked_ns;        /* Total time spent waiting */
+} cp_side_counters_t;
+
+/**
+ * Byte budget shared by several queues, e.g. every stage of one pipeline.
+ * Queues charge it when an item is put and credit it when the item is taken.
+ * Only queues attached as a gate wait for room in it (see consumer_producer_set_byte_budget).
+ */
+typedef struct cp_byte_budget
+{
+    size_t limit;                   /* Bytes allowed in flight across all attached queues */
+    atomic_size_t used;             /* Bytes currently charged */
+    atomic_size_t peak;             /* Largest value of used */
+    atomic_int waiters;             /* Gated producers asleep on released */
+    pthread_mutex_t lock;           /* Only taken to sleep on / signal released */
+    pthread_cond_t released;        /* Broadcast when bytes are credited back while someone waits */
+    int initialized;
+} cp_byte_budget_t;
+
+/**
+ * Delivery rule of a control message (consumer_producer_put_control)
+ */
+typedef enum
+{
+    CP_CONTROL_ORDERED = 0, /* Never overtakes data: delivered right after the items put before it (end-of-stream, flush) */
+    CP_CONTROL_URGENT  = 1  /* Overtakes all queued data and ordered controls (abort, urgent records) */
+} cp_control_order_t;
+
+/**
+ * One queued control message
+ */
+typedef struct
+{
+    char* item;                     /* The message (owned by the queue) */
+    size_t after;                   /* Ordered lane: data items that must be taken before it */
+} cp_control_t;
+
+/**
+ * Growable FIFO of control messages. A control put never waits for room.
+ */
+typedef struct
+{
+    cp_control_t* slots;            /* Ring of messages */
+    int capacity;                   /* Allocated slots */
+    int head;                       /* Oldest message */
+    int count;                      /* Messages queued */
+} cp_control_lane_t;
+
+/**
+ * Consumer-side buffer that receives copies of inline items (consumer_producer_get_batch_copy).
+ * Each consumer thread owns one; its copies stay valid until the next get through it.
+ */
+typedef struct
+{
+    char* data;                     /* slots * slot_size bytes (NULL when the queue has no inline slots) */
+    int slots;                      /* Largest batch it can receive */
+    size_t slot_size;               /* Inline payload size of the queue it was made for */
+} cp_scratch_t;
+
+/**
+ * Consumer-Producer queue structure for thread-safe producer-consumer pattern
+ * A single mutex guards the state; blocked threads wait on condition variables
+ * and are only woken on the transitions that can unblock them
+ */
+struct consumer_producer
+{
+    const cp_backend_t* backend;    /* Implementation behind the queue, chosen at init */
+    void* impl;                     /* Backend-private state: made by backend->init, freed by backend->destroy */
+    char** items;           /* Array of string pointers */
+    int capacity;           /* Maximum number of items */
+    int count;              /* Current number of items */
+    int head;               /* Index of first item */
+    int tail;               /* Index of next insertion point */
+    int initialized;        /* Indicates if the queue has been successfully initialized */
+    atomic_int finished_flag;       /* Indicates if signal_finished was called */
+    pthread_mutex_t lock;           /* Must be held whenever checking or mutating the queue state */
+    pthread_cond_t not_full;        /* Producers wait here while the queue is full */
+    pthread_cond_t not_empty;       /* Consumers wait here while the queue is empty */
+    pthread_cond_t drained;         /* wait_finished() waits here for finished && empty */
+    int producers_waiting;          /* Threads blocked on not_full (guarded by lock) */
+    int consumers_waiting;          /* Threads blocked on not_empty (guarded by lock) */
+    int finish_waiters;             /* Threads blocked on drained (guarded by lock) */
+    consumer_producer_mode_t mode;  /* Synchronization mode chosen at init */
+    consumer_producer_wait_t wait_strategy; /* Spin-then-park policy for blocked calls */
+    int spin_limit;                 /* Upper bound on the spin budget (pause iterations) */
+    cp_spin_state_t producer_spin;  /* Spin state of threads waiting for space */
+    cp_spin_state_t consumer_spin;  /* Spin state of threads waiting for items */
+
+    /* Elastic capacity (CP_MODE_LOCKED only; all guarded by lock). Disabled while max_capacity == capacity. */
+    int elastic;                    /* 1 once consumer_producer_set_elastic succeeded */
+    int min_capacity;               /* Never shrink below (the capacity given at init) */
+    int max_capacity;               /* Never grow beyond */
+    int high_watermark;             /* Percent: a put that leaves the queue this full doubles it */
+    int low_watermark;              /* Percent: a get that leaves the queue this empty counts as idle */
+    int shrink_after;               /* Consecutive idle gets before the capacity is halved */
+    int idle_gets;                  /* Current run of idle gets */
+    int peak_capacity;              /* Largest capacity reached */
+    long grows;                     /* Resize events, reported by consumer_producer_get_stats */
+    long shrinks;
+
+    /* Byte budget (CP_MODE_LOCKED only; guarded by lock). Items are sized as strlen + 1. */
+    size_t byte_budget;             /* Per-queue limit on bytes in flight (0 = count only items) */
+    size_t bytes_in_flight;         /* Bytes held by queued items */
+    size_t peak_bytes;              /* Largest bytes_in_flight observed */
+    cp_byte_budget_t* shared_budget;/* Optional budget shared with other queues (not owned) */
+    int shared_gate;                /* 1: puts wait for room in shared_budget; 0: they only charge it */
+
+    /* Control lanes (CP_MODE_LOCKED only; guarded by lock). Not bounded by capacity or byte budgets. */
+    cp_control_lane_t urgent_lane;  /* CP_CONTROL_URGENT messages, served before anything else */
+    cp_control_lane_t ordered_lane; /* CP_CONTROL_ORDERED messages, served once data_taken reaches 'after' */
+    size_t data_put;                /* Data items ever put */
+    size_t data_taken;              /* Data items ever taken */
+
+    /* Inline slots (CP_MODE_LOCKED only; guarded by lock). Short strings given to the *_copy puts
+     * live in the slab next to the ring; items[i] then points at slot i's payload. */
+    size_t inline_size;             /* Payload bytes per slot, terminator included (0 = off) */
+    char* inline_slab;              /* capacity * inline_size bytes */
+    long inlined;                   /* Items stored inline so far */
+
+    /* Overflow policy (CP_MODE_LOCKED only; guarded by lock) */
+    cp_overflow_t overflow;         /* What a put does when the item does not fit */
+    int sample_percent;             /* CP_OVERFLOW_SAMPLE: share of overflowing items kept */
+    cp_drop_callback_t on_drop;     /* Optional: told about every dropped item */
+    void* on_drop_arg;
+    long dropped_newest;            /* Drop counters, reported by consumer_producer_get_stats */
+    long dropped_oldest;
+    long dropped_sampled;
+
+    /* Item buffers the queue makes or frees itself (malloc/free unless consumer_producer_set_allocator) */
+    cp_alloc_fn item_alloc;
+    cp_free_fn item_free;
+    cp_size_fn item_size;           /* strlen + 1 unless consumer_producer_set_item_size */
+    cp_tag_get_fn item_tag_get;     /* Item flags and sequence number (NULL = items carry none) */
+    cp_tag_set_fn item_tag_set;
+
+    /* Instrumentation (off until consumer_producer_enable_instrumentation; costs nothing while off) */
+    int instrumented;               /* 1: count operations and time blocked calls */
+    cp_side_counters_t producer_counters;
+    cp_side_counters_t consumer_counters;
+    atomic_int peak_count;          /* Highest occupancy seen right after a put */
+
+    /* Credit-based flow control counters (consumer_producer_wait_credits; always on, cheap: once per grant) */
+    atomic_long credit_grants;      /* Grants handed out */
+    atomic_long credit_stalls;      /* Grants that had to wait for a credit */
+    atomic_llong credit_stall_ns;   /* Total time spent waiting for credits */
+
+    /* Readiness eventfds for poll/epoll-driven stages (-1 until consumer_producer_enable_events) */
+    int items_event_fd;             /* Readable while items (or finished) may be available */
+    int space_event_fd;             /* Readable while free slots may be available */
+    atomic_int items_armed;         /* A try_get found the queue empty: next put must notify */
+    atomic_int space_armed;         /* A try_put found the queue full: next get must notify */
+
+    /* CP_MODE_SPSC only: threads park on these monitors when the ring is truly full/empty */
+    monitor_t not_full_monitor;     /* Monitor for "not full" state */
+    monitor_t not_empty_monitor;    /* Monitor for "not empty" state */
+};
+
+/**
+ * Initialize a consumer-producer queue
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init(consumer_producer_t* queue, int capacity);
+
+/**
+ * Initialize a consumer-producer queue in a specific synchronization mode.
+ * CP_MODE_SPSC is only valid when exactly one thread calls put and exactly one thread calls get.
+ * CP_MODE_MPMC allows any number of threads on both sides without serializing them on one lock.
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @param mode Synchronization mode
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init_mode(consumer_producer_t* queue, int capacity, consumer_producer_mode_t mode);
+
+/**
+ * Initialize a consumer-producer queue on a specific backend, e.g. to A/B queue implementations
+ * per pipeline stage. Every public call works on every backend; the optional ones (CP_FEATURE_*)
+ * fail with an error on backends without the feature.
+ * @param queue Pointer to queue structure
+ * @param capacity Maximum number of items
+ * @param backend Backend to use (must outlive the queue; every hook must be set)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_init_backend(consumer_producer_t* queue, int capacity, const cp_backend_t* backend);
+
+/**
+ * Look up a built-in backend by name ("locked", "spsc", "mpmc" or "inline")
+ * @param name Backend name
+ * @return The backend, or NULL if there is none by that name
+ */
+const cp_backend_t* consumer_producer_backend(const char* name);
+
+/**
+ * Choose how blocked put/get calls wait. Call before producer and consumer threads start.
+ * CP_WAIT_SPIN trades CPU for wakeup latency: a waiter spins for up to spin_limit pause
+ * iterations and yields a few times before it sleeps. CP_WAIT_ADAPTIVE starts from the same
+ * budget and then sizes it from the observed wait times, dropping to plain parking when
+ * items arrive too rarely for spinning to pay off.
+ * @param queue Pointer to queue structure
+ * @param strategy Wait strategy
+ * @param spin_limit Maximum spin iterations (0 selects CP_SPIN_DEFAULT; ignored for CP_WAIT_PARK)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_wait_strategy(consumer_producer_t* queue, consumer_producer_wait_t strategy, int spin_limit);
+
+/**
+ * Let the queue grow and shrink between its initial capacity and max_capacity (CP_MODE_LOCKED only).
+ * A put that leaves the queue at or above high_pct percent occupancy doubles the capacity (up to
+ * max_capacity), so bursts are absorbed instead of stalling the producer. After shrink_after gets in a
+ * row that each leave the queue at or below low_pct percent occupancy, the capacity is halved (down
+ * to the initial capacity), so idle queues give the memory back. Resizes are counted in the stats.
+ * @param queue Pointer to queue structure
+ * @param max_capacity Upper bound (>= the initial capacity)
+ * @param high_pct High watermark in percent, 1..100 (0 selects CP_ELASTIC_HIGH_DEFAULT)
+ * @param low_pct Low watermark in percent, below half of high_pct (0 selects CP_ELASTIC_LOW_DEFAULT)
+ * @param shrink_after Idle gets before shrinking (0 selects CP_ELASTIC_SHRINK_AFTER_DEFAULT)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_elastic(consumer_producer_t* queue, int max_capacity,
+                                          int high_pct, int low_pct, int shrink_after);
+
+/**
+ * Initialize a byte budget that several queues can share
+ * @param budget Pointer to budget structure
+ * @param limit Bytes allowed in flight (> 0)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_budget_init(cp_byte_budget_t* budget, size_t limit);
+
+/**
+ * Destroy a shared byte budget. Every queue attached to it must be destroyed first.
+ * @param budget Pointer to budget structure
+ */
+void consumer_producer_budget_destroy(cp_byte_budget_t* budget);
+
+/**
+ * Bound the memory held by queued items instead of (in addition to) their count (CP_MODE_LOCKED only).
+ * A put waits while the item would push the queue past queue_bytes, or, for a gate queue, past the
+ * shared budget. An item larger than a whole budget is still admitted once the budget is empty, so
+ * nothing can wedge. Only the pipeline's entry queue should be a gate: a stage blocked on the shared
+ * budget while holding items that only it can drain would deadlock; inner queues just charge it.
+ * Call before producer and consumer threads start.
+ * @param queue Pointer to queue structure
+ * @param queue_bytes Per-queue byte limit (0 = none)
+ * @param shared Budget shared with other queues (NULL = none; must outlive the queue)
+ * @param gate 1 if puts wait for room in the shared budget, 0 if they only charge it
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_byte_budget(consumer_producer_t* queue, size_t queue_bytes,
+                                              cp_byte_budget_t* shared, int gate);
+
+/**
+ * Queue a control message in the high-priority lane (CP_MODE_LOCKED only). Never waits for room.
+ * Consumers receive, in this order: urgent controls (FIFO among themselves), then ordered
+ * controls and data interleaved in put order. So CP_CONTROL_URGENT overtakes every queued
+ * item, while CP_CONTROL_ORDERED only skips the wait for a free slot and still arrives after
+ * every item put before it; use it for anything whose meaning depends on the data ahead of it.
+ * @param queue Pointer to queue structure
+ * @param item Message to queue (queue takes ownership on success)
+ * @param order Delivery rule
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_control(consumer_producer_t* queue, const char* item, cp_control_order_t order);
+
+/**
+ * Choose what a put does when the item does not fit (CP_MODE_LOCKED only). Call before producer
+ * and consumer threads start. Every policy but CP_OVERFLOW_BLOCK keeps producers flowing when the
+ * consumer falls behind, at the cost of completeness: drops are counted in the stats and reported
+ * to on_drop. Dropped items count as accepted (put_count), and the queue frees those it owns.
+ * Control messages are never dropped. A gate queue whose shared byte budget is spent drops the new
+ * items under any policy but CP_OVERFLOW_BLOCK, since evicting its own items cannot free bytes held
+ * by the other queues. CP_OVERFLOW_SPILL is chosen through consumer_producer_set_spill; switching
+ * away from it fails while items are still on disk.
+ * @param queue Pointer to queue structure
+ * @param policy Overflow policy
+ * @param sample_percent CP_OVERFLOW_SAMPLE: share of overflowing items kept, 1..99 (0 = default)
+ * @param on_drop Optional callback for every dropped item (NULL = none)
+ * @param arg Passed to on_drop
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_overflow(consumer_producer_t* queue, cp_overflow_t policy, int sample_percent,
+                                           cp_drop_callback_t on_drop, void* arg);
+
+/**
+ * Spill items that do not fit to disk instead of blocking or dropping them (CP_MODE_LOCKED only;
+ * the overflow policy becomes CP_OVERFLOW_SPILL). Call before producer and consumer threads start.
+ * When the ring is full (or the byte budget spent), puts append the item to an unlinked temp file
+ * in dir, through CP_SPILL_BUFFER write buffers; gets read the items back in order as the ring
+ * drains. The file is written and read with the queue lock released, so other producers and
+ * consumers never wait for the disk. Memory stays bounded by the ring and four buffers, FIFO order
+ * holds, and spilled items count in the queue size until they are taken, so bursts far larger than
+ * the capacity are absorbed at disk speed.
+ * @param queue Pointer to queue structure
+ * @param dir Directory for the spill file (NULL = CP_SPILL_DIR_DEFAULT)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_spill(consumer_producer_t* queue, const char* dir);
+
+/**
+ * Give every slot an inline payload area (CP_MODE_LOCKED only). Call before producer and consumer
+ * threads start. Strings put through consumer_producer_put_copy(_batch) that fit, terminator
+ * included, are copied straight into the ring instead of being duplicated on the heap; longer ones
+ * fall back to a heap copy. Consumers that take them through consumer_producer_get_batch_copy
+ * receive them in their own scratch buffer, so short messages cost no malloc/free at all.
+ * Plain gets still work and hand out a heap copy of inline items.
+ * @param queue Pointer to queue structure
+ * @param slot_size Payload bytes per slot (CP_INLINE_MIN..CP_INLINE_MAX)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_inline(consumer_producer_t* queue, size_t slot_size);
+
+/**
+ * Allocate and free item buffers with the given functions instead of malloc and free (any mode).
+ * Call before any item is put. They back the copies made by the *_copy puts and by gets of inline
+ * items, items read back from a spill file, and the items the queue frees itself: dropped ones,
+ * spilled ones once buffered, and leftovers at destroy. Consumers free what they get with the
+ * matching free function, and items given to the owning puts must come from alloc (or be
+ * accepted by its free), since the queue may free them.
+ * @param queue Pointer to queue structure
+ * @param alloc Allocation function (NULL together with release = malloc/free)
+ * @param release Matching free function
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_allocator(consumer_producer_t* queue, cp_alloc_fn alloc, cp_free_fn release);
+
+/**
+ * Measure items with the given function instead of strlen (any mode), for items that know their
+ * own length. Every copy, inline slot, spill record and byte budget charge uses it.
+ * Call before any item is put.
+ * @param queue Pointer to queue structure
+ * @param size Function returning an item's bytes, NUL included (NULL = strlen + 1)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_item_size(consumer_producer_t* queue, cp_size_fn size);
+
+/**
+ * Keep a flags word and a sequence number per item across the spill file (any mode), for items
+ * that carry them beside their text. Spill records store what get reports, and set applies it to
+ * the item_alloc copy once its text is read back. Without them, read-back items carry none.
+ * Call before any item is put.
+ * @param queue Pointer to queue structure
+ * @param get Function reading an item's flags and sequence number (NULL together with set = none)
+ * @param set Function writing them to an item
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_set_item_tag(consumer_producer_t* queue, cp_tag_get_fn get, cp_tag_set_fn set);
+
+/**
+ * Copy a string into the queue (producer). Blocks if queue is full. The caller keeps ownership of str.
+ * Works in every mode; only queues with inline slots avoid the heap copy.
+ * @param queue Pointer to queue structure
+ * @param str String to copy
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_copy(consumer_producer_t* queue, const char* str);
+
+/**
+ * Copy several strings into the queue (producer), in order, with the batching of put_batch.
+ * @param queue Pointer to queue structure
+ * @param strs Strings to copy (the caller keeps ownership)
+ * @param count Number of strings
+ * @param put_count If not NULL, receives how many strings were queued
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_copy_batch(consumer_producer_t* queue, const char* const* strs, int count,
+                                             int* put_count);
+
+/**
+ * Prepare a consumer's scratch buffer for consumer_producer_get_batch_copy
+ * @param queue Queue the buffer will read from (its inline slots must be configured already)
+ * @param scratch Buffer to prepare
+ * @param slots Largest batch the consumer will take
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_scratch_init(const consumer_producer_t* queue, cp_scratch_t* scratch, int slots);
+
+/**
+ * Release a scratch buffer
+ * @param scratch Buffer to release
+ */
+void consumer_producer_scratch_destroy(cp_scratch_t* scratch);
+
+/**
+ * Does item point into the scratch buffer? Such items must not be freed.
+ * @param scratch Buffer passed to consumer_producer_get_batch_copy
+ * @param item Item it returned
+ * @return 1 if the item lives in the scratch buffer, 0 if the caller owns it
+ */
+int consumer_producer_scratch_owns(const cp_scratch_t* scratch, const char* item);
+
+/**
+ * Like consumer_producer_get_batch, but inline items are copied into scratch instead of the heap.
+ * Items inside scratch (consumer_producer_scratch_owns) stay valid until the next call with the same
+ * buffer and must not be freed; the caller owns the others.
+ * @param queue Pointer to queue structure
+ * @param out Receives the items
+ * @param max_items Capacity of out (at most scratch->slots)
+ * @param scratch Buffer prepared by consumer_producer_scratch_init for this queue
+ * @return Number of items removed, 0 if finished and drained, -1 on error
+ */
+int consumer_producer_get_batch_copy(consumer_producer_t* queue, char** out, int max_items, cp_scratch_t* scratch);
+
+/**
+ * Start counting puts/gets and timing blocked calls. Call before producer and consumer threads start.
+ * Blocked time covers spinning and sleeping alike, so it tells a stage starved on (or backed up
+ * behind) a queue apart from one that is busy in its own work.
+ * @param queue Pointer to queue structure
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_enable_instrumentation(consumer_producer_t* queue);
+
+/**
+ * Take a snapshot of the queue's capacity, occupancy, resize and contention counters
+ * @param queue Pointer to queue structure
+ * @param out Receives the snapshot
+ * @return 0 on success, -1 on error
+ */
+int consumer_producer_get_stats(consumer_producer_t* queue, cp_stats_t* out);
+
+/**
+ * Destroy a consumer-producer queue and free its resources
+ * @param queue Pointer to queue structure
+ */
+void consumer_producer_destroy(consumer_producer_t* queue);
+
+/**
+ * Add an item to the queue (producer). Blocks if queue is full.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put(consumer_producer_t* queue, const char* item);
+
+/**
+ * Remove an item from the queue (consumer) and returns it. Blocks if queue is empty.
+ * @param queue Pointer to queue structure
+ * @return String item or NULL if queue is empty
+ */
+char* consumer_producer_get(consumer_producer_t* queue);
+
+/**
+ * Add several items to the queue (producer), in order. Blocks while the queue is full.
+ * Items are inserted in as few lock acquisitions and wakeups as the free space allows.
+ * @param queue Pointer to queue structure
+ * @param items Strings to add (queue takes ownership of each item it accepts)
+ * @param count Number of items
+ * @param put_count If not NULL, receives how many items were accepted (the caller still owns the rest)
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count);
+
+/**
+ * Remove up to max_items items from the queue (consumer), oldest first. Blocks while the queue is empty,
+ * then takes everything available (up to max_items) at once.
+ * @param queue Pointer to queue structure
+ * @param out Receives the items (caller takes ownership)
+ * @param max_items Capacity of out
+ * @return Number of items removed, 0 if finished and drained, -1 on error
+ */
+int consumer_producer_get_batch(consumer_producer_t* queue, char** out, int max_items);
+
+/**
+ * Compute the absolute deadline that lies timeout_ms milliseconds from now, for the *_timed calls.
+ * Deadlines are CLOCK_MONOTONIC, so wall-clock changes do not stretch or cut timeouts.
+ * @param deadline Receives the deadline
+ * @param timeout_ms Relative timeout in milliseconds (negative counts as 0)
+ */
+void consumer_producer_deadline_after(struct timespec* deadline, long timeout_ms);
+
+/**
+ * Add an item if there is room right now (producer). Never blocks or spins.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership only on success)
+ * @return NULL on success, CP_ERR_TIMEOUT if the queue is full, other error message on failure
+ */
+const char* consumer_producer_try_put(consumer_producer_t* queue, const char* item);
+
+/**
+ * Add an item (producer), waiting at most until deadline for room.
+ * @param queue Pointer to queue structure
+ * @param item String to add (queue takes ownership only on success)
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return NULL on success, CP_ERR_TIMEOUT if the deadline passed, other error message on failure
+ */
+const char* consumer_producer_put_timed(consumer_producer_t* queue, const char* item, const struct timespec* deadline);
+
+/**
+ * Remove one item if one is available right now (consumer). Never blocks or spins.
+ * @param queue Pointer to queue structure
+ * @param out Receives the item (caller takes ownership)
+ * @return 1 if an item was removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the queue is empty
+ */
+int consumer_producer_try_get(consumer_producer_t* queue, char** out);
+
+/**
+ * Remove one item (consumer), waiting at most until deadline.
+ * @param queue Pointer to queue structure
+ * @param out Receives the item (caller takes ownership)
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return 1 if an item was removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the deadline passed
+ */
+int consumer_producer_get_timed(consumer_producer_t* queue, char** out, const struct timespec* deadline);
+
+/**
+ * Remove up to max_items items (consumer), waiting at most until deadline for the first one.
+ * Useful for time-bounded batching: whatever arrived by the deadline is returned at once.
+ * @param queue Pointer to queue structure
+ * @param out Receives the items (caller takes ownership)
+ * @param max_items Capacity of out
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return Number of items removed, 0 if finished and drained, -1 on error, CP_TIMEDOUT if the deadline passed
+ */
+int consumer_producer_get_batch_timed(consumer_producer_t* queue, char** out, int max_items,
+                                      const struct timespec* deadline);
+
+/**
+ * Create readiness eventfds so the queue can be multiplexed with other queues in one
+ * poll/epoll loop instead of blocking one thread per queue. Call before threads start.
+ *
+ * Both descriptors are eventfds and report readiness as POLLIN/EPOLLIN:
+ * - items fd: the queue went non-empty (or finished) since a try_get last found it empty
+ * - space fd: the queue went non-full since a try_put last found it full
+ * Readiness is a hint that is re-armed by the non-blocking calls: after the fd fires, call
+ * try_get (try_put) until it returns CP_TIMEDOUT (CP_ERR_TIMEOUT); only then is the fd
+ * guaranteed to fire again on the next transition. The queue owns the descriptors.
+ * @param queue Pointer to queue structure
+ * @return NULL on success, error message on failure
+ */
+const char* consumer_producer_enable_events(consumer_producer_t* queue);
+
+/**
+ * Get the eventfd that becomes readable when items are available
+ * @param queue Pointer to queue structure
+ * @return File descriptor, or -1 if events are not enabled
+ */
+int consumer_producer_items_fd(const consumer_producer_t* queue);
+
+/**
+ * Get the eventfd that becomes readable when free slots are available
+ * @param queue Pointer to queue structure
+ * @return File descriptor, or -1 if events are not enabled
+ */
+int consumer_producer_space_fd(const consumer_producer_t* queue);
+
+/**
+ * Signal that processing is finished
+ * @param queue Pointer to queue structure
+ */
+void consumer_producer_signal_finished(consumer_producer_t* queue);
+
+/**
+ * Wait for processing to be finished (finished was signaled and the queue is drained).
+ * Blocks without polling.
+ * @param queue Pointer to queue structure
+ * @return 0 on success, -1 on error
+ */
+int consumer_producer_wait_finished(consumer_producer_t* queue);
+
+/**
+ * Wait for processing to be finished, giving up at an absolute deadline (e.g. for watchdog shutdowns)
+ * @param queue Pointer to queue structure
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return 0 on success, -1 on error, CP_TIMEDOUT if the deadline passed first
+ */
+int consumer_producer_wait_finished_timed(consumer_producer_t* queue, const struct timespec* deadline);
+
+/**
+ * Credits the queue grants its producer: how many items a put could add right now without waiting.
+ * A producer that batches against credits never blocks in the middle of a put, so it can keep its
+ * own input queued (back-pressuring the stage before it) instead of sitting on items it already took.
+ * Exact for a sole producer; with several, they share the credits. Under a byte budget or a shared
+ * gate budget the room depends on item sizes, so at most one credit is granted: that single put may
+ * still wait for bytes, but never after the producer took several items. Shedding overflow policies
+ * grant the whole capacity, since their puts never wait.
+ * @param queue Pointer to queue structure
+ * @return Number of credits (0 if none or finished), -1 on error
+ */
+int consumer_producer_credits(consumer_producer_t* queue);
+
+/**
+ * Wait until the queue grants at least one credit (see consumer_producer_credits).
+ * Calls that had to wait are counted as credit stalls in the stats, with the time they waited.
+ * @param queue Pointer to queue structure
+ * @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+ * @return Number of credits (>0), -1 on error or after finished, CP_TIMEDOUT if the deadline passed first
+ */
+int consumer_producer_wait_credits(consumer_producer_t* queue, const struct timespec* deadline);
+
+/**
+ * Check if the queue is full
+ * @param queue Pointer to the queue structure
+ * @return 1 if full, 0 otherwise
+ */
+int queue_is_full(const consumer_producer_t* queue);
+
+/**
+ * Check if the queue is empty
+ * @param queue Pointer to the queue structure
+ * @return 1 if empty, 0 otherwise
+ */
+int queue_is_empty(const consumer_producer_t* queue);
+
+#endif /* CONSUMER_PRODUCER_H */
@@ -0,0 +1,165 @@
+#include "message.h"
+#include "buffer_pool.h"
+#include <string.h>
+
+/* A message is one pooled buffer: header first, text right behind it. That offset is what tells
+   a message from a plain pooled buffer, whose text always starts its buffer. */
+_Static_assert(sizeof(message_t) % sizeof(void*) == 0, "message text must stay pointer-aligned");
+
+char* message_alloc(size_t length)
+{
+    size_t total = sizeof(message_t) + length + 1;
+    if (total > BP_CLASS_MAX) {
+        return (char*)buffer_pool_alloc(length + 1);    // Too long for the pool: a plain malloc'd text
+    }
+    message_t* msg = (message_t*)buffer_pool_alloc(total);
+    if (msg == NULL || buffer_pool_block(msg) == NULL) {
+        return (char*)msg;                              // Pool range used up: plain malloc'd text
+    }
+    msg->length = length;
+    msg->capacity = buffer_pool_capacity(msg) - sizeof(message_t);
+    atomic_init(&msg->refs, 1);
+    msg->flags = 0;
+    msg->seq = 0;
+    return (char*)(msg + 1);
+}
+
+char* message_new(const char* text, size_t length)
+{
+    char* out = message_alloc(length);
+    if (out != NULL) {
+        memcpy(out, text, length);
+        out[length] = '\0';
+    }
+    return out;
+}
+
+message_t* message_of(const char* text)
+{
+    char* block = (char*)buffer_pool_block(text);
+    if (block == NULL || text - block != (ptrdiff_t)sizeof(message_t)) {
+        return NULL;
+    }
+    return (message_t*)block;
+}
+
+/* Carry a message's metadata over to its copy (if the copy is a message too) */
+static void message_copy_meta(const message_t* from, char* to)
+{
+    message_t* msg = message_of(to);
+    if (from != NULL && msg != NULL) {
+        msg->flags = from->flags;
+        msg->seq = from->seq;
+    }
+}
+
+char* message_dup(const char* text)
+{
+    message_t* msg = message_of(text);
+    char* copy = message_new(text, msg != NULL ? msg->length : strlen(text));
+    message_copy_meta(msg, copy);
+    return copy;
+}
+
+size_t message_length(const char* text)
+{
+    message_t* msg = message_of(text);
+    return msg != NULL ? msg->length : strlen(text);
+}
+
+void message_set_length(char* text, size_t length)
+{
+    message_t* msg = message_of(text);
+    if (msg != NULL) {
+        msg->length = length;
+    }
+}
+
+size_t message_capacity(const char* text)
+{
+    message_t* msg = message_of(text);
+    return msg != NULL ? msg->capacity : buffer_pool_capacity(text);
+}
+
+char* message_ref(char* text)
+{
+    message_t* msg = message_of(text);
+    if (msg == NULL) {
+        return message_dup(text);
+    }
+    atomic_fetch_add_explicit(&msg->refs, 1, memory_order_relaxed);
+    return text;
+}
+
+void message_release(void* text)
+{
+    message_t* msg = message_of((const char*)text);
+    if (msg == NULL) {
+        buffer_pool_free(text);
+        return;
+    }
+    // A sole holder skips the atomic update: nobody else can take a reference from under it
+    if (atomic_load_explicit(&msg->refs, memory_order_acquire) == 1 ||
+        atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) == 1) {
+        buffer_pool_free(msg);
+    }
+}
+
+char* message_writable(char* text, size_t capacity)
+{
+    message_t* msg = message_of(text);
+    size_t length;
+    if (msg != NULL) {
+        if (capacity <= msg->capacity && atomic_load_explicit(&msg->refs, memory_order_acquire) == 1) {
+            return text;
+        }
+        length = msg->length;
+    } else {
+        // A malloc'd text is taken to be exactly as long as its string
+        length = strlen(text);
+        size_t have = buffer_pool_capacity(text);
+        if (capacity <= (have != 0 ? have : length + 1)) {
+            return text;
+        }
+    }
+
+    // Shared, or out of room: continue in a private message
+    if (capacity < length + 1) {
+        capacity = length + 1;
+    }
+    char* copy = message_alloc(capacity - 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, text, length + 1);
+    message_set_length(copy, length);
+    message_copy_meta(msg, copy);
+    message_release(text);
+    return copy;
+}
+
+void* message_alloc_item(size_t bytes)
+{
+    return message_alloc(bytes > 0 ? bytes - 1 : 0);
+}
+
+size_t message_item_bytes(const char* item)
+{
+    return item != NULL ? message_length(item) + 1 : 0;
+}
+
+void message_item_tag(const char* item, unsigned int* flags, unsigned long* seq)
+{
+    message_t* msg = message_of(item);
+    *flags = msg != NULL ? msg->flags : 0;
+    *seq = msg != NULL ? msg->seq : 0;
+}
+
+void message_set_item_tag(char* item, unsigned int flags, unsigned long seq)
+{
+    message_t* msg = message_of(item);
+    if (msg != NULL) {
+        msg->flags = flags;
+        msg->seq = seq;
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Message envelope. A message is still handed around as the char* of its text, so every
+ * char*-based API keeps working; a header in front of the text, in the same pooled buffer,
+ * carries what the pipeline would otherwise re-derive or could not express at all: the length
+ * (no strlen per hop), the room left for in-place growth, a reference count (one buffer read by
+ * several holders) and a flags word and sequence number for metadata-driven fast paths.
+ *
+ * Strings that are not envelopes (literals, malloc'd or plain pooled buffers, queue scratch
+ * copies, texts too long for the pool) are accepted everywhere: message_of returns NULL for them
+ * and the functions below fall back to the string itself.
+ */
+
+/* Header placed right before a message's text */
+typedef struct
+{
+    size_t length;          /* Characters in the text, without the NUL */
+    size_t capacity;        /* Bytes the text may use, NUL included */
+    atomic_int refs;        /* Holders of the message; the last message_release frees it */
+    unsigned int flags;     /* Metadata bits for the stages; kept by dup and copy on write */
+    unsigned long seq;      /* Position in the stream, 0 = not numbered yet */
+} message_t;
+
+/**
+ * Allocate a message for length characters. The caller writes the text and its NUL.
+ * @param length Characters the text will have
+ * @return The message's text, or NULL when out of memory (texts too long for the pool come back
+ *         as plain buffers)
+ */
+char* message_alloc(size_t length);
+
+/**
+ * Copy length characters into a new message
+ * @param text Characters to copy (need not be NUL-terminated)
+ * @param length Number of characters
+ * @return The message's text, or NULL when out of memory
+ */
+char* message_new(const char* text, size_t length);
+
+/**
+ * Copy a string or message into a new message, keeping a message's flags and sequence number
+ * @param text String or message to copy
+ * @return The copy's text, or NULL when out of memory
+ */
+char* message_dup(const char* text);
+
+/**
+ * Header of a message
+ * @param text Text of a message, or any other string
+ * @return The header, or NULL if text is not a message
+ */
+message_t* message_of(const char* text);
+
+/**
+ * Length of a message's text, read from its header; strlen for other strings
+ * @param text Text of a message, or any other string
+ * @return Characters in the text
+ */
+size_t message_length(const char* text);
+
+/**
+ * Record a new length after rewriting a message's text (no-op for other strings)
+ * @param text Text of a message, or any other string
+ * @param length New number of characters (the caller wrote the NUL)
+ */
+void message_set_length(char* text, size_t length);
+
+/**
+ * Bytes a text may use in its buffer, NUL included
+ * @param text Text of a message, or any other string
+ * @return A message's capacity, a plain pooled buffer's size, or 0 if unknown
+ */
+size_t message_capacity(const char* text);
+
+/**
+ * Take another reference to a message, e.g. to hand it to a second holder without a copy.
+ * Other strings are copied instead, so the result always needs its own message_release.
+ * @param text Text of a message, or any other string
+ * @return text itself, or a copy (NULL when out of memory)
+ */
+char* message_ref(char* text);
+
+/**
+ * Drop a reference to a message and free it with the last one; other strings are freed
+ * like buffer_pool_free
+ * @param text Text of a message, a pooled or malloc'd buffer, or NULL
+ */
+void message_release(void* text);
+
+/**
+ * Get a text the caller may rewrite in place with room for capacity bytes: text itself if the
+ * caller is its only holder and it has the room, else a private copy that replaces the caller's
+ * reference (a message's flags and sequence number are kept)
+ * @param text Text of a message, a pooled or malloc'd buffer
+ * @param capacity Bytes needed, NUL included
+ * @return The writable text, or NULL when out of memory (text is left untouched)
+ */
+char* message_writable(char* text, size_t capacity);
+
+/**
+ * Queue allocator hook (consumer_producer_set_allocator): a message for an item of bytes bytes
+ * that the queue then fills, NUL included
+ * @param bytes Bytes of the item, NUL included
+ * @return The message's text, or NULL when out of memory
+ */
+void* message_alloc_item(size_t bytes);
+
+/**
+ * Queue item size hook (consumer_producer_set_item_size): bytes of an item, NUL included
+ * @param item Text of a message, or any other string
+ * @return message_length(item) + 1
+ */
+size_t message_item_bytes(const char* item);
+
+/**
+ * Queue item tag hook (consumer_producer_set_item_tag): a message's flags and sequence number,
+ * 0 for other strings
+ * @param item Text of a message, or any other string
+ * @param flags Receives the flags
+ * @param seq Receives the sequence number
+ */
+void message_item_tag(const char* item, unsigned int* flags, unsigned long* seq);
+
+/**
+ * Queue item tag hook (consumer_producer_set_item_tag): give a message flags and a sequence
+ * number (no-op for other strings)
+ * @param item Text of a message, or any other string
+ * @param flags Flags to set
+ * @param seq Sequence number to set
+ */
+void message_set_item_tag(char* item, unsigned int flags, unsigned long seq);
+
+#endif /* MESSAGE_H */
@@ -1,171 +1,471 @@
-#include "monitor.h"
-#include <stdlib.h>     
-
-int monitor_init(monitor_t* monitor)
-{
-    // Check for NULL pointer
-    if (monitor == NULL)
-    {
-        return -1;
-    }
-
-    // Check if monitor is already initialized
-    if (monitor->initialized == 1)
-    {
-        return -1;
-    }
-
-    // Reset internal values
-    monitor->signaled = 0;
-    monitor->initialized = 0; // Will set to 1 only if init is successful
-
-    // Initialize mutex
-    int res = pthread_mutex_init(&monitor->mutex, NULL);
-    if (res != 0)
-    {
-        return -1;
-    }
-
-    // Initialize condition variable
-    res = pthread_cond_init(&monitor->condition, NULL);
-    if (res != 0)
-    {
-        pthread_mutex_destroy(&monitor->mutex);
-        return -1;
-    }
-
-    // Mark as successfully initialized
-    monitor->initialized = 1;
-
-    // Return success
-    return 0;
-}
-
-/** 
-* Destroy a monitor and free its resources
-* @param monitor Pointer to monitor structure
-*/
-void monitor_destroy(monitor_t* monitor)
-{
-    // Check for NULL pointer
-    if (monitor == NULL) {
-        return;
-    }
-
-    // Check if monitor was initialized
-    if (monitor->initialized == 0) {
-        return;
-    }
-
-    // Free condition variable resource
-    pthread_cond_destroy(&monitor->condition);
-
-    // Free mutex resource
-    pthread_mutex_destroy(&monitor->mutex);
-
-    // Reset internal values
-    monitor->signaled = 0;
-    monitor->initialized = 0;
-}
-
-
-
-/**
- * Signal a monitor (sets the monitor state)
- * @param monitor Pointer to monitor structure
- */
-void monitor_signal(monitor_t* monitor)
-{
-    // Check for NULL pointer
-    if (monitor == NULL) {
-        return;
-    }
-
-    // Check if monitor was initialized
-    if (monitor->initialized == 0) {
-        return;
-    }
-
-    // Attempt to lock the mutex
-    if (pthread_mutex_lock(&monitor->mutex) != 0) {
-        // If lock fails, exit function without making changes
-        return;
-    }
-
-    // Update the signaled state (set to 1 always, even if already 1)
-    monitor->signaled = 1;
-
-    // Send broadcast signal to wake all waiting threads
-    pthread_cond_broadcast(&monitor->condition);
-
-    // Unlock the mutex
-    pthread_mutex_unlock(&monitor->mutex);
-}
-
-/**
- * Reset a monitor (clears the monitor state)
- * @param monitor Pointer to monitor structure
- */
-void monitor_reset(monitor_t* monitor)
-{
-    // Check for NULL pointer
-    if (monitor == NULL) {
-        return;
-    }
-
-    // Check if monitor was initialized
-    if (monitor->initialized == 0) {
-        return;
-    }
-
-    // Attempt to lock the mutex
-    if (pthread_mutex_lock(&monitor->mutex) != 0) {
-        return; // Exit if lock fails
-    }
-
-    // Reset the signaled state
-    monitor->signaled = 0;
-
-    // Attempt to unlock the mutex
-    pthread_mutex_unlock(&monitor->mutex);
-}
-
-/**
-* Wait for a monitor to be signaled (infinite wait)
-* @param monitor Pointer to monitor structure
-* @return 0 on success, -1 on error
-*/
-int monitor_wait(monitor_t* monitor)
-{
-    // Check for NULL pointer
-    if (monitor == NULL) {
-        return -1;
-    }
-
-    // Check if monitor was initialized
-    if (monitor->initialized == 0) {
-        return -1;
-    }
-
-    // Attempt to lock the mutex
-    if (pthread_mutex_lock(&monitor->mutex) != 0) {
-        return -1;
-    }
-
-    // Wait for a signal (handle spurious wakeups)
-    while (monitor->signaled == 0) {
-        if (pthread_cond_wait(&monitor->condition, &monitor->mutex) != 0) {
-            // Unlock mutex before returning in case of error
-            pthread_mutex_unlock(&monitor->mutex);
-            return -1;
-        }
-    }
-
-    // Attempt to unlock the mutex
-    if (pthread_mutex_unlock(&monitor->mutex) != 0) {
-        return -1;
-    }
-
-    // Return success
-    return 0;
-}
\ No newline at end of file
+#ifdef MONITOR_USE_FUTEX
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* syscall() */
+#endif
+#elif !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L     /* pthread_condattr_setclock */
+#endif
+
+#include "monitor.h"
+#include <stdlib.h>     
+
+#ifdef MONITOR_USE_FUTEX
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* ---------------------------------------------------------------------------
+ * futex(2) backend
+ *
+ * 'signaled' is the futex word. A waiter announces itself in 'waiters' before
+ * sleeping on the word while it is 0; a signaler flips the word to 1 and only
+ * enters the kernel if that was a 0 -> 1 transition with someone announced.
+ * Both sides use seq_cst operations, so "announce, then check the word" and
+ * "set the word, then check announcements" can never both miss each other,
+ * and FUTEX_WAIT itself re-checks the word atomically in the kernel.
+ * ------------------------------------------------------------------------- */
+
+static int futex_wait(atomic_int* word, int expected)
+{
+    return (int)syscall(SYS_futex, (int*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+/* Like futex_wait, but with an absolute CLOCK_MONOTONIC deadline (NULL = none) */
+static int futex_wait_until(atomic_int* word, int expected, const struct timespec* deadline)
+{
+    return (int)syscall(SYS_futex, (int*)word, FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, NULL,
+                        FUTEX_BITSET_MATCH_ANY);
+}
+
+static void futex_wake_all(atomic_int* word)
+{
+    syscall(SYS_futex, (int*)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+int monitor_init(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return -1;
+    }
+
+    // Check if monitor is already initialized
+    if (monitor->initialized == 1) {
+        return -1;
+    }
+
+    // No kernel object to create: the state words are all there is
+    atomic_init(&monitor->signaled, 0);
+    atomic_init(&monitor->waiters, 0);
+    atomic_init(&monitor->waits, 0);
+    atomic_init(&monitor->sleeps, 0);
+    atomic_init(&monitor->spurious_wakeups, 0);
+    monitor->initialized = 1;
+    return 0;
+}
+
+void monitor_destroy(monitor_t* monitor)
+{
+    // Check for NULL pointer or uninitialized monitor
+    if (monitor == NULL || monitor->initialized == 0) {
+        return;
+    }
+
+    // Reset internal values
+    atomic_store(&monitor->signaled, 0);
+    atomic_store(&monitor->waiters, 0);
+    monitor->initialized = 0;
+}
+
+void monitor_signal(monitor_t* monitor)
+{
+    // Check for NULL pointer or uninitialized monitor
+    if (monitor == NULL || monitor->initialized == 0) {
+        return;
+    }
+
+    // Already signaled: nobody can be sleeping on a 1, nothing else to do
+    if (atomic_exchange(&monitor->signaled, 1) == 1) {
+        return;
+    }
+
+    // Fast path: no waiters, no syscall
+    if (atomic_load(&monitor->waiters) > 0) {
+        futex_wake_all(&monitor->signaled);
+    }
+}
+
+void monitor_reset(monitor_t* monitor)
+{
+    // Check for NULL pointer or uninitialized monitor
+    if (monitor == NULL || monitor->initialized == 0) {
+        return;
+    }
+
+    atomic_store(&monitor->signaled, 0);
+}
+
+int monitor_wait(monitor_t* monitor)
+{
+    // Check for NULL pointer or uninitialized monitor
+    if (monitor == NULL || monitor->initialized == 0) {
+        return -1;
+    }
+
+    // Fast path: the signal is remembered
+    atomic_fetch_add_explicit(&monitor->waits, 1, memory_order_relaxed);
+    if (atomic_load(&monitor->signaled) == 1) {
+        return 0;
+    }
+
+    // Announce ourselves, then sleep only while the word still reads 0
+    atomic_fetch_add_explicit(&monitor->sleeps, 1, memory_order_relaxed);
+    atomic_fetch_add(&monitor->waiters, 1);
+    int woke = 0;
+    while (atomic_load(&monitor->signaled) == 0) {
+        if (woke) {
+            atomic_fetch_add_explicit(&monitor->spurious_wakeups, 1, memory_order_relaxed);
+        }
+        if (futex_wait(&monitor->signaled, 0) != 0 && errno != EAGAIN && errno != EINTR) {
+            atomic_fetch_sub(&monitor->waiters, 1);
+            return -1;
+        }
+        woke = 1;
+    }
+    atomic_fetch_sub(&monitor->waiters, 1);
+
+    return 0;
+}
+
+int monitor_timedwait(monitor_t* monitor, const struct timespec* deadline)
+{
+    // Check for NULL pointer or uninitialized monitor
+    if (monitor == NULL || monitor->initialized == 0) {
+        return -1;
+    }
+    if (deadline == NULL) {
+        return monitor_wait(monitor);
+    }
+
+    // Fast path: the signal is remembered
+    atomic_fetch_add_explicit(&monitor->waits, 1, memory_order_relaxed);
+    if (atomic_load(&monitor->signaled) == 1) {
+        return 0;
+    }
+
+    // Same protocol as monitor_wait; the kernel enforces the deadline
+    atomic_fetch_add_explicit(&monitor->sleeps, 1, memory_order_relaxed);
+    atomic_fetch_add(&monitor->waiters, 1);
+    int woke = 0;
+    while (atomic_load(&monitor->signaled) == 0) {
+        if (woke) {
+            atomic_fetch_add_explicit(&monitor->spurious_wakeups, 1, memory_order_relaxed);
+        }
+        woke = 1;
+        if (futex_wait_until(&monitor->signaled, 0, deadline) != 0) {
+            if (errno == ETIMEDOUT) {
+                atomic_fetch_sub(&monitor->waiters, 1);
+                return atomic_load(&monitor->signaled) == 1 ? 0 : 1;
+            }
+            if (errno != EAGAIN && errno != EINTR) {
+                atomic_fetch_sub(&monitor->waiters, 1);
+                return -1;
+            }
+        }
+    }
+    atomic_fetch_sub(&monitor->waiters, 1);
+
+    return 0;
+}
+
+int monitor_get_stats(monitor_t* monitor, monitor_stats_t* out)
+{
+    // Check for NULL pointers or uninitialized monitor
+    if (monitor == NULL || out == NULL || monitor->initialized == 0) {
+        return -1;
+    }
+
+    out->waits = atomic_load_explicit(&monitor->waits, memory_order_relaxed);
+    out->sleeps = atomic_load_explicit(&monitor->sleeps, memory_order_relaxed);
+    out->spurious_wakeups = atomic_load_explicit(&monitor->spurious_wakeups, memory_order_relaxed);
+    return 0;
+}
+
+#else /* pthread backend */
+
+#include <errno.h>
+
+int monitor_init(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL)
+    {
+        return -1;
+    }
+
+    // Check if monitor is already initialized
+    if (monitor->initialized == 1)
+    {
+        return -1;
+    }
+
+    // Reset internal values
+    monitor->signaled = 0;
+    atomic_init(&monitor->waits, 0);
+    atomic_init(&monitor->sleeps, 0);
+    atomic_init(&monitor->spurious_wakeups, 0);
+    monitor->initialized = 0; // Will set to 1 only if init is successful
+
+    // Initialize mutex
+    int res = pthread_mutex_init(&monitor->mutex, NULL);
+    if (res != 0)
+    {
+        return -1;
+    }
+
+    // Initialize condition variable (timed waits use CLOCK_MONOTONIC deadlines)
+    pthread_condattr_t attr;
+    res = pthread_condattr_init(&attr);
+    if (res == 0)
+    {
+        res = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        if (res == 0)
+        {
+            res = pthread_cond_init(&monitor->condition, &attr);
+        }
+        pthread_condattr_destroy(&attr);
+    }
+    if (res != 0)
+    {
+        pthread_mutex_destroy(&monitor->mutex);
+        return -1;
+    }
+
+    // Mark as successfully initialized
+    monitor->initialized = 1;
+
+    // Return success
+    return 0;
+}
+
+/** 
+* Destroy a monitor and free its resources
+* @param monitor Pointer to monitor structure
+*/
+void monitor_destroy(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return;
+    }
+
+    // Free condition variable resource
+    pthread_cond_destroy(&monitor->condition);
+
+    // Free mutex resource
+    pthread_mutex_destroy(&monitor->mutex);
+
+    // Reset internal values
+    monitor->signaled = 0;
+    monitor->initialized = 0;
+}
+
+
+
+/**
+ * Signal a monitor (sets the monitor state)
+ * @param monitor Pointer to monitor structure
+ */
+void monitor_signal(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return;
+    }
+
+    // Attempt to lock the mutex
+    if (pthread_mutex_lock(&monitor->mutex) != 0) {
+        // If lock fails, exit function without making changes
+        return;
+    }
+
+    // Update the signaled state (set to 1 always, even if already 1)
+    monitor->signaled = 1;
+
+    // Send broadcast signal to wake all waiting threads
+    pthread_cond_broadcast(&monitor->condition);
+
+    // Unlock the mutex
+    pthread_mutex_unlock(&monitor->mutex);
+}
+
+/**
+ * Reset a monitor (clears the monitor state)
+ * @param monitor Pointer to monitor structure
+ */
+void monitor_reset(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return;
+    }
+
+    // Attempt to lock the mutex
+    if (pthread_mutex_lock(&monitor->mutex) != 0) {
+        return; // Exit if lock fails
+    }
+
+    // Reset the signaled state
+    monitor->signaled = 0;
+
+    // Attempt to unlock the mutex
+    pthread_mutex_unlock(&monitor->mutex);
+}
+
+/**
+* Wait for a monitor to be signaled (infinite wait)
+* @param monitor Pointer to monitor structure
+* @return 0 on success, -1 on error
+*/
+int monitor_wait(monitor_t* monitor)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return -1;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return -1;
+    }
+
+    // Attempt to lock the mutex
+    if (pthread_mutex_lock(&monitor->mutex) != 0) {
+        return -1;
+    }
+
+    // Wait for a signal (handle spurious wakeups)
+    atomic_fetch_add_explicit(&monitor->waits, 1, memory_order_relaxed);
+    if (monitor->signaled == 0) {
+        atomic_fetch_add_explicit(&monitor->sleeps, 1, memory_order_relaxed);
+    }
+    while (monitor->signaled == 0) {
+        if (pthread_cond_wait(&monitor->condition, &monitor->mutex) != 0) {
+            // Unlock mutex before returning in case of error
+            pthread_mutex_unlock(&monitor->mutex);
+            return -1;
+        }
+        if (monitor->signaled == 0) {
+            atomic_fetch_add_explicit(&monitor->spurious_wakeups, 1, memory_order_relaxed);
+        }
+    }
+
+    // Attempt to unlock the mutex
+    if (pthread_mutex_unlock(&monitor->mutex) != 0) {
+        return -1;
+    }
+
+    // Return success
+    return 0;
+}
+
+/**
+* Wait for a monitor to be signaled, giving up at an absolute deadline
+* @param monitor Pointer to monitor structure
+* @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+* @return 0 on success, 1 if the deadline passed first, -1 on error
+*/
+int monitor_timedwait(monitor_t* monitor, const struct timespec* deadline)
+{
+    // Check for NULL pointer
+    if (monitor == NULL) {
+        return -1;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return -1;
+    }
+
+    if (deadline == NULL) {
+        return monitor_wait(monitor);
+    }
+
+    // Attempt to lock the mutex
+    if (pthread_mutex_lock(&monitor->mutex) != 0) {
+        return -1;
+    }
+
+    // Wait for a signal or the deadline (handle spurious wakeups)
+    int result = 0;
+    atomic_fetch_add_explicit(&monitor->waits, 1, memory_order_relaxed);
+    if (monitor->signaled == 0) {
+        atomic_fetch_add_explicit(&monitor->sleeps, 1, memory_order_relaxed);
+    }
+    while (monitor->signaled == 0) {
+        int rc = pthread_cond_timedwait(&monitor->condition, &monitor->mutex, deadline);
+        if (rc == ETIMEDOUT) {
+            result = (monitor->signaled == 1) ? 0 : 1;
+            break;
+        }
+        if (rc != 0) {
+            // Unlock mutex before returning in case of error
+            pthread_mutex_unlock(&monitor->mutex);
+            return -1;
+        }
+        if (monitor->signaled == 0) {
+            atomic_fetch_add_explicit(&monitor->spurious_wakeups, 1, memory_order_relaxed);
+        }
+    }
+
+    // Attempt to unlock the mutex
+    if (pthread_mutex_unlock(&monitor->mutex) != 0) {
+        return -1;
+    }
+
+    return result;
+}
+
+/**
+* Take a snapshot of the monitor's contention counters
+* @param monitor Pointer to monitor structure
+* @param out Receives the counters
+* @return 0 on success, -1 on error
+*/
+int monitor_get_stats(monitor_t* monitor, monitor_stats_t* out)
+{
+    // Check for NULL pointers
+    if (monitor == NULL || out == NULL) {
+        return -1;
+    }
+
+    // Check if monitor was initialized
+    if (monitor->initialized == 0) {
+        return -1;
+    }
+
+    // Counters are atomics: no need to take the mutex for a snapshot
+    out->waits = atomic_load_explicit(&monitor->waits, memory_order_relaxed);
+    out->sleeps = atomic_load_explicit(&monitor->sleeps, memory_order_relaxed);
+    out->spurious_wakeups = atomic_load_explicit(&monitor->spurious_wakeups, memory_order_relaxed);
+    return 0;
+}
+
+#endif /* MONITOR_USE_FUTEX */
@@ -1,46 +1,95 @@
-
-#include <pthread.h>
-
-/**
-* Monitor structure that can remember its state
-* This solves the race condition where signals sent before waiting are lost
-*/
-typedef struct
-{
-pthread_mutex_t mutex; /* Mutex for thread safety */
-pthread_cond_t condition; /* Condition variable */
-int signaled; /* Flag to remember if monitor was signaled */
-int initialized;
-} monitor_t;
-
-/**
-* Initialize a monitor
-* @param monitor Pointer to monitor structure
-* @return 0 on success, -1 on failure
-*/
-int monitor_init(monitor_t* monitor);
-
-/** 
-* Destroy a monitor and free its resources
-* @param monitor Pointer to monitor structure
-*/
-void monitor_destroy(monitor_t* monitor);
-
-/**
-* Signal a monitor (sets the monitor state)
-* @param monitor Pointer to monitor structure
-*/
-void monitor_signal(monitor_t* monitor);
-
-/**
-* Reset a monitor (clears the monitor state)
-* @param monitor Pointer to monitor structure
-*/
-void monitor_reset(monitor_t* monitor);
-
-/**
-* Wait for a monitor to be signaled (infinite wait)
-* @param monitor Pointer to monitor structure
-* @return 0 on success, -1 on error
-*/
-int monitor_wait(monitor_t* monitor);
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/**
+* Monitor contention counters snapshot (monitor_get_stats)
+*/
+typedef struct
+{
+long waits; /* monitor_wait/monitor_timedwait calls */
+long sleeps; /* Calls that found the monitor unsignaled and had to block */
+long spurious_wakeups; /* Wakeups that found the monitor still unsignaled */
+} monitor_stats_t;
+
+#ifdef MONITOR_USE_FUTEX
+
+/**
+* Monitor structure that can remember its state (Linux futex(2) backend)
+* Build with -DMONITOR_USE_FUTEX to select it. The signaled flag is itself the futex word:
+* signal/reset/wait never take a lock, and FUTEX_WAKE is only issued when a thread sleeps.
+*/
+typedef struct
+{
+atomic_int signaled; /* Flag to remember if monitor was signaled (futex word: 0 or 1) */
+atomic_int waiters; /* Threads that may be sleeping in monitor_wait */
+int initialized;
+atomic_long waits; /* Counters reported by monitor_get_stats (relaxed) */
+atomic_long sleeps;
+atomic_long spurious_wakeups;
+} monitor_t;
+#else
+/**
+* Monitor structure that can remember its state
+* This solves the race condition where signals sent before waiting are lost
+*/
+typedef struct
+{
+pthread_mutex_t mutex; /* Mutex for thread safety */
+pthread_cond_t condition; /* Condition variable */
+int signaled; /* Flag to remember if monitor was signaled */
+int initialized;
+atomic_long waits; /* Counters reported by monitor_get_stats (relaxed) */
+atomic_long sleeps;
+atomic_long spurious_wakeups;
+} monitor_t;
+#endif
+
+/**
+* Initialize a monitor
+* @param monitor Pointer to monitor structure
+* @return 0 on success, -1 on failure
+*/
+int monitor_init(monitor_t* monitor);
+
+/** 
+* Destroy a monitor and free its resources
+* @param monitor Pointer to monitor structure
+*/
+void monitor_destroy(monitor_t* monitor);
+
+/**
+* Signal a monitor (sets the monitor state)
+* @param monitor Pointer to monitor structure
+*/
+void monitor_signal(monitor_t* monitor);
+
+/**
+* Reset a monitor (clears the monitor state)
+* @param monitor Pointer to monitor structure
+*/
+void monitor_reset(monitor_t* monitor);
+
+/**
+* Wait for a monitor to be signaled (infinite wait)
+* @param monitor Pointer to monitor structure
+* @return 0 on success, -1 on error
+*/
+int monitor_wait(monitor_t* monitor);
+
+/**
+* Wait for a monitor to be signaled, giving up at an absolute deadline
+* @param monitor Pointer to monitor structure
+* @param deadline Absolute CLOCK_MONOTONIC time (NULL waits forever)
+* @return 0 on success, 1 if the deadline passed first, -1 on error
+*/
+int monitor_timedwait(monitor_t* monitor, const struct timespec* deadline);
+
+/**
+* Take a snapshot of the monitor's contention counters
+* @param monitor Pointer to monitor structure
+* @param out Receives the counters
+* @return 0 on success, -1 on error
+*/
+int monitor_get_stats(monitor_t* monitor, monitor_stats_t* out);
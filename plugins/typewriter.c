@@ -15,11 +15,6 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    /* Do not print for the termination token; pass it through unchanged */
-    if (is_end(input)) {
-        return input;
-    }
-
     const unsigned int DELAY_US = 100000U;  /* 100 ms */
     const char *prefix = "[typewriter] ";
 
@@ -34,7 +29,7 @@ const char* plugin_transform(const char* input)
     }
 
     /* Type the input character-by-character */
-    size_t len = strlen(input);
+    size_t len = message_length(input);
     for (size_t i = 0; i < len; ++i) {
         if (fputc((unsigned char)input[i], stdout) == EOF) {
             /* best-effort: stop on I/O error */
@@ -63,3 +58,15 @@ const char* plugin_init(int queue_size)
 {
     return common_plugin_init(plugin_transform, "typewriter", queue_size);
 }
+
+/**
+ * Create and start a new instance of the typewriter plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init(plugin_transform, "typewriter", queue_size, queue_backend, out_instance);
+}
@@ -1,5 +1,6 @@
 #include "plugin_common.h"
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -15,19 +16,14 @@ const char* plugin_transform(const char* input)
         return NULL;
     }
 
-    // Do not transform the termination token; pass it through unchanged
-    if (is_end(input)) {
-        return input;
-    }
-
     // Empty string is a no-op; return as-is
-    size_t len = strlen(input);
+    size_t len = message_length(input);
     if (len == 0) {
         return input;
     }
 
-    // Allocate output buffer (len + 1 for the terminating NUL)
-    char* out = (char*)malloc(len + 1);
+    // Allocate the output message (len characters; we write them and the NUL)
+    char* out = message_alloc(len);
     if (out == NULL) {
         // return original input without crashing
         return input;
@@ -47,6 +43,70 @@ const char* plugin_transform(const char* input)
     return out;
 }
 
+/**
+ * In-place form of plugin_transform: uppercases the line in its own buffer
+ * @param buf Line to transform (*len characters plus NUL)
+ * @param len Line length (unchanged)
+ * @param capacity Bytes available in buf (unused: the length never changes)
+ * @return 0 on success, -1 on invalid input
+ */
+long plugin_transform_inplace(char* buf, size_t* len, size_t capacity)
+{
+    (void)capacity;
+    if (buf == NULL || len == NULL) {
+        return -1;
+    }
+
+    // Convert ASCII lowercase letters to uppercase; leave other chars as-is
+    for (size_t i = 0; i < *len; ++i) {
+        unsigned char ch = (unsigned char)buf[i];
+        if (ch >= 'a' && ch <= 'z') {
+            buf[i] = (char)('A' + (ch - 'a'));
+        }
+    }
+    return 0;
+}
+
+/**
+ * Batch form of plugin_transform: uppercases every line of the batch in one pass over the arena.
+ * Offsets do not change, so the arena is converted as one string, eight bytes per step: each byte
+ * of a word is tested for 'a'..'z' with carry-free additions on its low seven bits, and the 0x20
+ * bit of the matching bytes is cleared.
+ * @param in Lines to transform
+ * @param out Receives the uppercased lines
+ * @return 0 on success, -1 on invalid input, or the capacity it needs
+ */
+long plugin_transform_batch(const plugin_batch_t* in, plugin_batch_t* out)
+{
+    if (in == NULL || out == NULL) {
+        return -1;
+    }
+    size_t bytes = in->offsets[in->count];
+    if (out->capacity < bytes) {
+        return (long)bytes;
+    }
+
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, in->data + i, sizeof(word));
+        uint64_t low7 = word & ~high;
+        uint64_t from_a = low7 + (0x80 - 'a') * ones;       // High bit set where the byte is >= 'a'
+        uint64_t past_z = low7 + (0x80 - 'z' - 1) * ones;   // High bit set where the byte is > 'z'
+        uint64_t lower = (from_a ^ past_z) & ~word & high;  // 'a'..'z', and not a byte >= 0x80
+        word ^= lower >> 2;
+        memcpy(out->data + i, &word, sizeof(word));
+    }
+    for (; i < bytes; ++i) {
+        unsigned char ch = (unsigned char)in->data[i];
+        out->data[i] = (ch >= 'a' && ch <= 'z') ? (char)('A' + (ch - 'a')) : (char)ch;
+    }
+    memcpy(out->offsets, in->offsets, (size_t)(in->count + 1) * sizeof(size_t));
+    return 0;
+}
+
 /**
  * Initialize the uppercaser plugin
  * @param queue_size Maximum number of items that can be queued
@@ -54,5 +114,19 @@ const char* plugin_transform(const char* input)
  */
 const char* plugin_init(int queue_size)
 {
-    return common_plugin_init(plugin_transform, "uppercaser", queue_size);
+    return common_plugin_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch, "uppercaser",
+                                    queue_size);
+}
+
+/**
+ * Create and start a new instance of the uppercaser plugin
+ * @param queue_size Maximum number of items that can be queued
+ * @param queue_backend Queue backend name (NULL or "" = ANALYZER_QUEUE_MODE)
+ * @param out_instance Receives the instance handle on success
+ * @return NULL on success, error message on failure
+ */
+const char* plugin_instance_init(int queue_size, const char* queue_backend, void** out_instance)
+{
+    return common_plugin_instance_init_batch(plugin_transform, plugin_transform_inplace, plugin_transform_batch,
+                                             "uppercaser", queue_size, queue_backend, out_instance);
 }
@@ -3,7 +3,7 @@
 # Notes:
 # - Does NOT build the project; assumes ./output/analyzer and plugins already exist.
 # - Focuses on queue backpressure and order preservation under concurrency.
-# - No duplicate plugin instances are used (project doesn't support duplicates).
+# - No duplicate plugin instances are used (duplicates are covered in edge_tests.sh).
 
 set -u
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
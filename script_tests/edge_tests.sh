@@ -387,6 +387,51 @@ EOF
   pass "Long chain with empty and single-char inputs"
 }
 
+test_edge_duplicate_plugins_in_chain() {
+  # The same .so several times in one chain: each stage runs its own plugin instance
+  run_analyzer 3 rotator rotator uppercaser logger rotator logger <<'EOF'
+abcd
+xy
+<END>
+EOF
+  # The two loggers run concurrently: require every line, not an order between them
+  assert_stdout_has_line "[logger] CDAB"
+  assert_stdout_has_line "[logger] YX"
+  assert_stdout_has_line "[logger] BCDA"
+  assert_stdout_has_line "[logger] XY"
+  assert_shutdown_line
+  assert_stderr_empty
+  assert_exit_code_eq 0
+
+  pass "Duplicate plugins in one chain run as independent stages"
+}
+
+# ---------- Edge 15c: a stage served by a worker pool keeps the line order ----------
+test_edge_stage_workers_keep_order() {
+  local input="" expected=""
+  for i in $(seq 1 300); do
+    input+="w${i}"$'\n'
+    expected+="[logger] W${i}"$'\n'
+  done
+  expected+="Pipeline shutdown complete"
+  # Flipping twice gives the line back; the second flipper and the uppercaser run 4 workers each
+  ANALYZER_STAGE_WORKERS=1,4,4,1 run_analyzer 4 flipper flipper uppercaser logger <<<"${input}<END>"
+  assert_stdout_equals "$expected"
+  assert_stderr_empty
+  assert_exit_code_eq 0
+
+  ANALYZER_STAGE_WORKERS=1,0 run_analyzer 4 uppercaser logger <<<"x"$'\n'"<END>"
+  assert_exit_code_eq 2
+
+  # The sink prints in its transform: it has no reorder buffer after it, so it cannot be pooled
+  ANALYZER_STAGE_WORKERS=1,4 run_analyzer 4 uppercaser logger <<<"x"$'\n'"<END>"
+  assert_exit_code_eq 2
+  ANALYZER_STAGE_WORKERS=4 run_analyzer 4 logger <<<"x"$'\n'"<END>"
+  assert_exit_code_eq 2
+
+  pass "Worker pools release lines in input order; invalid worker counts and pooled sinks are rejected"
+}
+
 # ---------- Edge 16: STDOUT hygiene (only pipeline output) ----------
 test_edge_stdout_hygiene_again() {
   # Case A: uppercaser + logger -> exactly two lines
@@ -577,6 +622,8 @@ test_edge_uppercaser_nonalpha
 test_edge_punct_and_spaces_transforms
 test_edge_many_lines_sequence
 test_edge_long_chain_empty_and_single
+test_edge_duplicate_plugins_in_chain
+test_edge_stage_workers_keep_order
 test_edge_stdout_hygiene_again
 test_end_precision
 test_input_after_end_ignored
@@ -2,7 +2,7 @@
 # stress_robustness_tests.sh — Stress & Robustness tests (1–5)
 # Notes:
 # - Does NOT build the project; assumes ./output/analyzer and plugins already exist.
-# - No duplicate plugin instances are used.
+# - No duplicate plugin instances are used (duplicates are covered in edge_tests.sh).
 # - Uses file-based diffs for large outputs to avoid huge in-memory strings.
 
 set -u
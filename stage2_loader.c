@@ -3,6 +3,7 @@
 #include <string.h>    // strlen, strcpy, strcat, strdup
 #include <dlfcn.h>     // dlopen, dlsym, dlerror, dlclose
 #include "loader.h"
+#include "plugins/sync/buffer_pool.h"
 
 /* ---- Symbol names expected from each plugin (as per spec) ---- */
 #define SYM_PLUGIN_INIT          "plugin_init"
@@ -11,6 +12,42 @@
 #define SYM_PLUGIN_ATTACH        "plugin_attach"
 #define SYM_PLUGIN_WAIT_FINISHED "plugin_wait_finished"
 
+/* ---- Optional symbols: used when exported, silently skipped otherwise ---- */
+#define SYM_PLUGIN_PLACE_WORK_BATCH "plugin_place_work_batch"
+#define SYM_PLUGIN_ATTACH_BATCH     "plugin_attach_batch"
+#define SYM_PLUGIN_SET_BYTE_BUDGET  "plugin_set_byte_budget"
+#define SYM_PLUGIN_SET_QUEUE_BACKEND "plugin_set_queue_backend"
+#define SYM_PLUGIN_GRANT_CREDITS    "plugin_grant_credits"
+#define SYM_PLUGIN_ATTACH_CREDITS   "plugin_attach_credits"
+#define SYM_PLUGIN_SET_WORKERS      "plugin_set_workers"
+#define SYM_PLUGIN_PLACE_WORK_OWNED "plugin_place_work_owned"
+#define SYM_PLUGIN_PLACE_WORK_OWNED_BATCH "plugin_place_work_owned_batch"
+#define SYM_PLUGIN_ATTACH_OWNED     "plugin_attach_owned"
+#define SYM_PLUGIN_SET_BUFFER_POOL  "plugin_set_buffer_pool"
+#define SYM_PLUGIN_PLACE_CONTROL    "plugin_place_control"
+#define SYM_PLUGIN_ATTACH_CONTROL   "plugin_attach_control"
+
+/* The END kind of plugin_control_t (plugins/plugin_common.h) */
+#define PLUGIN_CONTROL_END 0
+
+/* ---- Optional instance ABI: lets one .so serve several stages ---- */
+#define SYM_PLUGIN_INSTANCE_INIT          "plugin_instance_init"
+#define SYM_PLUGIN_INSTANCE_FINI          "plugin_instance_fini"
+#define SYM_PLUGIN_INSTANCE_PLACE_WORK    "plugin_instance_place_work"
+#define SYM_PLUGIN_INSTANCE_ATTACH        "plugin_instance_attach"
+#define SYM_PLUGIN_INSTANCE_WAIT_FINISHED "plugin_instance_wait_finished"
+#define SYM_PLUGIN_INSTANCE_PLACE_WORK_BATCH "plugin_instance_place_work_batch"
+#define SYM_PLUGIN_INSTANCE_ATTACH_BATCH  "plugin_instance_attach_batch"
+#define SYM_PLUGIN_INSTANCE_SET_BYTE_BUDGET "plugin_instance_set_byte_budget"
+#define SYM_PLUGIN_INSTANCE_GRANT_CREDITS "plugin_instance_grant_credits"
+#define SYM_PLUGIN_INSTANCE_ATTACH_CREDITS "plugin_instance_attach_credits"
+#define SYM_PLUGIN_INSTANCE_SET_WORKERS   "plugin_instance_set_workers"
+#define SYM_PLUGIN_INSTANCE_PLACE_WORK_OWNED "plugin_instance_place_work_owned"
+#define SYM_PLUGIN_INSTANCE_PLACE_WORK_OWNED_BATCH "plugin_instance_place_work_owned_batch"
+#define SYM_PLUGIN_INSTANCE_ATTACH_OWNED  "plugin_instance_attach_owned"
+#define SYM_PLUGIN_INSTANCE_PLACE_CONTROL "plugin_instance_place_control"
+#define SYM_PLUGIN_INSTANCE_ATTACH_CONTROL "plugin_instance_attach_control"
+
 /* --------- Small helper: build "<name>.so" --------- */
 char* build_so_filename(const char* name) 
 {
@@ -81,6 +118,227 @@ static void* must_dlsym(void* h, const char* sym, const char* so_name,
     return p;
 }
 
+/* Resolve an optional symbol; NULL if the plugin does not export it */
+static void* try_dlsym(void* h, const char* sym)
+{
+    (void)dlerror();
+    void* p = dlsym(h, sym);
+    if (dlerror() != NULL) {
+        return NULL;
+    }
+    return p;
+}
+
+/* Drop the instance ABI: the stage is driven through its legacy symbols */
+static void clear_instance_abi(plugin_handle_t* p)
+{
+    p->instance_init          = NULL;
+    p->instance_fini          = NULL;
+    p->instance_place_work    = NULL;
+    p->instance_attach        = NULL;
+    p->instance_wait_finished = NULL;
+    p->instance_place_work_batch = NULL;
+    p->instance_attach_batch  = NULL;
+    p->instance_set_byte_budget = NULL;
+    p->instance_grant_credits = NULL;
+    p->instance_attach_credits = NULL;
+    p->instance_set_workers   = NULL;
+    p->instance_place_work_owned = NULL;
+    p->instance_place_work_owned_batch = NULL;
+    p->instance_attach_owned  = NULL;
+    p->instance_place_control = NULL;
+    p->instance_attach_control = NULL;
+}
+
+/* Resolve the instance ABI; a plugin missing any of the five core calls stays on the legacy symbols */
+static void resolve_instance_abi(plugin_handle_t* p, void* h)
+{
+    p->instance_init          = (plugin_instance_init_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_INIT);
+    p->instance_fini          = (plugin_instance_fini_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_FINI);
+    p->instance_place_work    = (plugin_instance_place_work_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_PLACE_WORK);
+    p->instance_attach        = (plugin_instance_attach_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_ATTACH);
+    p->instance_wait_finished = (plugin_instance_wait_finished_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_WAIT_FINISHED);
+    if (!p->instance_init || !p->instance_fini || !p->instance_place_work ||
+        !p->instance_attach || !p->instance_wait_finished) {
+        clear_instance_abi(p);
+        return;
+    }
+    p->instance_place_work_batch = (plugin_instance_place_work_batch_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_PLACE_WORK_BATCH);
+    p->instance_attach_batch     = (plugin_instance_attach_batch_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_ATTACH_BATCH);
+    p->instance_set_byte_budget  = (plugin_instance_set_byte_budget_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_SET_BYTE_BUDGET);
+    p->instance_grant_credits    = (plugin_instance_grant_credits_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_GRANT_CREDITS);
+    p->instance_attach_credits   = (plugin_instance_attach_credits_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_ATTACH_CREDITS);
+    p->instance_set_workers      = (plugin_instance_set_workers_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_SET_WORKERS);
+    p->instance_place_work_owned = (plugin_instance_place_work_owned_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_PLACE_WORK_OWNED);
+    p->instance_place_work_owned_batch = (plugin_instance_place_work_owned_batch_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_PLACE_WORK_OWNED_BATCH);
+    p->instance_attach_owned     = (plugin_instance_attach_owned_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_ATTACH_OWNED);
+    p->instance_place_control    = (plugin_instance_place_control_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_PLACE_CONTROL);
+    p->instance_attach_control   = (plugin_instance_attach_control_func_t)try_dlsym(h, SYM_PLUGIN_INSTANCE_ATTACH_CONTROL);
+}
+
+/* ------------------ Per-stage calls (instance ABI first, legacy symbols otherwise) ------------------ */
+const char* plugin_handle_init(plugin_handle_t* p, int queue_size)
+{
+    if (p->instance_init) {
+        return p->instance_init(queue_size, p->queue_backend, &p->instance);
+    }
+    return p->init(queue_size);
+}
+
+const char* plugin_handle_fini(plugin_handle_t* p)
+{
+    if (p->instance_init) {
+        const char* err = p->instance_fini(p->instance);
+        if (err == NULL) p->instance = NULL;
+        return err;
+    }
+    return p->fini();
+}
+
+const char* plugin_handle_place_work(plugin_handle_t* p, const char* s)
+{
+    if (p->instance_init) {
+        return p->instance_place_work(p->instance, s);
+    }
+    return p->place_work(s);
+}
+
+const char* plugin_handle_place_end(plugin_handle_t* p)
+{
+    if (p->instance_init ? p->instance_place_control != NULL : p->place_control != NULL) {
+        return p->instance_init ? p->instance_place_control(p->instance, PLUGIN_CONTROL_END)
+                                : p->place_control(PLUGIN_CONTROL_END);
+    }
+    return plugin_handle_place_work(p, "<END>");
+}
+
+const char* plugin_handle_wait_finished(plugin_handle_t* p)
+{
+    if (p->instance_init) {
+        return p->instance_wait_finished(p->instance);
+    }
+    return p->wait_finished();
+}
+
+int plugin_handle_has_byte_budget(const plugin_handle_t* p)
+{
+    return p->instance_init ? p->instance_set_byte_budget != NULL : p->set_byte_budget != NULL;
+}
+
+const char* plugin_handle_set_byte_budget(plugin_handle_t* p, struct cp_byte_budget* budget, int gate)
+{
+    if (p->instance_init) {
+        return p->instance_set_byte_budget(p->instance, budget, gate);
+    }
+    return p->set_byte_budget(budget, gate);
+}
+
+const char* plugin_handle_set_workers(plugin_handle_t* p, int workers)
+{
+    if (p->instance_init ? p->instance_set_workers == NULL : p->set_workers == NULL) {
+        return "plugin does not support worker pools";
+    }
+    if (p->instance_init) {
+        return p->instance_set_workers(p->instance, workers);
+    }
+    return p->set_workers(workers);
+}
+
+/* An instance forwarding into a legacy stage: the "next instance" is that stage's handle */
+static const char* legacy_stage_place_work(void* next, const char* s)
+{
+    return ((plugin_handle_t*)next)->place_work(s);
+}
+
+static const char* legacy_stage_place_work_batch(void* next, const char* const* strs, int count)
+{
+    return ((plugin_handle_t*)next)->place_work_batch(strs, count);
+}
+
+static int legacy_stage_grant_credits(void* next, int max_credits)
+{
+    return ((plugin_handle_t*)next)->grant_credits(max_credits);
+}
+
+static const char* legacy_stage_place_work_owned(void* next, char* s)
+{
+    return ((plugin_handle_t*)next)->place_work_owned(s);
+}
+
+static const char* legacy_stage_place_work_owned_batch(void* next, char** strs, int count)
+{
+    return ((plugin_handle_t*)next)->place_work_owned_batch(strs, count);
+}
+
+static const char* legacy_stage_place_control(void* next, int kind)
+{
+    return ((plugin_handle_t*)next)->place_control(kind);
+}
+
+/* Buffers may only be handed over between plugins that allocate from the same pool */
+static int share_buffer_pool(const plugin_handle_t* p, const plugin_handle_t* next)
+{
+    return p->set_buffer_pool != NULL && next->set_buffer_pool != NULL;
+}
+
+void plugin_handle_attach(plugin_handle_t* p, plugin_handle_t* next, int use_credits)
+{
+    /* Both sides on the instance ABI: the upstream instance calls the downstream one by handle */
+    if (p->instance_init && next->instance_init) {
+        p->instance_attach(p->instance, next->instance_place_work, next->instance);
+        if (p->instance_attach_batch && next->instance_place_work_batch) {
+            p->instance_attach_batch(p->instance, next->instance_place_work_batch);
+        }
+        if (use_credits && p->instance_attach_credits && next->instance_grant_credits) {
+            p->instance_attach_credits(p->instance, next->instance_grant_credits);
+        }
+        /* Outputs are fresh heap buffers: hand them over instead of copying them at every hop */
+        if (p->instance_attach_owned && next->instance_place_work_owned && share_buffer_pool(p, next)) {
+            p->instance_attach_owned(p->instance, next->instance_place_work_owned,
+                                     next->instance_place_work_owned_batch);
+        }
+        /* END, FLUSH and BARRIER cross as control messages, never as strings */
+        if (p->instance_attach_control && next->instance_place_control) {
+            p->instance_attach_control(p->instance, next->instance_place_control);
+        }
+        return;
+    }
+
+    /* Legacy downstream: its global symbols drive its only instance */
+    if (p->instance_init) {
+        p->instance_attach(p->instance, legacy_stage_place_work, next);
+        if (p->instance_attach_batch && next->place_work_batch) {
+            p->instance_attach_batch(p->instance, legacy_stage_place_work_batch);
+        }
+        if (use_credits && p->instance_attach_credits && next->grant_credits) {
+            p->instance_attach_credits(p->instance, legacy_stage_grant_credits);
+        }
+        if (p->instance_attach_owned && next->place_work_owned && share_buffer_pool(p, next)) {
+            p->instance_attach_owned(p->instance, legacy_stage_place_work_owned,
+                                     next->place_work_owned_batch ? legacy_stage_place_work_owned_batch : NULL);
+        }
+        if (p->instance_attach_control && next->place_control) {
+            p->instance_attach_control(p->instance, legacy_stage_place_control);
+        }
+        return;
+    }
+
+    /* Legacy upstream (the loader keeps the stage after it on its legacy symbols too) */
+    p->attach(next->place_work);
+    if (p->attach_batch && next->place_work_batch) {
+        p->attach_batch(next->place_work_batch);
+    }
+    if (use_credits && p->attach_credits && next->grant_credits) {
+        p->attach_credits(next->grant_credits);
+    }
+    if (p->attach_owned && next->place_work_owned && share_buffer_pool(p, next)) {
+        p->attach_owned(next->place_work_owned, next->place_work_owned_batch);
+    }
+    if (p->attach_control && next->place_control) {
+        p->attach_control(next->place_control);
+    }
+}
+
 /* ------------------ Public entrypoint for Stage 2 ------------------ */
 void stage2_load_plugins(char** plugin_names,
                          int plugin_count,
@@ -131,6 +389,27 @@ void stage2_load_plugins(char** plugin_names,
         arr[i].wait_finished = wait_finished;
         arr[i].handle        = h;
 
+        /* 4) optional extensions */
+        arr[i].place_work_batch = (plugin_place_work_batch_func_t)try_dlsym(h, SYM_PLUGIN_PLACE_WORK_BATCH);
+        arr[i].attach_batch     = (plugin_attach_batch_func_t)try_dlsym(h, SYM_PLUGIN_ATTACH_BATCH);
+        arr[i].set_byte_budget  = (plugin_set_byte_budget_func_t)try_dlsym(h, SYM_PLUGIN_SET_BYTE_BUDGET);
+        arr[i].set_queue_backend = (plugin_set_queue_backend_func_t)try_dlsym(h, SYM_PLUGIN_SET_QUEUE_BACKEND);
+        arr[i].grant_credits    = (plugin_grant_credits_func_t)try_dlsym(h, SYM_PLUGIN_GRANT_CREDITS);
+        arr[i].attach_credits   = (plugin_attach_credits_func_t)try_dlsym(h, SYM_PLUGIN_ATTACH_CREDITS);
+        arr[i].set_workers      = (plugin_set_workers_func_t)try_dlsym(h, SYM_PLUGIN_SET_WORKERS);
+        arr[i].place_work_owned = (plugin_place_work_owned_func_t)try_dlsym(h, SYM_PLUGIN_PLACE_WORK_OWNED);
+        arr[i].place_work_owned_batch = (plugin_place_work_owned_batch_func_t)try_dlsym(h, SYM_PLUGIN_PLACE_WORK_OWNED_BATCH);
+        arr[i].attach_owned     = (plugin_attach_owned_func_t)try_dlsym(h, SYM_PLUGIN_ATTACH_OWNED);
+        arr[i].place_control    = (plugin_place_control_func_t)try_dlsym(h, SYM_PLUGIN_PLACE_CONTROL);
+        arr[i].attach_control   = (plugin_attach_control_func_t)try_dlsym(h, SYM_PLUGIN_ATTACH_CONTROL);
+        resolve_instance_abi(&arr[i], h);
+
+        /* 5) one buffer pool for the whole process, so a buffer may be freed by any plugin */
+        arr[i].set_buffer_pool  = (plugin_set_buffer_pool_func_t)try_dlsym(h, SYM_PLUGIN_SET_BUFFER_POOL);
+        if (arr[i].set_buffer_pool && arr[i].set_buffer_pool(buffer_pool_default()) != NULL) {
+            arr[i].set_buffer_pool = NULL;
+        }
+
         arr[i].name = strdup(plugin_names[i]); /* without .so */
         if (!arr[i].name) {
             free(sofile);
@@ -142,6 +421,14 @@ void stage2_load_plugins(char** plugin_names,
         free(sofile);
     }
 
+    /* A legacy stage forwards through a plain function pointer, which cannot carry an instance
+       handle: the stage after it is driven through its legacy symbols as well */
+    for (int i = 1; i < plugin_count; ++i) {
+        if (!arr[i - 1].instance_init) {
+            clear_instance_abi(&arr[i]);
+        }
+    }
+
     /* success */
     *out_arr = arr;
 }
@@ -0,0 +1,191 @@
+// tests/benchmarks/bench_queue.c
+// Throughput / context-switch benchmark for consumer_producer_t.
+// - Each scenario streams a fixed number of pre-allocated items through one queue
+// - Reports items/sec and context switches (voluntary + involuntary) per 1000 items
+// - Not a pass/fail test: run it before and after a queue change and compare
+// - Usage: bench_queue [backend...] runs only the scenarios on the named backends (A/B runs)
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "consumer_producer.h"   // provided via -I plugins/sync
+
+#define ITEMS_PER_RUN 400000
+
+typedef struct {
+    const char* name;
+    const char* backend;    // consumer_producer_backend name
+    int capacity;
+    int producers;
+    int consumers;
+    consumer_producer_wait_t wait;
+    int copy;               // Producers use put_copy and consumers get_batch_copy (inline slots)
+} scenario_t;
+
+typedef struct {
+    consumer_producer_t* queue;
+    char** items;
+    int count;
+    int copy;
+} producer_args_t;
+
+typedef struct {
+    consumer_producer_t* queue;
+    int copy;
+} consumer_args_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long context_switches(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+static void* producer_main(void* arg) {
+    producer_args_t* a = (producer_args_t*)arg;
+    for (int i = 0; i < a->count; ++i) {
+        const char* err = a->copy ? consumer_producer_put_copy(a->queue, a->items[i])
+                                  : consumer_producer_put(a->queue, a->items[i]);
+        if (err != NULL) {
+            fprintf(stderr, "put failed\n");
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+static void* consumer_main(void* arg) {
+    consumer_args_t* a = (consumer_args_t*)arg;
+    if (a->copy) {
+        // Copied items are the consumer's: inline ones live in its scratch buffer, the rest on the heap
+        cp_scratch_t scratch;
+        char* out[16];
+        int n;
+        consumer_producer_scratch_init(a->queue, &scratch, 16);
+        while ((n = consumer_producer_get_batch_copy(a->queue, out, 16, &scratch)) > 0) {
+            for (int i = 0; i < n; ++i) {
+                if (!consumer_producer_scratch_owns(&scratch, out[i])) {
+                    free(out[i]);
+                }
+            }
+        }
+        consumer_producer_scratch_destroy(&scratch);
+        return NULL;
+    }
+    char* item;
+    while ((item = consumer_producer_get(a->queue)) != NULL) {
+        // Items are never freed here: they point into one shared arena
+        (void)item;
+    }
+    return NULL;
+}
+
+static void run_scenario(const scenario_t* sc, char* arena) {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_backend(&queue, sc->capacity, consumer_producer_backend(sc->backend)) != NULL) {
+        printf("%-28s  (skipped: backend unavailable)\n", sc->name);
+        return;
+    }
+    consumer_producer_set_wait_strategy(&queue, sc->wait, 0);
+
+    int per_producer = ITEMS_PER_RUN / sc->producers;
+    char** items = (char**)malloc((size_t)ITEMS_PER_RUN * sizeof(char*));
+    for (int i = 0; i < ITEMS_PER_RUN; ++i) {
+        items[i] = arena + (size_t)i * 8;
+    }
+
+    pthread_t prod[16], cons[16];
+    producer_args_t args[16];
+    consumer_args_t cargs = { &queue, sc->copy };
+
+    long cs_before = context_switches();
+    double t0 = now_sec();
+
+    for (int c = 0; c < sc->consumers; ++c) {
+        pthread_create(&cons[c], NULL, consumer_main, &cargs);
+    }
+    for (int p = 0; p < sc->producers; ++p) {
+        args[p].queue = &queue;
+        args[p].items = items + (size_t)p * (size_t)per_producer;
+        args[p].count = per_producer;
+        args[p].copy = sc->copy;
+        pthread_create(&prod[p], NULL, producer_main, &args[p]);
+    }
+    for (int p = 0; p < sc->producers; ++p) {
+        pthread_join(prod[p], NULL);
+    }
+    consumer_producer_signal_finished(&queue);
+    for (int c = 0; c < sc->consumers; ++c) {
+        pthread_join(cons[c], NULL);
+    }
+
+    double elapsed = now_sec() - t0;
+    long cs = context_switches() - cs_before;
+    long total = (long)per_producer * sc->producers;
+
+    printf("%-28s  %10.0f items/s   %8.2f ctx-switches/1k items\n",
+           sc->name, (double)total / elapsed, (double)cs * 1000.0 / (double)total);
+
+    // The arena owns the strings; make destroy a no-op for them (MPMC drained them all)
+    if (queue.items != NULL) {
+        memset(queue.items, 0, (size_t)queue.capacity * sizeof(char*));
+    }
+    consumer_producer_destroy(&queue);
+    free(items);
+}
+
+int main(int argc, char** argv) {
+    static const scenario_t scenarios[] = {
+        { "locked 1P/1C cap=1",        "locked", 1,    1, 1, CP_WAIT_PARK, 0 },
+        { "locked 1P/1C cap=64",       "locked", 64,   1, 1, CP_WAIT_PARK, 0 },
+        { "locked 1P/1C cap=1024",     "locked", 1024, 1, 1, CP_WAIT_PARK, 0 },
+        { "locked 4P/4C cap=64",       "locked", 64,   4, 4, CP_WAIT_PARK, 0 },
+        { "spsc   1P/1C cap=64",       "spsc",  64,   1, 1, CP_WAIT_PARK, 0 },
+        { "spsc   1P/1C cap=1024",     "spsc",  1024, 1, 1, CP_WAIT_PARK, 0 },
+        { "locked 1P/1C cap=64 spin",  "locked", 64,   1, 1, CP_WAIT_SPIN, 0 },
+        { "spsc   1P/1C cap=64 spin",  "spsc",  64,   1, 1, CP_WAIT_SPIN, 0 },
+        { "spsc   1P/1C cap=64 adapt", "spsc",  64,   1, 1, CP_WAIT_ADAPTIVE, 0 },
+        // Consumer contention: one shared lock vs. the sequence-numbered ring
+        { "locked 2P/1C cap=64",       "locked", 64,   2, 1, CP_WAIT_PARK, 0 },
+        { "locked 2P/2C cap=64",       "locked", 64,   2, 2, CP_WAIT_PARK, 0 },
+        { "locked 2P/4C cap=64",       "locked", 64,   2, 4, CP_WAIT_PARK, 0 },
+        { "locked 2P/8C cap=64",       "locked", 64,   2, 8, CP_WAIT_PARK, 0 },
+        { "mpmc   2P/1C cap=64",       "mpmc",  64,   2, 1, CP_WAIT_PARK, 0 },
+        { "mpmc   2P/2C cap=64",       "mpmc",  64,   2, 2, CP_WAIT_PARK, 0 },
+        { "mpmc   2P/4C cap=64",       "mpmc",  64,   2, 4, CP_WAIT_PARK, 0 },
+        { "mpmc   2P/8C cap=64",       "mpmc",  64,   2, 8, CP_WAIT_PARK, 0 },
+        // Inline slots: short strings copied into the ring instead of strdup'd by the producer
+        { "locked 1P/1C cap=64 copy",  "locked", 64,   1, 1, CP_WAIT_PARK, 1 },
+        { "inline 1P/1C cap=64 copy",  "inline", 64,   1, 1, CP_WAIT_PARK, 1 },
+    };
+
+    char* arena = (char*)calloc((size_t)ITEMS_PER_RUN, 8);
+    for (int i = 0; i < ITEMS_PER_RUN; ++i) {
+        snprintf(arena + (size_t)i * 8, 8, "%d", i % 1000000);
+    }
+
+    printf("=== consumer_producer benchmark (%d items per scenario) ===\n", ITEMS_PER_RUN);
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        int selected = argc < 2;
+        for (int a = 1; a < argc; ++a) {
+            selected |= strcmp(argv[a], scenarios[i].backend) == 0;
+        }
+        if (selected) {
+            run_scenario(&scenarios[i], arena);
+        }
+    }
+
+    free(arena);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+GREEN="\033[0;32m"
+RED="\033[0;31m"
+NC="\033[0m"
+
+
+compile_and_report() {
+  CMD=$1
+  DESC=$2
+
+  echo "Compiling $DESC..."
+  eval "$CMD"
+  if [ $? -eq 0 ]; then
+    echo -e "[${GREEN}PASS${NC}] $DESC compiled successfully"
+  else
+    echo -e "[${RED}FAIL${NC}] $DESC failed to compile"
+    exit 1
+  fi
+}
+
+mkdir -p ../../output
+
+# MONITOR_IMPL=futex ./build_bench.sh measures the futex monitor backend
+SYNC_FLAGS=""
+if [ "${MONITOR_IMPL:-pthread}" = "futex" ]; then
+  SYNC_FLAGS="-DMONITOR_USE_FUTEX"
+fi
+
+echo ""
+echo "Compiling benchmarks..."
+echo ""
+
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L $SYNC_FLAGS -I../../plugins/sync   -o ../../output/bench_queue   bench_queue.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "bench_queue"
+
+echo ""
+echo "Running benchmarks..."
+echo ""
+# ./build_bench.sh spsc locked only runs the scenarios on those backends
+../../output/bench_queue "$@"
+echo ""
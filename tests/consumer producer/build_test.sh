@@ -36,6 +36,23 @@ echo "Compiling integration test..."
 compile_and_report "gcc -o test_integration test_integration.c ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c -lpthread" "test_integration"
 compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -I../../plugins/sync   -o ../../output/test_integration2   test_integration2.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread"
 compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/extra_integration_tests   extra_integration_tests.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_spsc   test_spsc.c   ../../plugins/sync/monitor.c   -lpthread" "test_spsc"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_batch   test_batch.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_batch"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_wait_strategy   test_wait_strategy.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_wait_strategy"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_timed   test_timed.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_timed"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_events   test_events.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_events"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_mpmc   test_mpmc.c   ../../plugins/sync/monitor.c   -lpthread" "test_mpmc"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_elastic   test_elastic.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_elastic"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_byte_budget   test_byte_budget.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_byte_budget"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_instrumentation   test_instrumentation.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_instrumentation"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_priority   test_priority.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_priority"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_inline   test_inline.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_inline"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_overflow   test_overflow.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_overflow"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_backend   test_backend.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_backend"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_credits   test_credits.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_credits"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_spill   test_spill.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_spill"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_buffer_pool   test_buffer_pool.c   ../../plugins/sync/buffer_pool.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_buffer_pool"
+compile_and_report "gcc -std=c11 -O2 -Wall -Wextra -D_POSIX_C_SOURCE=200809L -I../../plugins/sync   -o ../../output/test_message   test_message.c   ../../plugins/sync/message.c   ../../plugins/sync/buffer_pool.c   ../../plugins/sync/consumer_producer.c   ../../plugins/sync/monitor.c   -lpthread" "test_message"
 
 
 echo ""
@@ -64,4 +81,72 @@ echo ""
 echo "Running extra integration tests ..."
 echo ""
 ../../output/extra_integration_tests
-echo ""
\ No newline at end of file
+echo ""
+echo "Running SPSC mode tests ..."
+echo ""
+../../output/test_spsc
+echo ""
+echo "Running batch API tests ..."
+echo ""
+../../output/test_batch
+echo ""
+echo "Running wait strategy tests ..."
+echo ""
+../../output/test_wait_strategy
+echo ""
+echo "Running timed and non-blocking operation tests ..."
+echo ""
+../../output/test_timed
+echo ""
+echo "Running readiness eventfd tests ..."
+echo ""
+../../output/test_events
+echo ""
+echo "Running MPMC mode tests ..."
+echo ""
+../../output/test_mpmc
+echo ""
+echo "Running elastic capacity tests ..."
+echo ""
+../../output/test_elastic
+echo ""
+echo "Running byte budget tests ..."
+echo ""
+../../output/test_byte_budget
+echo ""
+echo "Running instrumentation tests ..."
+echo ""
+../../output/test_instrumentation
+echo ""
+echo "Running control lane tests ..."
+echo ""
+../../output/test_priority
+echo ""
+echo "Running inline slot tests ..."
+echo ""
+../../output/test_inline
+echo ""
+echo "Running overflow policy tests ..."
+echo ""
+../../output/test_overflow
+echo ""
+echo "Running queue backend tests ..."
+echo ""
+../../output/test_backend
+echo ""
+echo "Running credit flow control tests ..."
+echo ""
+../../output/test_credits
+echo ""
+echo "Running spill to disk tests ..."
+echo ""
+../../output/test_spill
+echo ""
+echo "Running buffer pool tests ..."
+echo ""
+../../output/test_buffer_pool
+echo ""
+echo "Running message envelope tests ..."
+echo ""
+../../output/test_message
+echo ""
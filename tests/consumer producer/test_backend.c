@@ -0,0 +1,185 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 50000
+
+static const char* const BACKENDS[] = { "locked", "spsc", "mpmc", "inline" };
+#define BACKEND_COUNT (sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+
+void test_lookup() {
+    if (consumer_producer_backend("locked") != &cp_backend_locked ||
+        consumer_producer_backend("spsc") != &cp_backend_spsc ||
+        consumer_producer_backend("mpmc") != &cp_backend_mpmc ||
+        consumer_producer_backend("inline") != &cp_backend_inline)
+        TEST_FAIL("Built-in backends should be found by name");
+    if (consumer_producer_backend("futex") != NULL || consumer_producer_backend(NULL) != NULL)
+        TEST_FAIL("Unknown names should not resolve");
+    TEST_PASS("Built-in backends are looked up by name");
+}
+
+void test_init_backend_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_init_backend(&queue, 4, NULL) == NULL)
+        TEST_FAIL("NULL backend should be rejected");
+    cp_backend_t incomplete = cp_backend_locked;
+    incomplete.wait_finished = NULL;
+    if (consumer_producer_init_backend(&queue, 4, &incomplete) == NULL)
+        TEST_FAIL("Backend with a missing hook should be rejected");
+    if (consumer_producer_init_backend(&queue, 0, &cp_backend_locked) == NULL)
+        TEST_FAIL("Invalid capacity should be rejected");
+
+    // init_mode picks the matching built-in backend
+    consumer_producer_init_mode(&queue, 4, CP_MODE_MPMC);
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (queue.backend != &cp_backend_mpmc || strcmp(stats.backend, "mpmc") != 0)
+        TEST_FAIL("init_mode should select the MPMC backend");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("init_backend validates its input; init_mode maps modes to backends");
+}
+
+void test_features_follow_backend() {
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        const cp_backend_t* backend = consumer_producer_backend(BACKENDS[b]);
+        consumer_producer_t queue;
+        init_backend(&queue, 4, backend);
+
+        char* ctl = strdup("ctl");
+        int has_control = consumer_producer_put_control(&queue, ctl, CP_CONTROL_URGENT) == NULL;
+        int has_elastic = consumer_producer_set_elastic(&queue, 8, 0, 0, 0) == NULL;
+        if (has_control != ((backend->features & CP_FEATURE_CONTROL) != 0) ||
+            has_elastic != ((backend->features & CP_FEATURE_ELASTIC) != 0))
+            TEST_FAIL("Optional calls should work exactly on backends with the feature");
+        free(has_control ? consumer_producer_get(&queue) : ctl);
+        consumer_producer_destroy(&queue);
+    }
+
+    // The inline backend comes with inline slots configured
+    consumer_producer_t queue;
+    cp_scratch_t scratch;
+    init_backend(&queue, 4, &cp_backend_inline);
+    consumer_producer_scratch_init(&queue, &scratch, 4);
+    consumer_producer_put_copy(&queue, "short");
+    char* out[4];
+    if (consumer_producer_get_batch_copy(&queue, out, 4, &scratch) != 1 ||
+        !consumer_producer_scratch_owns(&scratch, out[0]) || queue.inline_size != CP_INLINE_DEFAULT)
+        TEST_FAIL("Inline backend should store short strings in its slots");
+    consumer_producer_scratch_destroy(&scratch);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Optional features follow the backend");
+}
+
+// A custom backend: the locked one with its puts counted
+static long counted_puts = 0;
+static const char* counting_put_batch(consumer_producer_t* queue, char** items, int count, int* put_count,
+                                      const struct timespec* deadline, int copy) {
+    counted_puts += count;
+    return cp_backend_locked.put_batch(queue, items, count, put_count, deadline, copy);
+}
+
+// Its credits hook records whether it was asked only to look
+static int credits_looked = 0;
+static int looking_credits(consumer_producer_t* queue, const struct timespec* deadline) {
+    if (deadline == CP_NO_WAIT)
+        credits_looked = 1;
+    return cp_backend_locked.credits(queue, deadline);
+}
+
+void test_custom_backend() {
+    cp_backend_t counting = cp_backend_locked;
+    counting.name = "counting";
+    counting.put_batch = counting_put_batch;
+    counting.credits = looking_credits;
+    counting.mode = (consumer_producer_mode_t)7;    // Not a built-in mode: the hooks carry the behavior
+
+    consumer_producer_t queue;
+    init_backend(&queue, 4, &counting);
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_try_put(&queue, strdup("b"));
+    char* batch[2] = { strdup("c"), strdup("d") };
+    consumer_producer_put_batch(&queue, batch, 2, NULL);
+    if (counted_puts != 4)
+        TEST_FAIL("Every put should go through the backend's hook");
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 4 || strcmp(stats.backend, "counting") != 0)
+        TEST_FAIL("Stats should come from the custom backend");
+    if (consumer_producer_credits(&queue) != 0 || !credits_looked)
+        TEST_FAIL("Credits should reach the custom hook with CP_NO_WAIT");
+    consumer_producer_destroy(&queue);  // Frees the items left through the locked hooks
+    TEST_PASS("A custom backend can wrap a built-in one");
+}
+
+void test_full_empty_without_backend() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (queue_is_full(&queue) != 0 || queue_is_empty(&queue) != 1)
+        TEST_FAIL("A queue never initialized should be empty and not full");
+
+    init_backend(&queue, 1, &cp_backend_locked);
+    consumer_producer_put(&queue, strdup("a"));
+    if (queue_is_full(&queue) != 1)
+        TEST_FAIL("A queue at capacity should be full");
+    consumer_producer_destroy(&queue);
+    if (queue_is_full(&queue) != 0 || queue_is_empty(&queue) != 1)
+        TEST_FAIL("A destroyed queue should be empty and not full");
+    TEST_PASS("queue_is_full/queue_is_empty answer for a queue without a backend");
+}
+
+void* stream_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char buf[32];
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (consumer_producer_put_copy(queue, buf) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_same_stream_on_every_backend() {
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        consumer_producer_t queue;
+        cp_scratch_t scratch;
+        init_backend(&queue, 16, consumer_producer_backend(BACKENDS[b]));
+        consumer_producer_scratch_init(&queue, &scratch, 8);
+        pthread_t producer;
+        pthread_create(&producer, NULL, stream_producer, &queue);
+
+        long expected = 0;
+        char* out[8];
+        int n;
+        while ((n = consumer_producer_get_batch_copy(&queue, out, 8, &scratch)) > 0) {
+            for (int k = 0; k < n; ++k) {
+                if (strtol(out[k], NULL, 10) != expected)
+                    TEST_FAIL("Items out of order");
+                expected++;
+                if (!consumer_producer_scratch_owns(&scratch, out[k]))
+                    free(out[k]);
+            }
+        }
+        pthread_join(producer, NULL);
+        if (expected != STREAM_ITEMS || consumer_producer_wait_finished(&queue) != 0)
+            TEST_FAIL("Stream should be delivered completely and finish");
+        consumer_producer_scratch_destroy(&scratch);
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("The same stream is delivered in order on every built-in backend");
+}
+
+int main() {
+    printf("=== Testing consumer_producer backends ===\n");
+    test_lookup();
+    test_init_backend_validation();
+    test_features_follow_backend();
+    test_custom_backend();
+    test_full_empty_without_backend();
+    test_same_stream_on_every_backend();
+    printf(GREEN "All backend tests passed.\n" NC);
+    return 0;
+}
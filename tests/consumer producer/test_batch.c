@@ -0,0 +1,144 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 100000
+#define CHUNK 16
+
+typedef struct {
+    consumer_producer_t* queue;
+    consumer_producer_mode_t mode;
+} stream_args_t;
+
+void test_put_batch_then_get_batch(consumer_producer_mode_t mode) {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 8, mode) != NULL)
+        TEST_FAIL("Initialization failed");
+
+    char* items[5] = { strdup("a"), strdup("b"), strdup("c"), strdup("d"), strdup("e") };
+    int put = -1;
+    if (consumer_producer_put_batch(&queue, items, 5, &put) != NULL || put != 5)
+        TEST_FAIL("put_batch did not accept all items");
+
+    char* out[3];
+    int n = consumer_producer_get_batch(&queue, out, 3);
+    if (n != 3 || strcmp(out[0], "a") != 0 || strcmp(out[2], "c") != 0)
+        TEST_FAIL("get_batch should return the oldest items, capped at max_items");
+    for (int i = 0; i < n; ++i) free(out[i]);
+
+    n = consumer_producer_get_batch(&queue, out, 3);
+    if (n != 2 || strcmp(out[0], "d") != 0 || strcmp(out[1], "e") != 0)
+        TEST_FAIL("get_batch should return whatever is available");
+    for (int i = 0; i < n; ++i) free(out[i]);
+
+    consumer_producer_destroy(&queue);
+}
+
+void test_batch_invalid_args() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 4);
+
+    char* items[2] = { strdup("x"), NULL };
+    int put = -1;
+    if (consumer_producer_put_batch(&queue, items, 2, &put) == NULL || put != 0)
+        TEST_FAIL("put_batch with a NULL item should fail without enqueuing anything");
+    free(items[0]);
+
+    char* out[1];
+    if (consumer_producer_get_batch(&queue, out, 0) != -1)
+        TEST_FAIL("get_batch with max_items 0 should fail");
+    if (consumer_producer_get_batch(NULL, out, 1) != -1)
+        TEST_FAIL("get_batch with NULL queue should fail");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Batch argument validation");
+}
+
+void test_get_batch_finished_returns_zero(consumer_producer_mode_t mode) {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, mode);
+
+    consumer_producer_signal_finished(&queue);
+    char* out[4];
+    if (consumer_producer_get_batch(&queue, out, 4) != 0)
+        TEST_FAIL("get_batch on finished and empty queue should return 0");
+
+    char* items[1] = { strdup("late") };
+    if (consumer_producer_put_batch(&queue, items, 1, NULL) == NULL)
+        TEST_FAIL("put_batch after finished should fail");
+    free(items[0]);
+
+    consumer_producer_destroy(&queue);
+}
+
+void* batch_producer(void* arg) {
+    stream_args_t* a = (stream_args_t*)arg;
+    char* chunk[CHUNK];
+    char buf[32];
+    for (int i = 0; i < STREAM_ITEMS; i += CHUNK) {
+        int n = (STREAM_ITEMS - i) < CHUNK ? (STREAM_ITEMS - i) : CHUNK;
+        for (int k = 0; k < n; ++k) {
+            snprintf(buf, sizeof(buf), "%d", i + k);
+            chunk[k] = strdup(buf);
+        }
+        if (consumer_producer_put_batch(a->queue, chunk, n, NULL) != NULL)
+            TEST_FAIL("Producer put_batch failed");
+    }
+    consumer_producer_signal_finished(a->queue);
+    return NULL;
+}
+
+void* batch_consumer(void* arg) {
+    stream_args_t* a = (stream_args_t*)arg;
+    char* out[CHUNK];
+    long expected = 0;
+    int n;
+    while ((n = consumer_producer_get_batch(a->queue, out, CHUNK)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (strtol(out[k], NULL, 10) != expected)
+                TEST_FAIL("Batch stream delivered items out of order");
+            expected++;
+            free(out[k]);
+        }
+    }
+    if (n != 0 || expected != STREAM_ITEMS)
+        TEST_FAIL("Batch stream lost items");
+    return NULL;
+}
+
+void test_threaded_batch_stream(consumer_producer_mode_t mode) {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 5, mode);
+    stream_args_t args = { &queue, mode };
+
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, batch_consumer, &args);
+    pthread_create(&producer, NULL, batch_producer, &args);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished failed after batch stream");
+
+    consumer_producer_destroy(&queue);
+}
+
+int main() {
+    printf("=== Testing consumer_producer batch API ===\n");
+    test_put_batch_then_get_batch(CP_MODE_LOCKED);
+    test_put_batch_then_get_batch(CP_MODE_SPSC);
+    TEST_PASS("put_batch/get_batch keep FIFO order (locked and SPSC)");
+    test_batch_invalid_args();
+    test_get_batch_finished_returns_zero(CP_MODE_LOCKED);
+    test_get_batch_finished_returns_zero(CP_MODE_SPSC);
+    TEST_PASS("get_batch returns 0 once finished and drained");
+    test_threaded_batch_stream(CP_MODE_LOCKED);
+    test_threaded_batch_stream(CP_MODE_SPSC);
+    TEST_PASS("Threaded batch stream keeps FIFO order with chunks larger than the queue");
+    printf(GREEN "All batch tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <pthread.h>
+
+#include "test_util.h"
+#include "../../plugins/sync/buffer_pool.h"
+
+#define STREAM_ITEMS 200000
+
+void test_size_classes() {
+    buffer_pool_stats_t before, after;
+    buffer_pool_get_stats(buffer_pool_current(), &before);
+
+    void* small = buffer_pool_alloc(1);
+    void* mid = buffer_pool_alloc(BP_CLASS_MIN + 1);
+    void* largest = buffer_pool_alloc(BP_CLASS_MAX);
+    void* huge = buffer_pool_alloc(BP_CLASS_MAX + 1);
+    if (small == NULL || mid == NULL || largest == NULL || huge == NULL)
+        TEST_FAIL("Allocations should succeed");
+    if (buffer_pool_capacity(small) != BP_CLASS_MIN || buffer_pool_capacity(mid) != 2 * BP_CLASS_MIN ||
+        buffer_pool_capacity(largest) != BP_CLASS_MAX)
+        TEST_FAIL("Sizes should round up to their power-of-two class");
+    if (buffer_pool_capacity(huge) != 0)
+        TEST_FAIL("Sizes beyond the largest class should come from malloc");
+    memset(largest, 'x', BP_CLASS_MAX);
+
+    buffer_pool_get_stats(buffer_pool_current(), &after);
+    if (after.fallbacks != before.fallbacks + 1 || after.slabs < 3)
+        TEST_FAIL("Fallbacks and slabs should be counted");
+
+    // A freed buffer is the next one handed out for its class
+    buffer_pool_free(small);
+    if (buffer_pool_alloc(10) != small)
+        TEST_FAIL("The thread cache should reuse the last freed buffer");
+    buffer_pool_free(small);
+    buffer_pool_free(mid);
+    buffer_pool_free(largest);
+    buffer_pool_free(huge);
+    buffer_pool_free(NULL);
+    TEST_PASS("Sizes round up to power-of-two classes; larger ones fall back to malloc");
+}
+
+void test_realloc_and_foreign_buffers() {
+    char* buf = buffer_pool_strdup("abc");
+    if (buf == NULL || strcmp(buf, "abc") != 0 || buffer_pool_capacity(buf) != BP_CLASS_MIN)
+        TEST_FAIL("strdup should copy into the smallest class");
+    if (buffer_pool_realloc(buf, BP_CLASS_MIN) != buf)
+        TEST_FAIL("Growing within the class should keep the buffer");
+    char* bigger = (char*)buffer_pool_realloc(buf, 100);
+    if (bigger == NULL || strcmp(bigger, "abc") != 0 || buffer_pool_capacity(bigger) != 128)
+        TEST_FAIL("Growing past the class should move the contents to a larger one");
+    buffer_pool_free(bigger);
+
+    // malloc'd buffers are recognised and stay with malloc
+    char* foreign = strdup("from malloc");
+    if (buffer_pool_capacity(foreign) != 0)
+        TEST_FAIL("malloc'd buffers are not pooled");
+    foreign = (char*)buffer_pool_realloc(foreign, 4096);
+    if (foreign == NULL || strcmp(foreign, "from malloc") != 0 || buffer_pool_capacity(foreign) != 0)
+        TEST_FAIL("realloc of a malloc'd buffer should stay with malloc");
+    buffer_pool_free(foreign);      // Goes to free() (checked under sanitizers)
+    TEST_PASS("realloc grows across classes; malloc'd buffers pass through untouched");
+}
+
+void test_use_validation() {
+    if (buffer_pool_use(NULL) == NULL)
+        TEST_FAIL("NULL pool should be rejected");
+    if (buffer_pool_use(buffer_pool_current()) != NULL)
+        TEST_FAIL("Using the current pool again should be accepted");
+    buffer_pool_stats_t stats;
+    if (buffer_pool_get_stats(NULL, &stats) != -1 || buffer_pool_get_stats(buffer_pool_current(), NULL) != -1)
+        TEST_FAIL("get_stats should validate its input");
+    TEST_PASS("use and get_stats validate their input");
+}
+
+// Allocator that counts, to see which buffers the queue makes and frees itself
+static long counted_allocs = 0;
+static long counted_frees = 0;
+static void* counting_alloc(size_t bytes) {
+    counted_allocs++;
+    return malloc(bytes);
+}
+static void counting_free(void* item) {
+    if (item != NULL)
+        counted_frees++;
+    free(item);
+}
+
+void test_queue_allocator() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_set_allocator(NULL, counting_alloc, counting_free) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_allocator(&queue, counting_alloc, counting_free) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+    consumer_producer_init(&queue, 8);
+    if (consumer_producer_set_allocator(&queue, counting_alloc, NULL) == NULL)
+        TEST_FAIL("A one-sided allocator should be rejected");
+    if (consumer_producer_set_allocator(&queue, counting_alloc, counting_free) != NULL)
+        TEST_FAIL("Valid allocator rejected");
+
+    consumer_producer_put_copy(&queue, "a");
+    consumer_producer_put_copy(&queue, "b");
+    consumer_producer_put(&queue, strdup("owned"));
+    char* got = consumer_producer_get(&queue);
+    if (got == NULL || strcmp(got, "a") != 0 || counted_allocs != 2)
+        TEST_FAIL("Copies should come from the queue's allocator");
+    counting_free(got);
+    consumer_producer_destroy(&queue);
+    if (counted_frees != 3)
+        TEST_FAIL("Leftover items should go back through the queue's free function");
+
+    // Back to malloc/free
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 8);
+    consumer_producer_set_allocator(&queue, counting_alloc, counting_free);
+    if (consumer_producer_set_allocator(&queue, NULL, NULL) != NULL)
+        TEST_FAIL("Resetting the allocator should work");
+    consumer_producer_put_copy(&queue, "c");
+    consumer_producer_destroy(&queue);
+    if (counted_allocs != 2 || counted_frees != 3)
+        TEST_FAIL("A reset queue should use malloc/free again");
+    TEST_PASS("Queues make and free their own item buffers through the allocator they are given");
+}
+
+void* pooled_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char buf[64];
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        snprintf(buf, sizeof(buf), "%d %s", i, i % 3 == 0 ? "with a somewhat longer tail to it" : "");
+        if (consumer_producer_put_copy(queue, buf) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    buffer_pool_flush_thread();
+    return NULL;
+}
+
+void test_cross_thread_steady_state() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 64);
+    consumer_producer_set_allocator(&queue, buffer_pool_alloc, buffer_pool_free);
+    buffer_pool_stats_t warm, done;
+    buffer_pool_get_stats(buffer_pool_current(), &warm);
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, pooled_producer, &queue);
+
+    // Allocated by the producer, freed here: buffers must flow back to it through the pool
+    long expected = 0;
+    char* out[16];
+    int n;
+    while ((n = consumer_producer_get_batch(&queue, out, 16)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (strtol(out[k], NULL, 10) != expected)
+                TEST_FAIL("Items out of order");
+            expected++;
+            buffer_pool_free(out[k]);
+        }
+        if (expected == STREAM_ITEMS / 2)
+            buffer_pool_get_stats(buffer_pool_current(), &warm);
+    }
+    pthread_join(producer, NULL);
+    buffer_pool_flush_thread();
+    buffer_pool_get_stats(buffer_pool_current(), &done);
+    if (expected != STREAM_ITEMS)
+        TEST_FAIL("Stream should be delivered completely");
+    if (done.misses != warm.misses || done.fallbacks != warm.fallbacks)
+        TEST_FAIL("Once warm, the pool should not carve slabs or call malloc anymore");
+    if (done.returned <= warm.returned || done.hits < STREAM_ITEMS / 2)
+        TEST_FAIL("Buffers should come back through the return lists and be reused");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Buffers freed in another thread are reused: no slab or malloc in steady state");
+}
+
+int main() {
+    printf("=== Testing buffer pool ===\n");
+    test_size_classes();
+    test_realloc_and_foreign_buffers();
+    test_use_validation();
+    test_queue_allocator();
+    test_cross_thread_steady_state();
+    printf(GREEN "All buffer pool tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 50000
+#define STREAM_BYTES 512
+
+// A string of len characters: accounts for len + 1 bytes
+static char* item_of_len(size_t len, char fill) {
+    char* s = malloc(len + 1);
+    memset(s, fill, len);
+    s[len] = '\0';
+    return s;
+}
+
+void test_set_byte_budget_validation() {
+    consumer_producer_t queue;
+    cp_byte_budget_t budget;
+    memset(&queue, 0, sizeof(queue));
+    memset(&budget, 0, sizeof(budget));
+
+    if (consumer_producer_budget_init(NULL, 64) == NULL)
+        TEST_FAIL("NULL budget should be rejected");
+    if (consumer_producer_budget_init(&budget, 0) == NULL)
+        TEST_FAIL("Zero budget limit should be rejected");
+    if (consumer_producer_set_byte_budget(NULL, 64, NULL, 0) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_byte_budget(&queue, 64, NULL, 0) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (consumer_producer_set_byte_budget(&queue, 64, &budget, 0) == NULL)
+        TEST_FAIL("Uninitialized shared budget should be rejected");
+    consumer_producer_budget_init(&budget, 64);
+    if (consumer_producer_set_byte_budget(&queue, 64, &budget, 2) == NULL)
+        TEST_FAIL("Gate flag other than 0/1 should be rejected");
+    if (consumer_producer_set_byte_budget(&queue, 64, &budget, 1) != NULL)
+        TEST_FAIL("Valid budgets rejected");
+
+    consumer_producer_put(&queue, strdup("x"));
+    cp_byte_budget_t other;
+    consumer_producer_budget_init(&other, 64);
+    if (consumer_producer_set_byte_budget(&queue, 64, &other, 0) == NULL)
+        TEST_FAIL("Switching shared budgets on a non-empty queue should be rejected");
+    consumer_producer_destroy(&queue);
+    if (atomic_load(&budget.used) != 0)
+        TEST_FAIL("destroy should credit leftover bytes back to the shared budget");
+    consumer_producer_budget_destroy(&other);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    if (consumer_producer_set_byte_budget(&queue, 64, NULL, 0) == NULL)
+        TEST_FAIL("Lock-free modes should reject byte budgets");
+    consumer_producer_destroy(&queue);
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("set_byte_budget validates its input");
+}
+
+void test_queue_budget_limits_bytes() {
+    consumer_producer_t queue;
+    cp_stats_t stats;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 16);
+    consumer_producer_set_byte_budget(&queue, 100, NULL, 0);
+
+    // Two 40-byte items fit (80 bytes), a third would need 120 despite 14 free slots
+    consumer_producer_put(&queue, item_of_len(39, 'a'));
+    consumer_producer_put(&queue, item_of_len(39, 'b'));
+    char* extra = item_of_len(39, 'c');
+    if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("Put over the byte budget should wait even with free slots");
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.bytes != 80 || stats.peak_bytes != 80 || stats.byte_budget != 100 || stats.count != 2)
+        TEST_FAIL("Stats should report the queued bytes and the budget");
+
+    free(consumer_producer_get(&queue));
+    if (consumer_producer_try_put(&queue, extra) != NULL)
+        TEST_FAIL("Put should succeed once a get released bytes");
+
+    while (consumer_producer_try_get(&queue, &extra) == 1)
+        free(extra);
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.bytes != 0 || stats.peak_bytes != 80)
+        TEST_FAIL("Drained queue should hold no bytes and keep its peak");
+
+    // A single item larger than the whole budget is admitted into an empty queue
+    if (consumer_producer_try_put(&queue, item_of_len(500, 'z')) != NULL)
+        TEST_FAIL("Oversized item should be admitted into an empty queue");
+    extra = strdup("small");
+    if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("Nothing else fits behind an oversized item");
+    free(extra);
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Per-queue byte budget holds puts back independently of free slots");
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    long delay_ms;
+} delayed_args_t;
+
+void* delayed_get(void* arg) {
+    delayed_args_t* a = (delayed_args_t*)arg;
+    sleep_ms(a->delay_ms);
+    free(consumer_producer_get(a->queue));
+    return NULL;
+}
+
+void test_blocked_put_wakes_on_get() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 16);
+    consumer_producer_set_byte_budget(&queue, 64, NULL, 0);
+    consumer_producer_put(&queue, item_of_len(49, 'a'));
+
+    delayed_args_t args = { &queue, 30 };
+    pthread_t getter;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&getter, NULL, delayed_get, &args);
+
+    if (consumer_producer_put(&queue, item_of_len(49, 'b')) != NULL)
+        TEST_FAIL("Blocking put failed");
+    long waited = elapsed_ms(&start);
+    if (waited < 25 || waited > 5000)
+        TEST_FAIL("Put should block until the consumer released bytes");
+
+    pthread_join(getter, NULL);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Put blocked on bytes resumes when a get releases them");
+}
+
+void test_shared_budget_gates_entry_queue() {
+    consumer_producer_t entry, inner;
+    cp_byte_budget_t budget;
+    memset(&entry, 0, sizeof(entry));
+    memset(&inner, 0, sizeof(inner));
+    consumer_producer_budget_init(&budget, 100);
+    consumer_producer_init(&entry, 16);
+    consumer_producer_init(&inner, 16);
+    consumer_producer_set_byte_budget(&entry, 0, &budget, 1);
+    consumer_producer_set_byte_budget(&inner, 0, &budget, 0);
+
+    // Bytes held further down the chain count against the entry queue
+    consumer_producer_put(&inner, item_of_len(59, 'i'));
+    consumer_producer_put(&entry, item_of_len(29, 'e'));
+    if (atomic_load(&budget.used) != 90)
+        TEST_FAIL("Shared budget should account both queues");
+
+    char* extra = item_of_len(19, 'x');
+    if (consumer_producer_try_put(&entry, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("Gated entry queue should wait for room in the shared budget");
+
+    // The accounting queue never waits, even over the shared limit
+    if (consumer_producer_try_put(&inner, strdup("inner may overshoot")) != NULL)
+        TEST_FAIL("Non-gated queue must not wait on the shared budget");
+    if (atomic_load(&budget.used) <= 100 || atomic_load(&budget.peak) != atomic_load(&budget.used))
+        TEST_FAIL("Shared budget should track its overshoot and peak");
+
+    // Draining the inner queue makes room for the entry queue again
+    char* item;
+    while (consumer_producer_try_get(&inner, &item) == 1)
+        free(item);
+    if (consumer_producer_try_put(&entry, extra) != NULL)
+        TEST_FAIL("Entry queue should accept once the inner stage released bytes");
+
+    consumer_producer_destroy(&entry);
+    consumer_producer_destroy(&inner);
+    if (atomic_load(&budget.used) != 0)
+        TEST_FAIL("All bytes should be credited back after destroy");
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("Shared budget gates the entry queue on bytes held anywhere in the chain");
+}
+
+typedef struct {
+    consumer_producer_t* from;  // NULL for the source stage
+    consumer_producer_t* to;
+} stage_args_t;
+
+void* source_stage(void* arg) {
+    stage_args_t* a = (stage_args_t*)arg;
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        // Mixed line lengths: the number, padded a little, every 16th line a lot
+        size_t pad = (i % 16 == 0) ? 200 : (size_t)(i % 7);
+        char* s = malloc(16 + pad);
+        int len = snprintf(s, 16, "%d", i);
+        memset(s + len, ' ', pad);
+        s[len + pad] = '\0';
+        if (consumer_producer_put(a->to, s) != NULL)
+            TEST_FAIL("Source put failed");
+    }
+    consumer_producer_signal_finished(a->to);
+    return NULL;
+}
+
+void* relay_stage(void* arg) {
+    stage_args_t* a = (stage_args_t*)arg;
+    char* batch[8];
+    int n;
+    while ((n = consumer_producer_get_batch(a->from, batch, 8)) > 0) {
+        int put = 0;
+        if (consumer_producer_put_batch(a->to, batch, n, &put) != NULL || put != n)
+            TEST_FAIL("Relay put failed");
+    }
+    consumer_producer_signal_finished(a->to);
+    return NULL;
+}
+
+void test_threaded_pipeline_under_budget() {
+    consumer_producer_t first, second;
+    cp_byte_budget_t budget;
+    memset(&first, 0, sizeof(first));
+    memset(&second, 0, sizeof(second));
+    consumer_producer_budget_init(&budget, STREAM_BYTES);
+    consumer_producer_init(&first, 64);
+    consumer_producer_init(&second, 64);
+    consumer_producer_set_byte_budget(&first, STREAM_BYTES / 2, &budget, 1);
+    consumer_producer_set_byte_budget(&second, STREAM_BYTES / 2, &budget, 0);
+
+    stage_args_t src = { NULL, &first };
+    stage_args_t mid = { &first, &second };
+    pthread_t source, relay;
+    pthread_create(&source, NULL, source_stage, &src);
+    pthread_create(&relay, NULL, relay_stage, &mid);
+
+    long expected = 0;
+    char* item;
+    while ((item = consumer_producer_get(&second)) != NULL) {
+        if (strtol(item, NULL, 10) != expected)
+            TEST_FAIL("Items out of order under a byte budget");
+        expected++;
+        free(item);
+    }
+    pthread_join(source, NULL);
+    pthread_join(relay, NULL);
+    if (expected != STREAM_ITEMS)
+        TEST_FAIL("Items lost under a byte budget");
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&first, &stats);
+    if (stats.bytes != 0 || stats.peak_bytes > STREAM_BYTES / 2)
+        TEST_FAIL("Entry queue exceeded its byte budget");
+    if (atomic_load(&budget.used) != 0)
+        TEST_FAIL("Shared budget should be empty after the stream drained");
+
+    consumer_producer_destroy(&first);
+    consumer_producer_destroy(&second);
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("Two-stage stream with mixed line lengths stays within its byte budgets");
+}
+
+int main() {
+    printf("=== Testing consumer_producer byte budgets ===\n");
+    test_set_byte_budget_validation();
+    test_queue_budget_limits_bytes();
+    test_blocked_put_wakes_on_get();
+    test_shared_budget_gates_entry_queue();
+    test_threaded_pipeline_under_budget();
+    printf(GREEN "All byte budget tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 20000
+
+static const char* const BACKENDS[] = { "locked", "spsc", "mpmc", "inline" };
+#define BACKEND_COUNT (sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+
+void test_credits_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_credits(NULL) != -1 || consumer_producer_wait_credits(NULL, NULL) != -1)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_credits(&queue) != -1 || consumer_producer_wait_credits(&queue, NULL) != -1)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    cp_backend_t incomplete = cp_backend_locked;
+    incomplete.credits = NULL;
+    if (consumer_producer_init_backend(&queue, 4, &incomplete) == NULL)
+        TEST_FAIL("Backend without a credits hook should be rejected");
+    TEST_PASS("Credit calls validate their input");
+}
+
+void test_credits_follow_free_slots() {
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        consumer_producer_t queue;
+        init_backend(&queue, 4, consumer_producer_backend(BACKENDS[b]));
+        if (consumer_producer_credits(&queue) != 4)
+            TEST_FAIL("An empty queue should grant its capacity");
+        for (int i = 0; i < 3; ++i)
+            consumer_producer_put(&queue, item_for(i));
+        if (consumer_producer_wait_credits(&queue, NULL) != 1)
+            TEST_FAIL("Credits should match the free slots");
+        consumer_producer_put(&queue, item_for(3));
+        if (consumer_producer_credits(&queue) != 0)
+            TEST_FAIL("A full queue should grant no credits");
+
+        // A full queue starves the producer until the deadline
+        struct timespec deadline;
+        consumer_producer_deadline_after(&deadline, 10);
+        if (consumer_producer_wait_credits(&queue, &deadline) != CP_TIMEDOUT)
+            TEST_FAIL("wait_credits on a full queue should time out");
+        cp_stats_t stats;
+        consumer_producer_get_stats(&queue, &stats);
+        if (stats.credit_grants != 1 || stats.credit_stalls != 1 || stats.credit_stall_ns < 5000000)
+            TEST_FAIL("Grants and stalls should be counted");
+
+        free(consumer_producer_get(&queue));
+        if (consumer_producer_wait_credits(&queue, NULL) != 1)
+            TEST_FAIL("A get should give a credit back");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Every backend grants one credit per free slot and counts stalls");
+}
+
+void test_credits_on_locked_features() {
+    // Elastic queues grant up to their maximum
+    consumer_producer_t queue;
+    init_queue(&queue, 4);
+    consumer_producer_set_elastic(&queue, 16, 0, 0, 0);
+    if (consumer_producer_credits(&queue) != 16)
+        TEST_FAIL("Elastic queues should grant up to their maximum capacity");
+    consumer_producer_destroy(&queue);
+
+    // A spent byte budget grants nothing, even with free slots
+    init_queue(&queue, 8);
+    consumer_producer_set_byte_budget(&queue, 8, NULL, 0);
+    consumer_producer_put(&queue, strdup("12345678"));
+    if (consumer_producer_credits(&queue) != 0)
+        TEST_FAIL("A spent byte budget should grant no credits");
+    free(consumer_producer_get(&queue));
+    if (consumer_producer_credits(&queue) != 1)
+        TEST_FAIL("Freed bytes should give a credit back");
+    consumer_producer_destroy(&queue);
+
+    // Dropping policies never make a put wait
+    init_queue(&queue, 2);
+    consumer_producer_set_overflow(&queue, CP_OVERFLOW_DROP_OLDEST, 0, NULL, NULL);
+    consumer_producer_put(&queue, item_for(0));
+    consumer_producer_put(&queue, item_for(1));
+    if (consumer_producer_credits(&queue) != 2)
+        TEST_FAIL("Shedding queues should always grant their capacity");
+    consumer_producer_destroy(&queue);
+
+    // After finished nothing may be put anymore
+    init_queue(&queue, 2);
+    consumer_producer_signal_finished(&queue);
+    if (consumer_producer_credits(&queue) != 0 || consumer_producer_wait_credits(&queue, NULL) != -1)
+        TEST_FAIL("A finished queue should grant no credits");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Credits account for elastic growth, byte budgets, overflow policies and finished");
+}
+
+void test_byte_budget_grants_one_credit() {
+    // Eight free slots, but only 10 bytes of the 30 left: two more 10-byte items would not fit
+    consumer_producer_t queue;
+    init_queue(&queue, 10);
+    consumer_producer_set_byte_budget(&queue, 30, NULL, 0);
+    consumer_producer_put(&queue, strdup("123456789"));
+    consumer_producer_put(&queue, strdup("123456789"));
+
+    int credits = consumer_producer_credits(&queue);
+    if (credits != 1)
+        TEST_FAIL("A queue under a byte budget should grant one credit at a time");
+    for (int k = 0; k < credits; ++k) {
+        char* item = strdup("123456789");
+        if (consumer_producer_try_put(&queue, item) != NULL)
+            TEST_FAIL("A put within the granted credits should not wait for bytes");
+    }
+    if (consumer_producer_credits(&queue) != 0)
+        TEST_FAIL("A spent byte budget should grant no credits");
+    consumer_producer_destroy(&queue);
+
+    // The same holds for the entry queue of a shared budget
+    cp_byte_budget_t budget;
+    consumer_producer_budget_init(&budget, 64);
+    init_queue(&queue, 10);
+    consumer_producer_set_byte_budget(&queue, 0, &budget, 1);
+    if (consumer_producer_credits(&queue) != 1)
+        TEST_FAIL("A gate queue should grant one credit at a time");
+    consumer_producer_destroy(&queue);
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("Byte budgets grant one credit at a time, so credit holders never block on bytes mid-batch");
+}
+
+// Producer that batches against credits: a try_put within its credits must never find the queue full
+void* credit_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    int i = 0;
+    while (i < STREAM_ITEMS) {
+        int credits = consumer_producer_wait_credits(queue, NULL);
+        if (credits <= 0)
+            TEST_FAIL("wait_credits failed");
+        for (int k = 0; k < credits && i < STREAM_ITEMS; ++k, ++i) {
+            char* item = item_for(i);
+            if (consumer_producer_try_put(queue, item) != NULL)
+                TEST_FAIL("A put within the granted credits should never wait");
+        }
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_producer_never_blocks_within_credits() {
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        consumer_producer_t queue;
+        init_backend(&queue, 8, consumer_producer_backend(BACKENDS[b]));
+        pthread_t producer;
+        pthread_create(&producer, NULL, credit_producer, &queue);
+
+        // A consumer that pauses now and then, so the producer runs out of credits
+        long expected = 0;
+        char* out[4];
+        int n;
+        while ((n = consumer_producer_get_batch(&queue, out, 4)) > 0) {
+            for (int k = 0; k < n; ++k) {
+                if (strtol(out[k], NULL, 10) != expected)
+                    TEST_FAIL("Items out of order");
+                expected++;
+                free(out[k]);
+            }
+            if (expected % 1024 < 4)
+                sleep_us(200);
+        }
+        pthread_join(producer, NULL);
+        if (expected != STREAM_ITEMS)
+            TEST_FAIL("Stream should be delivered completely");
+
+        cp_stats_t stats;
+        consumer_producer_get_stats(&queue, &stats);
+        if (stats.credit_grants == 0 || stats.credit_stalls == 0 || stats.credit_stalls > stats.credit_grants + 1)
+            TEST_FAIL("A starved producer should show up as credit stalls");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("A producer batching against credits never blocks mid-put on any backend");
+}
+
+// A grant holder that puts nothing (a pool worker whose batch waits for the one ahead of it)
+void* idle_credit_waiter(void* arg) {
+    if (consumer_producer_wait_credits((consumer_producer_t*)arg, NULL) <= 0)
+        TEST_FAIL("wait_credits failed");
+    return NULL;
+}
+
+static atomic_int late_put_done;
+void* late_putter(void* arg) {
+    if (consumer_producer_put((consumer_producer_t*)arg, item_for(2)) != NULL)
+        TEST_FAIL("Put failed");
+    atomic_store(&late_put_done, 1);
+    return NULL;
+}
+
+void test_credit_wait_passes_wakeup_on() {
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        if (strcmp(BACKENDS[b], "spsc") == 0)
+            continue;   // A single producer: nobody to pass a wakeup to
+        consumer_producer_t queue;
+        init_backend(&queue, 2, consumer_producer_backend(BACKENDS[b]));
+        consumer_producer_put(&queue, item_for(0));
+        consumer_producer_put(&queue, item_for(1));
+
+        // Both asleep on the full queue, the grant first in line
+        atomic_store(&late_put_done, 0);
+        pthread_t waiter, putter;
+        pthread_create(&waiter, NULL, idle_credit_waiter, &queue);
+        sleep_us(20000);
+        pthread_create(&putter, NULL, late_putter, &queue);
+        sleep_us(20000);
+
+        // One free slot: whoever gets the wakeup, the put must not keep sleeping
+        free(consumer_producer_get(&queue));
+        for (int i = 0; i < 200 && !atomic_load(&late_put_done); ++i)
+            sleep_us(10000);
+        if (!atomic_load(&late_put_done))
+            TEST_FAIL("A put should not sleep on a queue with room while a credit grant took its wakeup");
+        pthread_join(waiter, NULL);
+        pthread_join(putter, NULL);
+        free(consumer_producer_get(&queue));
+        free(consumer_producer_get(&queue));
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("A credit grant passes its wakeup on to a put waiting behind it");
+}
+
+int main() {
+    printf("=== Testing consumer_producer credits ===\n");
+    test_credits_validation();
+    test_credits_follow_free_slots();
+    test_credits_on_locked_features();
+    test_byte_budget_grants_one_credit();
+    test_producer_never_blocks_within_credits();
+    test_credit_wait_passes_wakeup_on();
+    printf(GREEN "All credit tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 100000
+
+static void init_elastic(consumer_producer_t* queue, int capacity, int max_capacity, int shrink_after) {
+    init_queue(queue, capacity);
+    if (consumer_producer_set_elastic(queue, max_capacity, 75, 25, shrink_after) != NULL)
+        TEST_FAIL("set_elastic failed");
+}
+
+void test_set_elastic_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_set_elastic(NULL, 8, 0, 0, 0) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_elastic(&queue, 8, 0, 0, 0) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (consumer_producer_set_elastic(&queue, 2, 0, 0, 0) == NULL)
+        TEST_FAIL("Maximum below the initial capacity should be rejected");
+    if (consumer_producer_set_elastic(&queue, 8, 101, 0, 0) == NULL)
+        TEST_FAIL("High watermark above 100 percent should be rejected");
+    if (consumer_producer_set_elastic(&queue, 8, 60, 30, 0) == NULL)
+        TEST_FAIL("Low watermark must stay below half the high watermark");
+    if (consumer_producer_set_elastic(&queue, 8, 0, 0, -1) == NULL)
+        TEST_FAIL("Negative shrink delay should be rejected");
+    if (consumer_producer_set_elastic(&queue, 8, 0, 0, 0) != NULL)
+        TEST_FAIL("Defaults should be accepted");
+    if (queue.high_watermark != CP_ELASTIC_HIGH_DEFAULT || queue.low_watermark != CP_ELASTIC_LOW_DEFAULT ||
+        queue.shrink_after != CP_ELASTIC_SHRINK_AFTER_DEFAULT)
+        TEST_FAIL("Zero should select the default watermarks and delay");
+    consumer_producer_destroy(&queue);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    if (consumer_producer_set_elastic(&queue, 8, 0, 0, 0) == NULL)
+        TEST_FAIL("Lock-free modes should reject elastic capacity");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("set_elastic validates its input");
+}
+
+void test_grows_instead_of_blocking() {
+    consumer_producer_t queue;
+    init_elastic(&queue, 4, 16, 4);
+    cp_stats_t stats;
+
+    // A single thread can burst well past the initial capacity without blocking
+    for (int i = 0; i < 16; ++i) {
+        if (consumer_producer_try_put(&queue, item_for(i)) != NULL)
+            TEST_FAIL("Elastic queue should grow instead of reporting full");
+    }
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 16 || stats.count != 16 || stats.peak_capacity != 16 || stats.grows != 2)
+        TEST_FAIL("Queue should have doubled twice to its maximum");
+
+    // At the maximum, backpressure applies again
+    char* extra = strdup("extra");
+    if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("Queue must not grow beyond its maximum");
+    free(extra);
+
+    // Resizing keeps FIFO order
+    for (int i = 0; i < 16; ++i) {
+        char* item = consumer_producer_get(&queue);
+        if (item == NULL || strtol(item, NULL, 10) != i)
+            TEST_FAIL("Items out of order after a resize");
+        free(item);
+    }
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Elastic queue grows on bursts up to its maximum");
+}
+
+void test_grows_early_at_high_watermark() {
+    consumer_producer_t queue;
+    init_elastic(&queue, 8, 64, 4);
+    cp_stats_t stats;
+
+    // 6 of 8 slots = 75%: the put that reaches the high watermark doubles the queue
+    for (int i = 0; i < 5; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 8 || stats.grows != 0)
+        TEST_FAIL("Queue grew below the high watermark");
+    consumer_producer_put(&queue, item_for(5));
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 16 || stats.grows != 1)
+        TEST_FAIL("Queue should grow when a put reaches the high watermark");
+
+    consumer_producer_destroy(&queue);  // Frees the queued items
+    TEST_PASS("Elastic queue grows ahead of a stall at the high watermark");
+}
+
+void test_shrinks_after_sustained_low_occupancy() {
+    consumer_producer_t queue;
+    init_elastic(&queue, 4, 32, 8);
+    cp_stats_t stats;
+
+    // Wrap the ring first so the shrink has to unwrap items as well
+    for (int i = 0; i < 3; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    for (int i = 0; i < 3; ++i)
+        free(consumer_producer_get(&queue));
+
+    for (int i = 0; i < 32; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 32)
+        TEST_FAIL("Burst should have grown the queue to its maximum");
+
+    // Drain, then keep a trickle going: one item in flight, far below the low watermark
+    for (int i = 0; i < 32; ++i)
+        free(consumer_producer_get(&queue));
+    for (int i = 0; i < 64; ++i) {
+        consumer_producer_put(&queue, item_for(i));
+        char* item = consumer_producer_get(&queue);
+        if (item == NULL || strtol(item, NULL, 10) != i)
+            TEST_FAIL("Items out of order while shrinking");
+        free(item);
+    }
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 4 || stats.min_capacity != 4 || stats.peak_capacity != 32)
+        TEST_FAIL("Idle queue should shrink back to its initial capacity");
+    if (stats.shrinks != 3)
+        TEST_FAIL("Each halving should be counted as one shrink");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Elastic queue shrinks back after sustained low occupancy");
+}
+
+void test_stats_for_fixed_queues() {
+    consumer_producer_mode_t modes[] = { CP_MODE_LOCKED, CP_MODE_SPSC, CP_MODE_MPMC };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        consumer_producer_t queue;
+        cp_stats_t stats;
+        memset(&queue, 0, sizeof(queue));
+        consumer_producer_init_mode(&queue, 8, modes[m]);
+        consumer_producer_put(&queue, strdup("a"));
+        consumer_producer_put(&queue, strdup("b"));
+        if (consumer_producer_get_stats(&queue, &stats) != 0)
+            TEST_FAIL("get_stats failed");
+        if (stats.capacity != 8 || stats.count != 2 || stats.min_capacity != 8 || stats.max_capacity != 8 ||
+            stats.grows != 0 || stats.shrinks != 0)
+            TEST_FAIL("Fixed queue stats are wrong");
+        consumer_producer_destroy(&queue);
+    }
+    if (consumer_producer_get_stats(NULL, NULL) != -1)
+        TEST_FAIL("get_stats should reject NULL");
+    TEST_PASS("get_stats reports fixed queues in every mode");
+}
+
+void* elastic_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        if (consumer_producer_put(queue, item_for(i)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_threaded_stream_with_resizes() {
+    consumer_producer_t queue;
+    init_elastic(&queue, 2, 256, 16);
+    pthread_t producer;
+    pthread_create(&producer, NULL, elastic_producer, &queue);
+
+    long expected = 0;
+    char* batch[8];
+    int n;
+    while ((n = consumer_producer_get_batch(&queue, batch, 8)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (strtol(batch[k], NULL, 10) != expected)
+                TEST_FAIL("Items out of order across resizes");
+            expected++;
+            free(batch[k]);
+        }
+    }
+    pthread_join(producer, NULL);
+    if (expected != STREAM_ITEMS)
+        TEST_FAIL("Items lost across resizes");
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity < 2 || stats.capacity > 256 || stats.peak_capacity > 256)
+        TEST_FAIL("Capacity left its bounds");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Concurrent producer and consumer keep FIFO order while the queue resizes");
+}
+
+int main() {
+    printf("=== Testing consumer_producer elastic capacity ===\n");
+    test_set_elastic_validation();
+    test_grows_instead_of_blocking();
+    test_grows_early_at_high_watermark();
+    test_shrinks_after_sustained_low_occupancy();
+    test_stats_for_fixed_queues();
+    test_threaded_stream_with_resizes();
+    printf(GREEN "All elastic capacity tests passed.\n" NC);
+    return 0;
+}
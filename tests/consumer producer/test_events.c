@@ -0,0 +1,175 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include "test_util.h"
+
+#define QUEUES          4
+#define ITEMS_PER_QUEUE 20000
+
+static const consumer_producer_mode_t MODES[] = { CP_MODE_LOCKED, CP_MODE_SPSC, CP_MODE_MPMC };
+#define MODE_COUNT (sizeof(MODES) / sizeof(MODES[0]))
+
+static int fd_readable(int fd) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, 0) == 1 && (p.revents & POLLIN);
+}
+
+void test_enable_events_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_enable_events(NULL) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_enable_events(&queue) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 2);
+    if (consumer_producer_items_fd(&queue) != -1 || consumer_producer_space_fd(&queue) != -1)
+        TEST_FAIL("Event fds should be -1 before enable_events");
+    if (consumer_producer_enable_events(&queue) != NULL)
+        TEST_FAIL("enable_events failed");
+    if (consumer_producer_enable_events(&queue) == NULL)
+        TEST_FAIL("Enabling events twice should be rejected");
+    if (consumer_producer_items_fd(&queue) < 0 || consumer_producer_space_fd(&queue) < 0)
+        TEST_FAIL("Event fds not exposed");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("enable_events validates its input and exposes both fds");
+}
+
+void test_readiness_follows_transitions() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        memset(&queue, 0, sizeof(queue));
+        consumer_producer_init_mode(&queue, 2, MODES[m]);
+        consumer_producer_enable_events(&queue);
+        int items_fd = consumer_producer_items_fd(&queue);
+        int space_fd = consumer_producer_space_fd(&queue);
+        char* item = NULL;
+
+        if (fd_readable(items_fd) || !fd_readable(space_fd))
+            TEST_FAIL("Empty queue: items fd must be idle and space fd ready");
+
+        consumer_producer_put(&queue, strdup("a"));
+        if (!fd_readable(items_fd))
+            TEST_FAIL("Items fd must fire on empty -> non-empty");
+
+        consumer_producer_put(&queue, strdup("b"));
+        char* extra = strdup("c");
+        if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+            TEST_FAIL("try_put on a full queue should fail");
+        if (fd_readable(space_fd))
+            TEST_FAIL("Space fd must be idle after try_put found the queue full");
+
+        if (consumer_producer_try_get(&queue, &item) != 1)
+            TEST_FAIL("try_get should return an item");
+        free(item);
+        if (!fd_readable(space_fd))
+            TEST_FAIL("Space fd must fire on full -> non-full");
+        if (consumer_producer_try_put(&queue, extra) != NULL)
+            TEST_FAIL("try_put should succeed once space fired");
+
+        while (consumer_producer_try_get(&queue, &item) == 1)
+            free(item);
+        if (fd_readable(items_fd))
+            TEST_FAIL("Items fd must be idle after try_get found the queue empty");
+
+        consumer_producer_signal_finished(&queue);
+        if (!fd_readable(items_fd))
+            TEST_FAIL("Items fd must fire on finished");
+        if (consumer_producer_try_get(&queue, &item) != 0)
+            TEST_FAIL("try_get should report finished and drained");
+
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Readiness fds follow empty/full transitions and finished");
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    int id;
+} producer_args_t;
+
+void* queue_producer(void* arg) {
+    producer_args_t* a = (producer_args_t*)arg;
+    char buf[32];
+    for (int i = 0; i < ITEMS_PER_QUEUE; ++i) {
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (consumer_producer_put(a->queue, strdup(buf)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(a->queue);
+    return NULL;
+}
+
+void test_epoll_multiplexes_queues() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queues[QUEUES];
+        producer_args_t args[QUEUES];
+        pthread_t producers[QUEUES];
+        long expected[QUEUES] = { 0 };
+        int finished = 0;
+
+        int ep = epoll_create1(0);
+        if (ep < 0)
+            TEST_FAIL("epoll_create1 failed");
+
+        for (int q = 0; q < QUEUES; ++q) {
+            memset(&queues[q], 0, sizeof(queues[q]));
+            consumer_producer_init_mode(&queues[q], 8, MODES[m]);
+            consumer_producer_enable_events(&queues[q]);
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)q };
+            epoll_ctl(ep, EPOLL_CTL_ADD, consumer_producer_items_fd(&queues[q]), &ev);
+        }
+        for (int q = 0; q < QUEUES; ++q) {
+            args[q].queue = &queues[q];
+            args[q].id = q;
+            pthread_create(&producers[q], NULL, queue_producer, &args[q]);
+        }
+
+        // One thread serves every queue: wait for readiness, drain until the queue says empty
+        while (finished < QUEUES) {
+            struct epoll_event events[QUEUES];
+            int n = epoll_wait(ep, events, QUEUES, 5000);
+            if (n <= 0)
+                TEST_FAIL("epoll_wait timed out: a readiness notification was lost");
+            for (int e = 0; e < n; ++e) {
+                int q = (int)events[e].data.u32;
+                char* item;
+                int rc;
+                while ((rc = consumer_producer_try_get(&queues[q], &item)) == 1) {
+                    if (strtol(item, NULL, 10) != expected[q])
+                        TEST_FAIL("Items delivered out of order");
+                    expected[q]++;
+                    free(item);
+                }
+                if (rc == 0) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, consumer_producer_items_fd(&queues[q]), NULL);
+                    finished++;
+                } else if (rc != CP_TIMEDOUT) {
+                    TEST_FAIL("try_get failed");
+                }
+            }
+        }
+
+        for (int q = 0; q < QUEUES; ++q) {
+            pthread_join(producers[q], NULL);
+            if (expected[q] != ITEMS_PER_QUEUE)
+                TEST_FAIL("Items lost");
+            consumer_producer_destroy(&queues[q]);
+        }
+        close(ep);
+    }
+    TEST_PASS("One epoll loop drains several queues without lost wakeups");
+}
+
+int main() {
+    printf("=== Testing consumer_producer readiness eventfds ===\n");
+    test_enable_events_validation();
+    test_readiness_follows_transitions();
+    test_epoll_multiplexes_queues();
+    printf(GREEN "All readiness event tests passed.\n" NC);
+    return 0;
+}
@@ -24,8 +24,8 @@ void test_valid_initialization() {
     if (!queue.initialized)
         TEST_FAIL("Queue should be marked as initialized");
 
-    if (!queue.not_empty_monitor.initialized || !queue.not_full_monitor.initialized || !queue.finished_monitor.initialized)
-        TEST_FAIL("One or more monitors not initialized properly");
+    if (queue.producers_waiting != 0 || queue.consumers_waiting != 0 || queue.finish_waiters != 0)
+        TEST_FAIL("Waiter counts not initialized properly");
 
     consumer_producer_destroy(&queue);
     TEST_PASS("Valid initialization");
@@ -0,0 +1,229 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define SLOT_SIZE    32
+#define BATCH        8
+#define STREAM_ITEMS 100000
+
+static void init_inline(consumer_producer_t* queue, int capacity) {
+    init_queue(queue, capacity);
+    if (consumer_producer_set_inline(queue, SLOT_SIZE) != NULL)
+        TEST_FAIL("set_inline failed");
+}
+
+// Line i of a stream: short most of the time, longer than a slot every 10th line
+static void line_for(int i, char* buf, size_t size) {
+    if (i % 10 == 0)
+        snprintf(buf, size, "%d %s", i, "a line that does not fit into a thirty-two byte slot");
+    else
+        snprintf(buf, size, "%d", i);
+}
+
+void test_set_inline_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_set_inline(NULL, SLOT_SIZE) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_inline(&queue, SLOT_SIZE) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (consumer_producer_set_inline(&queue, CP_INLINE_MIN - 1) == NULL)
+        TEST_FAIL("Slot size below the minimum should be rejected");
+    if (consumer_producer_set_inline(&queue, CP_INLINE_MAX + 1) == NULL)
+        TEST_FAIL("Slot size above the maximum should be rejected");
+    consumer_producer_put(&queue, strdup("x"));
+    if (consumer_producer_set_inline(&queue, SLOT_SIZE) == NULL)
+        TEST_FAIL("Non-empty queue should be rejected");
+    free(consumer_producer_get(&queue));
+    if (consumer_producer_set_inline(&queue, SLOT_SIZE) != NULL)
+        TEST_FAIL("Valid slot size rejected");
+    consumer_producer_destroy(&queue);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    if (consumer_producer_set_inline(&queue, SLOT_SIZE) == NULL)
+        TEST_FAIL("Lock-free modes should reject inline slots");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("set_inline validates its input");
+}
+
+void test_short_strings_stay_inline() {
+    consumer_producer_t queue;
+    cp_scratch_t scratch;
+    cp_stats_t stats;
+    init_inline(&queue, 8);
+    if (consumer_producer_scratch_init(&queue, &scratch, BATCH) != NULL)
+        TEST_FAIL("scratch_init failed");
+
+    // The caller keeps its strings: the queue copies them
+    char fits[SLOT_SIZE];
+    memset(fits, 'f', SLOT_SIZE - 1);
+    fits[SLOT_SIZE - 1] = '\0';
+    char too_long[SLOT_SIZE + 1];
+    memset(too_long, 'l', SLOT_SIZE);
+    too_long[SLOT_SIZE] = '\0';
+    const char* strs[] = { "short", fits, too_long };
+    int put = 0;
+    if (consumer_producer_put_copy_batch(&queue, strs, 3, &put) != NULL || put != 3)
+        TEST_FAIL("put_copy_batch failed");
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.inline_size != SLOT_SIZE || stats.inlined != 2 || stats.bytes != 6 + SLOT_SIZE + SLOT_SIZE + 1)
+        TEST_FAIL("Only strings that fit a slot, terminator included, should be inlined");
+
+    char* out[BATCH];
+    int n = consumer_producer_get_batch_copy(&queue, out, BATCH, &scratch);
+    if (n != 3 || strcmp(out[0], "short") != 0 || strcmp(out[1], fits) != 0 || strcmp(out[2], too_long) != 0)
+        TEST_FAIL("get_batch_copy returned the wrong items");
+    if (!consumer_producer_scratch_owns(&scratch, out[0]) || !consumer_producer_scratch_owns(&scratch, out[1]))
+        TEST_FAIL("Inline items should be copied into the scratch buffer");
+    if (consumer_producer_scratch_owns(&scratch, out[2]))
+        TEST_FAIL("Oversized items should be handed over as heap strings");
+    free(out[2]);
+
+    // Plain gets still hand out strings the caller can free
+    consumer_producer_put_copy(&queue, "plain");
+    char* item = consumer_producer_get(&queue);
+    if (item == NULL || strcmp(item, "plain") != 0)
+        TEST_FAIL("Plain get should return a heap copy of an inline item");
+    free(item);
+
+    // Owned puts are never inlined
+    consumer_producer_put(&queue, strdup("owned"));
+    n = consumer_producer_get_batch_copy(&queue, out, 1, &scratch);
+    if (n != 1 || consumer_producer_scratch_owns(&scratch, out[0]) || strcmp(out[0], "owned") != 0)
+        TEST_FAIL("Owned puts should be handed over as they are");
+    free(out[0]);
+
+    if (consumer_producer_get_batch_copy(&queue, out, BATCH + 1, &scratch) != -1)
+        TEST_FAIL("Batch larger than the scratch buffer should be rejected");
+
+    consumer_producer_scratch_destroy(&scratch);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Short strings are copied into their slot and out into the scratch buffer");
+}
+
+void test_inline_survives_resizes() {
+    consumer_producer_t queue;
+    cp_stats_t stats;
+    init_inline(&queue, 4);
+    if (consumer_producer_set_elastic(&queue, 32, 75, 25, 4) != NULL)
+        TEST_FAIL("set_elastic failed");
+
+    // Wrap the ring, then burst past the initial capacity so inline payloads have to move
+    char buf[96];
+    for (int i = 0; i < 3; ++i) {
+        consumer_producer_put_copy(&queue, "warm");
+        free(consumer_producer_get(&queue));
+    }
+    for (int i = 0; i < 32; ++i) {
+        line_for(i, buf, sizeof(buf));
+        if (consumer_producer_put_copy(&queue, buf) != NULL)
+            TEST_FAIL("put_copy failed");
+    }
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.capacity != 32 || stats.grows == 0)
+        TEST_FAIL("Burst should have grown the queue");
+
+    // Drain through plain gets, then leave a few items behind for destroy
+    for (int i = 0; i < 28; ++i) {
+        char* item = consumer_producer_get(&queue);
+        line_for(i, buf, sizeof(buf));
+        if (item == NULL || strcmp(item, buf) != 0)
+            TEST_FAIL("Inline payload lost across a resize");
+        free(item);
+    }
+    consumer_producer_destroy(&queue);  // Frees the heap items left, not the inline ones
+    TEST_PASS("Inline payloads move with their slots when an elastic queue resizes");
+}
+
+void test_put_copy_without_inline_slots() {
+    consumer_producer_mode_t modes[] = { CP_MODE_LOCKED, CP_MODE_SPSC, CP_MODE_MPMC };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        consumer_producer_t queue;
+        cp_scratch_t scratch;
+        memset(&queue, 0, sizeof(queue));
+        consumer_producer_init_mode(&queue, 4, modes[m]);
+        if (consumer_producer_scratch_init(&queue, &scratch, BATCH) != NULL || scratch.data != NULL)
+            TEST_FAIL("Scratch buffer of a queue without inline slots should be empty");
+
+        char buf[8] = "copy me";
+        if (consumer_producer_put_copy(&queue, buf) != NULL)
+            TEST_FAIL("put_copy failed");
+        buf[0] = 'X';   // The queue must hold its own copy
+
+        char* out[BATCH];
+        int n = consumer_producer_get_batch_copy(&queue, out, BATCH, &scratch);
+        if (n != 1 || strcmp(out[0], "copy me") != 0 || consumer_producer_scratch_owns(&scratch, out[0]))
+            TEST_FAIL("Without inline slots the consumer should receive a heap copy");
+        free(out[0]);
+        consumer_producer_scratch_destroy(&scratch);
+        consumer_producer_destroy(&queue);
+    }
+    if (consumer_producer_put_copy(NULL, "x") == NULL)
+        TEST_FAIL("put_copy should reject a NULL queue");
+    TEST_PASS("put_copy and get_batch_copy work in every mode");
+}
+
+void* copy_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char buf[96];
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        line_for(i, buf, sizeof(buf));
+        if (consumer_producer_put_copy(queue, buf) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_threaded_stream() {
+    consumer_producer_t queue;
+    cp_scratch_t scratch;
+    init_inline(&queue, 16);
+    consumer_producer_scratch_init(&queue, &scratch, BATCH);
+    pthread_t producer;
+    pthread_create(&producer, NULL, copy_producer, &queue);
+
+    int expected = 0;
+    char buf[96];
+    char* out[BATCH];
+    int n;
+    while ((n = consumer_producer_get_batch_copy(&queue, out, BATCH, &scratch)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            line_for(expected, buf, sizeof(buf));
+            if (strcmp(out[k], buf) != 0)
+                TEST_FAIL("Mixed inline/heap stream delivered the wrong item");
+            if (consumer_producer_scratch_owns(&scratch, out[k]) != (expected % 10 != 0))
+                TEST_FAIL("Item stored the wrong way");
+            if (!consumer_producer_scratch_owns(&scratch, out[k]))
+                free(out[k]);
+            expected++;
+        }
+    }
+    pthread_join(producer, NULL);
+    if (expected != STREAM_ITEMS)
+        TEST_FAIL("Items lost in a mixed inline/heap stream");
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.inlined != STREAM_ITEMS - STREAM_ITEMS / 10 || stats.bytes != 0)
+        TEST_FAIL("Nine out of ten lines should have been inlined");
+    consumer_producer_scratch_destroy(&scratch);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Concurrent stream of mixed line lengths keeps order and content");
+}
+
+int main() {
+    printf("=== Testing consumer_producer inline slots ===\n");
+    test_set_inline_validation();
+    test_short_strings_stay_inline();
+    test_inline_survives_resizes();
+    test_put_copy_without_inline_slots();
+    test_threaded_stream();
+    printf(GREEN "All inline slot tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define DELAY_MS 30
+
+static const consumer_producer_mode_t MODES[] = { CP_MODE_LOCKED, CP_MODE_SPSC, CP_MODE_MPMC };
+#define MODE_COUNT (sizeof(MODES) / sizeof(MODES[0]))
+
+static void init_instrumented(consumer_producer_t* queue, int capacity, consumer_producer_mode_t mode) {
+    init_mode(queue, capacity, mode);
+    if (consumer_producer_enable_instrumentation(queue) != NULL)
+        TEST_FAIL("enable_instrumentation failed");
+}
+
+void test_enable_instrumentation_validation() {
+    consumer_producer_t queue;
+    cp_stats_t stats;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_enable_instrumentation(NULL) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_enable_instrumentation(&queue) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    // Off by default: operations leave the counters at zero
+    consumer_producer_init(&queue, 4);
+    consumer_producer_put(&queue, strdup("a"));
+    free(consumer_producer_get(&queue));
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.puts != 0 || stats.gets != 0 || stats.peak_count != 0)
+        TEST_FAIL("Counters should stay at zero while instrumentation is off");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("enable_instrumentation validates its input; counters are off by default");
+}
+
+void test_counts_operations() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        cp_stats_t stats;
+        init_instrumented(&queue, 8, MODES[m]);
+
+        char* batch[3] = { strdup("a"), strdup("b"), strdup("c") };
+        consumer_producer_put_batch(&queue, batch, 3, NULL);
+        consumer_producer_put(&queue, strdup("d"));
+        char* out[8];
+        int n = consumer_producer_get_batch(&queue, out, 8);
+        for (int i = 0; i < n; ++i)
+            free(out[i]);
+
+        // A try that gives up is neither an operation nor a blocked call
+        char* item;
+        if (consumer_producer_try_get(&queue, &item) != CP_TIMEDOUT)
+            TEST_FAIL("try_get on an empty queue should time out");
+
+        consumer_producer_get_stats(&queue, &stats);
+        if (n != 4 || stats.puts != 4 || stats.gets != 4)
+            TEST_FAIL("Puts and gets should be counted per item");
+        if (stats.peak_count != 4)
+            TEST_FAIL("Peak occupancy should be the highest count after a put");
+        if (stats.producer_blocked != 0 || stats.consumer_blocked != 0 ||
+            stats.producer_blocked_ns != 0 || stats.consumer_blocked_ns != 0)
+            TEST_FAIL("Calls that never waited must not count as blocked");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Puts, gets and peak occupancy are counted in every mode");
+}
+
+void* delayed_get(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    sleep_ms(DELAY_MS);
+    free(consumer_producer_get(queue));
+    return NULL;
+}
+
+void* delayed_put(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    sleep_ms(DELAY_MS);
+    consumer_producer_put(queue, strdup("late"));
+    return NULL;
+}
+
+void test_times_blocked_producer() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        cp_stats_t stats;
+        pthread_t getter;
+        init_instrumented(&queue, 2, MODES[m]);
+        consumer_producer_put(&queue, strdup("a"));
+        consumer_producer_put(&queue, strdup("b"));
+
+        pthread_create(&getter, NULL, delayed_get, &queue);
+        consumer_producer_put(&queue, strdup("c"));  // Full: waits for the getter
+        pthread_join(getter, NULL);
+
+        consumer_producer_get_stats(&queue, &stats);
+        if (stats.producer_blocked != 1)
+            TEST_FAIL("The put on a full queue should count as one blocked call");
+        if (stats.producer_blocked_ns < (DELAY_MS - 10) * 1000000LL || stats.producer_blocked_ns > 5000000000LL)
+            TEST_FAIL("Producer blocked time should cover the wait for the getter");
+        if (MODES[m] == CP_MODE_SPSC && stats.monitor_waits == 0)
+            TEST_FAIL("SPSC producer should have parked on its monitor");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("A put that waits on a full queue is counted and timed");
+}
+
+void test_times_blocked_consumer() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        cp_stats_t stats;
+        pthread_t putter;
+        init_instrumented(&queue, 2, MODES[m]);
+
+        pthread_create(&putter, NULL, delayed_put, &queue);
+        char* item = consumer_producer_get(&queue);  // Empty: waits for the putter
+        pthread_join(putter, NULL);
+        if (item == NULL || strcmp(item, "late") != 0)
+            TEST_FAIL("Get should return the late item");
+        free(item);
+
+        consumer_producer_get_stats(&queue, &stats);
+        if (stats.consumer_blocked != 1 || stats.producer_blocked != 0)
+            TEST_FAIL("The get on an empty queue should count as one blocked call");
+        if (stats.consumer_blocked_ns < (DELAY_MS - 10) * 1000000LL || stats.consumer_blocked_ns > 5000000000LL)
+            TEST_FAIL("Consumer blocked time should cover the wait for the putter");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("A get that waits on an empty queue is counted and timed");
+}
+
+void test_times_byte_budget_wait() {
+    consumer_producer_t queue;
+    cp_byte_budget_t budget;
+    cp_stats_t stats;
+    pthread_t getter;
+    consumer_producer_budget_init(&budget, 8);
+    init_instrumented(&queue, 16, CP_MODE_LOCKED);
+    consumer_producer_set_byte_budget(&queue, 0, &budget, 1);
+    consumer_producer_put(&queue, strdup("1234567"));
+
+    // Slots are free, but the shared budget is spent until the getter credits it
+    pthread_create(&getter, NULL, delayed_get, &queue);
+    consumer_producer_put(&queue, strdup("x"));
+    pthread_join(getter, NULL);
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.producer_blocked != 1 || stats.producer_blocked_ns < (DELAY_MS - 10) * 1000000LL)
+        TEST_FAIL("Waiting on the byte budget should count as a blocked put");
+    consumer_producer_destroy(&queue);
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("A put held back by the byte budget is counted and timed");
+}
+
+int main() {
+    printf("=== Testing consumer_producer instrumentation ===\n");
+    test_enable_instrumentation_validation();
+    test_counts_operations();
+    test_times_blocked_producer();
+    test_times_blocked_consumer();
+    test_times_byte_budget_wait();
+    printf(GREEN "All instrumentation tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "test_util.h"
+#include "../../plugins/sync/buffer_pool.h"
+#include "../../plugins/sync/message.h"
+
+void test_envelope() {
+    char* text = message_new("hello world", 5);
+    message_t* msg = message_of(text);
+    if (text == NULL || msg == NULL || strcmp(text, "hello") != 0)
+        TEST_FAIL("message_new should copy the text into a message");
+    if (msg->length != 5 || message_length(text) != 5 || msg->flags != 0 || msg->seq != 0 ||
+        msg->capacity != 2 * BP_CLASS_MIN - sizeof(message_t) || message_capacity(text) != msg->capacity)
+        TEST_FAIL("Header should hold length, capacity and cleared metadata");
+
+    // Anything else is a plain string
+    char* plain = (char*)buffer_pool_alloc(16);
+    strcpy(plain, "plain");
+    char* heap = strdup("from malloc");
+    if (message_of("literal") != NULL || message_of(plain) != NULL || message_of(heap) != NULL || message_of(NULL) != NULL)
+        TEST_FAIL("Only messages have a header");
+    if (message_length(plain) != 5 || message_length(heap) != 11 || message_capacity(plain) != BP_CLASS_MIN ||
+        message_capacity(heap) != 0)
+        TEST_FAIL("Plain strings fall back to strlen and the pool's capacity");
+    message_set_length(plain, 1);       // No header: ignored
+    message_release(plain);
+    message_release(heap);
+    message_release(NULL);
+
+    message_set_length(text, 2);
+    text[2] = '\0';
+    if (message_length(text) != 2)
+        TEST_FAIL("set_length should update the header");
+    message_release(text);
+    TEST_PASS("Messages carry their length and capacity; plain strings keep working");
+}
+
+void test_refcount() {
+    char* text = message_new("shared", 6);
+    message_t* msg = message_of(text);
+    if (message_ref(text) != text || atomic_load(&msg->refs) != 2)
+        TEST_FAIL("ref should share the buffer");
+    message_release(text);
+    if (atomic_load(&msg->refs) != 1 || strcmp(text, "shared") != 0)
+        TEST_FAIL("The other holder's reference should keep the message alive");
+    message_release(text);
+    if (buffer_pool_alloc(sizeof(message_t) + 7) != (void*)msg)
+        TEST_FAIL("The last release should give the buffer back to the pool");
+    buffer_pool_free(msg);
+
+    // A plain string cannot be shared: ref copies it into a message
+    char* copy = message_ref((char*)"literal");
+    if (copy == NULL || message_of(copy) == NULL || strcmp(copy, "literal") != 0)
+        TEST_FAIL("ref of a plain string should return a message copy");
+    message_release(copy);
+    TEST_PASS("References share one buffer; the last release frees it");
+}
+
+void test_writable() {
+    char* text = message_new("abc", 3);
+    message_t* msg = message_of(text);
+    msg->flags = 0x1u;
+    msg->seq = 42;
+    if (message_writable(text, 4) != text || message_writable(text, msg->capacity) != text)
+        TEST_FAIL("A sole holder with room should write in place");
+
+    // Shared: copy on write, the other holder keeps the original
+    message_ref(text);
+    char* mine = message_writable(text, 4);
+    message_t* copy = message_of(mine);
+    if (mine == text || copy == NULL || strcmp(mine, "abc") != 0 || copy->length != 3 ||
+        copy->flags != 0x1u || copy->seq != 42 || atomic_load(&msg->refs) != 1)
+        TEST_FAIL("A shared message should be copied with its metadata, dropping our reference");
+    message_release(text);
+
+    // Out of room: moved to a bigger message
+    char* grown = message_writable(mine, 500);
+    if (grown == NULL || message_capacity(grown) < 500 || strcmp(grown, "abc") != 0 ||
+        message_length(grown) != 3 || message_of(grown)->seq != 42)
+        TEST_FAIL("Growing should move the text into a bigger message");
+    message_release(grown);
+
+    // Plain strings turn into messages when they need room
+    char* heap = strdup("xyz");
+    if (message_writable(heap, 4) != heap)
+        TEST_FAIL("A malloc'd string is writable within its own length");
+    char* moved = message_writable(heap, 100);
+    if (moved == NULL || message_of(moved) == NULL || message_length(moved) != 3 || strcmp(moved, "xyz") != 0)
+        TEST_FAIL("A plain string that needs room should become a message");
+    message_release(moved);
+    TEST_PASS("writable copies shared or full messages and keeps their metadata");
+}
+
+void test_dup_and_long_texts() {
+    char* text = message_new("<END>", 5);
+    message_of(text)->flags = 0x1u;
+    message_of(text)->seq = 7;
+    char* dup = message_dup(text);
+    if (dup == text || message_of(dup) == NULL || message_of(dup)->flags != 0x1u ||
+        message_of(dup)->seq != 7 || strcmp(dup, "<END>") != 0)
+        TEST_FAIL("dup should copy the text and its metadata");
+    message_release(text);
+    message_release(dup);
+
+    // Longer than the largest class: a plain buffer, still usable through the same calls
+    size_t length = BP_CLASS_MAX;
+    char* big = message_alloc(length);
+    if (big == NULL || message_of(big) != NULL)
+        TEST_FAIL("Texts too long for the pool should come back plain");
+    memset(big, 'x', length);
+    big[length] = '\0';
+    if (message_length(big) != length || message_item_bytes(big) != length + 1)
+        TEST_FAIL("Plain long texts should still be measured");
+    message_release(big);               // Goes to free() (checked under sanitizers)
+    TEST_PASS("dup keeps metadata; texts beyond the pool fall back to plain buffers");
+}
+
+static int measured = 0;
+static size_t counting_size(const char* item) {
+    measured++;
+    return strlen(item) + 1;
+}
+
+void test_queue_hooks() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_set_item_size(NULL, counting_size) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_item_size(&queue, counting_size) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+    consumer_producer_init(&queue, 8);
+
+    // Item sizes come from the hook, not from strlen
+    cp_stats_t stats;
+    if (consumer_producer_set_item_size(&queue, counting_size) != NULL)
+        TEST_FAIL("Valid item size function rejected");
+    consumer_producer_put_copy(&queue, "abc");
+    if (measured == 0 || consumer_producer_get_stats(&queue, &stats) != 0 || stats.bytes != 4)
+        TEST_FAIL("Queued bytes should be measured with the item size function");
+    free(consumer_producer_get(&queue));
+    consumer_producer_destroy(&queue);
+
+    // A queue of messages: copies are messages that know their length
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init(&queue, 8);
+    consumer_producer_set_allocator(&queue, message_alloc_item, message_release);
+    consumer_producer_set_item_size(&queue, message_item_bytes);
+    char* shared = message_new("fan-out", 7);
+    consumer_producer_put(&queue, message_ref(shared));
+    consumer_producer_put_copy(&queue, "copied");
+    if (consumer_producer_get_stats(&queue, &stats) != 0 || stats.bytes != 8 + 7)
+        TEST_FAIL("Messages should be measured from their header");
+    char* first = consumer_producer_get(&queue);
+    char* second = consumer_producer_get(&queue);
+    if (first != shared || atomic_load(&message_of(shared)->refs) != 2)
+        TEST_FAIL("A referenced message should travel without a copy");
+    if (message_of(second) == NULL || message_length(second) != 6 || strcmp(second, "copied") != 0)
+        TEST_FAIL("Queue copies should be messages");
+    message_release(first);
+    message_release(second);
+    consumer_producer_put(&queue, message_ref(shared));
+    consumer_producer_destroy(&queue);  // Drops its reference to the leftover
+    if (atomic_load(&message_of(shared)->refs) != 1)
+        TEST_FAIL("Leftover messages should be released by destroy");
+    message_release(shared);
+
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init(&queue, 8) != NULL || consumer_producer_set_item_size(&queue, NULL) != NULL)
+        TEST_FAIL("Resetting the item size should work");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Queues measure items through their item size hook and carry messages");
+}
+
+void test_spill_keeps_tags() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_set_item_tag(&queue, message_item_tag, message_set_item_tag) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+    consumer_producer_init(&queue, 2);
+    if (consumer_producer_set_item_tag(&queue, message_item_tag, NULL) == NULL)
+        TEST_FAIL("A get without a set should be rejected");
+    consumer_producer_set_allocator(&queue, message_alloc_item, message_release);
+    consumer_producer_set_item_size(&queue, message_item_bytes);
+    if (consumer_producer_set_item_tag(&queue, message_item_tag, message_set_item_tag) != NULL ||
+        consumer_producer_set_spill(&queue, NULL) != NULL)
+        TEST_FAIL("Valid item tag functions rejected");
+
+    // Most of these go through the spill file and come back as new messages
+    for (int i = 0; i < 10; ++i) {
+        char* text = message_new("tagged", 6);
+        message_of(text)->flags = 0x100u + (unsigned int)i;
+        message_of(text)->seq = 1000UL + (unsigned long)i;
+        consumer_producer_put(&queue, text);
+    }
+    consumer_producer_put_copy(&queue, "plain");
+    for (int i = 0; i < 10; ++i) {
+        char* text = consumer_producer_get(&queue);
+        message_t* msg = message_of(text);
+        if (msg == NULL || strcmp(text, "tagged") != 0 || msg->flags != 0x100u + (unsigned int)i ||
+            msg->seq != 1000UL + (unsigned long)i)
+            TEST_FAIL("Spilled messages should keep their flags and sequence number");
+        message_release(text);
+    }
+    char* plain = consumer_producer_get(&queue);
+    if (plain == NULL || strcmp(plain, "plain") != 0 || message_of(plain)->flags != 0 || message_of(plain)->seq != 0)
+        TEST_FAIL("Untagged copies should come back without metadata");
+    message_release(plain);
+
+    cp_stats_t stats;
+    if (consumer_producer_get_stats(&queue, &stats) != 0 || stats.spilled < 8)
+        TEST_FAIL("The burst should have been spilled");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("The spill file keeps message flags and sequence numbers");
+}
+
+int main() {
+    printf("=== Testing message envelope ===\n");
+    test_envelope();
+    test_refcount();
+    test_writable();
+    test_dup_and_long_texts();
+    test_queue_hooks();
+    test_spill_keeps_tags();
+    printf(GREEN "All message tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <pthread.h>
+
+/* White-box: the ring cells and positions are private to consumer_producer.c */
+#include "../../plugins/sync/consumer_producer.c"
+#include "test_util.h"
+
+#define PRODUCERS          4
+#define CONSUMERS          4
+#define ITEMS_PER_PRODUCER 50000
+
+void test_mpmc_init() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 5, CP_MODE_MPMC) != NULL)
+        TEST_FAIL("MPMC initialization failed");
+    if (queue.mode != CP_MODE_MPMC || queue.capacity != 5 || ((cp_mpmc_t*)queue.impl)->mask != 7)
+        TEST_FAIL("MPMC ring should keep the capacity and round the ring to a power of two");
+    if (((cp_mpmc_t*)queue.impl)->cells == NULL || queue.items != NULL)
+        TEST_FAIL("MPMC should allocate sequence-numbered cells instead of an items array");
+    consumer_producer_destroy(&queue);
+
+    // A one-slot queue still needs a two-slot ring
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 1, CP_MODE_MPMC) != NULL || ((cp_mpmc_t*)queue.impl)->mask != 1)
+        TEST_FAIL("MPMC ring must have at least two slots");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("MPMC init sizes the ring");
+}
+
+void test_mpmc_capacity_and_finished() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 3, CP_MODE_MPMC);
+    char* item = NULL;
+
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_put(&queue, strdup("b"));
+    if (queue_is_full(&queue))
+        TEST_FAIL("Queue reported full too early");
+    consumer_producer_put(&queue, strdup("c"));
+    if (!queue_is_full(&queue))
+        TEST_FAIL("Queue should be full at its logical capacity, not the ring size");
+
+    char* extra = strdup("d");
+    if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("try_put beyond capacity should fail");
+    free(extra);
+
+    item = consumer_producer_get(&queue);
+    if (item == NULL || strcmp(item, "a") != 0)
+        TEST_FAIL("MPMC get did not return the oldest item");
+    free(item);
+
+    consumer_producer_signal_finished(&queue);
+    if (consumer_producer_put(&queue, strdup("late")) == NULL)
+        TEST_FAIL("Put after finished should fail");
+
+    char* out[4];
+    if (consumer_producer_get_batch(&queue, out, 4) != 2 || strcmp(out[0], "b") != 0 || strcmp(out[1], "c") != 0)
+        TEST_FAIL("Items queued before finished must still be delivered in order");
+    free(out[0]);
+    free(out[1]);
+
+    if (consumer_producer_get(&queue) != NULL)
+        TEST_FAIL("Get on finished and empty queue should return NULL");
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished should succeed once drained");
+
+    // Leave an item behind to check destroy frees it
+    consumer_producer_destroy(&queue);
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 2, CP_MODE_MPMC);
+    consumer_producer_put(&queue, strdup("leftover"));
+    consumer_producer_destroy(&queue);
+    TEST_PASS("MPMC honors capacity and finished semantics");
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    int id;
+} producer_args_t;
+
+typedef struct {
+    consumer_producer_t* queue;
+    long last_seen[PRODUCERS];  // Per-producer order as observed by this consumer
+    long received;
+} consumer_args_t;
+
+static unsigned char seen[PRODUCERS][ITEMS_PER_PRODUCER];
+
+void* mpmc_producer(void* arg) {
+    producer_args_t* a = (producer_args_t*)arg;
+    char buf[32];
+    for (int i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+        snprintf(buf, sizeof(buf), "%d:%d", a->id, i);
+        if (consumer_producer_put(a->queue, strdup(buf)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    return NULL;
+}
+
+void* mpmc_consumer(void* arg) {
+    consumer_args_t* a = (consumer_args_t*)arg;
+    char* batch[8];
+    int n;
+    while ((n = consumer_producer_get_batch(a->queue, batch, 8)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            int p = 0, i = 0;
+            if (sscanf(batch[k], "%d:%d", &p, &i) != 2 || p < 0 || p >= PRODUCERS)
+                TEST_FAIL("Corrupted item");
+            if (i <= a->last_seen[p])
+                TEST_FAIL("A consumer saw one producer's items out of order");
+            a->last_seen[p] = i;
+            __atomic_add_fetch(&seen[p][i], 1, __ATOMIC_RELAXED);
+            a->received++;
+            free(batch[k]);
+        }
+    }
+    if (n < 0)
+        TEST_FAIL("get_batch failed");
+    return NULL;
+}
+
+void test_mpmc_threaded_stream() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 16, CP_MODE_MPMC);
+
+    pthread_t producers[PRODUCERS], consumers[CONSUMERS];
+    producer_args_t pargs[PRODUCERS];
+    consumer_args_t cargs[CONSUMERS];
+
+    for (int c = 0; c < CONSUMERS; ++c) {
+        cargs[c].queue = &queue;
+        cargs[c].received = 0;
+        for (int p = 0; p < PRODUCERS; ++p)
+            cargs[c].last_seen[p] = -1;
+        pthread_create(&consumers[c], NULL, mpmc_consumer, &cargs[c]);
+    }
+    for (int p = 0; p < PRODUCERS; ++p) {
+        pargs[p].queue = &queue;
+        pargs[p].id = p;
+        pthread_create(&producers[p], NULL, mpmc_producer, &pargs[p]);
+    }
+    for (int p = 0; p < PRODUCERS; ++p)
+        pthread_join(producers[p], NULL);
+    consumer_producer_signal_finished(&queue);
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished failed");
+
+    long total = 0;
+    for (int c = 0; c < CONSUMERS; ++c) {
+        pthread_join(consumers[c], NULL);
+        total += cargs[c].received;
+    }
+    if (total != (long)PRODUCERS * ITEMS_PER_PRODUCER)
+        TEST_FAIL("Items lost or duplicated");
+    for (int p = 0; p < PRODUCERS; ++p)
+        for (int i = 0; i < ITEMS_PER_PRODUCER; ++i)
+            if (seen[p][i] != 1)
+                TEST_FAIL("An item was not delivered exactly once");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("MPMC delivers every item exactly once with several producers and consumers");
+}
+
+// Finished while a put has claimed a position but not published its item yet
+void test_mpmc_finished_with_put_in_flight() {
+    consumer_producer_t queue;
+    init_mode(&queue, 4, CP_MODE_MPMC);
+    consumer_producer_put(&queue, strdup("a"));
+    cp_mpmc_t* mpmc = (cp_mpmc_t*)queue.impl;
+    size_t pos = atomic_fetch_add(&mpmc->enqueue_pos, 1);     // The stalled producer's claim
+    consumer_producer_signal_finished(&queue);
+
+    char* item = NULL;
+    expect_next(&queue, "a");
+    if (consumer_producer_try_get(&queue, &item) != CP_TIMEDOUT)
+        TEST_FAIL("try_get should not wait for a put still in flight");
+    struct timespec start, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    consumer_producer_deadline_after(&deadline, 50);
+    if (consumer_producer_get_timed(&queue, &item, &deadline) != CP_TIMEDOUT || elapsed_ms(&start) > 1000)
+        TEST_FAIL("get_timed should give up at its deadline while a put is in flight");
+
+    // The producer publishes: its item is still delivered, then the queue reports the end
+    cp_mpmc_cell_t* cell = &mpmc->cells[pos & mpmc->mask];
+    cell->data = strdup("b");
+    atomic_store(&cell->seq, pos + 1);
+    expect_next(&queue, "b");
+    if (consumer_producer_get(&queue) != NULL)
+        TEST_FAIL("Finished and drained queue should return NULL");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("MPMC gets honor their deadline while finished waits for a put in flight");
+}
+
+int main() {
+    printf("=== Testing consumer_producer MPMC mode ===\n");
+    test_mpmc_init();
+    test_mpmc_capacity_and_finished();
+    test_mpmc_finished_with_put_in_flight();
+    test_mpmc_threaded_stream();
+    printf(GREEN "All MPMC tests passed.\n" NC);
+    return 0;
+}
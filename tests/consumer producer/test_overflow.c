@@ -0,0 +1,249 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define SAMPLE_ITEMS  10000
+#define STREAM_ITEMS  20000
+
+typedef struct {
+    int calls;
+    char last[32];
+} drop_log_t;
+
+static void record_drop(const char* item, void* arg) {
+    drop_log_t* log = (drop_log_t*)arg;
+    log->calls++;
+    snprintf(log->last, sizeof(log->last), "%s", item);
+}
+
+static void init_overflow(consumer_producer_t* queue, int capacity, cp_overflow_t policy, int percent,
+                          drop_log_t* log) {
+    init_queue(queue, capacity);
+    if (consumer_producer_set_overflow(queue, policy, percent, log != NULL ? record_drop : NULL, log) != NULL)
+        TEST_FAIL("set_overflow failed");
+}
+
+void test_set_overflow_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_set_overflow(NULL, CP_OVERFLOW_DROP_NEWEST, 0, NULL, NULL) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_DROP_NEWEST, 0, NULL, NULL) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (queue.overflow != CP_OVERFLOW_BLOCK)
+        TEST_FAIL("Default overflow policy should be block");
+    if (consumer_producer_set_overflow(&queue, (cp_overflow_t)9, 0, NULL, NULL) == NULL)
+        TEST_FAIL("Unknown policy should be rejected");
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_SAMPLE, 100, NULL, NULL) == NULL)
+        TEST_FAIL("Sample percentage of 100 should be rejected");
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_SAMPLE, 0, NULL, NULL) != NULL)
+        TEST_FAIL("Valid sampling policy rejected");
+    if (queue.sample_percent != CP_SAMPLE_PERCENT_DEFAULT)
+        TEST_FAIL("Sample percentage 0 should select the default");
+    consumer_producer_destroy(&queue);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_MPMC);
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_DROP_OLDEST, 0, NULL, NULL) == NULL)
+        TEST_FAIL("Lock-free modes should reject shedding policies");
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_BLOCK, 0, NULL, NULL) != NULL)
+        TEST_FAIL("Block is valid in every mode");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("set_overflow validates its input");
+}
+
+void test_drop_newest() {
+    consumer_producer_t queue;
+    drop_log_t log = { 0, "" };
+    cp_stats_t stats;
+    init_overflow(&queue, 2, CP_OVERFLOW_DROP_NEWEST, 0, &log);
+
+    // Neither the blocking put nor the try_put waits: the new items are dropped
+    char* batch[4] = { item_for(0), item_for(1), item_for(2), item_for(3) };
+    int put = 0;
+    if (consumer_producer_put_batch(&queue, batch, 4, &put) != NULL || put != 4)
+        TEST_FAIL("Dropped items should count as accepted");
+    if (consumer_producer_try_put(&queue, item_for(4)) != NULL)
+        TEST_FAIL("try_put on a full shedding queue should succeed");
+    if (consumer_producer_put_copy(&queue, "copied") != NULL)
+        TEST_FAIL("put_copy on a full shedding queue should succeed");
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 2 || stats.dropped_newest != 4 || stats.dropped_oldest != 0 || log.calls != 4)
+        TEST_FAIL("Drop counters or callback wrong");
+    if (strcmp(log.last, "copied") != 0)
+        TEST_FAIL("Callback should see the dropped item");
+    expect_next(&queue, "0");
+    expect_next(&queue, "1");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("drop-newest keeps the queued items and drops the new ones");
+}
+
+void test_drop_oldest() {
+    consumer_producer_t queue;
+    drop_log_t log = { 0, "" };
+    cp_stats_t stats;
+    init_overflow(&queue, 3, CP_OVERFLOW_DROP_OLDEST, 0, &log);
+
+    for (int i = 0; i < 5; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    consumer_producer_put_control(&queue, strdup("ctl"), CP_CONTROL_ORDERED);
+    consumer_producer_put(&queue, item_for(5));
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 3 || stats.dropped_oldest != 3 || log.calls != 3 || strcmp(log.last, "2") != 0)
+        TEST_FAIL("The oldest items should have been evicted");
+
+    // Evicted items count as taken: the ordered control still sits right after item 4
+    expect_next(&queue, "3");
+    expect_next(&queue, "4");
+    expect_next(&queue, "ctl");
+    expect_next(&queue, "5");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("drop-oldest evicts the head to make room and keeps controls in place");
+}
+
+void test_drop_oldest_under_byte_budget() {
+    consumer_producer_t queue;
+    init_overflow(&queue, 16, CP_OVERFLOW_DROP_OLDEST, 0, NULL);
+    consumer_producer_set_byte_budget(&queue, 20, NULL, 0);
+
+    consumer_producer_put(&queue, strdup("aaaaaaaa"));  // 9 bytes
+    consumer_producer_put(&queue, strdup("bbbbbbbb"));  // 18
+    consumer_producer_put(&queue, strdup("cccccccc"));  // 27 > 20: evicting the oldest is enough
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 2 || stats.bytes != 18 || stats.dropped_oldest != 1)
+        TEST_FAIL("Eviction should free just enough bytes");
+    expect_next(&queue, "bbbbbbbb");
+    expect_next(&queue, "cccccccc");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("drop-oldest also makes room under a byte budget");
+}
+
+void test_sample_keeps_a_share() {
+    consumer_producer_t queue;
+    cp_stats_t stats;
+    init_overflow(&queue, 1, CP_OVERFLOW_SAMPLE, 25, NULL);
+    consumer_producer_put(&queue, strdup("first"));
+
+    // The queue stays full: each kept item evicts the one queued before it
+    for (int i = 0; i < SAMPLE_ITEMS; ++i) {
+        if (consumer_producer_try_put(&queue, item_for(i)) != NULL)
+            TEST_FAIL("try_put on a full sampling queue should not fail");
+    }
+    consumer_producer_get_stats(&queue, &stats);
+    long kept = stats.dropped_oldest;
+    if (kept + stats.dropped_sampled != SAMPLE_ITEMS || stats.count != 1)
+        TEST_FAIL("Every overflowing item is either kept or dropped");
+    if (kept < SAMPLE_ITEMS / 5 || kept > SAMPLE_ITEMS * 3 / 10)
+        TEST_FAIL("Sampling should keep about a quarter of the overflowing items");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("sample keeps the configured share of overflowing items");
+}
+
+void test_sample_never_blocks() {
+    consumer_producer_t queue;
+    cp_stats_t stats;
+    init_overflow(&queue, 2, CP_OVERFLOW_SAMPLE, 99, NULL);
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_put(&queue, strdup("b"));
+    if (consumer_producer_credits(&queue) <= 0)
+        TEST_FAIL("A sampling queue should always grant credits");
+
+    // A blocking put would sit out its whole deadline on the full queue
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += 5;
+    for (int i = 0; i < 100; ++i) {
+        if (consumer_producer_put_timed(&queue, item_for(i), &deadline) != NULL)
+            TEST_FAIL("Put on a full sampling queue should not wait");
+    }
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 2 || stats.dropped_oldest + stats.dropped_sampled != 100)
+        TEST_FAIL("Kept samples should evict the oldest items");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("sample keeps puts flowing on a full queue");
+}
+
+void test_shared_budget_sheds_gate_queue() {
+    consumer_producer_t entry;
+    cp_byte_budget_t budget;
+    drop_log_t log = { 0, "" };
+    consumer_producer_budget_init(&budget, 16);
+    init_overflow(&entry, 16, CP_OVERFLOW_DROP_OLDEST, 0, &log);
+    consumer_producer_set_byte_budget(&entry, 0, &budget, 1);
+
+    consumer_producer_put(&entry, strdup("0123456789"));
+    if (consumer_producer_put(&entry, strdup("0123456789")) != NULL)
+        TEST_FAIL("Put on a spent shared budget should not fail");
+    cp_stats_t stats;
+    consumer_producer_get_stats(&entry, &stats);
+    if (stats.count != 1 || stats.dropped_newest != 1 || log.calls != 1 || atomic_load(&budget.used) != 11)
+        TEST_FAIL("A spent shared budget should drop the new item");
+    consumer_producer_destroy(&entry);
+    consumer_producer_budget_destroy(&budget);
+    TEST_PASS("Shedding gate queue drops new items instead of waiting on the shared budget");
+}
+
+void* fast_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        if (consumer_producer_put(queue, item_for(i)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_slow_consumer_never_stalls_producer() {
+    cp_overflow_t policies[] = { CP_OVERFLOW_DROP_NEWEST, CP_OVERFLOW_DROP_OLDEST };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        consumer_producer_t queue;
+        init_overflow(&queue, 8, policies[p], 0, NULL);
+        pthread_t producer;
+        pthread_create(&producer, NULL, fast_producer, &queue);
+
+        // A sink that sleeps on every item: without shedding the producer would wait ~STREAM_ITEMS times
+        long last = -1;
+        long received = 0;
+        char* item;
+        while ((item = consumer_producer_get(&queue)) != NULL) {
+            long v = strtol(item, NULL, 10);
+            if (v <= last)
+                TEST_FAIL("Surviving items out of order");
+            last = v;
+            received++;
+            free(item);
+            sleep_us(100);
+        }
+        pthread_join(producer, NULL);
+
+        cp_stats_t stats;
+        consumer_producer_get_stats(&queue, &stats);
+        if (received + stats.dropped_newest + stats.dropped_oldest != STREAM_ITEMS)
+            TEST_FAIL("Every item is either delivered or counted as dropped");
+        if (policies[p] == CP_OVERFLOW_DROP_OLDEST && last != STREAM_ITEMS - 1)
+            TEST_FAIL("drop-oldest should always deliver the newest item");
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Shedding queues keep a fast producer flowing past a slow consumer");
+}
+
+int main() {
+    printf("=== Testing consumer_producer overflow policies ===\n");
+    test_set_overflow_validation();
+    test_drop_newest();
+    test_drop_oldest();
+    test_drop_oldest_under_byte_budget();
+    test_sample_keeps_a_share();
+    test_sample_never_blocks();
+    test_shared_budget_sheds_gate_queue();
+    test_slow_consumer_never_stalls_producer();
+    printf(GREEN "All overflow policy tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 50000
+#define MARK_EVERY   1000
+
+void test_put_control_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_put_control(NULL, "x", CP_CONTROL_URGENT) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_put_control(&queue, "x", CP_CONTROL_URGENT) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (consumer_producer_put_control(&queue, NULL, CP_CONTROL_URGENT) == NULL)
+        TEST_FAIL("NULL item should be rejected");
+    if (consumer_producer_put_control(&queue, "x", (cp_control_order_t)7) == NULL)
+        TEST_FAIL("Unknown control order should be rejected");
+
+    consumer_producer_signal_finished(&queue);
+    if (consumer_producer_put_control(&queue, "x", CP_CONTROL_ORDERED) == NULL)
+        TEST_FAIL("Control put after finished should be rejected");
+    consumer_producer_destroy(&queue);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    if (consumer_producer_put_control(&queue, "x", CP_CONTROL_URGENT) == NULL)
+        TEST_FAIL("Lock-free modes should reject control messages");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("put_control validates its input");
+}
+
+void test_urgent_overtakes_data() {
+    consumer_producer_t queue;
+    init_queue(&queue, 8);
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_put(&queue, strdup("b"));
+    consumer_producer_put_control(&queue, strdup("ordered"), CP_CONTROL_ORDERED);
+    consumer_producer_put_control(&queue, strdup("abort"), CP_CONTROL_URGENT);
+    consumer_producer_put_control(&queue, strdup("flush"), CP_CONTROL_URGENT);
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 2 || stats.controls != 3)
+        TEST_FAIL("Stats should count data and control messages separately");
+
+    // Urgent controls first (FIFO among themselves), then the rest in put order
+    expect_next(&queue, "abort");
+    expect_next(&queue, "flush");
+    expect_next(&queue, "a");
+    expect_next(&queue, "b");
+    expect_next(&queue, "ordered");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Urgent controls overtake queued data");
+}
+
+void test_ordered_keeps_put_order() {
+    consumer_producer_t queue;
+    init_queue(&queue, 8);
+    consumer_producer_put_control(&queue, strdup("c0"), CP_CONTROL_ORDERED);
+    consumer_producer_put(&queue, strdup("d0"));
+    consumer_producer_put(&queue, strdup("d1"));
+    consumer_producer_put_control(&queue, strdup("c1"), CP_CONTROL_ORDERED);
+    consumer_producer_put_control(&queue, strdup("c2"), CP_CONTROL_ORDERED);
+    consumer_producer_put(&queue, strdup("d2"));
+
+    // A batch get interleaves both lanes in put order
+    char* out[8];
+    const char* expected[] = { "c0", "d0", "d1", "c1", "c2", "d2" };
+    int n = consumer_producer_get_batch(&queue, out, 8);
+    if (n != 6)
+        TEST_FAIL("Batch get should drain both lanes");
+    for (int i = 0; i < n; ++i) {
+        if (strcmp(out[i], expected[i]) != 0)
+            TEST_FAIL("Ordered controls must keep their place among the data");
+        free(out[i]);
+    }
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Ordered controls arrive exactly where they were put");
+}
+
+void test_control_never_waits_for_room() {
+    consumer_producer_t queue;
+    init_queue(&queue, 2);
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_put(&queue, strdup("b"));
+
+    // The data ring is full, yet controls (more than the lane's first allocation) go straight in
+    char* extra = strdup("c");
+    if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+        TEST_FAIL("Data put on a full queue should wait");
+    free(extra);
+    for (int i = 0; i < 10; ++i) {
+        if (consumer_producer_put_control(&queue, item_for(i), CP_CONTROL_ORDERED) != NULL)
+            TEST_FAIL("Control put should not wait for a free slot");
+    }
+
+    // Finished only counts as drained once the lanes are empty too
+    consumer_producer_signal_finished(&queue);
+    expect_next(&queue, "a");
+    expect_next(&queue, "b");
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (consumer_producer_wait_finished_timed(&queue, &now) != CP_TIMEDOUT)
+        TEST_FAIL("Queue with pending controls must not count as drained");
+    for (int i = 0; i < 10; ++i) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%d", i);
+        expect_next(&queue, buf);
+    }
+    if (consumer_producer_get(&queue) != NULL)
+        TEST_FAIL("Drained finished queue should return NULL");
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished failed after draining the lanes");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Controls bypass a full queue and are drained before finishing");
+}
+
+void test_destroy_frees_pending_controls() {
+    consumer_producer_t queue;
+    init_queue(&queue, 4);
+    for (int i = 0; i < 6; ++i) {
+        consumer_producer_put_control(&queue, item_for(i), i % 2 ? CP_CONTROL_URGENT : CP_CONTROL_ORDERED);
+    }
+    consumer_producer_destroy(&queue);  // Frees the pending controls (checked under sanitizers)
+    TEST_PASS("destroy frees control messages nobody received");
+}
+
+void* data_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        if (consumer_producer_put(queue, item_for(i)) != NULL)
+            TEST_FAIL("Data put failed");
+        // Every MARK_EVERY items, mark the position with an ordered control
+        if ((i + 1) % MARK_EVERY == 0) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "mark %d", i + 1);
+            if (consumer_producer_put_control(queue, strdup(buf), CP_CONTROL_ORDERED) != NULL)
+                TEST_FAIL("Control put failed");
+        }
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_threaded_marks_stay_in_place() {
+    consumer_producer_t queue;
+    init_queue(&queue, 16);
+    pthread_t producer;
+    pthread_create(&producer, NULL, data_producer, &queue);
+
+    long expected = 0;
+    long marks = 0;
+    char* batch[8];
+    int n;
+    while ((n = consumer_producer_get_batch(&queue, batch, 8)) > 0) {
+        for (int k = 0; k < n; ++k) {
+            if (strncmp(batch[k], "mark ", 5) == 0) {
+                if (strtol(batch[k] + 5, NULL, 10) != expected)
+                    TEST_FAIL("Ordered control overtook the data put before it");
+                marks++;
+            } else {
+                if (strtol(batch[k], NULL, 10) != expected)
+                    TEST_FAIL("Data out of order next to control messages");
+                expected++;
+            }
+            free(batch[k]);
+        }
+    }
+    pthread_join(producer, NULL);
+    if (expected != STREAM_ITEMS || marks != STREAM_ITEMS / MARK_EVERY)
+        TEST_FAIL("Items lost next to control messages");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Concurrent stream keeps ordered controls at their position");
+}
+
+int main() {
+    printf("=== Testing consumer_producer control lanes ===\n");
+    test_put_control_validation();
+    test_urgent_overtakes_data();
+    test_ordered_keeps_put_order();
+    test_control_never_waits_for_room();
+    test_destroy_frees_pending_controls();
+    test_threaded_marks_stay_in_place();
+    printf(GREEN "All control lane tests passed.\n" NC);
+    return 0;
+}
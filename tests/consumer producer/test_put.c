@@ -17,6 +17,7 @@
 
 void test_put_single_item() {
     consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
     if (consumer_producer_init(&queue, 2) != NULL)
         TEST_FAIL("Initialization failed");
 
@@ -34,6 +35,7 @@ void test_put_single_item() {
 
 void test_put_multiple_items() {
     consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
     consumer_producer_init(&queue, 3);
 
     consumer_producer_put(&queue, strdup("one"));
@@ -49,6 +51,7 @@ void test_put_multiple_items() {
 
 void test_put_null_item() {
     consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
     consumer_producer_init(&queue, 2);
 
     const char* err = consumer_producer_put(&queue, NULL);
@@ -72,6 +75,7 @@ void test_put_uninitialized_queue() {
 
 void test_put_after_finished() {
     consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
     consumer_producer_init(&queue, 2);
 
     consumer_producer_signal_finished(&queue);
@@ -104,6 +108,7 @@ void* blocked_put_thread(void* arg) {
 
 void test_blocking_when_full() {
     consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
     consumer_producer_init(&queue, 1);
 
     // Fill the queue
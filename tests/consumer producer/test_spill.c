@@ -0,0 +1,265 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define BURST_ITEMS  1000
+#define STREAM_ITEMS 200000
+#define SHARED_ITEMS 50000
+#define CONSUMERS    4
+
+static void init_spill(consumer_producer_t* queue, int capacity) {
+    init_queue(queue, capacity);
+    if (consumer_producer_set_spill(queue, NULL) != NULL)
+        TEST_FAIL("set_spill failed");
+}
+
+static void expect_number(consumer_producer_t* queue, int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", i);
+    expect_next(queue, buf);
+}
+
+void test_set_spill_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_set_spill(NULL, NULL) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_spill(&queue, NULL) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (consumer_producer_set_spill(&queue, "/nonexistent/spill/dir") == NULL)
+        TEST_FAIL("Missing directory should be rejected");
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_SPILL, 0, NULL, NULL) == NULL)
+        TEST_FAIL("set_overflow should not enable spilling");
+    if (consumer_producer_set_spill(&queue, "/tmp") != NULL || queue.overflow != CP_OVERFLOW_SPILL)
+        TEST_FAIL("Valid spill directory rejected");
+
+    // Switching away from spilling only works while nothing is on disk
+    for (int i = 0; i < 6; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_BLOCK, 0, NULL, NULL) == NULL)
+        TEST_FAIL("Leaving spill mode with items on disk should be rejected");
+    for (int i = 0; i < 6; ++i)
+        expect_number(&queue, i);
+    if (consumer_producer_set_overflow(&queue, CP_OVERFLOW_BLOCK, 0, NULL, NULL) != NULL)
+        TEST_FAIL("Leaving an empty spill should work");
+    consumer_producer_destroy(&queue);
+
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    if (consumer_producer_set_spill(&queue, NULL) == NULL)
+        TEST_FAIL("Lock-free modes should reject spilling");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("set_spill validates its input");
+}
+
+void test_burst_spills_and_comes_back_in_order() {
+    consumer_producer_t queue;
+    init_spill(&queue, 4);
+
+    // A burst far beyond the capacity never waits
+    for (int i = 0; i < BURST_ITEMS; ++i) {
+        char* item = item_for(i);
+        if (consumer_producer_try_put(&queue, item) != NULL)
+            TEST_FAIL("A spilling queue should never make a put wait");
+    }
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 4 || stats.spill_count != BURST_ITEMS - 4 || stats.spilled != BURST_ITEMS - 4 ||
+        stats.spill_bytes == 0 || stats.spill_peak_bytes != stats.spill_bytes)
+        TEST_FAIL("Items beyond the capacity should be on disk");
+
+    // Half of it back, then more on top: still one FIFO
+    for (int i = 0; i < BURST_ITEMS / 2; ++i)
+        expect_number(&queue, i);
+    for (int i = BURST_ITEMS; i < BURST_ITEMS + 10; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    for (int i = BURST_ITEMS / 2; i < BURST_ITEMS + 10; ++i)
+        expect_number(&queue, i);
+
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 0 || stats.spill_count != 0 || stats.spill_bytes != 0 || stats.spill_lost != 0)
+        TEST_FAIL("Drained queue should have nothing left on disk");
+
+    // Once drained, puts go to the ring again
+    consumer_producer_put(&queue, item_for(7));
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 1 || stats.spilled != BURST_ITEMS + 10 - 4)
+        TEST_FAIL("Puts into a drained queue should not spill");
+    expect_number(&queue, 7);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Bursts spill to disk and come back in order");
+}
+
+void test_ordered_controls_wait_for_spilled_items() {
+    consumer_producer_t queue;
+    init_spill(&queue, 4);
+    for (int i = 0; i < 10; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    consumer_producer_put_control(&queue, strdup("ctl"), CP_CONTROL_ORDERED);
+    for (int i = 10; i < 15; ++i)
+        consumer_producer_put(&queue, item_for(i));
+
+    for (int i = 0; i < 10; ++i)
+        expect_number(&queue, i);
+    expect_next(&queue, "ctl");
+    for (int i = 10; i < 15; ++i)
+        expect_number(&queue, i);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Ordered controls stay behind the items spilled before them");
+}
+
+void test_spill_under_byte_budget_and_long_items() {
+    consumer_producer_t queue;
+    init_spill(&queue, 16);
+    consumer_producer_set_byte_budget(&queue, 32, NULL, 0);
+
+    // Longer than the spill buffers: written and read straight through
+    size_t long_len = CP_SPILL_BUFFER * 2 + 7;
+    char* long_item = (char*)malloc(long_len + 1);
+    memset(long_item, 'x', long_len);
+    long_item[long_len] = '\0';
+
+    consumer_producer_put(&queue, strdup("0123456789abcdefghijklmnopqrstu"));   // 32 bytes: budget spent
+    consumer_producer_put(&queue, strdup("short"));                              // Spilled despite free slots
+    consumer_producer_put(&queue, strdup(long_item));
+    consumer_producer_put(&queue, strdup("tail"));
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.count != 1 || stats.spill_count != 3)
+        TEST_FAIL("A spent byte budget should spill too");
+
+    expect_next(&queue, "0123456789abcdefghijklmnopqrstu");
+    expect_next(&queue, "short");
+    expect_next(&queue, long_item);
+    expect_next(&queue, "tail");
+    free(long_item);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Byte budgets spill as well, and items longer than the buffers survive");
+}
+
+void test_destroy_discards_spill() {
+    consumer_producer_t queue;
+    init_spill(&queue, 2);
+    for (int i = 0; i < 50; ++i)
+        consumer_producer_put(&queue, item_for(i));
+    consumer_producer_destroy(&queue);  // Frees the ring items and closes the file (checked under sanitizers)
+    TEST_PASS("destroy discards the items still on disk");
+}
+
+void* burst_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char buf[32];
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (consumer_producer_put_copy(queue, buf) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void test_threaded_burst() {
+    for (int with_inline = 0; with_inline < 2; ++with_inline) {
+        consumer_producer_t queue;
+        cp_scratch_t scratch;
+        init_spill(&queue, 16);
+        if (with_inline)
+            consumer_producer_set_inline(&queue, 32);
+        consumer_producer_scratch_init(&queue, &scratch, 8);
+        pthread_t producer;
+        pthread_create(&producer, NULL, burst_producer, &queue);
+
+        // A consumer slower than the producer: the backlog builds up on disk
+        long expected = 0;
+        char* out[8];
+        int n;
+        while ((n = consumer_producer_get_batch_copy(&queue, out, 8, &scratch)) > 0) {
+            for (int k = 0; k < n; ++k) {
+                if (strtol(out[k], NULL, 10) != expected)
+                    TEST_FAIL("Spilled stream out of order");
+                expected++;
+                if (!consumer_producer_scratch_owns(&scratch, out[k]))
+                    free(out[k]);
+            }
+            if (expected % 4096 < 8)
+                sleep_us(500);
+        }
+        pthread_join(producer, NULL);
+        if (expected != STREAM_ITEMS || consumer_producer_wait_finished(&queue) != 0)
+            TEST_FAIL("Spilled stream should be delivered completely and finish");
+
+        cp_stats_t stats;
+        consumer_producer_get_stats(&queue, &stats);
+        if (stats.spilled == 0 || stats.spill_count != 0 || stats.spill_lost != 0)
+            TEST_FAIL("The burst should have gone through the spill file");
+        consumer_producer_scratch_destroy(&scratch);
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Concurrent burst many times the capacity is absorbed in order");
+}
+
+static unsigned char shared_seen[SHARED_ITEMS];
+
+void* shared_consumer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    long last = -1;
+    char* item;
+    while ((item = consumer_producer_get(queue)) != NULL) {
+        long i = strtol(item, NULL, 10);
+        free(item);
+        // One FIFO: every consumer sees its share in increasing order
+        if (i <= last || i >= SHARED_ITEMS || shared_seen[i]++)
+            TEST_FAIL("Spilled item out of order or delivered twice");
+        last = i;
+    }
+    return NULL;
+}
+
+void test_consumers_share_the_read_back() {
+    consumer_producer_t queue;
+    init_spill(&queue, 4);
+    memset(shared_seen, 0, sizeof(shared_seen));
+
+    // Several write buffers' worth goes to disk before anyone consumes
+    for (int i = 0; i < SHARED_ITEMS; ++i)
+        if (consumer_producer_put(&queue, item_for(i)) != NULL)
+            TEST_FAIL("Spilling put failed");
+    consumer_producer_signal_finished(&queue);
+    if (queue_is_empty(&queue))
+        TEST_FAIL("Spilled items should count as queued");
+
+    // Consumers find the ring dry while one of them reads the next records back
+    pthread_t consumers[CONSUMERS];
+    for (int c = 0; c < CONSUMERS; ++c)
+        pthread_create(&consumers[c], NULL, shared_consumer, &queue);
+    for (int c = 0; c < CONSUMERS; ++c)
+        pthread_join(consumers[c], NULL);
+    for (int i = 0; i < SHARED_ITEMS; ++i)
+        if (!shared_seen[i])
+            TEST_FAIL("Spilled item lost");
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("Queue should be drained");
+
+    cp_stats_t stats;
+    consumer_producer_get_stats(&queue, &stats);
+    if (stats.spill_count != 0 || stats.spill_lost != 0)
+        TEST_FAIL("Nothing should stay on disk or get lost");
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Consumers share the items read back from disk, each exactly once");
+}
+
+int main() {
+    printf("=== Testing consumer_producer spill to disk ===\n");
+    test_set_spill_validation();
+    test_burst_spills_and_comes_back_in_order();
+    test_ordered_controls_wait_for_spilled_items();
+    test_spill_under_byte_budget_and_long_items();
+    test_destroy_discards_spill();
+    test_threaded_burst();
+    test_consumers_share_the_read_back();
+    printf(GREEN "All spill tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <pthread.h>
+
+/* White-box: the ring indices are private to consumer_producer.c */
+#include "../../plugins/sync/consumer_producer.c"
+#include "test_util.h"
+
+#define STREAM_ITEMS 200000
+
+void test_spsc_init_rounds_ring() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 5, CP_MODE_SPSC) != NULL)
+        TEST_FAIL("SPSC initialization failed");
+
+    if (queue.mode != CP_MODE_SPSC || queue.capacity != 5)
+        TEST_FAIL("SPSC mode or capacity not stored");
+
+    if (((cp_spsc_t*)queue.impl)->mask != 7)
+        TEST_FAIL("SPSC ring size should be rounded up to a power of two");
+
+    if (!queue.not_empty_monitor.initialized || !queue.not_full_monitor.initialized)
+        TEST_FAIL("SPSC parking monitors not initialized properly");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("SPSC init rounds the ring to a power of two");
+}
+
+void test_spsc_invalid_mode() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 4, (consumer_producer_mode_t)42) == NULL)
+        TEST_FAIL("Unknown mode should be rejected");
+
+    TEST_PASS("Unknown queue mode rejected");
+}
+
+void test_spsc_respects_logical_capacity() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 3, CP_MODE_SPSC);
+
+    consumer_producer_put(&queue, strdup("a"));
+    consumer_producer_put(&queue, strdup("b"));
+    if (queue_is_full(&queue))
+        TEST_FAIL("Queue reported full too early");
+
+    consumer_producer_put(&queue, strdup("c"));
+    if (!queue_is_full(&queue))
+        TEST_FAIL("Queue should be full at its logical capacity, not the ring size");
+
+    char* item = consumer_producer_get(&queue);
+    if (item == NULL || strcmp(item, "a") != 0)
+        TEST_FAIL("SPSC get did not return the oldest item");
+    free(item);
+
+    // Leave two items behind: destroy must free them
+    consumer_producer_destroy(&queue);
+    TEST_PASS("SPSC honors the requested capacity");
+}
+
+void test_spsc_finished_drains_then_null() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+
+    consumer_producer_put(&queue, strdup("last"));
+    consumer_producer_signal_finished(&queue);
+
+    if (consumer_producer_put(&queue, strdup("late")) == NULL)
+        TEST_FAIL("Put after finished should fail");
+
+    char* item = consumer_producer_get(&queue);
+    if (item == NULL || strcmp(item, "last") != 0)
+        TEST_FAIL("Items queued before finished must still be delivered");
+    free(item);
+
+    if (consumer_producer_get(&queue) != NULL)
+        TEST_FAIL("Get on finished and empty queue should return NULL");
+
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished should succeed once drained");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("SPSC finished semantics");
+}
+
+void* finish_waiter(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += 5;
+    return (void*)(long)consumer_producer_wait_finished_timed(queue, &deadline);
+}
+
+void test_spsc_every_finish_waiter_released() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    consumer_producer_put(&queue, strdup("a"));
+
+    // Both waiters sleep before finished; neither may swallow the wakeup of the other
+    pthread_t waiters[2];
+    for (int i = 0; i < 2; ++i)
+        pthread_create(&waiters[i], NULL, finish_waiter, &queue);
+    struct timespec pause = { 0, 20 * 1000000L };
+    nanosleep(&pause, NULL);
+    consumer_producer_signal_finished(&queue);
+    nanosleep(&pause, NULL);
+    free(consumer_producer_get(&queue));
+
+    for (int i = 0; i < 2; ++i) {
+        void* rc;
+        pthread_join(waiters[i], &rc);
+        if ((long)rc != 0)
+            TEST_FAIL("Every wait_finished caller should return once the ring is drained");
+    }
+    consumer_producer_destroy(&queue);
+    TEST_PASS("SPSC wait_finished releases every waiter");
+}
+
+void* stream_producer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    char buf[32];
+    for (int i = 0; i < STREAM_ITEMS; ++i) {
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (consumer_producer_put(queue, strdup(buf)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(queue);
+    return NULL;
+}
+
+void* stream_consumer(void* arg) {
+    consumer_producer_t* queue = (consumer_producer_t*)arg;
+    long expected = 0;
+    char* item;
+    while ((item = consumer_producer_get(queue)) != NULL) {
+        if (strtol(item, NULL, 10) != expected)
+            TEST_FAIL("SPSC stream delivered items out of order");
+        expected++;
+        free(item);
+    }
+    if (expected != STREAM_ITEMS)
+        TEST_FAIL("SPSC stream lost items");
+    return NULL;
+}
+
+void test_spsc_threaded_stream() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 2, CP_MODE_SPSC);
+
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, stream_consumer, &queue);
+    pthread_create(&producer, NULL, stream_producer, &queue);
+
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished failed during stream");
+
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    consumer_producer_destroy(&queue);
+    TEST_PASS("SPSC threaded stream keeps FIFO order with a tiny ring");
+}
+
+int main() {
+    printf("=== Testing consumer_producer SPSC mode ===\n");
+    test_spsc_init_rounds_ring();
+    test_spsc_invalid_mode();
+    test_spsc_respects_logical_capacity();
+    test_spsc_finished_drains_then_null();
+    test_spsc_every_finish_waiter_released();
+    test_spsc_threaded_stream();
+    printf(GREEN "All SPSC tests passed.\n" NC);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+static const consumer_producer_mode_t MODES[] = { CP_MODE_LOCKED, CP_MODE_SPSC, CP_MODE_MPMC };
+#define MODE_COUNT (sizeof(MODES) / sizeof(MODES[0]))
+
+void test_deadline_after() {
+    struct timespec before, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &before);
+    consumer_producer_deadline_after(&deadline, 1999);
+
+    if (deadline.tv_nsec < 0 || deadline.tv_nsec >= 1000000000L)
+        TEST_FAIL("Deadline nanoseconds not normalized");
+    long diff_ms = (deadline.tv_sec - before.tv_sec) * 1000L + (deadline.tv_nsec - before.tv_nsec) / 1000000L;
+    if (diff_ms < 1999 || diff_ms > 2100)
+        TEST_FAIL("Deadline not timeout_ms in the future");
+
+    TEST_PASS("deadline_after computes a normalized monotonic deadline");
+}
+
+void test_try_operations() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        init_mode(&queue, 1, MODES[m]);
+        char* item = NULL;
+
+        if (consumer_producer_try_get(&queue, &item) != CP_TIMEDOUT)
+            TEST_FAIL("try_get on an empty queue should report CP_TIMEDOUT");
+
+        if (consumer_producer_try_put(&queue, strdup("a")) != NULL)
+            TEST_FAIL("try_put with room should succeed");
+
+        char* extra = strdup("b");
+        if (consumer_producer_try_put(&queue, extra) != CP_ERR_TIMEOUT)
+            TEST_FAIL("try_put on a full queue should return CP_ERR_TIMEOUT");
+        free(extra);    // Rejected: still ours
+
+        if (consumer_producer_try_get(&queue, &item) != 1 || strcmp(item, "a") != 0)
+            TEST_FAIL("try_get should return the queued item");
+        free(item);
+
+        consumer_producer_signal_finished(&queue);
+        if (consumer_producer_try_get(&queue, &item) != 0)
+            TEST_FAIL("try_get on a finished and drained queue should return 0");
+
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("try_put/try_get never block and report full/empty/finished");
+}
+
+void test_timed_operations_expire() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        init_mode(&queue, 1, MODES[m]);
+        struct timespec start, deadline;
+        char* item = NULL;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        consumer_producer_deadline_after(&deadline, 50);
+        if (consumer_producer_get_timed(&queue, &item, &deadline) != CP_TIMEDOUT)
+            TEST_FAIL("get_timed on an empty queue should time out");
+        long waited = elapsed_ms(&start);
+        if (waited < 45 || waited > 2000)
+            TEST_FAIL("get_timed did not honor its deadline");
+
+        consumer_producer_put(&queue, strdup("x"));
+        char* extra = strdup("y");
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        consumer_producer_deadline_after(&deadline, 50);
+        if (consumer_producer_put_timed(&queue, extra, &deadline) != CP_ERR_TIMEOUT)
+            TEST_FAIL("put_timed on a full queue should time out");
+        waited = elapsed_ms(&start);
+        if (waited < 45 || waited > 2000)
+            TEST_FAIL("put_timed did not honor its deadline");
+        free(extra);
+
+        consumer_producer_deadline_after(&deadline, 50);
+        if (consumer_producer_wait_finished_timed(&queue, &deadline) != CP_TIMEDOUT)
+            TEST_FAIL("wait_finished_timed should time out while not finished");
+
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Timed put/get/wait_finished give up at their deadline");
+}
+
+typedef struct {
+    consumer_producer_t* queue;
+    long delay_ms;
+} delayed_args_t;
+
+void* delayed_put_then_finish(void* arg) {
+    delayed_args_t* a = (delayed_args_t*)arg;
+    sleep_ms(a->delay_ms);
+    consumer_producer_put(a->queue, strdup("late"));
+    consumer_producer_put(a->queue, strdup("later"));
+    consumer_producer_signal_finished(a->queue);
+    return NULL;
+}
+
+void test_timed_operations_wake_early() {
+    for (size_t m = 0; m < MODE_COUNT; ++m) {
+        consumer_producer_t queue;
+        init_mode(&queue, 4, MODES[m]);
+        delayed_args_t args = { &queue, 20 };
+        struct timespec start, deadline;
+        pthread_t producer;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_create(&producer, NULL, delayed_put_then_finish, &args);
+
+        char* out[4] = { NULL };
+        consumer_producer_deadline_after(&deadline, 5000);
+        int n = consumer_producer_get_batch_timed(&queue, out, 4, &deadline);
+        if (n < 1 || strcmp(out[0], "late") != 0)
+            TEST_FAIL("get_batch_timed should return the item put before the deadline");
+        if (elapsed_ms(&start) > 2000)
+            TEST_FAIL("get_batch_timed waited for the deadline instead of the item");
+        for (int i = 0; i < n; ++i)
+            free(out[i]);
+
+        // Drain whatever is left, then wait_finished_timed must succeed well before its deadline
+        char* item;
+        while (consumer_producer_get_timed(&queue, &item, &deadline) == 1)
+            free(item);
+        if (consumer_producer_wait_finished_timed(&queue, &deadline) != 0)
+            TEST_FAIL("wait_finished_timed should succeed once finished and drained");
+
+        pthread_join(producer, NULL);
+        consumer_producer_destroy(&queue);
+    }
+    TEST_PASS("Timed calls return as soon as the queue state allows");
+}
+
+int main() {
+    printf("=== Testing consumer_producer timed and non-blocking operations ===\n");
+    test_deadline_after();
+    test_try_operations();
+    test_timed_operations_expire();
+    test_timed_operations_wake_early();
+    printf(GREEN "All timed operation tests passed.\n" NC);
+    return 0;
+}
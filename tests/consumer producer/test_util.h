@@ -0,0 +1,70 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+/* Fixtures shared by the queue tests in this directory (not by the original unit tests) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../plugins/sync/consumer_producer.h"
+
+// Output colors
+#define RED     "\033[0;31m"
+#define GREEN   "\033[0;32m"
+#define NC      "\033[0m"
+
+#define TEST_PASS(msg) printf(GREEN "[PASS] " NC msg "\n")
+#define TEST_FAIL(msg) do { printf(RED "[FAIL] " NC msg "\n"); exit(1); } while(0)
+
+static inline void sleep_us(long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static inline void sleep_ms(long ms) {
+    sleep_us(ms * 1000);
+}
+
+// Milliseconds elapsed since start (CLOCK_MONOTONIC)
+static inline long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+// Initialize a zeroed queue in the given mode
+static inline void init_mode(consumer_producer_t* queue, int capacity, consumer_producer_mode_t mode) {
+    memset(queue, 0, sizeof(*queue));
+    if (consumer_producer_init_mode(queue, capacity, mode) != NULL)
+        TEST_FAIL("Queue initialization failed");
+}
+
+static inline void init_queue(consumer_producer_t* queue, int capacity) {
+    init_mode(queue, capacity, CP_MODE_LOCKED);
+}
+
+// Heap string holding the decimal number i
+static inline char* item_for(int i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", i);
+    return strdup(buf);
+}
+
+// Take the next item and compare it with the expected string
+static inline void expect_next(consumer_producer_t* queue, const char* expected) {
+    char* item = consumer_producer_get(queue);
+    if (item == NULL || strcmp(item, expected) != 0)
+        TEST_FAIL("Got a different item than expected (wrong order or wrong item kept)");
+    free(item);
+}
+
+// Initialize a zeroed queue on the given backend
+static inline void init_backend(consumer_producer_t* queue, int capacity, const cp_backend_t* backend) {
+    memset(queue, 0, sizeof(*queue));
+    if (consumer_producer_init_backend(queue, capacity, backend) != NULL)
+        TEST_FAIL("Queue initialization failed");
+}
+
+#endif // TEST_UTIL_H
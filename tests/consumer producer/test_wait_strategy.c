@@ -0,0 +1,132 @@
+#include <pthread.h>
+
+#include "test_util.h"
+
+#define STREAM_ITEMS 100000
+#define SLOW_ITEMS   20
+
+typedef struct {
+    consumer_producer_t* queue;
+    int items;
+    long delay_us;      // Pause between two puts (0 = as fast as possible)
+} stream_args_t;
+
+void* stream_producer(void* arg) {
+    stream_args_t* a = (stream_args_t*)arg;
+    char buf[32];
+    for (int i = 0; i < a->items; ++i) {
+        if (a->delay_us > 0)
+            sleep_us(a->delay_us);
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (consumer_producer_put(a->queue, strdup(buf)) != NULL)
+            TEST_FAIL("Producer put failed");
+    }
+    consumer_producer_signal_finished(a->queue);
+    return NULL;
+}
+
+void* stream_consumer(void* arg) {
+    stream_args_t* a = (stream_args_t*)arg;
+    long expected = 0;
+    char* item;
+    while ((item = consumer_producer_get(a->queue)) != NULL) {
+        if (strtol(item, NULL, 10) != expected)
+            TEST_FAIL("Stream delivered items out of order");
+        expected++;
+        free(item);
+    }
+    if (expected != a->items)
+        TEST_FAIL("Stream lost items");
+    return NULL;
+}
+
+static void run_stream(consumer_producer_t* queue, int items, long delay_us) {
+    stream_args_t args = { queue, items, delay_us };
+    pthread_t producer, consumer;
+    pthread_create(&consumer, NULL, stream_consumer, &args);
+    pthread_create(&producer, NULL, stream_producer, &args);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+}
+
+void test_set_wait_strategy_validation() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+
+    if (consumer_producer_set_wait_strategy(NULL, CP_WAIT_SPIN, 10) == NULL)
+        TEST_FAIL("NULL queue should be rejected");
+    if (consumer_producer_set_wait_strategy(&queue, CP_WAIT_SPIN, 10) == NULL)
+        TEST_FAIL("Uninitialized queue should be rejected");
+
+    consumer_producer_init(&queue, 4);
+    if (queue.wait_strategy != CP_WAIT_PARK)
+        TEST_FAIL("Default wait strategy should be park");
+    if (consumer_producer_set_wait_strategy(&queue, (consumer_producer_wait_t)9, 10) == NULL)
+        TEST_FAIL("Unknown wait strategy should be rejected");
+    if (consumer_producer_set_wait_strategy(&queue, CP_WAIT_SPIN, -1) == NULL)
+        TEST_FAIL("Negative spin limit should be rejected");
+
+    if (consumer_producer_set_wait_strategy(&queue, CP_WAIT_SPIN, 0) != NULL)
+        TEST_FAIL("Valid spin strategy rejected");
+    if (queue.spin_limit != CP_SPIN_DEFAULT || atomic_load(&queue.consumer_spin.budget) != CP_SPIN_DEFAULT)
+        TEST_FAIL("Spin limit 0 should select the default budget");
+
+    if (consumer_producer_set_wait_strategy(&queue, CP_WAIT_PARK, 500) != NULL)
+        TEST_FAIL("Valid park strategy rejected");
+    if (atomic_load(&queue.producer_spin.budget) != 0)
+        TEST_FAIL("Park strategy should not spin");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("set_wait_strategy validates its input");
+}
+
+void test_spin_stream(consumer_producer_mode_t mode, consumer_producer_wait_t strategy) {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    if (consumer_producer_init_mode(&queue, 2, mode) != NULL)
+        TEST_FAIL("Queue initialization failed");
+    if (consumer_producer_set_wait_strategy(&queue, strategy, 2000) != NULL)
+        TEST_FAIL("set_wait_strategy failed");
+
+    run_stream(&queue, STREAM_ITEMS, 0);
+    if (consumer_producer_wait_finished(&queue) != 0)
+        TEST_FAIL("wait_finished failed after a spinning stream");
+    consumer_producer_destroy(&queue);
+}
+
+void test_spin_streams() {
+    test_spin_stream(CP_MODE_LOCKED, CP_WAIT_SPIN);
+    test_spin_stream(CP_MODE_SPSC, CP_WAIT_SPIN);
+    test_spin_stream(CP_MODE_LOCKED, CP_WAIT_ADAPTIVE);
+    test_spin_stream(CP_MODE_SPSC, CP_WAIT_ADAPTIVE);
+    test_spin_stream(CP_MODE_MPMC, CP_WAIT_SPIN);
+    test_spin_stream(CP_MODE_MPMC, CP_WAIT_ADAPTIVE);
+    TEST_PASS("Spinning and adaptive waits keep FIFO order in every queue mode");
+}
+
+void test_adaptive_parks_on_cold_stream() {
+    consumer_producer_t queue;
+    memset(&queue, 0, sizeof(queue));
+    consumer_producer_init_mode(&queue, 4, CP_MODE_SPSC);
+    consumer_producer_set_wait_strategy(&queue, CP_WAIT_ADAPTIVE, 1000);
+
+    // Items 5ms apart: far longer than 1000 pause iterations, spinning cannot pay off
+    run_stream(&queue, SLOW_ITEMS, 5000);
+
+    if (atomic_load(&queue.consumer_spin.budget) != 0)
+        TEST_FAIL("Adaptive consumer should stop spinning when items arrive rarely");
+    if (atomic_load(&queue.consumer_spin.avg_wait_ns) < 1000000)
+        TEST_FAIL("Adaptive consumer should have observed the slow inter-arrival time");
+
+    consumer_producer_destroy(&queue);
+    TEST_PASS("Adaptive wait falls back to parking on a cold stream");
+}
+
+int main() {
+    printf("=== Testing consumer_producer wait strategies ===\n");
+    test_set_wait_strategy_validation();
+    test_spin_streams();
+    test_adaptive_parks_on_cold_stream();
+    printf(GREEN "All wait strategy tests passed.\n" NC);
+    return 0;
+}
@@ -14,8 +14,13 @@ TEST_DIR="./"
 MONITOR_SRC="../../plugins/sync/monitor.c"
 INCLUDE_DIR="../../"
 OUTPUT_DIR="./output_tests"
+# MONITOR_IMPL=futex ./build_test.sh runs the same tests against the futex backend
+SYNC_FLAGS=""
+if [ "${MONITOR_IMPL:-pthread}" = "futex" ]; then
+    SYNC_FLAGS="-DMONITOR_USE_FUTEX"
+fi
 
-TESTS=("test_init" "test_destroy" "test_signal" "test_reset" "test_wait" "test_integration")
+TESTS=("test_init" "test_destroy" "test_signal" "test_reset" "test_wait" "test_timedwait" "test_stats" "test_integration")
 
 # ===========================
 # Prepare output directory
@@ -32,7 +37,7 @@ for test in "${TESTS[@]}"; do
     echo -e "${GREEN}[BUILD] Compiling ${test}.c...${NC}"
     gcc "$TEST_DIR/${test}.c" "$MONITOR_SRC" \
         -I"$INCLUDE_DIR" -lpthread \
-        -Wall -Wextra -Werror -Wno-unused-parameter \
+        -Wall -Wextra -Werror -Wno-unused-parameter $SYNC_FLAGS \
         -o "$OUTPUT_DIR/$test"
 
     if [ $? -ne 0 ]; then
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "../../plugins/sync/monitor.h"
+
+#define GREEN "\033[0;32m"
+#define RED "\033[0;31m"
+#define NC "\033[0m" // No Color
+
+/*
+ * Helper: absolute CLOCK_MONOTONIC deadline ms milliseconds from now
+ */
+static struct timespec deadline_in_ms(long ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/*
+ * Test 1: monitor_get_stats with NULL / uninitialized monitor
+ * Expected: return -1
+ */
+void test_monitor_stats_invalid() {
+    printf("[TEST] test_monitor_stats_invalid...\n");
+    monitor_t monitor;
+    monitor_stats_t stats;
+    monitor.initialized = 0;
+    if (monitor_get_stats(NULL, &stats) == -1 && monitor_get_stats(&monitor, &stats) == -1) {
+        printf(GREEN "[PASS] test_monitor_stats_invalid passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_stats_invalid: Expected -1 for NULL or uninitialized monitor.\n" NC);
+    }
+}
+
+/*
+ * Test 2: Waits on a remembered signal
+ * Expected: every call is counted, none of them sleeps
+ */
+void test_monitor_stats_remembered_signal() {
+    printf("[TEST] test_monitor_stats_remembered_signal...\n");
+    monitor_t monitor;
+    monitor_stats_t stats;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+    monitor_signal(&monitor);
+    monitor_wait(&monitor);
+    monitor_wait(&monitor);
+    struct timespec deadline = deadline_in_ms(1000);
+    monitor_timedwait(&monitor, &deadline);
+    if (monitor_get_stats(&monitor, &stats) == 0 && stats.waits == 3 && stats.sleeps == 0 &&
+        stats.spurious_wakeups == 0) {
+        printf(GREEN "[PASS] test_monitor_stats_remembered_signal passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_stats_remembered_signal: Expected 3 waits, 0 sleeps (got %ld, %ld).\n" NC,
+               stats.waits, stats.sleeps);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * Test 3: A wait that blocks until another thread signals, and one that times out
+ * Expected: both are counted as sleeps; the timeout is not a spurious wakeup
+ */
+void* delayed_signal_thread(void* arg) {
+    usleep(20000);
+    monitor_signal((monitor_t*)arg);
+    return NULL;
+}
+
+void test_monitor_stats_sleeps() {
+    printf("[TEST] test_monitor_stats_sleeps...\n");
+    monitor_t monitor;
+    monitor_stats_t stats;
+    pthread_t tid;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+
+    struct timespec deadline = deadline_in_ms(20);
+    int expired = monitor_timedwait(&monitor, &deadline);
+
+    pthread_create(&tid, NULL, delayed_signal_thread, &monitor);
+    monitor_wait(&monitor);
+    pthread_join(tid, NULL);
+
+    if (expired == 1 && monitor_get_stats(&monitor, &stats) == 0 && stats.waits == 2 && stats.sleeps == 2 &&
+        stats.spurious_wakeups == 0) {
+        printf(GREEN "[PASS] test_monitor_stats_sleeps passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_stats_sleeps: Expected 2 waits, 2 sleeps, 0 spurious (got %ld, %ld, %ld).\n" NC,
+               stats.waits, stats.sleeps, stats.spurious_wakeups);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * Test 4: Counters start over after destroy + init
+ * Expected: all zero
+ */
+void test_monitor_stats_reset_on_init() {
+    printf("[TEST] test_monitor_stats_reset_on_init...\n");
+    monitor_t monitor;
+    monitor_stats_t stats;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+    monitor_signal(&monitor);
+    monitor_wait(&monitor);
+    monitor_destroy(&monitor);
+    monitor_init(&monitor);
+    if (monitor_get_stats(&monitor, &stats) == 0 && stats.waits == 0 && stats.sleeps == 0 &&
+        stats.spurious_wakeups == 0) {
+        printf(GREEN "[PASS] test_monitor_stats_reset_on_init passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_stats_reset_on_init: Expected zeroed counters after init.\n" NC);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * MAIN FUNCTION TO RUN ALL STATS TESTS
+ */
+int main() {
+    printf("=== Running monitor_get_stats unit tests ===\n");
+    test_monitor_stats_invalid();
+    test_monitor_stats_remembered_signal();
+    test_monitor_stats_sleeps();
+    test_monitor_stats_reset_on_init();
+    printf(GREEN "✅ All monitor_get_stats tests finished.\n" NC);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "../../plugins/sync/monitor.h"
+
+#define GREEN "\033[0;32m"
+#define RED "\033[0;31m"
+#define NC "\033[0m" // No Color
+
+/*
+ * Helper: absolute CLOCK_MONOTONIC deadline ms milliseconds from now
+ */
+static struct timespec deadline_in_ms(long ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static long ms_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+/*
+ * Test 1: monitor_timedwait with NULL / uninitialized monitor
+ * Expected: return -1
+ */
+void test_monitor_timedwait_invalid() {
+    printf("[TEST] test_monitor_timedwait_invalid...\n");
+    struct timespec deadline = deadline_in_ms(10);
+    monitor_t monitor;
+    monitor.initialized = 0;
+    if (monitor_timedwait(NULL, &deadline) == -1 && monitor_timedwait(&monitor, &deadline) == -1) {
+        printf(GREEN "[PASS] test_monitor_timedwait_invalid passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_timedwait_invalid: Expected -1 for NULL or uninitialized monitor.\n" NC);
+    }
+}
+
+/*
+ * Test 2: Signal before timed wait
+ * Expected: returns 0 immediately
+ */
+void test_monitor_timedwait_signal_before_wait() {
+    printf("[TEST] test_monitor_timedwait_signal_before_wait...\n");
+    monitor_t monitor;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+    monitor_signal(&monitor);
+    struct timespec deadline = deadline_in_ms(1000);
+    if (monitor_timedwait(&monitor, &deadline) == 0) {
+        printf(GREEN "[PASS] test_monitor_timedwait_signal_before_wait passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_timedwait_signal_before_wait: Expected 0 for a remembered signal.\n" NC);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * Test 3: No signal at all
+ * Expected: returns 1 once the deadline passed, not earlier
+ */
+void test_monitor_timedwait_expires() {
+    printf("[TEST] test_monitor_timedwait_expires...\n");
+    monitor_t monitor;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline = deadline_in_ms(50);
+    int res = monitor_timedwait(&monitor, &deadline);
+    long waited = ms_since(&start);
+    if (res == 1 && waited >= 45) {
+        printf(GREEN "[PASS] test_monitor_timedwait_expires passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_timedwait_expires: Expected 1 after ~50ms (got %d after %ldms).\n" NC, res, waited);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * Test 4: Signal from another thread before the deadline
+ * Expected: returns 0 well before the deadline
+ */
+void* delayed_signal_thread(void* arg) {
+    usleep(20000);
+    monitor_signal((monitor_t*)arg);
+    return NULL;
+}
+
+void test_monitor_timedwait_signaled_in_time() {
+    printf("[TEST] test_monitor_timedwait_signaled_in_time...\n");
+    monitor_t monitor;
+    pthread_t tid;
+    monitor.initialized = 0;
+    monitor_init(&monitor);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&tid, NULL, delayed_signal_thread, &monitor);
+    struct timespec deadline = deadline_in_ms(5000);
+    int res = monitor_timedwait(&monitor, &deadline);
+    long waited = ms_since(&start);
+    pthread_join(tid, NULL);
+    if (res == 0 && waited < 2000) {
+        printf(GREEN "[PASS] test_monitor_timedwait_signaled_in_time passed successfully.\n" NC);
+    } else {
+        printf(RED "[FAIL] test_monitor_timedwait_signaled_in_time: Expected an early 0 (got %d after %ldms).\n" NC, res, waited);
+    }
+    monitor_destroy(&monitor);
+}
+
+/*
+ * MAIN FUNCTION TO RUN ALL TIMEDWAIT TESTS
+ */
+int main() {
+    printf("=== Running monitor_timedwait unit tests ===\n");
+    test_monitor_timedwait_invalid();
+    test_monitor_timedwait_signal_before_wait();
+    test_monitor_timedwait_expires();
+    test_monitor_timedwait_signaled_in_time();
+    printf(GREEN "✅ All monitor_timedwait tests finished.\n" NC);
+    return 0;
+}
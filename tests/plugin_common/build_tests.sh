@@ -29,7 +29,7 @@ compile_and_report "gcc -std=c11 -O2 -g -Wall -Wextra -pthread \
   -D_XOPEN_SOURCE=700 -D_POSIX_C_SOURCE=200809L \
   plugin_common_unit_tests.c \
   ../../plugins/plugin_common.c ../../plugins/logger.c \
-  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c \
+  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c ../../plugins/sync/buffer_pool.c ../../plugins/sync/message.c \
   -I../.. -I../../plugins \
   -o plugin_common_unit_tests"
 
@@ -41,7 +41,7 @@ compile_and_report "gcc -std=c11 -O2 -g -Wall -Wextra -pthread \
   -D_XOPEN_SOURCE=700 -D_POSIX_C_SOURCE=200809L \
   plugin_common_integration_tests.c \
   ../../plugins/plugin_common.c \
-  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c \
+  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c ../../plugins/sync/buffer_pool.c ../../plugins/sync/message.c \
   -I../.. -I../../plugins \
   -o plugin_common_integration_tests"
 
@@ -53,7 +53,7 @@ compile_and_report "gcc -std=c11 -O2 -g -Wall -Wextra -pthread \
   -D_XOPEN_SOURCE=700 -D_POSIX_C_SOURCE=200809L \
   extra_tests_plugin_common.c \
   ../../plugins/plugin_common.c \
-  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c \
+  ../../plugins/sync/consumer_producer.c ../../plugins/sync/monitor.c ../../plugins/sync/buffer_pool.c ../../plugins/sync/message.c \
   -I../.. -I../../plugins \
   -o extra_tests_plugin_common"
 
@@ -7,6 +7,9 @@
 //  4) No printing in common when last plugin
 //  5) Backpressure with slow consumer – order preserved
 //  6) Two parallel producers – all items delivered
+//  7) place_work_batch – order preserved across chunks
+//  8) attach_batch – outputs forwarded as batches, END still once
+//  9) instances – same plugin chained twice + a replica, next to the default instance
 //
 // Notes:
 //  - Colored PASS/FAIL output
@@ -284,6 +287,550 @@ static void t6_two_producers_parallel(void){
     collect_reset();
 }
 
+// ========== TEST 7: place_work_batch preserves order across chunks ==========
+static void t7_place_work_batch_order(void){
+    const char* TEST = "T7: place_work_batch (small queue, many chunks); order preserved";
+
+    collect_reset();
+
+    const char* err = common_plugin_init(proc_identity_same, "t7", 3);
+    if(err){ fail(TEST, err); return; }
+    plugin_attach(next_collect_no_print);
+
+    enum { N = 200 };
+    char storage[N][16];
+    const char* items[N];
+    for(int i=0;i<N;++i){ snprintf(storage[i],sizeof(storage[i]),"b%03d",i); items[i]=storage[i]; }
+
+    err = plugin_place_work_batch(items, N);
+    plugin_place_work("<END>");
+    plugin_wait_finished();
+    plugin_fini();
+
+    int ok = (err==NULL && g_collect_sz==N);
+    for(int i=0; ok && i<N; ++i){ if(strcmp(g_collect[i],storage[i])!=0) ok=0; }
+
+    if(ok) pass(TEST); else fail(TEST, "order/count mismatch");
+    collect_reset();
+}
+
+// ========== TEST 8: attach_batch forwards batches; END still forwarded once ==========
+static int g_batch_calls = 0, g_batch_items = 0, g_batch_end_seen = 0;
+static const char* next_batch_collect(const char* const* strs, int count){
+    ++g_batch_calls;
+    for(int i=0;i<count;++i){ if(!is_end_token(strs[i])){ collect_push(strs[i]); ++g_batch_items; } }
+    return NULL;
+}
+static const char* next_single_end_only(const char* s){
+    if(is_end_token(s)) ++g_batch_end_seen; else collect_push(s);
+    return NULL;
+}
+static void t8_attach_batch_forwards_batches(void){
+    const char* TEST = "T8: attach_batch forwards batches; END once";
+
+    collect_reset();
+    g_batch_calls = g_batch_items = g_batch_end_seen = 0;
+
+    const char* err = common_plugin_init(proc_slow_same, "t8", 64);
+    if(err){ fail(TEST, err); return; }
+    plugin_attach(next_single_end_only);
+    plugin_attach_batch(next_batch_collect);
+
+    const int N = 40;
+    char buf[16];
+    for(int i=0;i<N;++i){ snprintf(buf,sizeof(buf),"c%03d",i); plugin_place_work(buf); }
+    plugin_place_work("<END>");
+    plugin_wait_finished();
+    plugin_fini();
+
+    int ok = (g_batch_items==N && g_collect_sz==N && g_batch_end_seen==1 && g_batch_calls < N);
+    for(int i=0; ok && i<N; ++i){ snprintf(buf,sizeof(buf),"c%03d",i); if(strcmp(g_collect[i],buf)!=0) ok=0; }
+
+    if(ok) pass(TEST); else fail(TEST, "batch forwarding mismatch");
+    collect_reset();
+}
+
+// ========== TEST 9: instances of one plugin are independent stages ==========
+static const char* proc_append_x(const char* in){
+    size_t n = strlen(in);
+    char* out = (char*)malloc(n + 2);
+    if(!out) return NULL;
+    memcpy(out, in, n); out[n] = 'x'; out[n+1] = '\0';
+    return out;
+}
+static const char* next_collect_instance(void* instance, const char* s){
+    (void)instance;
+    return next_collect_no_print(s);
+}
+static void t9_instances_independent(void){
+    const char* TEST = "T9: instances chained twice + replica, default instance untouched";
+
+    collect_reset();
+
+    // Default instance (legacy symbols) stays up the whole time
+    const char* err = common_plugin_init(proc_identity_same, "t9", 4);
+    if(err){ fail(TEST, err); return; }
+
+    void *first = NULL, *second = NULL, *replica = NULL;
+    err = common_plugin_instance_init(proc_append_x, "t9", 2, NULL, &first);
+    if(!err) err = common_plugin_instance_init(proc_append_x, "t9", 2, "spsc", &second);
+    if(!err) err = common_plugin_instance_init(proc_append_x, "t9", 2, NULL, &replica);
+    void* none = NULL;
+    const char* bad = common_plugin_instance_init(proc_append_x, "t9", 2, "bogus", &none);
+    if(err || !bad || none){
+        fail(TEST, err ? err : "unknown backend accepted");
+        plugin_place_work("<END>"); plugin_fini();
+        return;
+    }
+
+    // first -> second -> collect: every item goes through the plugin twice
+    plugin_instance_attach(first, plugin_instance_place_work, second);
+    plugin_instance_attach_batch(first, plugin_instance_place_work_batch);
+    plugin_instance_attach_credits(first, plugin_instance_grant_credits);
+    plugin_instance_attach(second, next_collect_instance, NULL);
+
+    const int N = 30;
+    char buf[16];
+    for(int i=0;i<N;++i){ snprintf(buf,sizeof(buf),"i%03d",i); plugin_instance_place_work(first, buf); }
+    plugin_instance_place_work(first, "<END>");
+    plugin_instance_wait_finished(second);
+
+    int ok = (g_collect_sz==N);
+    for(int i=0; ok && i<N; ++i){ snprintf(buf,sizeof(buf),"i%03dxx",i); if(strcmp(g_collect[i],buf)!=0) ok=0; }
+
+    // The replica and the default instance are still running and unaffected
+    cp_stats_t stats;
+    ok = ok && plugin_instance_place_work(replica, "r") == NULL &&
+         plugin_instance_get_queue_stats(replica, &stats) == NULL && stats.capacity == 2 &&
+         plugin_get_queue_stats(&stats) == NULL && stats.capacity == 4;
+
+    plugin_instance_place_work(replica, "<END>");
+    ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL &&
+         plugin_instance_fini(replica) == NULL;
+    plugin_place_work("<END>");
+    ok = ok && plugin_fini() == NULL;
+
+    if(ok) pass(TEST); else fail(TEST, "instances interfered with each other");
+    collect_reset();
+}
+
+// ========== TEST 10: a worker pool releases its batches in input order ==========
+static const char* proc_uneven_append_x(const char* in){
+    if(atoi(in + 1) % 7 == 0) sleep_ms(3);   // Some batches finish long after the ones behind them
+    return proc_append_x(in);
+}
+static void t10_worker_pool_keeps_order(void){
+    const char* TEST = "T10: 4 workers, uneven transform; output in input order, reorder stats";
+
+    collect_reset();
+
+    void *pooled = NULL, *last = NULL, *single = NULL;
+    const char* err = common_plugin_instance_init(proc_uneven_append_x, "t10", 8, NULL, &pooled);
+    if(!err) err = common_plugin_instance_init(proc_identity_same, "t10", 8, NULL, &last);
+    if(!err) err = common_plugin_instance_init(proc_identity_same, "t10", 8, "spsc", &single);
+    if(err){ fail(TEST, err); return; }
+
+    int ok = plugin_instance_set_workers(pooled, 0) != NULL &&
+             plugin_instance_set_workers(pooled, PLUGIN_WORKERS_MAX + 1) != NULL &&
+             plugin_instance_set_workers(single, 2) != NULL &&
+             plugin_instance_set_workers(pooled, 4) == NULL;
+
+    // pooled -> last -> collect, with batches and credits between the two
+    plugin_instance_attach(pooled, plugin_instance_place_work, last);
+    plugin_instance_attach_batch(pooled, plugin_instance_place_work_batch);
+    plugin_instance_attach_credits(pooled, plugin_instance_grant_credits);
+    plugin_instance_attach(last, next_collect_instance, NULL);
+
+    const int N = 400;
+    char buf[16];
+    for(int i=0;i<N;++i){ snprintf(buf,sizeof(buf),"i%03d",i); plugin_instance_place_work(pooled, buf); }
+    plugin_instance_place_work(pooled, "<END>");
+    plugin_instance_wait_finished(last);
+
+    ok = ok && g_collect_sz==N;
+    for(int i=0; ok && i<N; ++i){ snprintf(buf,sizeof(buf),"i%03dx",i); if(strcmp(g_collect[i],buf)!=0) ok=0; }
+
+    plugin_pool_stats_t stats;
+    ok = ok && plugin_instance_get_pool_stats(pooled, &stats) == NULL && stats.workers == 4 &&
+         stats.batches > 0 && stats.reorder_depth == 0 && stats.reorder_peak <= 2 * 4 &&
+         (stats.parked > 0) == (stats.reorder_peak > 0) && (stats.parked > 0 || stats.hol_stall_ns == 0);
+    ok = ok && plugin_instance_get_pool_stats(last, &stats) == NULL && stats.workers == 1 && stats.batches == 0;
+
+    plugin_instance_place_work(single, "<END>");
+    ok = ok && plugin_instance_fini(pooled) == NULL && plugin_instance_fini(last) == NULL &&
+         plugin_instance_fini(single) == NULL;
+
+    if(ok) pass(TEST); else fail(TEST, "pool lost, reordered or miscounted batches");
+    collect_reset();
+}
+
+// ========== TEST 11: owned handoff moves buffers along the chain without copies ==========
+#define T11_N 50
+static const char* g_t11_out[T11_N];   // Buffers the first stage produced, by item number
+static const char* g_t11_in[T11_N];    // Buffers the second stage received, by item number
+static const char* proc_append_x_record(const char* in){
+    const char* out = proc_append_x(in);
+    g_t11_out[atoi(in + 1) % T11_N] = out;
+    return out;
+}
+static const char* proc_record_input(const char* in){
+    g_t11_in[atoi(in + 1) % T11_N] = in;
+    return in;
+}
+static int t11_run(int owned){
+    collect_reset();
+    void *first = NULL, *second = NULL;
+    const char* err = common_plugin_instance_init(proc_append_x_record, "t11", 4, NULL, &first);
+    if(!err) err = common_plugin_instance_init(proc_record_input, "t11", 4, NULL, &second);
+    if(err) return 0;
+
+    plugin_instance_attach(first, plugin_instance_place_work, second);
+    plugin_instance_attach_batch(first, plugin_instance_place_work_batch);
+    if(owned) plugin_instance_attach_owned(first, plugin_instance_place_work_owned, plugin_instance_place_work_owned_batch);
+    plugin_instance_attach(second, next_collect_instance, NULL);
+
+    char buf[16];
+    for(int i=0;i<T11_N;++i){ snprintf(buf,sizeof(buf),"i%03d",i); plugin_instance_place_work(first, buf); }
+    plugin_instance_place_work(first, "<END>");
+    plugin_instance_wait_finished(second);
+
+    int ok = (g_collect_sz==T11_N);
+    for(int i=0; ok && i<T11_N; ++i){
+        snprintf(buf,sizeof(buf),"i%03dx",i);
+        // Owned: the second stage works on the very buffer the first produced; copied: on its own copy
+        if(strcmp(g_collect[i],buf)!=0 || (g_t11_in[i]==g_t11_out[i]) != owned) ok=0;
+    }
+    ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL;
+    collect_reset();
+    return ok;
+}
+static void t11_owned_handoff_without_copies(void){
+    const char* TEST = "T11: attach_owned hands buffers downstream; failures free them";
+
+    int ok = t11_run(1) && t11_run(0);
+
+    // The callee owns what it is given even when it cannot queue it (checked under sanitizers)
+    plugin_context_t idle;
+    memset(&idle, 0, sizeof(idle));
+    char* batch[2] = { strdup("a"), strdup("b") };
+    ok = ok && plugin_instance_place_work_owned(&idle, strdup("x")) != NULL &&
+         plugin_instance_place_work_owned_batch(&idle, batch, 2) != NULL;
+
+    if(ok) pass(TEST); else fail(TEST, "outputs were copied, lost or reordered");
+}
+
+// ========== TEST 12: in-place transforms, including ones that need a larger buffer ==========
+static long inplace_append_x(char* buf, size_t* len, size_t capacity){
+    if(capacity < *len + 2) return (long)(*len + 2);
+    buf[(*len)++] = 'x';
+    buf[*len] = '\0';
+    return 0;
+}
+static void t12_inplace_transform_grows_buffers(void){
+    const char* TEST = "T12: in-place transform on heap and inline items; worker grows buffers on request";
+
+    int ok = 1;
+    const char* backends[] = { "locked", "inline" };
+    for(int b=0; ok && b<2; ++b){
+        collect_reset();
+        void* inst = NULL;
+        if(common_plugin_instance_init_inplace(proc_append_x, inplace_append_x, "t12", 4, backends[b], &inst) != NULL){
+            ok = 0; break;
+        }
+        plugin_instance_attach(inst, next_collect_instance, NULL);
+
+        // Short lines fit in an inline slot; the long one is a heap item that must be grown
+        char long_line[200];
+        memset(long_line, 'l', sizeof(long_line) - 1);
+        long_line[sizeof(long_line) - 1] = '\0';
+        plugin_instance_place_work(inst, "a");
+        plugin_instance_place_work(inst, long_line);
+        plugin_instance_place_work(inst, "bc");
+        plugin_instance_place_work(inst, "<END>");
+        plugin_instance_wait_finished(inst);
+
+        char long_out[sizeof(long_line) + 1];
+        snprintf(long_out, sizeof(long_out), "%sx", long_line);
+        ok = g_collect_sz==3 && strcmp(g_collect[0],"ax")==0 && strcmp(g_collect[1],long_out)==0 &&
+             strcmp(g_collect[2],"bcx")==0 && plugin_instance_fini(inst) == NULL;
+    }
+
+    if(ok) pass(TEST); else fail(TEST, "in-place outputs wrong");
+    collect_reset();
+}
+
+// ========== TEST 13: pooled buffers reach a steady state with no slab or malloc ==========
+#define T13_N 2000
+static int t13_run(void){
+    collect_reset();
+    void *first = NULL, *second = NULL;
+    const char* err = common_plugin_instance_init_inplace(proc_append_x, inplace_append_x, "t13", 8, NULL, &first);
+    if(!err) err = common_plugin_instance_init(proc_identity_same, "t13", 8, NULL, &second);
+    if(err) return 0;
+    plugin_instance_attach(first, plugin_instance_place_work, second);
+    plugin_instance_attach_owned(first, plugin_instance_place_work_owned, plugin_instance_place_work_owned_batch);
+    plugin_instance_attach(second, next_collect_instance, NULL);
+
+    // Copied into the pool here, grown in place by the first stage, freed by the second
+    char buf[16];
+    for(int i=0;i<T13_N;++i){ snprintf(buf,sizeof(buf),"p%04d",i); plugin_instance_place_work(first, buf); }
+    plugin_instance_place_work(first, "<END>");
+    plugin_instance_wait_finished(second);
+
+    int ok = g_collect_sz==T13_N && strcmp(g_collect[T13_N-1],"p1999x")==0;
+    ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL;
+    collect_reset();
+    return ok;
+}
+static void t13_buffer_pool_steady_state(void){
+    const char* TEST = "T13: buffers move between threads through the pool; a warm pool needs no slab or malloc";
+
+    buffer_pool_stats_t warm, done;
+    int ok = t13_run();
+    buffer_pool_flush_thread();
+    buffer_pool_get_stats(buffer_pool_current(), &warm);
+    ok = ok && t13_run();
+    buffer_pool_flush_thread();
+    buffer_pool_get_stats(buffer_pool_current(), &done);
+
+    if(!ok) fail(TEST, "chain outputs wrong");
+    else if(done.misses != warm.misses || done.fallbacks != warm.fallbacks) fail(TEST, "warm pool still allocating");
+    else if(done.hits - warm.hits < T13_N) fail(TEST, "buffers not reused");
+    else pass(TEST);
+}
+
+// ========== TEST 14: messages keep their length and number along the chain; shared ones are not overwritten ==========
+#define T14_N 100
+static unsigned long g_t14_seq[T14_N];  // Sequence number each output arrived with, by arrival
+static int g_t14_len_ok = 1;            // Every header length matched its text
+static int g_t14_sz = 0;
+static const char* proc_message_append_y(const char* in){
+    size_t n = message_length(in);
+    char* out = message_alloc(n + 1);
+    if(!out) return NULL;
+    memcpy(out, in, n); out[n] = 'y'; out[n+1] = '\0';
+    return out;
+}
+static const char* next_collect_message(void* instance, const char* s){
+    (void)instance;
+    if(!is_end(s) && g_t14_sz < T14_N){
+        message_t* msg = message_of(s);
+        g_t14_seq[g_t14_sz++] = msg != NULL ? msg->seq : 0;
+        if(msg == NULL || msg->length != strlen(s)) g_t14_len_ok = 0;
+    }
+    return next_collect_no_print(s);
+}
+static void t14_message_envelope_along_chain(void){
+    const char* TEST = "T14: messages carry length and sequence number across stages; shared messages are copied on write";
+
+    // In place (grows the message), then a new output message, both handed off without copies
+    collect_reset();
+    g_t14_sz = 0;
+    void *first = NULL, *second = NULL;
+    const char* err = common_plugin_instance_init_inplace(proc_append_x, inplace_append_x, "t14", 8, NULL, &first);
+    if(!err) err = common_plugin_instance_init(proc_message_append_y, "t14", 8, NULL, &second);
+    int ok = err == NULL;
+    if(ok){
+        plugin_instance_attach(first, plugin_instance_place_work, second);
+        plugin_instance_attach_owned(first, plugin_instance_place_work_owned, plugin_instance_place_work_owned_batch);
+        plugin_instance_attach(second, next_collect_message, NULL);
+
+        char buf[48];
+        for(int i=0;i<T14_N;++i){ snprintf(buf,sizeof(buf),"m%d%s",i, i%2 ? "-with-a-tail-past-the-first-class" : ""); plugin_instance_place_work(first, buf); }
+        plugin_instance_place_work(first, "<END>");
+        plugin_instance_wait_finished(second);
+
+        ok = g_collect_sz==T14_N && g_t14_sz==T14_N && g_t14_len_ok &&
+             strcmp(g_collect[1],"m1-with-a-tail-past-the-first-classxy")==0;
+        for(int i=0; ok && i<T14_N; ++i) if(g_t14_seq[i] != (unsigned long)i + 1) ok = 0;
+        ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL;
+    }
+
+    // One message given to two in-place stages: each rewrites its own copy, the original stays intact
+    collect_reset();
+    void *left = NULL, *right = NULL;
+    ok = ok && common_plugin_instance_init_inplace(proc_append_x, inplace_append_x, "t14", 4, NULL, &left) == NULL &&
+         common_plugin_instance_init_inplace(proc_append_x, inplace_append_x, "t14", 4, NULL, &right) == NULL;
+    if(ok){
+        plugin_instance_attach(left, next_collect_instance, NULL);
+        plugin_instance_attach(right, next_collect_instance, NULL);
+        char* shared = message_new("fan", 3);
+        char* for_right = message_ref(shared);
+        ok = plugin_instance_place_work_owned(left, message_ref(shared)) == NULL;
+        plugin_instance_place_work(left, "<END>");
+        plugin_instance_wait_finished(left);
+        ok = ok && plugin_instance_place_work_owned(right, for_right) == NULL;
+        plugin_instance_place_work(right, "<END>");
+        plugin_instance_wait_finished(right);
+        ok = ok && g_collect_sz==2 && strcmp(g_collect[0],"fanx")==0 && strcmp(g_collect[1],"fanx")==0 &&
+             strcmp(shared,"fan")==0 && message_length(shared)==3 && atomic_load(&message_of(shared)->refs)==1;
+        message_release(shared);
+        ok = ok && plugin_instance_fini(left) == NULL && plugin_instance_fini(right) == NULL;
+    }
+
+    if(ok) pass(TEST); else fail(TEST, "message metadata lost or shared message overwritten");
+    collect_reset();
+}
+
+// ========== TEST 15: END, FLUSH and BARRIER are control messages; an "<END>" line is data ==========
+static int g_t15_controls[PLUGIN_CONTROL_KINDS];
+static const char* proc_rotate_right(const char* in){
+    size_t n = message_length(in);
+    char* out = message_alloc(n);
+    if(!out) return NULL;
+    if(n > 0){ out[0] = in[n-1]; memcpy(out+1, in, n-1); }
+    out[n] = '\0';
+    return out;
+}
+static const char* next_collect_all(void* instance, const char* s){
+    (void)instance;
+    collect_push(s);    // Everything that arrives as a string is data here
+    return NULL;
+}
+static const char* next_count_control(void* instance, int kind){
+    (void)instance;
+    if(kind >= 0 && kind < PLUGIN_CONTROL_KINDS) g_t15_controls[kind]++;
+    return NULL;
+}
+static void t15_control_messages(void){
+    const char* TEST = "T15: controls travel in order between stages; a line that reads \"<END>\" is only data";
+
+    collect_reset();
+    memset(g_t15_controls, 0, sizeof(g_t15_controls));
+    void *first = NULL, *second = NULL;
+    const char* err = common_plugin_instance_init(proc_rotate_right, "t15", 4, NULL, &first);
+    if(!err) err = common_plugin_instance_init(proc_identity_same, "t15", 4, NULL, &second);
+    int ok = err == NULL && plugin_instance_set_workers(second, 3) == NULL;
+    if(ok){
+        plugin_instance_attach(first, plugin_instance_place_work, second);
+        plugin_instance_attach_batch(first, plugin_instance_place_work_batch);
+        plugin_instance_attach_control(first, plugin_instance_place_control);
+        plugin_instance_attach(second, next_collect_all, NULL);
+        plugin_instance_attach_control(second, next_count_control);
+
+        // The first stage turns "END><" into "<END>": the second stage must pass it on as a line
+        ok = plugin_instance_place_work(first, "END><") == NULL &&
+             plugin_instance_place_work(first, "ba") == NULL &&
+             plugin_instance_place_control(first, PLUGIN_CONTROL_FLUSH) == NULL &&
+             plugin_instance_place_work(first, "dc") == NULL &&
+             plugin_instance_place_control(first, PLUGIN_CONTROL_BARRIER) == NULL;
+
+        // Once the barrier passed the second stage, everything before it was delivered
+        ok = ok && plugin_instance_wait_barrier(second, 1) == NULL &&
+             g_collect_sz==3 && strcmp(g_collect[0],"<END>")==0 && strcmp(g_collect[1],"ab")==0 &&
+             strcmp(g_collect[2],"cd")==0 && g_t15_controls[PLUGIN_CONTROL_FLUSH]==1 &&
+             g_t15_controls[PLUGIN_CONTROL_BARRIER]==1;
+
+        // The string ABI's "<END>" still ends the stream, and crosses the stages as a control
+        ok = ok && plugin_instance_place_control(first, 99) != NULL &&
+             plugin_instance_place_work(first, "fe") == NULL && plugin_instance_place_work(first, "<END>") == NULL;
+        plugin_instance_wait_finished(second);
+        ok = ok && g_collect_sz==4 && strcmp(g_collect[3],"ef")==0 && g_t15_controls[PLUGIN_CONTROL_END]==1 &&
+             plugin_instance_wait_barrier(second, 2) != NULL;
+        ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL;
+    }
+
+    if(ok) pass(TEST); else fail(TEST, "control messages lost, out of order or mistaken for data");
+    collect_reset();
+}
+
+// ========== TEST 16: batch transforms take whole runs of lines; scalar stages and controls are unaffected ==========
+#define T16_N 500
+#define T16_LONG 4096   // Exactly a fresh worker's arena: appending asks for more
+static atomic_int g_t16_calls, g_t16_widest, g_t16_regrow;
+static const char* proc_append_z(const char* in){
+    size_t n = message_length(in);
+    char* out = message_alloc(n + 1);
+    if(!out) return NULL;
+    memcpy(out, in, n); out[n] = 'z'; out[n+1] = '\0';
+    return out;
+}
+static long batch_append_z(const plugin_batch_t* in, plugin_batch_t* out){
+    atomic_fetch_add(&g_t16_calls, 1);
+    int widest = atomic_load(&g_t16_widest);
+    while(in->count > widest && !atomic_compare_exchange_weak(&g_t16_widest, &widest, in->count)) {}
+    for(int i=0;i<in->count;++i)                  // A "fail" line fails its batch: the worker falls back to proc_append_z
+        if(in->offsets[i+1] - in->offsets[i] == 4 && memcmp(in->data + in->offsets[i], "fail", 4) == 0) return -1;
+
+    size_t need = in->offsets[in->count] + (size_t)in->count;
+    if(out->capacity < need){ atomic_fetch_add(&g_t16_regrow, 1); return (long)need; }
+    out->offsets[0] = 0;
+    for(int i=0;i<in->count;++i){
+        size_t n = in->offsets[i+1] - in->offsets[i];
+        memcpy(out->data + out->offsets[i], in->data + in->offsets[i], n);
+        out->data[out->offsets[i] + n] = 'z';
+        out->offsets[i+1] = out->offsets[i] + n + 1;
+    }
+    return 0;
+}
+static void t16_batch_transforms(void){
+    const char* TEST = "T16: batch transforms take runs of lines in one call, in order, around controls and scalar stages";
+
+    collect_reset();
+    memset(g_t15_controls, 0, sizeof(g_t15_controls));
+    atomic_store(&g_t16_calls, 0); atomic_store(&g_t16_widest, 0); atomic_store(&g_t16_regrow, 0);
+    void *first = NULL, *second = NULL, *third = NULL;
+    const char* err = common_plugin_instance_init_batch(proc_append_z, NULL, batch_append_z, "t16", 64, NULL, &first);
+    if(!err) err = common_plugin_instance_init_batch(proc_append_z, NULL, batch_append_z, "t16", 64, NULL, &second);
+    if(!err) err = common_plugin_instance_init(proc_rotate_right, "t16", 64, NULL, &third);
+    int ok = err == NULL && plugin_instance_set_workers(second, 3) == NULL;
+    if(ok){
+        plugin_instance_attach(first, plugin_instance_place_work, second);
+        plugin_instance_attach_owned(first, plugin_instance_place_work_owned, plugin_instance_place_work_owned_batch);
+        plugin_instance_attach_control(first, plugin_instance_place_control);
+        plugin_instance_attach(second, plugin_instance_place_work, third);
+        plugin_instance_attach_batch(second, plugin_instance_place_work_batch);
+        plugin_instance_attach_control(second, plugin_instance_place_control);
+        plugin_instance_attach(third, next_collect_all, NULL);
+        plugin_instance_attach_control(third, next_count_control);
+
+        // Runs of lines, a FLUSH in the middle and a failing batch
+        char bufs[50][16];
+        const char* strs[50];
+        for(int i=0;i<T16_N;i+=50){
+            for(int k=0;k<50;++k){ snprintf(bufs[k],sizeof(bufs[k]),"p%04d",i+k); strs[k]=bufs[k]; }
+            ok = ok && plugin_instance_place_work_batch(first, strs, 50) == NULL;
+            if(i == T16_N/2) ok = ok && plugin_instance_place_control(first, PLUGIN_CONTROL_FLUSH) == NULL;
+        }
+        ok = ok && plugin_instance_place_work(first, "fail") == NULL && plugin_instance_place_work(first, "<END>") == NULL;
+        plugin_instance_wait_finished(third);
+
+        // Each line went through both batch stages (+ "zz"), then the scalar rotation
+        ok = ok && g_collect_sz == T16_N + 1;
+        char want[16];
+        for(int i=0; ok && i<T16_N; ++i){
+            snprintf(want,sizeof(want),"zp%04dz",i);
+            if(strcmp(g_collect[i], want) != 0) ok = 0;
+        }
+        ok = ok && strcmp(g_collect[T16_N],"zfailz")==0 &&
+             g_t15_controls[PLUGIN_CONTROL_FLUSH]==1 && g_t15_controls[PLUGIN_CONTROL_END]==1 &&
+             atomic_load(&g_t16_widest) > 1 && atomic_load(&g_t16_calls) < 2 * (T16_N + 1);
+        ok = ok && plugin_instance_fini(first) == NULL && plugin_instance_fini(second) == NULL &&
+             plugin_instance_fini(third) == NULL;
+    }
+
+    // A new worker starts with an empty arena: a line that fills it makes the transform ask for more
+    collect_reset();
+    void* solo = NULL;
+    char* longline = (char*)malloc(T16_LONG + 1);
+    ok = ok && longline != NULL &&
+         common_plugin_instance_init_batch(proc_append_z, NULL, batch_append_z, "t16", 4, NULL, &solo) == NULL;
+    if(ok){
+        plugin_instance_attach(solo, next_collect_all, NULL);
+        plugin_instance_attach_control(solo, next_count_control);
+        memset(longline, 'l', T16_LONG); longline[T16_LONG] = '\0';
+        ok = plugin_instance_place_work(solo, longline) == NULL && plugin_instance_place_work(solo, "<END>") == NULL;
+        plugin_instance_wait_finished(solo);
+        ok = ok && g_collect_sz == 1 && strlen(g_collect[0]) == T16_LONG + 1 && g_collect[0][T16_LONG] == 'z' &&
+             strncmp(g_collect[0], longline, T16_LONG) == 0 && atomic_load(&g_t16_regrow) > 0;
+        ok = ok && plugin_instance_fini(solo) == NULL;
+    }
+    free(longline);
+
+    if(ok) pass(TEST); else fail(TEST, "batch outputs wrong, out of order, or lines not batched");
+    collect_reset();
+}
+
 // ========== main ==========
 int main(void){
     t1_end_flows_once_and_not_printed();
@@ -292,6 +839,16 @@ int main(void){
     t4_last_plugin_no_stdout();
     t5_backpressure_order_preserved();
     t6_two_producers_parallel();
+    t7_place_work_batch_order();
+    t8_attach_batch_forwards_batches();
+    t9_instances_independent();
+    t10_worker_pool_keeps_order();
+    t11_owned_handoff_without_copies();
+    t12_inplace_transform_grows_buffers();
+    t13_buffer_pool_steady_state();
+    t14_message_envelope_along_chain();
+    t15_control_messages();
+    t16_batch_transforms();
 
     fprintf(stdout, "\n");
     if(g_tests_failed==0){
@@ -15,16 +15,29 @@
 
 /* ---------- Stubs visible to expander.c ---------- */
 /* We test only plugin_transform; provide tiny stubs so we don't link the SDK. */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
-const char* common_plugin_init(const char* (*process_function)(const char*),
-                               const char* name, int queue_size) {
-    (void)process_function; (void)name; (void)queue_size;
-    return NULL; /* no-op in unit tests */
-}
+size_t message_length(const char* s) { return strlen(s); }
+char* message_alloc(size_t length) { return (char*)malloc(length + 1); } /* outputs are freed with free() below */
 
 /* Include the plugin under test after the stubs */
 #include "../../plugins/expander.c"
 
+/* Init stubs: they need plugin_batch_t, so they come after the plugin's header */
+const char* common_plugin_init_batch(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                     plugin_batch_fn batch_function, const char* name, int queue_size) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    return NULL; /* no-op in unit tests */
+}
+
+const char* common_plugin_instance_init_batch(const char* (*process_function)(const char*),
+                                              plugin_inplace_fn inplace_function, plugin_batch_fn batch_function,
+                                              const char* name, int queue_size,
+                                              const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    (void)queue_backend;
+    *out_instance = NULL;
+    return NULL; /* no-op in unit tests */
+}
+
 /* ---------- Tiny assertions & reporting ---------- */
 static int tests_failed = 0;
 
@@ -45,10 +58,12 @@ static void test_null_input(void) {
     report_test("expander: NULL input returns NULL", out == NULL);
 }
 
-static void test_end_token_passthrough(void) {
+static void test_end_text_is_data(void) {
+    /* END is a control message, so a line reading "<END>" is expanded like any other */
     const char* in = "<END>";
     const char* out = plugin_transform(in);
-    report_test("expander: <END> is passed through unchanged (same pointer)", out == in);
+    report_test("expander: a \"<END>\" line is ordinary data", out && out != in && strcmp(out, "< E N D >") == 0);
+    if (out && out != in) free((void*)out);
 }
 
 static void test_empty_string_passthrough(void) {
@@ -151,13 +166,64 @@ static void test_long_string_near_limit(void) {
     free(expected);
 }
 
+static void test_inplace_same_buffer(void) {
+    char buf[16] = "abc";
+    size_t len = 3;
+    long rc = plugin_transform_inplace(buf, &len, sizeof(buf));
+    int ok = (rc == 0) && (len == 5) && (strcmp(buf, "a b c") == 0);
+    report_test("expander: in-place transform expands within the capacity", ok);
+}
+
+static void test_inplace_asks_for_capacity(void) {
+    char buf[] = "abc";
+    size_t len = 3;
+    long rc = plugin_transform_inplace(buf, &len, sizeof(buf));
+    int ok = (rc == 6) && (len == 3) && (strcmp(buf, "abc") == 0);
+    report_test("expander: in-place transform asks for a larger buffer, leaving it untouched", ok);
+}
+
+/* Pack lines into a columnar batch (arena + offsets) */
+static void pack_batch(plugin_batch_t* b, char* arena, size_t* offsets, const char* const* lines, int count) {
+    b->data = arena;
+    b->offsets = offsets;
+    b->count = count;
+    offsets[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        size_t n = strlen(lines[i]);
+        memcpy(arena + offsets[i], lines[i], n);
+        offsets[i + 1] = offsets[i] + n;
+    }
+    b->capacity = offsets[count];
+}
+
+/* Does line i of a batch hold text? */
+static int batch_line_is(const plugin_batch_t* b, int i, const char* text) {
+    size_t n = b->offsets[i + 1] - b->offsets[i];
+    return n == strlen(text) && memcmp(b->data + b->offsets[i], text, n) == 0;
+}
+
+static void test_batch_expands_each_line(void) {
+    const char* lines[] = { "abc", "", "x", "hi" };
+    char arena[16], out_arena[16];
+    size_t offsets[5], out_offsets[5];
+    plugin_batch_t in, out = { out_arena, out_offsets, 4, 6 };
+    pack_batch(&in, arena, offsets, lines, 4);
+
+    /* 5 + 0 + 1 + 3 characters: too many for 6 bytes, fine for 16 */
+    int ok = plugin_transform_batch(&in, &out) == 9;
+    out.capacity = sizeof(out_arena);
+    ok = ok && plugin_transform_batch(&in, &out) == 0 && batch_line_is(&out, 0, "a b c") &&
+         batch_line_is(&out, 1, "") && batch_line_is(&out, 2, "x") && batch_line_is(&out, 3, "h i");
+    report_test("expander: batch transform asks for room, then expands each line", ok);
+}
+
 /* ---------- Main ---------- */
 int main(void) {
     fprintf(stderr, "======== [EXPANDER UNIT TESTS] ========\n");
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_passthrough();
+    test_end_text_is_data();
     test_empty_string_passthrough();
     test_single_char_passthrough();
     test_basic_expansion();
@@ -166,6 +232,9 @@ int main(void) {
     test_leading_trailing_spaces();
     test_digits_and_symbols_preserved();
     test_long_string_near_limit();
+    test_inplace_same_buffer();
+    test_inplace_asks_for_capacity();
+    test_batch_expands_each_line();
 
     fprintf(stderr, "\n");
     if (tests_failed == 0) {
@@ -15,16 +15,29 @@
 
 /* ---------- Stubs visible to flipper.c ---------- */
 /* We test only plugin_transform; provide tiny stubs so we don't link the SDK. */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
-const char* common_plugin_init(const char* (*process_function)(const char*),
-                               const char* name, int queue_size) {
-    (void)process_function; (void)name; (void)queue_size;
-    return NULL; /* no-op in unit tests */
-}
+size_t message_length(const char* s) { return strlen(s); }
+char* message_alloc(size_t length) { return (char*)malloc(length + 1); } /* outputs are freed with free() below */
 
 /* Include the plugin under test after the stubs */
 #include "../../plugins/flipper.c"
 
+/* Init stubs: they need plugin_batch_t, so they come after the plugin's header */
+const char* common_plugin_init_batch(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                     plugin_batch_fn batch_function, const char* name, int queue_size) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    return NULL; /* no-op in unit tests */
+}
+
+const char* common_plugin_instance_init_batch(const char* (*process_function)(const char*),
+                                              plugin_inplace_fn inplace_function, plugin_batch_fn batch_function,
+                                              const char* name, int queue_size,
+                                              const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    (void)queue_backend;
+    *out_instance = NULL;
+    return NULL; /* no-op in unit tests */
+}
+
 /* ---------- Tiny assertions & reporting ---------- */
 static int tests_failed = 0;
 
@@ -45,10 +58,12 @@ static void test_null_input(void) {
     report_test("flipper: NULL input returns NULL", out == NULL);
 }
 
-static void test_end_token_passthrough(void) {
+static void test_end_text_is_data(void) {
+    /* END is a control message, so a line reading "<END>" is flipped like any other */
     const char* in = "<END>";
     const char* out = plugin_transform(in);
-    report_test("flipper: <END> is passed through unchanged (same pointer)", out == in);
+    report_test("flipper: a \"<END>\" line is ordinary data", out && out != in && strcmp(out, ">DNE<") == 0);
+    if (out && out != in) free((void*)out);
 }
 
 static void test_empty_string_passthrough(void) {
@@ -131,13 +146,61 @@ static void test_long_string_near_limit(void) {
     free(expected);
 }
 
+static void test_inplace_same_buffer(void) {
+    char even[] = "abcd";
+    char odd[] = "abcde";
+    size_t even_len = 4, odd_len = 5;
+    int ok = plugin_transform_inplace(even, &even_len, sizeof(even)) == 0 &&
+             plugin_transform_inplace(odd, &odd_len, sizeof(odd)) == 0 &&
+             strcmp(even, "dcba") == 0 && strcmp(odd, "edcba") == 0 && even_len == 4 && odd_len == 5;
+    report_test("flipper: in-place transform reverses the buffer itself", ok);
+}
+
+static void test_inplace_invalid_input(void) {
+    size_t len = 0;
+    report_test("flipper: in-place transform rejects NULL",
+                plugin_transform_inplace(NULL, &len, 1) == -1);
+}
+
+/* Pack lines into a columnar batch (arena + offsets) */
+static void pack_batch(plugin_batch_t* b, char* arena, size_t* offsets, const char* const* lines, int count) {
+    b->data = arena;
+    b->offsets = offsets;
+    b->count = count;
+    offsets[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        size_t n = strlen(lines[i]);
+        memcpy(arena + offsets[i], lines[i], n);
+        offsets[i + 1] = offsets[i] + n;
+    }
+    b->capacity = offsets[count];
+}
+
+/* Does line i of a batch hold text? */
+static int batch_line_is(const plugin_batch_t* b, int i, const char* text) {
+    size_t n = b->offsets[i + 1] - b->offsets[i];
+    return n == strlen(text) && memcmp(b->data + b->offsets[i], text, n) == 0;
+}
+
+static void test_batch_reverses_each_line(void) {
+    const char* lines[] = { "abc", "", "x", "hello world" };
+    char arena[32], out_arena[32];
+    size_t offsets[5], out_offsets[5];
+    plugin_batch_t in, out = { out_arena, out_offsets, 4, sizeof(out_arena) };
+    pack_batch(&in, arena, offsets, lines, 4);
+    int ok = plugin_transform_batch(&in, &out) == 0 && batch_line_is(&out, 0, "cba") && batch_line_is(&out, 1, "") &&
+             batch_line_is(&out, 2, "x") && batch_line_is(&out, 3, "dlrow olleh");
+    report_test("flipper: batch transform reverses each line in place in the arena", ok);
+    report_test("flipper: batch transform rejects NULL", plugin_transform_batch(NULL, &out) == -1);
+}
+
 /* ---------- Main ---------- */
 int main(void) {
     fprintf(stderr, "======== [FLIPPER UNIT TESTS] ========\n");
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_passthrough();
+    test_end_text_is_data();
     test_empty_string_passthrough();
     test_single_char_passthrough();
     test_even_length_reverse();
@@ -145,6 +208,9 @@ int main(void) {
     test_spaces_and_punctuation_preserved();
     test_leading_trailing_spaces();
     test_long_string_near_limit();
+    test_inplace_same_buffer();
+    test_inplace_invalid_input();
+    test_batch_reverses_each_line();
 
     fprintf(stderr, "\n");
 
@@ -9,8 +9,6 @@
 #include <unistd.h>
 #include <errno.h>
 
-/* Stub for is_end("<END>") used by logger.c */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
 
 /* Stub for common_plugin_init used indirectly by logger.c via plugin_init.
    We don't test init here, so a no-op stub keeps the linker happy. */
@@ -20,6 +18,14 @@ const char* common_plugin_init(const char* (*process_function)(const char*),
     return NULL;
 }
 
+const char* common_plugin_instance_init(const char* (*process_function)(const char*),
+                                        const char* name, int queue_size,
+                                        const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)name; (void)queue_size; (void)queue_backend;
+    *out_instance = NULL;
+    return NULL;
+}
+
 #include "../../plugins/logger.c"
 
 /* ---------- Colors ---------- */
@@ -121,7 +127,8 @@ static void test_null_input(void) {
     free(captured);
 }
 
-static void test_end_token_no_output(void) {
+static void test_end_text_is_printed(void) {
+    /* END is a control message, so a line reading "<END>" is printed like any other */
     const char* in = "<END>";
 
     capture_t cap;
@@ -130,8 +137,8 @@ static void test_end_token_no_output(void) {
     fflush(stdout);
     char* captured = capture_end(&cap);
 
-    int ok = (out == in) && captured && (strcmp(captured, "") == 0);
-    report_test("logger: <END> prints nothing and passes pointer through", ok);
+    int ok = (out == in) && captured && (strcmp(captured, "[logger] <END>\n") == 0);
+    report_test("logger: a \"<END>\" line is printed like any other", ok);
 
     free(captured);
 }
@@ -187,7 +194,7 @@ int main(void) {
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_no_output();
+    test_end_text_is_printed();
     test_empty_string_prints_header_only();
     test_regular_string_prints_exactly();
     test_punctuation_and_spaces_kept();
@@ -15,10 +15,21 @@
 
 /* ---------- Stubs visible to rotator.c ---------- */
 /* We test only plugin_transform; provide tiny stubs so we don't link the SDK. */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
-const char* common_plugin_init(const char* (*process_function)(const char*),
-                               const char* name, int queue_size) {
-    (void)process_function; (void)name; (void)queue_size;
+size_t message_length(const char* s) { return strlen(s); }
+char* message_alloc(size_t length) { return (char*)malloc(length + 1); } /* outputs are freed with free() below */
+const char* common_plugin_init_inplace(const char* (*process_function)(const char*),
+                                       long (*inplace_function)(char*, size_t*, size_t),
+                                       const char* name, int queue_size) {
+    (void)process_function; (void)inplace_function; (void)name; (void)queue_size;
+    return NULL; /* no-op in unit tests */
+}
+
+const char* common_plugin_instance_init_inplace(const char* (*process_function)(const char*),
+                                                long (*inplace_function)(char*, size_t*, size_t),
+                                                const char* name, int queue_size,
+                                                const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)inplace_function; (void)name; (void)queue_size; (void)queue_backend;
+    *out_instance = NULL;
     return NULL; /* no-op in unit tests */
 }
 
@@ -45,10 +56,12 @@ static void test_null_input(void) {
     report_test("rotator: NULL input returns NULL", out == NULL);
 }
 
-static void test_end_token_passthrough(void) {
+static void test_end_text_is_data(void) {
+    /* END is a control message, so a line reading "<END>" is rotated like any other */
     const char* in = "<END>";
     const char* out = plugin_transform(in);
-    report_test("rotator: <END> is passed through unchanged (same pointer)", out == in);
+    report_test("rotator: a \"<END>\" line is ordinary data", out && out != in && strcmp(out, "><END") == 0);
+    if (out && out != in) free((void*)out);
 }
 
 static void test_empty_string_passthrough(void) {
@@ -142,13 +155,30 @@ static void test_long_string_near_limit(void) {
     free(expected);
 }
 
+static void test_inplace_same_buffer(void) {
+    char buf[] = "abcd";
+    size_t len = strlen(buf);
+    long rc = plugin_transform_inplace(buf, &len, sizeof(buf));
+    char one[] = "x";
+    size_t one_len = 1;
+    long rc1 = plugin_transform_inplace(one, &one_len, sizeof(one));
+    int ok = (rc == 0) && (len == 4) && (strcmp(buf, "dabc") == 0) && (rc1 == 0) && (strcmp(one, "x") == 0);
+    report_test("rotator: in-place transform rotates the buffer itself", ok);
+}
+
+static void test_inplace_invalid_input(void) {
+    size_t len = 0;
+    report_test("rotator: in-place transform rejects NULL",
+                plugin_transform_inplace(NULL, &len, 1) == -1);
+}
+
 /* ---------- Main ---------- */
 int main(void) {
     fprintf(stderr, "======== [ROTATOR UNIT TESTS] ========\n");
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_passthrough();
+    test_end_text_is_data();
     test_empty_string_passthrough();
     test_single_char_passthrough();
     test_len2_swap();
@@ -157,6 +187,8 @@ int main(void) {
     test_spaces_and_punctuation_preserved();
     test_leading_trailing_spaces();
     test_long_string_near_limit();
+    test_inplace_same_buffer();
+    test_inplace_invalid_input();
     fprintf(stderr, "\n");
 
     if (tests_failed == 0) {
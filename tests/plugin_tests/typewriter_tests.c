@@ -20,13 +20,21 @@
 
 /* ---------- Stubs visible to typewriter.c ---------- */
 /* We test only plugin_transform; provide tiny stubs so we don't link the SDK. */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
+size_t message_length(const char* s) { return strlen(s); }
 const char* common_plugin_init(const char* (*process_function)(const char*),
                                const char* name, int queue_size) {
     (void)process_function; (void)name; (void)queue_size;
     return NULL; /* no-op in unit tests */
 }
 
+const char* common_plugin_instance_init(const char* (*process_function)(const char*),
+                                        const char* name, int queue_size,
+                                        const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)name; (void)queue_size; (void)queue_backend;
+    *out_instance = NULL;
+    return NULL; /* no-op in unit tests */
+}
+
 /* Include the plugin under test after the stubs & usleep macro */
 #include "../../plugins/typewriter.c"
 
@@ -130,7 +138,8 @@ static void test_null_input(void) {
     free(captured);
 }
 
-static void test_end_token_no_output(void) {
+static void test_end_text_is_printed(void) {
+    /* END is a control message, so a line reading "<END>" is printed like any other */
     const char* in = "<END>";
 
     capture_t cap; capture_begin(&cap);
@@ -138,8 +147,8 @@ static void test_end_token_no_output(void) {
     fflush(stdout);
     char* captured = capture_end(&cap);
 
-    int ok = (out == in) && captured && (strcmp(captured, "") == 0);
-    report_test("typewriter: <END> prints nothing and passes pointer through", ok);
+    int ok = (out == in) && captured && (strcmp(captured, "[typewriter] <END>\n") == 0);
+    report_test("typewriter: a \"<END>\" line is printed like any other", ok);
 
     free(captured);
 }
@@ -257,7 +266,7 @@ int main(void) {
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_no_output();
+    test_end_text_is_printed();
     test_empty_string_prints_header_only();
     test_short_text_hi();
     test_punctuation_and_spaces();
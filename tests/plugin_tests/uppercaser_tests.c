@@ -15,16 +15,29 @@
 
 /* ---------- Stubs visible to uppercaser.c ---------- */
 /* We test only plugin_transform; provide tiny stubs so we don't link the SDK. */
-int is_end(const char* s) { return (s != NULL) && (strcmp(s, "<END>") == 0); }
-const char* common_plugin_init(const char* (*process_function)(const char*),
-                               const char* name, int queue_size) {
-    (void)process_function; (void)name; (void)queue_size;
-    return NULL; /* no-op in unit tests */
-}
+size_t message_length(const char* s) { return strlen(s); }
+char* message_alloc(size_t length) { return (char*)malloc(length + 1); } /* outputs are freed with free() below */
 
 /* Include the plugin under test after the stubs */
 #include "../../plugins/uppercaser.c"
 
+/* Init stubs: they need plugin_batch_t, so they come after the plugin's header */
+const char* common_plugin_init_batch(const char* (*process_function)(const char*), plugin_inplace_fn inplace_function,
+                                     plugin_batch_fn batch_function, const char* name, int queue_size) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    return NULL; /* no-op in unit tests */
+}
+
+const char* common_plugin_instance_init_batch(const char* (*process_function)(const char*),
+                                              plugin_inplace_fn inplace_function, plugin_batch_fn batch_function,
+                                              const char* name, int queue_size,
+                                              const char* queue_backend, void** out_instance) {
+    (void)process_function; (void)inplace_function; (void)batch_function; (void)name; (void)queue_size;
+    (void)queue_backend;
+    *out_instance = NULL;
+    return NULL; /* no-op in unit tests */
+}
+
 /* ---------- Tiny assertions & reporting ---------- */
 static int tests_failed = 0;
 
@@ -45,10 +58,12 @@ static void test_null_input(void) {
     report_test("uppercaser: NULL input returns NULL", out == NULL);
 }
 
-static void test_end_token_passthrough(void) {
+static void test_end_text_is_data(void) {
+    /* END is a control message, so a line reading "<END>" is uppercased like any other */
     const char* in = "<END>";
     const char* out = plugin_transform(in);
-    report_test("uppercaser: <END> is passed through unchanged (same pointer)", out == in);
+    report_test("uppercaser: a \"<END>\" line is ordinary data", out && out != in && strcmp(out, "<END>") == 0);
+    if (out && out != in) free((void*)out);
 }
 
 static void test_empty_string_passthrough(void) {
@@ -126,19 +141,82 @@ static void test_long_string_near_limit(void) {
     free(expected);
 }
 
+static void test_inplace_same_buffer(void) {
+    char buf[] = "HeLlo 123!";
+    size_t len = strlen(buf);
+    long rc = plugin_transform_inplace(buf, &len, sizeof(buf));
+    int ok = (rc == 0) && (len == 10) && (strcmp(buf, "HELLO 123!") == 0);
+    report_test("uppercaser: in-place transform rewrites the buffer itself", ok);
+}
+
+static void test_inplace_invalid_input(void) {
+    size_t len = 0;
+    report_test("uppercaser: in-place transform rejects NULL",
+                plugin_transform_inplace(NULL, &len, 1) == -1);
+}
+
+/* Pack lines into a columnar batch (arena + offsets) */
+static void pack_batch(plugin_batch_t* b, char* arena, size_t* offsets, const char* const* lines, int count) {
+    b->data = arena;
+    b->offsets = offsets;
+    b->count = count;
+    offsets[0] = 0;
+    for (int i = 0; i < count; ++i) {
+        size_t n = strlen(lines[i]);
+        memcpy(arena + offsets[i], lines[i], n);
+        offsets[i + 1] = offsets[i] + n;
+    }
+    b->capacity = offsets[count];
+}
+
+/* Does line i of a batch hold text? */
+static int batch_line_is(const plugin_batch_t* b, int i, const char* text) {
+    size_t n = b->offsets[i + 1] - b->offsets[i];
+    return n == strlen(text) && memcmp(b->data + b->offsets[i], text, n) == 0;
+}
+
+static void test_batch_whole_arena(void) {
+    /* Lines shorter and longer than a word, letters at word edges, bytes next to 'a'..'z' and non-ASCII */
+    const char* lines[] = { "hello", "", "a", "MiXeD 123 abcxyz`{@[", "caf\xc3\xa9 \xe1\xfa!", "zzzzzzzzzzzzzzzzq" };
+    const char* expect[] = { "HELLO", "", "A", "MIXED 123 ABCXYZ`{@[", "CAF\xc3\xa9 \xe1\xfa!", "ZZZZZZZZZZZZZZZZQ" };
+    char arena[128], out_arena[128];
+    size_t offsets[7], out_offsets[7];
+    plugin_batch_t in, out = { out_arena, out_offsets, 6, sizeof(out_arena) };
+    pack_batch(&in, arena, offsets, lines, 6);
+    int ok = plugin_transform_batch(&in, &out) == 0;
+    for (int i = 0; ok && i < 6; ++i) {
+        ok = batch_line_is(&out, i, expect[i]);
+    }
+    report_test("uppercaser: batch transform uppercases every line of the arena", ok);
+}
+
+static void test_batch_asks_for_capacity(void) {
+    const char* lines[] = { "abc", "de" };
+    char arena[8], out_arena[8];
+    size_t offsets[3], out_offsets[3];
+    plugin_batch_t in, out = { out_arena, out_offsets, 2, 4 };
+    pack_batch(&in, arena, offsets, lines, 2);
+    report_test("uppercaser: batch transform asks for a bigger arena",
+                plugin_transform_batch(&in, &out) == 5 && plugin_transform_batch(NULL, &out) == -1);
+}
+
 /* ---------- Main ---------- */
 int main(void) {
     fprintf(stderr, "======== [UPPERCASER UNIT TESTS] ========\n");
     fprintf(stderr, "\n");
 
     test_null_input();
-    test_end_token_passthrough();
+    test_end_text_is_data();
     test_empty_string_passthrough();
     test_mixed_case_conversion();
     test_already_uppercase_copy_same_content();
     test_no_letters_copy_same_content();
     test_single_char_lower_upper();
     test_long_string_near_limit();
+    test_inplace_same_buffer();
+    test_inplace_invalid_input();
+    test_batch_whole_arena();
+    test_batch_asks_for_capacity();
 
     fprintf(stderr, "\n");
 